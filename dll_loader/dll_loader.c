@@ -48,6 +48,12 @@ typedef struct IMAGE_BASE_RELOCATION {
   DWORD SizeOfBlock;
 } IMAGE_BASE_RELOCATION;
 
+typedef struct IMAGE_BOUND_IMPORT_DESCRIPTOR {
+  DWORD TimeDateStamp;
+  WORD OffsetModuleName;
+  WORD NumberOfModuleForwarderRefs;
+} IMAGE_BOUND_IMPORT_DESCRIPTOR;
+
 typedef struct IMAGE_IMPORT_BY_NAME {
   USHORT Hint;
   UCHAR Name[1];
@@ -59,12 +65,30 @@ typedef struct IMAGE_IMPORT_BY_NAME {
 
 #define IMAGE_SNAP_BY_ORDINAL(ordinal) (((ordinal)&0x80000000) != 0)
 
+// Size of the region covered by a single IMAGE_BASE_RELOCATION block.
+#define RELOCATION_PAGE_SIZE 0x1000
+
+// Base relocations that DLLParseAndRelocate applies to each section as it is
+// copied into place.
+typedef struct RelocationPlan {
+  int32_t delta;
+  // Blocks within the raw relocation directory, sorted by VirtualAddress.
+  const IMAGE_BASE_RELOCATION **blocks;
+  uint32_t num_blocks;
+} RelocationPlan;
+
 static bool DLLParseHeader(DLLContext *ctx);
 static bool DLLLoadImage(DLLContext *ctx);
 static bool DLLProcessSections(DLLContext *ctx);
 static bool DLLResolveImports(DLLContext *ctx);
+static bool ParseAndRelocate(DLLContext *ctx, bool in_place,
+                             hwaddress_t base_address);
 
 bool DLLLoad(DLLContext *ctx) {
+  if (ctx->input.fuse_relocation) {
+    return ParseAndRelocate(ctx, true, 0);
+  }
+
   if (!DLLParse(ctx)) {
     return false;
   }
@@ -132,6 +156,12 @@ bool DLLInvokeTLSCallbacks(DLLContext *ctx) {
 void DLLFreeContext(DLLContext *ctx, bool keep_image) {
   DLLLoaderInput *i = &ctx->input;
   DLLLoaderOutput *o = &ctx->output;
+  DLLStreamState *s = &ctx->stream;
+  if (s->header_buffer) {
+    i->free(s->header_buffer);
+    s->header_buffer = NULL;
+  }
+
   if (o->section_headers) {
     i->free(o->section_headers);
     o->section_headers = NULL;
@@ -143,28 +173,26 @@ void DLLFreeContext(DLLContext *ctx, bool keep_image) {
   }
 }
 
-static bool DLLParseHeader(DLLContext *ctx) {
-  SETUP_READ_PTR(ctx);
-
-  SET_ERROR_CONTEXT(ctx, DLLL_DOS_HEADER);
-  IMAGE_DOS_HEADER *dos_header = (IMAGE_DOS_HEADER *)read_ptr;
-  ADVANCE_READ_PTR(sizeof(IMAGE_DOS_HEADER));
-
+static bool CheckDOSHeader(DLLContext *ctx,
+                           const IMAGE_DOS_HEADER *dos_header) {
   if (dos_header->e_magic != IMAGE_DOS_SIGNATURE) {
     SET_ERROR_STATUS(ctx, DLLL_INVALID_SIGNATURE);
     return false;
   }
+  return true;
+}
 
-  if (dos_header->e_lfanew > sizeof(*dos_header)) {
-    ADVANCE_READ_PTR(dos_header->e_lfanew - sizeof(*dos_header));
+// Returns the offset of the NT header within the raw data.
+static uint32_t NTHeaderOffset(const IMAGE_DOS_HEADER *dos_header) {
+  uint32_t offset = (uint32_t)dos_header->e_lfanew;
+  if (offset > sizeof(*dos_header)) {
+    return offset;
   }
+  return sizeof(*dos_header);
+}
 
-  SET_ERROR_CONTEXT(ctx, DLLL_NT_HEADER);
-  const IMAGE_NT_HEADERS32 *nt_header = (const IMAGE_NT_HEADERS32 *)read_ptr;
-  ADVANCE_READ_PTR(sizeof(IMAGE_NT_HEADERS32));
-
-  memcpy(&ctx->output.header, nt_header, sizeof(ctx->output.header));
-
+// Validates the NT header that has been copied into ctx->output.header.
+static bool CheckNTHeader(DLLContext *ctx) {
   if (ctx->output.header.Signature != IMAGE_NT_SIGNATURE) {
     SET_ERROR_STATUS(ctx, DLLL_INVALID_SIGNATURE);
     return false;
@@ -181,31 +209,82 @@ static bool DLLParseHeader(DLLContext *ctx) {
     return false;
   }
 
+  return true;
+}
+
+// Returns the number of bytes between the end of the NT header and the start of
+// the section table.
+static uint32_t SectionTablePadding(const DLLContext *ctx) {
   if (ctx->output.header.FileHeader.SizeOfOptionalHeader >
       sizeof(ctx->output.header.OptionalHeader)) {
-    ADVANCE_READ_PTR(ctx->output.header.FileHeader.SizeOfOptionalHeader -
-                     sizeof(ctx->output.header.OptionalHeader));
+    return ctx->output.header.FileHeader.SizeOfOptionalHeader -
+           sizeof(ctx->output.header.OptionalHeader);
   }
+  return 0;
+}
 
-  SET_ERROR_CONTEXT(ctx, DLLL_NT_HEADER_SECTION_TABLE);
-  uint32_t num_sections = ctx->output.header.FileHeader.NumberOfSections;
-  size_t section_header_size =
-      num_sections * sizeof(*ctx->output.section_headers);
+static uint32_t SectionTableSize(const DLLContext *ctx) {
+  return ctx->output.header.FileHeader.NumberOfSections *
+         sizeof(*ctx->output.section_headers);
+}
+
+static bool CopySectionTable(DLLContext *ctx, const void *section_table) {
+  uint32_t section_header_size = SectionTableSize(ctx);
   ctx->output.section_headers = ctx->input.alloc(section_header_size);
   if (!ctx->output.section_headers) {
     SET_ERROR_STATUS(ctx, DLLL_OUT_OF_MEMORY);
     return false;
   }
 
+  memcpy(ctx->output.section_headers, section_table, section_header_size);
+  return true;
+}
+
+// Verifies that the raw data for the given section fits within the image.
+static bool CheckSection(DLLContext *ctx, const IMAGE_SECTION_HEADER *header) {
+  uint32_t image_size = ctx->output.header.OptionalHeader.SizeOfImage;
+  if (header->VirtualAddress > image_size ||
+      header->SizeOfRawData > image_size - header->VirtualAddress) {
+    SET_ERROR_STATUS(ctx, DLLL_INVALID_SECTION);
+    return false;
+  }
+  return true;
+}
+
+static bool DLLParseHeader(DLLContext *ctx) {
+  SETUP_READ_PTR(ctx);
+
+  SET_ERROR_CONTEXT(ctx, DLLL_DOS_HEADER);
+  IMAGE_DOS_HEADER *dos_header = (IMAGE_DOS_HEADER *)read_ptr;
+  ADVANCE_READ_PTR(sizeof(IMAGE_DOS_HEADER));
+
+  if (!CheckDOSHeader(ctx, dos_header)) {
+    return false;
+  }
+
+  ADVANCE_READ_PTR(NTHeaderOffset(dos_header) - sizeof(*dos_header));
+
+  SET_ERROR_CONTEXT(ctx, DLLL_NT_HEADER);
+  const IMAGE_NT_HEADERS32 *nt_header = (const IMAGE_NT_HEADERS32 *)read_ptr;
+  ADVANCE_READ_PTR(sizeof(IMAGE_NT_HEADERS32));
+
+  memcpy(&ctx->output.header, nt_header, sizeof(ctx->output.header));
+
+  if (!CheckNTHeader(ctx)) {
+    return false;
+  }
+
+  ADVANCE_READ_PTR(SectionTablePadding(ctx));
+
+  SET_ERROR_CONTEXT(ctx, DLLL_NT_HEADER_SECTION_TABLE);
   const IMAGE_SECTION_HEADER *section_header_base =
       (const IMAGE_SECTION_HEADER *)read_ptr;
-  ADVANCE_READ_PTR(section_header_size);
-  memcpy(ctx->output.section_headers, section_header_base, section_header_size);
+  ADVANCE_READ_PTR(SectionTableSize(ctx));
 
-  return true;
+  return CopySectionTable(ctx, section_header_base);
 }
 
-static bool DLLLoadImage(DLLContext *ctx) {
+static bool AllocateImage(DLLContext *ctx) {
   SET_ERROR_CONTEXT(ctx, DLLL_LOAD_IMAGE);
   ctx->output.image =
       ctx->input.alloc(ctx->output.header.OptionalHeader.SizeOfImage);
@@ -220,6 +299,14 @@ static bool DLLLoadImage(DLLContext *ctx) {
     return false;
   }
 
+  return true;
+}
+
+static bool DLLLoadImage(DLLContext *ctx) {
+  if (!AllocateImage(ctx)) {
+    return false;
+  }
+
   memcpy(ctx->output.image, ctx->input.raw_data,
          ctx->output.header.OptionalHeader.SizeOfHeaders);
   return true;
@@ -236,8 +323,9 @@ static bool ProcessSection(const IMAGE_SECTION_HEADER *header,
     return true;
   }
 
-  char name_buf[16] = {0};
-  memcpy(name_buf, header->Name, sizeof(header->Name));
+  if (!CheckSection(ctx, header)) {
+    return false;
+  }
 
   ADVANCE_READ_PTR(header->PointerToRawData);
   const void *section_start = read_ptr;
@@ -259,6 +347,85 @@ static bool DLLProcessSections(DLLContext *ctx) {
   return true;
 }
 
+// The module targeted by an IMAGE_IMPORT_DESCRIPTOR.
+typedef struct ImportModule {
+  const char *name;
+  // Handle returned by the `resolve_module` input method, if provided.
+  void *handle;
+  bool found;
+} ImportModule;
+
+static bool ResolveImportByOrdinal(DLLContext *ctx, const ImportModule *module,
+                                   uint32_t ordinal, uint32_t *result) {
+  if (!module->found) {
+    return false;
+  }
+  if (ctx->input.resolve_module) {
+    return ctx->input.resolve_import_by_ordinal_in_module(module->handle,
+                                                          ordinal, result);
+  }
+  return ctx->input.resolve_import_by_ordinal(module->name, ordinal, result);
+}
+
+static bool ResolveImportByName(DLLContext *ctx, const ImportModule *module,
+                                const char *name, uint32_t hint,
+                                uint32_t *result) {
+  if (!module->found) {
+    return false;
+  }
+  if (ctx->input.resolve_module) {
+    if (ctx->input.resolve_import_by_name_with_hint_in_module) {
+      return ctx->input.resolve_import_by_name_with_hint_in_module(
+          module->handle, name, hint, result);
+    }
+    return ctx->input.resolve_import_by_name_in_module(module->handle, name,
+                                                       result);
+  }
+  return ctx->input.resolve_import_by_name(module->name, name, result);
+}
+
+// Returns true if the import address table entries for `image_name` were bound
+// against the build of the module that is currently loaded.
+static bool IsImportBound(const DLLContext *ctx, const char *image_name) {
+  if (!ctx->input.resolve_module_timestamp) {
+    return false;
+  }
+
+  const IMAGE_DATA_DIRECTORY *directory =
+      ctx->output.header.OptionalHeader.DataDirectory +
+      IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT;
+  uint32_t image_size = ctx->output.header.OptionalHeader.SizeOfImage;
+  if (!directory->Size || directory->VirtualAddress > image_size ||
+      directory->Size > image_size - directory->VirtualAddress) {
+    return false;
+  }
+
+  const uint8_t *table = ctx->output.image + directory->VirtualAddress;
+  uint32_t offset = 0;
+  while (offset + sizeof(IMAGE_BOUND_IMPORT_DESCRIPTOR) <= directory->Size) {
+    const IMAGE_BOUND_IMPORT_DESCRIPTOR *descriptor =
+        (const IMAGE_BOUND_IMPORT_DESCRIPTOR *)(table + offset);
+    if (!descriptor->TimeDateStamp) {
+      break;
+    }
+
+    uint32_t name_offset = descriptor->OffsetModuleName;
+    const char *name = (const char *)table + name_offset;
+    if (name_offset < directory->Size &&
+        memchr(name, 0, directory->Size - name_offset) &&
+        !strcmp(name, image_name)) {
+      uint32_t timestamp;
+      return ctx->input.resolve_module_timestamp(image_name, &timestamp) &&
+             timestamp == descriptor->TimeDateStamp;
+    }
+
+    // Forwarder references share the layout of the descriptor.
+    offset += (1 + descriptor->NumberOfModuleForwarderRefs) *
+              sizeof(IMAGE_BOUND_IMPORT_DESCRIPTOR);
+  }
+  return false;
+}
+
 static bool DLLResolveImports(DLLContext *ctx) {
   SET_ERROR_CONTEXT(ctx, DLLL_RESOLVE_IMPORTS);
 
@@ -282,6 +449,17 @@ static bool DLLResolveImports(DLLContext *ctx) {
       return false;
     }
 
+    // Bound descriptors are marked with a non-zero timestamp. Their lookup
+    // table is retained so that they may be resolved if the binding is stale.
+    if (descriptor->TimeDateStamp && IsImportBound(ctx, image_name)) {
+      continue;
+    }
+
+    ImportModule module = {image_name, NULL, true};
+    if (ctx->input.resolve_module) {
+      module.found = ctx->input.resolve_module(image_name, &module.handle);
+    }
+
     uint32_t *thunk;
     uint32_t *function =
         (uint32_t *)(ctx->output.image + descriptor->FirstThunk);
@@ -295,8 +473,7 @@ static bool DLLResolveImports(DLLContext *ctx) {
     for (; *thunk; ++thunk, ++function) {
       if (IMAGE_SNAP_BY_ORDINAL(*thunk)) {
         uint32_t ordinal = *thunk & 0xFFFF;
-        if (!ctx->input.resolve_import_by_ordinal(image_name, ordinal,
-                                                  function)) {
+        if (!ResolveImportByOrdinal(ctx, &module, ordinal, function)) {
           SET_ERROR_MESSAGE(ctx, strlen(image_name) + 16, "%s @ %d", image_name,
                             ordinal);
           SET_ERROR_STATUS(ctx, DLLL_UNRESOLVED_IMPORT);
@@ -306,8 +483,8 @@ static bool DLLResolveImports(DLLContext *ctx) {
         const IMAGE_IMPORT_BY_NAME *name_data =
             (const IMAGE_IMPORT_BY_NAME *)(ctx->output.image + *thunk);
         const char *import_name = (const char *)(name_data->Name);
-        if (!ctx->input.resolve_import_by_name(image_name, import_name,
-                                               function)) {
+        if (!ResolveImportByName(ctx, &module, import_name, name_data->Hint,
+                                 function)) {
           uint32_t message_len = strlen(image_name) + strlen(import_name) + 8;
           SET_ERROR_MESSAGE(ctx, message_len, "%s @ %s", image_name,
                             import_name);
@@ -326,6 +503,9 @@ bool DLLRelocate(DLLContext *ctx, hwaddress_t new_base) {
 
   uint32_t header_image_base = ctx->output.header.OptionalHeader.ImageBase;
   if (new_base == header_image_base) {
+    ctx->output.entrypoint =
+        (hwaddress_t)(new_base +
+                      ctx->output.header.OptionalHeader.AddressOfEntryPoint);
     return true;
   }
 
@@ -389,3 +569,527 @@ bool DLLRelocate(DLLContext *ctx, hwaddress_t new_base) {
 
   return true;
 }
+
+// Retrieves a pointer to `size` bytes of raw data at the given RVA.
+static const void *FindRawData(const DLLContext *ctx, uint32_t rva,
+                               uint32_t size) {
+  const uint8_t *raw_data = (const uint8_t *)ctx->input.raw_data;
+  uint32_t header_size = ctx->output.header.OptionalHeader.SizeOfHeaders;
+  if (rva < header_size) {
+    return size <= header_size - rva ? raw_data + rva : NULL;
+  }
+
+  for (uint32_t i = 0; i < ctx->output.header.FileHeader.NumberOfSections;
+       ++i) {
+    const IMAGE_SECTION_HEADER *header = ctx->output.section_headers + i;
+    if (rva < header->VirtualAddress ||
+        rva - header->VirtualAddress >= header->SizeOfRawData) {
+      continue;
+    }
+
+    uint32_t offset = rva - header->VirtualAddress;
+    if (size > header->SizeOfRawData - offset ||
+        header->PointerToRawData > ctx->input.raw_data_size ||
+        header->PointerToRawData + offset + size > ctx->input.raw_data_size) {
+      return NULL;
+    }
+    return raw_data + header->PointerToRawData + offset;
+  }
+  return NULL;
+}
+
+static const uint16_t *RelocationEntries(const IMAGE_BASE_RELOCATION *block) {
+  return (const uint16_t *)(block + 1);
+}
+
+static uint32_t NumRelocationEntries(const IMAGE_BASE_RELOCATION *block) {
+  return (block->SizeOfBlock - sizeof(*block)) / sizeof(uint16_t);
+}
+
+// Collects the relocation blocks needed to load the image at `base_address`,
+// reading them from the raw data as the relocation section has not been copied
+// yet.
+static bool PlanRelocations(DLLContext *ctx, hwaddress_t base_address,
+                            RelocationPlan *plan) {
+  SET_ERROR_CONTEXT(ctx, DLLL_RELOCATE);
+
+  plan->delta =
+      (int32_t)(base_address - ctx->output.header.OptionalHeader.ImageBase);
+  if (!plan->delta) {
+    return true;
+  }
+
+  const IMAGE_DATA_DIRECTORY *directory =
+      ctx->output.header.OptionalHeader.DataDirectory +
+      IMAGE_DIRECTORY_ENTRY_BASERELOC;
+  if (!directory->Size) {
+    SET_ERROR_STATUS(ctx, DLLL_NO_RELOCATION_DATA);
+    return false;
+  }
+
+  const uint8_t *table = (const uint8_t *)FindRawData(
+      ctx, directory->VirtualAddress, directory->Size);
+  if (!table) {
+    SET_ERROR_STATUS(ctx, DLLL_INVALID_RELOCATION);
+    return false;
+  }
+
+  // Blocks are walked twice, first to size the plan and then to populate it.
+  for (uint32_t pass = 0; pass < 2; ++pass) {
+    uint32_t count = 0;
+    uint32_t offset = 0;
+    while (directory->Size - offset >= sizeof(IMAGE_BASE_RELOCATION)) {
+      const IMAGE_BASE_RELOCATION *block =
+          (const IMAGE_BASE_RELOCATION *)(table + offset);
+      if (!block->VirtualAddress) {
+        break;
+      }
+      if (block->SizeOfBlock < sizeof(*block) ||
+          block->SizeOfBlock > directory->Size - offset) {
+        SET_ERROR_STATUS(ctx, DLLL_INVALID_RELOCATION);
+        return false;
+      }
+
+      if (pass) {
+        // Linkers emit blocks in ascending order, so this is generally a
+        // single comparison per block.
+        uint32_t i = count;
+        while (i && plan->blocks[i - 1]->VirtualAddress >
+                        block->VirtualAddress) {
+          plan->blocks[i] = plan->blocks[i - 1];
+          --i;
+        }
+        plan->blocks[i] = block;
+      }
+
+      ++count;
+      offset += block->SizeOfBlock;
+    }
+
+    if (!pass) {
+      if (!count) {
+        return true;
+      }
+      plan->blocks = ctx->input.alloc(count * sizeof(*plan->blocks));
+      if (!plan->blocks) {
+        SET_ERROR_STATUS(ctx, DLLL_OUT_OF_MEMORY);
+        return false;
+      }
+    }
+    plan->num_blocks = count;
+  }
+
+  return true;
+}
+
+// Returns true if the fixup at `rva` lies entirely within the raw data of the
+// given section.
+static bool IsInRawData(const IMAGE_SECTION_HEADER *header, uint32_t rva) {
+  return header->SizeOfRawData >= sizeof(uint32_t) &&
+         rva >= header->VirtualAddress &&
+         rva - header->VirtualAddress <=
+             header->SizeOfRawData - sizeof(uint32_t);
+}
+
+// Returns true if every fixup that `block` may hold lies within the raw data of
+// the given section.
+static bool ContainsBlock(const IMAGE_SECTION_HEADER *header,
+                          const IMAGE_BASE_RELOCATION *block) {
+  return IsInRawData(header, block->VirtualAddress) &&
+         IsInRawData(header, block->VirtualAddress + RELOCATION_PAGE_SIZE - 1);
+}
+
+// Returns the section whose raw data holds the fixup at `rva` or, if `block` is
+// given, every fixup in the block.
+static const IMAGE_SECTION_HEADER *FindRawSection(
+    const DLLContext *ctx, uint32_t rva, const IMAGE_BASE_RELOCATION *block) {
+  for (uint32_t i = 0; i < ctx->output.header.FileHeader.NumberOfSections;
+       ++i) {
+    const IMAGE_SECTION_HEADER *header = ctx->output.section_headers + i;
+    if (block ? ContainsBlock(header, block) : IsInRawData(header, rva)) {
+      return header;
+    }
+  }
+  return NULL;
+}
+
+// Applies the fixups in `block` that lie within the raw data of `section` or,
+// if `section` is NULL, outside of the raw data of every section.
+static bool ApplyRelocationBlock(DLLContext *ctx, const RelocationPlan *plan,
+                                 const IMAGE_BASE_RELOCATION *block,
+                                 const IMAGE_SECTION_HEADER *section) {
+  // Blocks that lie entirely within the section's raw data, which CheckSection
+  // has verified to be within the image, need no per fixup checks.
+  bool contained = section && ContainsBlock(section, block);
+  uint32_t image_size = ctx->output.header.OptionalHeader.SizeOfImage;
+
+  uint8_t *dest = ctx->output.image + block->VirtualAddress;
+  const uint16_t *entry = RelocationEntries(block);
+  const uint16_t *end = entry + NumRelocationEntries(block);
+  for (; entry < end; ++entry) {
+    uint32_t type = *entry >> 12;
+    if (type == IMAGE_REL_BASED_ABSOLUTE) {
+      continue;
+    }
+    if (type != IMAGE_REL_BASED_HIGHLOW) {
+      SET_ERROR_CONTEXT(ctx, DLLL_RELOCATE);
+      SET_ERROR_STATUS(ctx, DLLL_UNSUPPORTED_RELOCATION_TYPE);
+      return false;
+    }
+
+    uint32_t rva_offset = *entry & 0x0FFF;
+    if (!contained) {
+      uint32_t rva = block->VirtualAddress + rva_offset;
+      if (section ? !IsInRawData(section, rva)
+                  : FindRawSection(ctx, rva, NULL) != NULL) {
+        continue;
+      }
+      if (rva > image_size || image_size - rva < sizeof(uint32_t)) {
+        SET_ERROR_CONTEXT(ctx, DLLL_RELOCATE);
+        SET_ERROR_STATUS(ctx, DLLL_INVALID_RELOCATION);
+        return false;
+      }
+    }
+
+    uint32_t *target = (uint32_t *)(dest + rva_offset);
+    *target += plan->delta;
+  }
+  return true;
+}
+
+// Applies the fixups that fall within the raw data of the given section, which
+// has just been copied into the image.
+static bool RelocateSection(DLLContext *ctx, const RelocationPlan *plan,
+                            const IMAGE_SECTION_HEADER *header) {
+  // Find the first block whose page overlaps the section.
+  uint32_t low = 0;
+  uint32_t high = plan->num_blocks;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (plan->blocks[mid]->VirtualAddress + RELOCATION_PAGE_SIZE <=
+        header->VirtualAddress) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  uint32_t end = header->VirtualAddress + header->SizeOfRawData;
+  for (uint32_t i = low;
+       i < plan->num_blocks && plan->blocks[i]->VirtualAddress < end; ++i) {
+    if (!ApplyRelocationBlock(ctx, plan, plan->blocks[i], header)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool ProcessAndRelocateSections(DLLContext *ctx,
+                                       const RelocationPlan *plan) {
+  for (uint32_t i = 0; i < ctx->output.header.FileHeader.NumberOfSections;
+       ++i) {
+    const IMAGE_SECTION_HEADER *header = ctx->output.section_headers + i;
+    if (!ProcessSection(header, ctx)) {
+      return false;
+    }
+    if (plan->num_blocks && header->SizeOfRawData &&
+        !RelocateSection(ctx, plan, header)) {
+      return false;
+    }
+  }
+
+  // Fixups outside of any section's raw data (e.g., in the headers or in
+  // uninitialized data) are applied once everything is in place.
+  for (uint32_t i = 0; i < plan->num_blocks; ++i) {
+    const IMAGE_BASE_RELOCATION *block = plan->blocks[i];
+    if (!FindRawSection(ctx, 0, block) &&
+        !ApplyRelocationBlock(ctx, plan, block, NULL)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool ParseAndRelocate(DLLContext *ctx, bool in_place,
+                             hwaddress_t base_address) {
+  SET_ERROR_CONTEXT(ctx, DLLL_NOT_PARSED);
+  memset(&ctx->output, 0, sizeof(ctx->output));
+
+  RelocationPlan plan;
+  memset(&plan, 0, sizeof(plan));
+  bool ret = DLLParseHeader(ctx) && DLLLoadImage(ctx);
+  if (ret) {
+    if (in_place) {
+      base_address = (hwaddress_t)(intptr_t)ctx->output.image;
+    }
+    ret = PlanRelocations(ctx, base_address, &plan) &&
+          ProcessAndRelocateSections(ctx, &plan) && DLLResolveImports(ctx);
+  }
+
+  if (plan.blocks) {
+    ctx->input.free(plan.blocks);
+  }
+  if (!ret) {
+    DLLFreeContext(ctx, false);
+    return false;
+  }
+
+  ctx->output.header.OptionalHeader.ImageBase = base_address;
+  ctx->output.entrypoint =
+      (hwaddress_t)(base_address +
+                    ctx->output.header.OptionalHeader.AddressOfEntryPoint);
+  return true;
+}
+
+bool DLLParseAndRelocate(DLLContext *ctx, hwaddress_t base_address) {
+  return ParseAndRelocate(ctx, false, base_address);
+}
+
+void DLLStreamBegin(DLLContext *ctx) {
+  memset(&ctx->output, 0, sizeof(ctx->output));
+  memset(&ctx->stream, 0, sizeof(ctx->stream));
+  SET_ERROR_CONTEXT(ctx, DLLL_NOT_PARSED);
+}
+
+static bool ResizeHeaderBuffer(DLLContext *ctx, uint32_t size) {
+  DLLStreamState *s = &ctx->stream;
+  uint8_t *buffer = ctx->input.alloc(size);
+  if (!buffer) {
+    SET_ERROR_STATUS(ctx, DLLL_OUT_OF_MEMORY);
+    return false;
+  }
+
+  if (s->header_buffer) {
+    memcpy(buffer, s->header_buffer, s->header_buffer_size);
+    ctx->input.free(s->header_buffer);
+  }
+  s->header_buffer = buffer;
+  s->header_buffer_size = size;
+  return true;
+}
+
+// Called once the DOS and NT headers have been buffered to allocate the final
+// image.
+static bool StreamAllocateImage(DLLContext *ctx) {
+  DLLStreamState *s = &ctx->stream;
+  const IMAGE_DOS_HEADER *dos_header =
+      (const IMAGE_DOS_HEADER *)s->header_buffer;
+  uint32_t nt_header_offset = NTHeaderOffset(dos_header);
+
+  SET_ERROR_CONTEXT(ctx, DLLL_NT_HEADER);
+  memcpy(&ctx->output.header, s->header_buffer + nt_header_offset,
+         sizeof(ctx->output.header));
+  if (!CheckNTHeader(ctx)) {
+    return false;
+  }
+
+  SET_ERROR_CONTEXT(ctx, DLLL_NT_HEADER_SECTION_TABLE);
+  s->section_table_end = s->header_buffer_size + SectionTablePadding(ctx) +
+                         SectionTableSize(ctx);
+  if (s->section_table_end >
+      ctx->output.header.OptionalHeader.SizeOfHeaders) {
+    SET_ERROR_STATUS(ctx, DLLL_ERROR);
+    return false;
+  }
+
+  if (!AllocateImage(ctx)) {
+    return false;
+  }
+
+  memcpy(ctx->output.image, s->header_buffer, s->header_buffer_size);
+  ctx->input.free(s->header_buffer);
+  s->header_buffer = NULL;
+  return true;
+}
+
+// Accumulates the DOS and NT headers, which are needed to determine the size of
+// the final image.
+static bool StreamBufferHeaders(DLLContext *ctx, const uint8_t *data,
+                                uint32_t size, uint32_t *consumed) {
+  DLLStreamState *s = &ctx->stream;
+  if (!s->header_buffer) {
+    SET_ERROR_CONTEXT(ctx, DLLL_DOS_HEADER);
+    if (!ResizeHeaderBuffer(ctx, sizeof(IMAGE_DOS_HEADER))) {
+      return false;
+    }
+  }
+
+  uint32_t needed = s->header_buffer_size - s->bytes_received;
+  *consumed = size < needed ? size : needed;
+  memcpy(s->header_buffer + s->bytes_received, data, *consumed);
+  if (*consumed < needed) {
+    return true;
+  }
+
+  if (s->header_buffer_size == sizeof(IMAGE_DOS_HEADER)) {
+    const IMAGE_DOS_HEADER *dos_header =
+        (const IMAGE_DOS_HEADER *)s->header_buffer;
+    if (!CheckDOSHeader(ctx, dos_header)) {
+      return false;
+    }
+
+    SET_ERROR_CONTEXT(ctx, DLLL_NT_HEADER);
+    uint32_t nt_header_offset = NTHeaderOffset(dos_header);
+    if (nt_header_offset > UINT32_MAX - sizeof(IMAGE_NT_HEADERS32)) {
+      SET_ERROR_STATUS(ctx, DLLL_INVALID_SIGNATURE);
+      return false;
+    }
+    // Avoid buffering up to an arbitrary offset for a header that can never
+    // arrive.
+    uint32_t raw_data_size = ctx->input.raw_data_size;
+    if (raw_data_size &&
+        nt_header_offset + sizeof(IMAGE_NT_HEADERS32) > raw_data_size) {
+      SET_ERROR_STATUS(ctx, DLLL_FILE_TOO_SMALL);
+      return false;
+    }
+    return ResizeHeaderBuffer(ctx,
+                              nt_header_offset + sizeof(IMAGE_NT_HEADERS32));
+  }
+
+  return StreamAllocateImage(ctx);
+}
+
+// Copies header data directly into the image until the section table has been
+// received.
+static bool StreamCopySectionTable(DLLContext *ctx, const uint8_t *data,
+                                   uint32_t size, uint32_t *consumed) {
+  DLLStreamState *s = &ctx->stream;
+  uint32_t needed = s->section_table_end - s->bytes_received;
+  *consumed = size < needed ? size : needed;
+  memcpy(ctx->output.image + s->bytes_received, data, *consumed);
+  if (*consumed < needed) {
+    return true;
+  }
+
+  SET_ERROR_CONTEXT(ctx, DLLL_NT_HEADER_SECTION_TABLE);
+  const uint8_t *section_table =
+      ctx->output.image + s->section_table_end - SectionTableSize(ctx);
+  if (!CopySectionTable(ctx, section_table)) {
+    return false;
+  }
+
+  SET_ERROR_CONTEXT(ctx, DLLL_LOAD_SECTION);
+  for (uint32_t i = 0; i < ctx->output.header.FileHeader.NumberOfSections;
+       ++i) {
+    const IMAGE_SECTION_HEADER *header = &ctx->output.section_headers[i];
+    if (!header->SizeOfRawData) {
+      continue;
+    }
+
+    if (!CheckSection(ctx, header)) {
+      return false;
+    }
+
+    // Data that has already been consumed can no longer be copied into place.
+    // The end of the raw data must also be representable, or the stream could
+    // complete before the section is copied.
+    if (header->PointerToRawData < s->section_table_end ||
+        header->SizeOfRawData > UINT32_MAX - header->PointerToRawData) {
+      SET_ERROR_STATUS(ctx, DLLL_INVALID_SECTION);
+      return false;
+    }
+
+    uint32_t raw_end = header->PointerToRawData + header->SizeOfRawData;
+    if (raw_end > s->raw_data_end) {
+      s->raw_data_end = raw_end;
+    }
+  }
+
+  return true;
+}
+
+// Copies any portion of the given data that overlaps the headers or a section
+// into its final location in the image.
+static bool StreamCopySections(DLLContext *ctx, const uint8_t *data,
+                               uint32_t size, uint32_t *consumed) {
+  DLLStreamState *s = &ctx->stream;
+  uint32_t start = s->bytes_received;
+  uint32_t end = start + size;
+  *consumed = size;
+
+  uint32_t header_end = ctx->output.header.OptionalHeader.SizeOfHeaders;
+  if (start < header_end) {
+    uint32_t copy_end = end < header_end ? end : header_end;
+    memcpy(ctx->output.image + start, data, copy_end - start);
+  }
+
+  for (uint32_t i = 0; i < ctx->output.header.FileHeader.NumberOfSections;
+       ++i) {
+    const IMAGE_SECTION_HEADER *header = &ctx->output.section_headers[i];
+    // StreamCopySectionTable rejected sections whose end would wrap.
+    uint32_t section_start = header->PointerToRawData;
+    uint32_t section_end = section_start + header->SizeOfRawData;
+    if (!header->SizeOfRawData || section_end <= start ||
+        section_start >= end) {
+      continue;
+    }
+
+    uint32_t copy_start = start > section_start ? start : section_start;
+    uint32_t copy_end = end < section_end ? end : section_end;
+    memcpy(ctx->output.image + header->VirtualAddress +
+               (copy_start - section_start),
+           data + (copy_start - start), copy_end - copy_start);
+  }
+
+  return true;
+}
+
+bool DLLStreamWrite(DLLContext *ctx, const void *data, uint32_t size) {
+  if (ctx->output.status != DLLL_OK) {
+    return false;
+  }
+
+  DLLStreamState *s = &ctx->stream;
+  const uint8_t *read_ptr = (const uint8_t *)data;
+  while (size) {
+    uint32_t consumed = 0;
+    bool ret;
+    if (!ctx->output.image) {
+      ret = StreamBufferHeaders(ctx, read_ptr, size, &consumed);
+    } else if (!ctx->output.section_headers) {
+      ret = StreamCopySectionTable(ctx, read_ptr, size, &consumed);
+    } else {
+      ret = StreamCopySections(ctx, read_ptr, size, &consumed);
+    }
+
+    if (!ret) {
+      if (ctx->output.status == DLLL_OK) {
+        SET_ERROR_STATUS(ctx, DLLL_ERROR);
+      }
+      DLLFreeContext(ctx, false);
+      return false;
+    }
+
+    read_ptr += consumed;
+    size -= consumed;
+    s->bytes_received += consumed;
+  }
+
+  return true;
+}
+
+bool DLLStreamEnd(DLLContext *ctx) {
+  if (ctx->output.status != DLLL_OK) {
+    return false;
+  }
+
+  if (!ctx->output.section_headers ||
+      ctx->stream.bytes_received < ctx->stream.raw_data_end) {
+    SET_ERROR_CONTEXT(ctx, DLLL_LOAD_SECTION);
+    SET_ERROR_STATUS(ctx, DLLL_FILE_TOO_SMALL);
+    DLLFreeContext(ctx, false);
+    return false;
+  }
+
+  if (!DLLResolveImports(ctx)) {
+    DLLFreeContext(ctx, false);
+    return false;
+  }
+
+  if (!DLLRelocate(ctx, (uint32_t)(intptr_t)ctx->output.image)) {
+    DLLFreeContext(ctx, false);
+    return false;
+  }
+
+  return true;
+}
@@ -70,6 +70,12 @@ typedef enum DLLLoaderStatus {
 
   // A relocation entry used an unimplemented type.
   DLLL_UNSUPPORTED_RELOCATION_TYPE = 10,
+
+  // A section's raw data does not fit within the image.
+  DLLL_INVALID_SECTION = 11,
+
+  // A relocation block or fixup lies outside of the raw data or the image.
+  DLLL_INVALID_RELOCATION = 12,
 } DLLLoaderStatus;
 
 // The caller is responsible for setting up and cleaning up these values.
@@ -102,6 +108,51 @@ typedef struct DLLLoaderInput {
   bool(DLL_LOADER_API *resolve_import_by_name)(const char *image,
                                                const char *name,
                                                uint32_t *result);
+
+  // Optional pointer to a method used to look up an opaque handle for a module
+  // by name. If set, it is called once per import descriptor and the
+  // `resolve_import_*_in_module` methods are used to resolve each import,
+  // avoiding a module lookup per import.
+  // `image` - the name of the image (e.g., "xbdm.dll")
+  // `module` - [OUT] set to an opaque handle for the module
+  //  Returns true if the lookup was successful, false if not.
+  bool(DLL_LOADER_API *resolve_module)(const char *image, void **module);
+
+  // Pointer to a method used to look up the address of a function by ordinal
+  // within a module returned by `resolve_module`.
+  bool(DLL_LOADER_API *resolve_import_by_ordinal_in_module)(void *module,
+                                                            uint32_t ordinal,
+                                                            uint32_t *result);
+
+  // Pointer to a method used to look up the address of a function by name
+  // within a module returned by `resolve_module`.
+  bool(DLL_LOADER_API *resolve_import_by_name_in_module)(void *module,
+                                                         const char *name,
+                                                         uint32_t *result);
+
+  // Optional pointer to a method that is used in place of
+  // `resolve_import_by_name_in_module` if set.
+  // `hint` - the Hint of the import's IMAGE_IMPORT_BY_NAME, which the exporting
+  //          module may use to locate `name` without searching
+  bool(DLL_LOADER_API *resolve_import_by_name_with_hint_in_module)(
+      void *module, const char *name, uint32_t hint, uint32_t *result);
+
+  // Optional pointer to a method used to look up the TimeDateStamp of the
+  // loaded build of a module. If set, imports from modules listed in the DLL's
+  // IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT with a matching timestamp are not
+  // resolved and the addresses bound into the import address table are used
+  // as-is.
+  // `image` - the name of the image (e.g., "xboxkrnl.exe")
+  // `timestamp` - [OUT] set to the timestamp of the loaded module
+  //  Returns true if the lookup was successful, false if not.
+  bool(DLL_LOADER_API *resolve_module_timestamp)(const char *image,
+                                                 uint32_t *timestamp);
+
+  // If set, DLLLoad applies base relocations to each section as it is copied
+  // into the image rather than in a separate pass over the whole image. Has no
+  // effect on DLLStream* loads, as the relocation data is generally received
+  // last.
+  bool fuse_relocation;
 } DLLLoaderInput;
 
 typedef struct DLLLoaderOutput {
@@ -119,9 +170,27 @@ typedef struct DLLLoaderOutput {
   char error_message[DLLL_MAX_ERROR_LEN];
 } DLLLoaderOutput;
 
+// Bookkeeping used by the DLLStream* methods to load an image incrementally.
+typedef struct DLLStreamState {
+  // The number of raw bytes that have been consumed so far.
+  uint32_t bytes_received;
+
+  // Buffer used to accumulate the DOS and NT headers until the final image can
+  // be allocated.
+  uint8_t *header_buffer;
+  uint32_t header_buffer_size;
+
+  // Offset of the end of the section table within the raw data.
+  uint32_t section_table_end;
+
+  // Offset of the end of the last section's raw data.
+  uint32_t raw_data_end;
+} DLLStreamState;
+
 typedef struct DLLContext {
   DLLLoaderInput input;
   DLLLoaderOutput output;
+  DLLStreamState stream;
 } DLLContext;
 
 // Load the DLL into newly allocated memory, relocating to work properly
@@ -135,6 +204,27 @@ bool DLLParse(DLLContext *ctx);
 // Update the image to be loaded at the given address.
 bool DLLRelocate(DLLContext *ctx, hwaddress_t base_address);
 
+// Equivalent to DLLParse followed by DLLRelocate, but applies the relocations
+// for each section immediately after the section is copied into the image, in
+// page order, so that each page is only visited once.
+bool DLLParseAndRelocate(DLLContext *ctx, hwaddress_t base_address);
+
+// Prepares the given context to load a DLL incrementally via DLLStreamWrite.
+// `input.raw_data` is ignored. `input.raw_data_size` may be set to the total
+// size of the raw file if it is known in advance, or 0.
+void DLLStreamBegin(DLLContext *ctx);
+
+// Consumes the next `size` bytes of the raw DLL file. The final image is
+// allocated as soon as the headers have been received and each section is
+// copied directly into place, so the raw file never needs to be buffered.
+// On failure the context is freed and all subsequent writes will fail.
+bool DLLStreamWrite(DLLContext *ctx, const void *data, uint32_t size);
+
+// Resolves imports and relocates the image once all raw data has been passed to
+// DLLStreamWrite. On success the context is equivalent to one populated by
+// DLLLoad.
+bool DLLStreamEnd(DLLContext *ctx);
+
 bool DLLInvokeTLSCallbacks(DLLContext *ctx);
 
 // Frees resources owned by the given DLLContext instance.
@@ -10,9 +10,24 @@
 // 'dxcp' - ddxt command processor
 static const uint32_t kTag = 0x64786370;
 
+// Bounds of a single key/value pair within a parameter string.
+typedef struct ParameterToken {
+  const char *key_start;
+  const char *key_end;
+  // NULL if the key has no value. Excludes any enclosing quotation marks.
+  const char *value_start;
+  const char *value_end;
+  bool value_needs_unescaping;
+  // Start of the following key, if any.
+  const char *next;
+} ParameterToken;
+
+static int32_t NextParameter(const char *input, ParameterToken *token);
 static const char *FirstNonSpace(const char *input);
 static const char *KeyEnd(const char *input);
 static const char *ValueEnd(const char *input, bool *has_escaped_values);
+static bool ParseUInt32(const char *string_value, uint32_t *result);
+static bool ParseInt32(const char *string_value, int32_t *result);
 
 void CP_API CPDelete(CommandParameters *cp) {
   for (int i = 0; i < cp->entries; ++i) {
@@ -67,10 +82,24 @@ static bool CommandParametersReserve(int32_t max_entries,
   return true;
 }
 
-static int32_t CommandParametersAppend(
-    int32_t *max_entries, const char *key_start, const char *key_end,
-    const char *value_start, const char *value_end, bool value_needs_unescaping,
-    CommandParameters *cp) {
+// Copies the unescaped content of [start, end) to `dest`, which may alias
+// `start`. Returns the number of characters written or a PCP_ERR_ define.
+static int32_t Unescape(const char *start, const char *end, char *dest) {
+  char *dest_start = dest;
+  while (start != end) {
+    if (*start == '\\') {
+      if (++start == end) {
+        return PCP_ERR_INVALID_INPUT_UNTERMINATED_ESCAPE;
+      }
+    }
+    *dest++ = *start++;
+  }
+  return (int32_t)(dest - dest_start);
+}
+
+static int32_t CommandParametersAppend(int32_t *max_entries,
+                                       const ParameterToken *token,
+                                       CommandParameters *cp) {
   if (cp->entries == *max_entries) {
     *max_entries *= 2;
     if (!CommandParametersReserve(*max_entries, cp)) {
@@ -79,36 +108,32 @@ static int32_t CommandParametersAppend(
   }
 
   int32_t index = cp->entries;
-  size_t key_size = 1 + key_end - key_start;
+  size_t key_size = 1 + token->key_end - token->key_start;
   cp->keys[index] = (char *)DmAllocatePoolWithTag(key_size, kTag);
   if (!cp->keys[index]) {
     return PCP_ERR_OUT_OF_MEMORY;
   }
   ++cp->entries;
-  memcpy(cp->keys[index], key_start, key_size - 1);
+  memcpy(cp->keys[index], token->key_start, key_size - 1);
   cp->keys[index][key_size - 1] = 0;
 
+  const char *value_start = token->value_start;
+  const char *value_end = token->value_end;
   if (value_start && value_start != value_end) {
     size_t value_size = 1 + value_end - value_start;
-    cp->values[cp->entries - 1] =
-        (char *)DmAllocatePoolWithTag(value_size, kTag);
+    cp->values[index] = (char *)DmAllocatePoolWithTag(value_size, kTag);
     if (!cp->values[index]) {
       return PCP_ERR_OUT_OF_MEMORY;
     }
-    if (!value_needs_unescaping) {
+    if (!token->value_needs_unescaping) {
       memcpy(cp->values[index], value_start, value_size - 1);
       cp->values[index][value_size - 1] = 0;
     } else {
-      char *dest = cp->values[index];
-      while (value_start != value_end) {
-        if (*value_start == '\\') {
-          if (++value_start == value_end) {
-            return PCP_ERR_INVALID_INPUT_UNTERMINATED_ESCAPE;
-          }
-        }
-        *dest++ = *value_start++;
+      int32_t length = Unescape(value_start, value_end, cp->values[index]);
+      if (length < 0) {
+        return length;
       }
-      *dest = 0;
+      cp->values[index][length] = 0;
     }
   }
 
@@ -133,52 +158,228 @@ int32_t CP_API CPParseCommandParameters(const char *params,
     return PCP_ERR_OUT_OF_MEMORY;
   }
 
-  const char *key_start = FirstNonSpace(params);
-  if (!*key_start) {
+  ParameterToken token;
+  token.next = FirstNonSpace(params);
+  if (!*token.next) {
     CPDelete(result);
     return 0;
   }
 
-  while (*key_start) {
-    const char *key_end = KeyEnd(key_start);
-    if (key_end == key_start) {
+  while (*token.next) {
+    int32_t set_result = NextParameter(token.next, &token);
+    if (!set_result) {
+      set_result = CommandParametersAppend(&max_entries, &token, result);
+    }
+    if (set_result) {
       CPDelete(result);
-      return PCP_ERR_INVALID_KEY;
+      return set_result;
     }
+  }
+
+  return result->entries;
+}
+
+int32_t CP_API CPParseCommandParametersToBuffer(
+    const char *params, void *buffer, uint32_t buffer_size,
+    CommandParameterSlices *result) {
+  if (!result) {
+    return PCP_ERR_INVALID_INPUT;
+  }
+
+  result->entries = 0;
+  result->slices = NULL;
 
-    const char *entry_end = key_end;
-    const char *value_start = NULL;
-    const char *value_end = NULL;
-    bool value_needs_unescaping = false;
-    if (*key_end == '=') {
-      value_start = key_end + 1;
-      value_end = ValueEnd(value_start, &value_needs_unescaping);
-      entry_end = value_end;
-
-      // Ignore the enclosing quotation marks.
-      if (*value_start == '"') {
-        ++value_start;
-        if (*value_end != '"') {
-          CPDelete(result);
-          return PCP_ERR_INVALID_INPUT_UNTERMINATED_QUOTED_KEY;
+  if (!params || !buffer) {
+    return PCP_ERR_INVALID_INPUT;
+  }
+
+  // The slice array is placed at the start of the buffer and the copy of the
+  // parameter string at the end.
+  uintptr_t slices_start = ((uintptr_t)buffer + sizeof(void *) - 1) &
+                           ~(uintptr_t)(sizeof(void *) - 1);
+  uintptr_t buffer_end = (uintptr_t)buffer + buffer_size;
+  uint32_t params_size = strlen(params) + 1;
+  if (slices_start > buffer_end || buffer_end - slices_start < params_size) {
+    return PCP_ERR_BUFFER_TOO_SMALL;
+  }
+
+  char *text = (char *)(buffer_end - params_size);
+  memcpy(text, params, params_size);
+
+  CommandParameterSlice *slices = (CommandParameterSlice *)slices_start;
+  uint32_t max_entries =
+      ((uintptr_t)text - slices_start) / sizeof(CommandParameterSlice);
+  result->slices = slices;
+
+  ParameterToken token;
+  token.next = FirstNonSpace(text);
+  while (*token.next) {
+    int32_t parse_result = NextParameter(token.next, &token);
+    if (parse_result) {
+      result->entries = 0;
+      return parse_result;
+    }
+
+    if ((uint32_t)result->entries == max_entries) {
+      result->entries = 0;
+      return PCP_ERR_BUFFER_TOO_SMALL;
+    }
+
+    // The copy is writable, so the key and value are terminated in place. This
+    // is safe as the token has already located the start of the next key.
+    CommandParameterSlice *slice = slices + result->entries++;
+    slice->key = token.key_start;
+    slice->key_length = token.key_end - token.key_start;
+    *(char *)token.key_end = 0;
+
+    slice->value = NULL;
+    slice->value_length = 0;
+    if (token.value_start && token.value_start != token.value_end) {
+      char *value = (char *)token.value_start;
+      int32_t length = token.value_end - token.value_start;
+      if (token.value_needs_unescaping) {
+        length = Unescape(token.value_start, token.value_end, value);
+        if (length < 0) {
+          result->entries = 0;
+          return length;
         }
-        // The next entry must start after the terminating quotation mark.
-        ++entry_end;
       }
+      value[length] = 0;
+      slice->value = value;
+      slice->value_length = length;
     }
+  }
 
-    int set_result =
-        CommandParametersAppend(&max_entries, key_start, key_end, value_start,
-                                value_end, value_needs_unescaping, result);
-    if (set_result) {
-      CPDelete(result);
-      return set_result;
+  return result->entries;
+}
+
+// Parses the value of the given token, which must be entirely numeric.
+static bool ParseNumber(const ParameterToken *token, bool is_signed,
+                        void *output) {
+  const char *start = token->value_start;
+  if (!start || start == token->value_end || token->value_needs_unescaping) {
+    return false;
+  }
+
+  const char *end;
+  if (is_signed) {
+    int32_t value = strtol(start, (char **)&end, 0);
+    if (end != token->value_end) {
+      return false;
+    }
+    *(int32_t *)output = value;
+  } else {
+    uint32_t value = strtoul(start, (char **)&end, 0);
+    if (end != token->value_end) {
+      return false;
     }
+    *(uint32_t *)output = value;
+  }
+  return true;
+}
 
-    key_start = FirstNonSpace(entry_end);
+int32_t CP_API CPParseCommandParametersWithSchema(
+    const char *params, const CommandParameterSchema *schema,
+    uint32_t schema_entries, char *buffer, uint32_t buffer_size,
+    const char **error_key) {
+  const char *unused_error_key;
+  if (!error_key) {
+    error_key = &unused_error_key;
   }
+  *error_key = NULL;
 
-  return result->entries;
+  if (!params || !schema || schema_entries > CP_MAX_SCHEMA_ENTRIES) {
+    return PCP_ERR_INVALID_INPUT;
+  }
+
+  for (uint32_t i = 0; i < schema_entries; ++i) {
+    if (schema[i].type == CP_TYPE_STRING) {
+      *(const char **)schema[i].output = NULL;
+    } else if (schema[i].type == CP_TYPE_FLAG) {
+      *(bool *)schema[i].output = false;
+    }
+  }
+
+  uint32_t found = 0;
+  int32_t num_found = 0;
+  uint32_t buffer_used = 0;
+
+  ParameterToken token;
+  token.next = FirstNonSpace(params);
+  while (*token.next) {
+    int32_t parse_result = NextParameter(token.next, &token);
+    if (parse_result) {
+      return parse_result;
+    }
+
+    uint32_t key_length = token.key_end - token.key_start;
+    uint32_t index = 0;
+    for (; index < schema_entries; ++index) {
+      const char *key = schema[index].key;
+      if (!(found & (1u << index)) &&
+          !strncmp(key, token.key_start, key_length) && !key[key_length]) {
+        break;
+      }
+    }
+    if (index == schema_entries) {
+      continue;
+    }
+
+    const CommandParameterSchema *entry = schema + index;
+    switch (entry->type) {
+      case CP_TYPE_STRING: {
+        // Keys without a value are treated as absent.
+        if (!token.value_start || token.value_start == token.value_end) {
+          continue;
+        }
+        uint32_t value_size = 1 + token.value_end - token.value_start;
+        if (!buffer || buffer_size - buffer_used < value_size) {
+          return PCP_ERR_BUFFER_TOO_SMALL;
+        }
+        char *value = buffer + buffer_used;
+        int32_t length = token.value_end - token.value_start;
+        if (token.value_needs_unescaping) {
+          length = Unescape(token.value_start, token.value_end, value);
+          if (length < 0) {
+            return length;
+          }
+        } else {
+          memcpy(value, token.value_start, length);
+        }
+        value[length] = 0;
+        buffer_used += length + 1;
+        *(const char **)entry->output = value;
+      } break;
+
+      case CP_TYPE_UINT32:
+      case CP_TYPE_INT32:
+        if (!token.value_start || token.value_start == token.value_end) {
+          continue;
+        }
+        if (!ParseNumber(&token, entry->type == CP_TYPE_INT32,
+                         entry->output)) {
+          *error_key = entry->key;
+          return PCP_ERR_INVALID_VALUE;
+        }
+        break;
+
+      case CP_TYPE_FLAG:
+        *(bool *)entry->output = true;
+        break;
+    }
+
+    found |= 1u << index;
+    ++num_found;
+  }
+
+  for (uint32_t i = 0; i < schema_entries; ++i) {
+    if (schema[i].required && !(found & (1u << i))) {
+      *error_key = schema[i].key;
+      return PCP_ERR_MISSING_REQUIRED_KEY;
+    }
+  }
+
+  return num_found;
 }
 
 uint32_t CP_API CPPrintError(int32_t parse_return_code, char *buffer,
@@ -196,6 +397,10 @@ uint32_t CP_API CPPrintError(int32_t parse_return_code, char *buffer,
       strncpy(buffer, "Out of memory", buffer_len);
       return XBOX_E_CREATE_FILE_FAILED;
 
+    case PCP_ERR_BUFFER_TOO_SMALL:
+      strncpy(buffer, "Too many parameters for parse buffer", buffer_len);
+      return XBOX_E_FAIL;
+
     case PCP_ERR_INVALID_KEY:
       strncpy(buffer, "Malformed key", buffer_len);
       return XBOX_E_FAIL;
@@ -210,6 +415,28 @@ uint32_t CP_API CPPrintError(int32_t parse_return_code, char *buffer,
   }
 }
 
+uint32_t CP_API CPPrintSchemaError(int32_t parse_return_code,
+                                   const char *error_key, char *buffer,
+                                   uint32_t buffer_len) {
+  const char *prefix;
+  if (parse_return_code == PCP_ERR_MISSING_REQUIRED_KEY) {
+    prefix = "Missing required '";
+  } else if (parse_return_code == PCP_ERR_INVALID_VALUE) {
+    prefix = "Invalid '";
+  } else {
+    return CPPrintError(parse_return_code, buffer, buffer_len);
+  }
+
+  if (!buffer_len) {
+    return XBOX_E_FAIL;
+  }
+  buffer[0] = 0;
+  strncat(buffer, prefix, buffer_len - 1);
+  strncat(buffer, error_key ? error_key : "", buffer_len - 1 - strlen(buffer));
+  strncat(buffer, "' param", buffer_len - 1 - strlen(buffer));
+  return XBOX_E_FAIL;
+}
+
 bool CP_API CPHasKey(const char *key, CommandParameters *cp) {
   if (!cp || !key) {
     return false;
@@ -254,33 +481,103 @@ bool CP_API CPGetUInt32(const char *key, uint32_t *result,
     return false;
   }
 
-  const char *end;
-  *result = strtoul(string_value, (char **)&end, 0);
-  if (end == string_value) {
+  return ParseUInt32(string_value, result);
+}
+
+bool CP_API CPGetInt32(const char *key, int32_t *result,
+                       CommandParameters *cp) {
+  if (!result) {
     return false;
   }
 
-  // The full value must be a number to consider it valid.
-  if (*end != 0) {
+  const char *string_value;
+  if (!CPGetString(key, &string_value, cp)) {
     *result = 0;
     return false;
   }
 
-  return true;
+  return ParseInt32(string_value, result);
 }
 
-bool CP_API CPGetInt32(const char *key, int32_t *result,
-                       CommandParameters *cp) {
+static const CommandParameterSlice *FindSlice(
+    const char *key, const CommandParameterSlices *cp) {
+  if (!cp || !key) {
+    return NULL;
+  }
+
+  uint32_t key_length = strlen(key);
+  for (int32_t i = 0; i < cp->entries; ++i) {
+    const CommandParameterSlice *slice = cp->slices + i;
+    if (slice->key_length == key_length &&
+        !memcmp(slice->key, key, key_length)) {
+      return slice;
+    }
+  }
+  return NULL;
+}
+
+bool CP_API CPSlicesHasKey(const char *key, const CommandParameterSlices *cp) {
+  return FindSlice(key, cp) != NULL;
+}
+
+bool CP_API CPSlicesGetString(const char *key, const char **result,
+                              const CommandParameterSlices *cp) {
+  if (!result) {
+    return false;
+  }
+
+  const CommandParameterSlice *slice = FindSlice(key, cp);
+  *result = slice ? slice->value : NULL;
+  return *result != NULL;
+}
+
+bool CP_API CPSlicesGetUInt32(const char *key, uint32_t *result,
+                              const CommandParameterSlices *cp) {
   if (!result) {
     return false;
   }
 
   const char *string_value;
-  if (!CPGetString(key, &string_value, cp)) {
+  if (!CPSlicesGetString(key, &string_value, cp)) {
     *result = 0;
     return false;
   }
 
+  return ParseUInt32(string_value, result);
+}
+
+bool CP_API CPSlicesGetInt32(const char *key, int32_t *result,
+                             const CommandParameterSlices *cp) {
+  if (!result) {
+    return false;
+  }
+
+  const char *string_value;
+  if (!CPSlicesGetString(key, &string_value, cp)) {
+    *result = 0;
+    return false;
+  }
+
+  return ParseInt32(string_value, result);
+}
+
+static bool ParseUInt32(const char *string_value, uint32_t *result) {
+  const char *end;
+  *result = strtoul(string_value, (char **)&end, 0);
+  if (end == string_value) {
+    return false;
+  }
+
+  // The full value must be a number to consider it valid.
+  if (*end != 0) {
+    *result = 0;
+    return false;
+  }
+
+  return true;
+}
+
+static bool ParseInt32(const char *string_value, int32_t *result) {
   const char *end;
   *result = strtol(string_value, (char **)&end, 0);
   if (end == string_value) {
@@ -296,6 +593,40 @@ bool CP_API CPGetInt32(const char *key, int32_t *result,
   return true;
 }
 
+// Locates the key/value pair starting at `input`, which must not be empty or
+// begin with a space. Returns 0 on success or a PCP_ERR_ define.
+static int32_t NextParameter(const char *input, ParameterToken *token) {
+  token->key_start = input;
+  token->key_end = KeyEnd(input);
+  if (token->key_end == token->key_start) {
+    return PCP_ERR_INVALID_KEY;
+  }
+
+  const char *entry_end = token->key_end;
+  token->value_start = NULL;
+  token->value_end = NULL;
+  token->value_needs_unescaping = false;
+  if (*token->key_end == '=') {
+    token->value_start = token->key_end + 1;
+    token->value_end =
+        ValueEnd(token->value_start, &token->value_needs_unescaping);
+    entry_end = token->value_end;
+
+    // Ignore the enclosing quotation marks.
+    if (*token->value_start == '"') {
+      ++token->value_start;
+      if (*token->value_end != '"') {
+        return PCP_ERR_INVALID_INPUT_UNTERMINATED_QUOTED_KEY;
+      }
+      // The next entry must start after the terminating quotation mark.
+      ++entry_end;
+    }
+  }
+
+  token->next = FirstNonSpace(entry_end);
+  return 0;
+}
+
 static const char *FirstNonSpace(const char *input) {
   while (*input && *input == ' ') {
     ++input;
@@ -318,6 +649,10 @@ static const char *ValueEnd(const char *input, bool *has_escaped_values) {
       // Ignore any escaped values but flag that unescaping is necessary.
       if (*input == '\\') {
         *has_escaped_values = true;
+        // A trailing escape is left for the unterminated quote check.
+        if (!input[1]) {
+          break;
+        }
         ++input;
       }
       ++input;
@@ -16,9 +16,12 @@ extern "C" {
 
 #define PCP_ERR_INVALID_INPUT -1
 #define PCP_ERR_OUT_OF_MEMORY -2
+#define PCP_ERR_BUFFER_TOO_SMALL -3
 #define PCP_ERR_INVALID_KEY -10
 #define PCP_ERR_INVALID_INPUT_UNTERMINATED_QUOTED_KEY -11
 #define PCP_ERR_INVALID_INPUT_UNTERMINATED_ESCAPE -12
+#define PCP_ERR_MISSING_REQUIRED_KEY -20
+#define PCP_ERR_INVALID_VALUE -21
 
 #define DEFAULT_COMMAND_PARAMETER_RESERVE_SIZE 4
 
@@ -28,6 +31,51 @@ typedef struct CommandParameters {
   char **values;
 } CommandParameters;
 
+//! Key/value pair parsed by CPParseCommandParametersToBuffer. Both strings are
+//! null terminated and point into the caller-provided buffer. `value` is NULL
+//! if the key has no value.
+typedef struct CommandParameterSlice {
+  const char *key;
+  uint32_t key_length;
+  const char *value;
+  uint32_t value_length;
+} CommandParameterSlice;
+
+typedef struct CommandParameterSlices {
+  int32_t entries;
+  CommandParameterSlice *slices;
+} CommandParameterSlices;
+
+//! Returns the size of a buffer sufficient to parse `max_entries` parameters
+//! from a string of `params_length` characters.
+#define CP_PARAMETER_BUFFER_SIZE(max_entries, params_length) \
+  ((max_entries) * sizeof(CommandParameterSlice) + (params_length) + 1 + \
+   sizeof(void *))
+
+//! Types that may be extracted by CPParseCommandParametersWithSchema.
+typedef enum CommandParameterType {
+  //! `output` is a `const char **` that receives a null terminated copy of the
+  //! value or NULL if the key is absent.
+  CP_TYPE_STRING,
+  //! `output` is a `uint32_t *`, left untouched if the key is absent.
+  CP_TYPE_UINT32,
+  //! `output` is an `int32_t *`, left untouched if the key is absent.
+  CP_TYPE_INT32,
+  //! `output` is a `bool *` that is set to whether the key is present.
+  CP_TYPE_FLAG,
+} CommandParameterType;
+
+//! Describes a key to be extracted by CPParseCommandParametersWithSchema.
+typedef struct CommandParameterSchema {
+  const char *key;
+  CommandParameterType type;
+  bool required;
+  void *output;
+} CommandParameterSchema;
+
+//! Maximum number of entries in a CommandParameterSchema table.
+#define CP_MAX_SCHEMA_ENTRIES 32
+
 void CP_API CPDelete(CommandParameters *cp);
 
 //! Parses an XBDM parameter string, populating the given result struct.
@@ -39,9 +87,44 @@ void CP_API CPDelete(CommandParameters *cp);
 int32_t CP_API CPParseCommandParameters(const char *params,
                                         CommandParameters *result);
 
+//! Parses an XBDM parameter string without performing any allocations.
+//!
+//! A copy of `params` is placed at the end of `buffer`, where quoted values are
+//! unescaped in place. The remainder of `buffer` holds the slice array
+//! referenced by `result`. Returns the number of successfully parsed keys or a
+//! PCP_ERR_ define on invalid input. PCP_ERR_BUFFER_TOO_SMALL is returned if
+//! the buffer cannot hold the copy of `params` and every parsed entry.
+//!
+//! `result` remains valid for as long as `buffer` does and needs no cleanup.
+int32_t CP_API CPParseCommandParametersToBuffer(const char *params,
+                                                void *buffer,
+                                                uint32_t buffer_size,
+                                                CommandParameterSlices *result);
+
+//! Extracts the keys described by `schema` from an XBDM parameter string in a
+//! single pass, writing typed values directly to each entry's `output`.
+//! Unrecognized keys are ignored and the first occurrence of a key wins.
+//!
+//! String values are unescaped into `buffer`, which may be NULL if the schema
+//! contains no CP_TYPE_STRING entries.
+//!
+//! Returns the number of schema keys that were found or a PCP_ERR_ define. On
+//! PCP_ERR_MISSING_REQUIRED_KEY and PCP_ERR_INVALID_VALUE, `error_key` is set
+//! to the key of the offending schema entry.
+int32_t CP_API CPParseCommandParametersWithSchema(
+    const char *params, const CommandParameterSchema *schema,
+    uint32_t schema_entries, char *buffer, uint32_t buffer_size,
+    const char **error_key);
+
 uint32_t CP_API CPPrintError(int32_t parse_return_code, char *buffer,
                              uint32_t buffer_len);
 
+//! Prints a description of an error returned by
+//! CPParseCommandParametersWithSchema, including the offending key if any.
+uint32_t CP_API CPPrintSchemaError(int32_t parse_return_code,
+                                   const char *error_key, char *buffer,
+                                   uint32_t buffer_len);
+
 bool CP_API CPHasKey(const char *key, CommandParameters *cp);
 bool CP_API CPGetString(const char *key, const char **result,
                         CommandParameters *cp);
@@ -49,6 +132,14 @@ bool CP_API CPGetUInt32(const char *key, uint32_t *result,
                         CommandParameters *cp);
 bool CP_API CPGetInt32(const char *key, int32_t *result, CommandParameters *cp);
 
+bool CP_API CPSlicesHasKey(const char *key, const CommandParameterSlices *cp);
+bool CP_API CPSlicesGetString(const char *key, const char **result,
+                              const CommandParameterSlices *cp);
+bool CP_API CPSlicesGetUInt32(const char *key, uint32_t *result,
+                              const CommandParameterSlices *cp);
+bool CP_API CPSlicesGetInt32(const char *key, int32_t *result,
+                             const CommandParameterSlices *cp);
+
 #ifdef __cplusplus
 };  // exern "C"
 #endif
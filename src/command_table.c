@@ -0,0 +1,159 @@
+#include "command_table.h"
+
+#include <string.h>
+
+#include "util.h"
+#include "xbdm.h"
+
+static const uint32_t kTag = 0x64647872;  // 'ddxr'
+
+#define INITIAL_CAPACITY 16
+
+// Registered entries, kept sorted by name.
+static CommandTableEntry *entries = NULL;
+static uint32_t num_entries = 0;
+static uint32_t capacity = 0;
+
+static char ToLower(char c) {
+  return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+// Orders `entry_name` relative to the first `name_len` characters of `name`.
+static int CompareName(const char *entry_name, const char *name,
+                       uint32_t name_len) {
+  for (uint32_t i = 0; i < name_len; ++i) {
+    char a = ToLower(entry_name[i]);
+    char b = ToLower(name[i]);
+    if (a != b) {
+      return a < b ? -1 : 1;
+    }
+  }
+  return entry_name[name_len] ? 1 : 0;
+}
+
+// Returns the index of the first entry that does not order before `name`.
+static uint32_t LowerBound(const CommandTableEntry *table, uint32_t count,
+                           const char *name, uint32_t name_len) {
+  uint32_t low = 0;
+  uint32_t high = count;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (CompareName(table[mid].name, name, name_len) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+uint32_t CTGetNameLength(const char *command) {
+  uint32_t ret = 0;
+  while (command[ret] && command[ret] != ' ') {
+    ++ret;
+  }
+  return ret;
+}
+
+const CommandTableEntry *CTFindInTable(const CommandTableEntry *table,
+                                       uint32_t count, const char *name,
+                                       uint32_t name_len) {
+  uint32_t index = LowerBound(table, count, name, name_len);
+  if (index < count && !CompareName(table[index].name, name, name_len)) {
+    return table + index;
+  }
+  return NULL;
+}
+
+CommandTableEntry *CTFind(const char *name, uint32_t name_len) {
+  return (CommandTableEntry *)CTFindInTable(entries, num_entries, name,
+                                            name_len);
+}
+
+static bool Reserve(uint32_t count) {
+  if (count <= capacity) {
+    return true;
+  }
+
+  uint32_t new_capacity = capacity ? capacity * 2 : INITIAL_CAPACITY;
+  CommandTableEntry *new_entries =
+      DmAllocatePoolWithTag(new_capacity * sizeof(*new_entries), kTag);
+  if (!new_entries) {
+    return false;
+  }
+  if (entries) {
+    memcpy(new_entries, entries, num_entries * sizeof(*entries));
+    DmFreePool(entries);
+  }
+  entries = new_entries;
+  capacity = new_capacity;
+  return true;
+}
+
+CommandTableEntry *CTAdd(const char *name, uint32_t handler,
+                         const void *owner) {
+  if (!Reserve(num_entries + 1)) {
+    return NULL;
+  }
+  char *name_copy = PoolStrdup(name, kTag);
+  if (!name_copy) {
+    return NULL;
+  }
+
+  uint32_t index = LowerBound(entries, num_entries, name, strlen(name));
+  memmove(entries + index + 1, entries + index,
+          (num_entries - index) * sizeof(*entries));
+  ++num_entries;
+
+  CommandTableEntry *entry = entries + index;
+  entry->name = name_copy;
+  entry->handler = handler;
+  entry->owner = owner;
+  return entry;
+}
+
+void CTRemove(CommandTableEntry *entry) {
+  DmFreePool((void *)entry->name);
+  uint32_t index = entry - entries;
+  --num_entries;
+  memmove(entry, entry + 1, (num_entries - index) * sizeof(*entries));
+}
+
+uint32_t CTRemoveOwner(const void *owner, bool unclaimed_only) {
+  uint32_t ret = 0;
+  uint32_t i = 0;
+  while (i < num_entries) {
+    CommandTableEntry *entry = entries + i;
+    if (entry->owner == owner && (!unclaimed_only || !entry->handler)) {
+      CTRemove(entry);
+      ++ret;
+    } else {
+      ++i;
+    }
+  }
+  return ret;
+}
+
+void CTReleaseOwner(const void *owner) {
+  for (uint32_t i = 0; i < num_entries; ++i) {
+    if (entries[i].owner == owner) {
+      entries[i].handler = 0;
+    }
+  }
+}
+
+const CommandTableEntry *CTGetEntries(uint32_t *count) {
+  *count = num_entries;
+  return entries;
+}
+
+void CTReset(void) {
+  while (num_entries) {
+    CTRemove(entries + num_entries - 1);
+  }
+  if (entries) {
+    DmFreePool(entries);
+    entries = NULL;
+  }
+  capacity = 0;
+}
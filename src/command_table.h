@@ -0,0 +1,59 @@
+#ifndef DYNDXT_LOADER_COMMAND_TABLE_H
+#define DYNDXT_LOADER_COMMAND_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A subcommand handled by the loader's command processor. Names are compared
+// case-insensitively.
+typedef struct CommandTableEntry {
+  const char *name;
+  // Address of the handler. 0 while the owner is being replaced.
+  uint32_t handler;
+  // Opaque identifier of whatever registered the handler, or NULL.
+  const void *owner;
+} CommandTableEntry;
+
+// Returns the length of the subcommand name at the start of `command`, which is
+// terminated by a space or the end of the string.
+uint32_t CTGetNameLength(const char *command);
+
+// Binary searches `count` entries sorted by name for the one whose name matches
+// the first `name_len` characters of `name`. Returns NULL if there is none.
+const CommandTableEntry *CTFindInTable(const CommandTableEntry *table,
+                                       uint32_t count, const char *name,
+                                       uint32_t name_len);
+
+// Returns the registered entry matching the first `name_len` characters of
+// `name`, or NULL. Entries remain valid until the next CTAdd or CTRemove*.
+CommandTableEntry *CTFind(const char *name, uint32_t name_len);
+
+// Registers a handler for `name`, which must not already be registered.
+// Returns NULL if allocation fails.
+CommandTableEntry *CTAdd(const char *name, uint32_t handler,
+                         const void *owner);
+
+void CTRemove(CommandTableEntry *entry);
+
+// Removes every entry registered by `owner`. If `unclaimed_only` is set, only
+// entries whose handler is 0 are removed. Returns the number removed.
+uint32_t CTRemoveOwner(const void *owner, bool unclaimed_only);
+
+// Clears the handler of every entry registered by `owner`.
+void CTReleaseOwner(const void *owner);
+
+// Returns the registered entries, sorted by name.
+const CommandTableEntry *CTGetEntries(uint32_t *count);
+
+// Removes every entry and frees the table.
+void CTReset(void);
+
+#ifdef __cplusplus
+};  // extern "C"
+#endif
+
+#endif  // DYNDXT_LOADER_COMMAND_TABLE_H
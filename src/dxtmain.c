@@ -6,11 +6,21 @@
 #include <windows.h>
 
 #include "command_processor_util.h"
+#include "command_table.h"
 #include "dll_loader.h"
+#include "dynamic_dxt_loader.h"
+#include "entrypoint_worker.h"
+#include "image_bundle.h"
+#include "image_cache.h"
+#include "image_patch.h"
 #include "link_loaded_modules.h"
+#include "lz4_stream.h"
 #include "module_registry.h"
 #include "nxdk_dxt_dll_main.h"
+#include "plugin_table.h"
 #include "response_util.h"
+#include "sha256.h"
+#include "upload_manager.h"
 #include "util.h"
 #include "xbdm.h"
 
@@ -21,7 +31,14 @@
 static const char kHandlerName[] = "ddxt";
 static const uint32_t kTag = 0x64647874;  // 'ddxt'
 
+// Size of the stack buffer into which command parameters are parsed.
+#define COMMAND_PARAMETER_BUFFER_SIZE 512
+
 typedef HRESULT (*DXTMainProc)(void);
+typedef HRESULT (*CommandHandler)(const char *command, char *response,
+                                  DWORD response_len,
+                                  struct CommandContext *ctx);
+typedef void (*PluginShutdownProc)(void);
 
 typedef struct SendMethodAddressesContext {
   ModuleRegistryCursor cursor;
@@ -34,19 +51,236 @@ typedef struct ReceiveImageDataContext {
   uint32_t num_tls_callbacks;
   uint32_t *tls_callbacks;
   bool relocation_needed;
+  // Used to build the final image as data arrives if `relocation_needed` is
+  // set.
+  DLLContext dll_context;
+  // Set if the image is transferred LZ4 compressed. Decompressed data is passed
+  // directly to `dll_context`.
+  bool compressed;
+  LZ4StreamDecoder decoder;
+  // Set if the host provided the digest of the raw image. Data is hashed as it
+  // arrives and is retained in `cache_entry` (if any) once verified.
+  bool verify_digest;
+  uint8_t expected_digest[SHA256_DIGEST_SIZE];
+  SHA256Context sha256;
+  ImageCacheEntry *cache_entry;
+  uint32_t cache_entry_used;
+  // Set if the image is transferred as a patch against `patch_base`, which is
+  // pinned in the image cache until the transfer completes.
+  bool patched;
+  ImagePatchDecoder patch;
+  const ImageCacheEntry *patch_base;
+  // Set if the image was loaded from the image cache.
+  bool from_cache;
+  // If set, the entrypoint is invoked on a worker thread and its result is
+  // reported via the notification channel.
+  bool async;
+  // If set, the loaded image replaces the image of this plugin.
+  LoadedPlugin *reload_target;
 } ReceiveImageDataContext;
 
-// Reserve memory space for context objects used by multiline and binary receive
-// responses.
-static union {
-  SendMethodAddressesContext send_method_addresses_context;
-  ReceiveImageDataContext receive_image_data_context;
-} context_store;
-
+typedef struct ReceiveBundleDataContext {
+  // The bundle is received in place into this buffer.
+  uint8_t *data;
+  uint32_t size;
+  // Used to load each image in the bundle in turn.
+  DLLContext dll_context;
+} ReceiveBundleDataContext;
+
+typedef struct ReceiveUploadPartContext {
+  uint32_t upload_id;
+  // Offset of the part within the upload.
+  uint32_t offset;
+  uint32_t bytes_received;
+  // Set if this part received the last missing block of the upload.
+  bool completed_upload;
+} ReceiveUploadPartContext;
+
+// Flags set on an upload by "loadbegin".
+#define UPLOAD_FLAG_AUTO_COMMIT 0x01
+#define UPLOAD_FLAG_ASYNC 0x02
+
+typedef struct SendMissingRangesContext {
+  uint32_t upload_id;
+  // Offset from which to search for the next missing range.
+  uint32_t next_offset;
+} SendMissingRangesContext;
+
+// Plugin whose shutdown hook is running as part of a reload.
+static LoadedPlugin *reloading_plugin = NULL;
+
+// Maximum number of connections that may have a multiline or binary response
+// in progress at once.
+#define MAX_CONNECTION_CONTEXTS 4
+
+// Context objects used by multiline and binary receive responses. XBDM keeps a
+// CommandContext per connection, which identifies the owner of each entry.
+typedef struct ConnectionContext {
+  // The connection using this context, or NULL if it is free.
+  struct CommandContext *owner;
+  // The handler that continues the owner's response.
+  ContinuationProc handler;
+  // Set if the owner is receiving binary data rather than sending a multiline
+  // response.
+  bool receiving;
+  // Time at which the owner last issued a command or continued its response.
+  uint32_t last_activity;
+  // The plugin that started the response, which is pinned while the response is
+  // continued, or NULL if it was started by the loader. Responses of the loader
+  // are continued with the command lock held instead.
+  LoadedPlugin *plugin;
+  // Set once the owner has moved on from a response whose resources may only be
+  // freed by the loader's own command processing. The context is no longer
+  // found for the owner and is freed by the next ddxt command.
+  bool abandoned;
+  union {
+    SendMethodAddressesContext send_method_addresses_context;
+    ReceiveImageDataContext receive_image_data_context;
+    ReceiveBundleDataContext receive_bundle_data_context;
+    ReceiveUploadPartContext receive_upload_part_context;
+    SendMissingRangesContext send_missing_ranges_context;
+  } store;
+} ConnectionContext;
+
+static ConnectionContext connection_contexts[MAX_CONNECTION_CONTEXTS];
+
+// Kernel exports used to run command processing on a dedicated thread. These
+// are resolved via the module registry as the loader only links against XBDM.
+static const char kXboxKernelName[] = "xboxkrnl.exe";
+#define ORDINAL_KE_DELAY_EXECUTION_THREAD 99
+#define ORDINAL_KE_TICK_COUNT 156
+#define ORDINAL_PS_CREATE_SYSTEM_THREAD_EX 255
+#define ORDINAL_RTL_ENTER_CRITICAL_SECTION 277
+#define ORDINAL_RTL_INITIALIZE_CRITICAL_SECTION 291
+#define ORDINAL_RTL_LEAVE_CRITICAL_SECTION 294
+
+// Minimum stack size of the command processing thread.
+#define COMMAND_THREAD_STACK_SIZE 0x10000
+
+typedef X_API_PTR(NTSTATUS, PsCreateSystemThreadExProc)(
+    HANDLE *thread_handle, ULONG thread_extension_size, ULONG kernel_stack_size,
+    ULONG tls_data_size, HANDLE *thread_id,
+    LPTHREAD_START_ROUTINE start_routine, void *start_context,
+    BOOLEAN create_suspended, BOOLEAN debugger_thread, void *system_routine);
+typedef VOID_API_PTR(CriticalSectionProc)(CRITICAL_SECTION *critical_section);
+typedef X_API_PTR(NTSTATUS, KeDelayExecutionThreadProc)(
+    CHAR wait_mode, BOOLEAN alertable, LARGE_INTEGER *interval);
+
+// Interval for which YieldLoader sleeps, in relative 100ns units.
+#define YIELD_INTERVAL (-10000)
+
+static const volatile ULONG *tick_count;
+static PsCreateSystemThreadExProc create_system_thread;
+static CriticalSectionProc enter_critical_section;
+static CriticalSectionProc leave_critical_section;
+static KeDelayExecutionThreadProc delay_execution_thread;
+
+// Serializes the loader's own ddxt commands and their continuations, which may
+// run on one thread per connection. Held while an image is loaded, unloaded, or
+// replaced. Must be acquired before the loader lock.
+static CRITICAL_SECTION command_lock;
+
+// Protects the plugin and command tables and the connection contexts. Held only
+// while they are inspected or updated, never while a load or a handler
+// implemented by a plugin runs.
+static CRITICAL_SECTION loader_lock;
+
+// Handles a ddxt command. The loader's own subcommands are serialized via the
+// command lock, while those registered via DDXTRegisterCommand are dispatched
+// as by DispatchPluginCommand.
 static HRESULT_API ProcessCommand(const char *command, char *response,
                                   DWORD response_len,
                                   struct CommandContext *ctx);
 
+// Invokes the handler of the multiline or binary response in progress on the
+// given connection, releasing its context once the response is complete.
+static HRESULT_API ContinueCommand(struct CommandContext *ctx, char *response,
+                                   DWORD response_len);
+
+// Records the multiline or binary response started by a command of `plugin`
+// (NULL for the loader) that returned `ret` on the given connection so that it
+// is continued via ContinueCommand, or releases the connection's context if
+// there is none. The context must have been acquired before the command was
+// handled.
+static void TrackResponse(struct CommandContext *ctx, HRESULT ret,
+                          uint32_t now, LoadedPlugin *plugin);
+
+// Returns the context to be used for a multiline or binary response on the
+// given connection, or NULL if every context is in use. The context is marked
+// as active so that other connections do not discard it as idle. Takes the
+// loader lock.
+static ConnectionContext *AcquireConnectionContext(struct CommandContext *ctx);
+
+// Returns the context of the response in progress on the given connection, or
+// NULL. Takes the loader lock.
+static ConnectionContext *FindConnectionContext(struct CommandContext *ctx);
+
+// Takes the loader lock.
+static void ReleaseConnectionContext(struct CommandContext *ctx);
+
+// Frees the resources of responses that have been abandoned, either because
+// the connection `ctx` has issued a new command or because their connection has
+// been idle for longer than UPLOAD_DEFAULT_TIMEOUT_MS. Images and bundles being
+// received may only be freed with the command lock held, so unless
+// `release_resources` is set their contexts are left for a later call. The
+// loader lock must be held.
+static void DiscardAbandonedContexts(struct CommandContext *ctx, uint32_t now,
+                                     bool release_resources);
+
+// Returns the number of milliseconds since boot, or 0 if the kernel's tick
+// count could not be resolved.
+static uint32_t TickCount(void);
+
+// Creates the thread used to process ddxt commands. Compatible with
+// CreateThread.
+static HANDLE_API CreateCommandThread(LPSECURITY_ATTRIBUTES thread_attributes,
+                                      SIZE_T stack_size,
+                                      LPTHREAD_START_ROUTINE start_address,
+                                      LPVOID parameter, DWORD creation_flags,
+                                      LPDWORD thread_id);
+
+// Resolves the kernel exports needed to process commands on a dedicated thread.
+// Returns false if any is unavailable.
+static bool ResolveKernelExports(void);
+
+static void LockCommands(void);
+static void UnlockCommands(void);
+static void LockLoader(void);
+static void UnlockLoader(void);
+
+// Releases the loader lock, which must be held exactly once, long enough for
+// other threads to make progress, then reacquires it.
+static void YieldLoader(void);
+
+// Prevents `plugin` from being pinned, then waits for the handlers that have
+// already pinned it to return. Commands for the plugin wait until `closing` is
+// cleared or the plugin is removed. The loader lock must be held exactly once
+// and is released while waiting.
+static void RundownPlugin(LoadedPlugin *plugin);
+
+// Runs `handler`, implemented by `plugin` (which may be NULL), as the processor
+// of the given command. The loader lock must be held exactly once. It is
+// released while the handler runs, with the plugin pinned so that it cannot be
+// unloaded or replaced, and is released on return. A multiline or binary
+// response is wrapped by ContinueCommand so that it is discarded if the plugin
+// goes away.
+static HRESULT InvokePluginHandler(LoadedPlugin *plugin, ProcessorProc handler,
+                                   const char *command, char *response,
+                                   DWORD response_len,
+                                   struct CommandContext *ctx);
+
+// Pins an asynchronously started plugin before its entrypoint is invoked, so
+// that an unload or reload waits for the entrypoint to return. Returns false if
+// the plugin has since been unloaded or replaced.
+static bool BeginAsyncEntrypoint(uint32_t image_base,
+                                 EntrypointProc entrypoint);
+
+// Unpins the plugin pinned by BeginAsyncEntrypoint, if it was.
+static void EndAsyncEntrypoint(uint32_t image_base, bool invoked);
+
+static const EntrypointWorkerHooks kEntrypointWorkerHooks = {
+    CreateCommandThread, BeginAsyncEntrypoint, EndAsyncEntrypoint};
+
 // Trivial request to indicate that this DLL is running. Enumerates the module
 // export registry to aid debugging.
 static HRESULT HandleHello(const char *command, char *response,
@@ -57,6 +291,52 @@ static HRESULT HandleDynamicLoad(const char *command, char *response,
                                  DWORD response_len,
                                  struct CommandContext *ctx);
 
+// Starts an upload of a DLL image that may be sent in parts, in any order and
+// over several connections at once, via "loadpart" and then loaded via
+// "loadcommit" or by the part that completes it.
+static HRESULT HandleLoadBegin(const char *command, char *response,
+                               DWORD response_len, struct CommandContext *ctx);
+
+// Receives a range of an upload started by "loadbegin".
+static HRESULT HandleLoadPart(const char *command, char *response,
+                              DWORD response_len, struct CommandContext *ctx);
+
+// Lists the ranges of an upload that have not been received.
+static HRESULT HandleLoadStatus(const char *command, char *response,
+                                DWORD response_len, struct CommandContext *ctx);
+
+// Loads a fully received upload as with "load".
+static HRESULT HandleLoadCommit(const char *command, char *response,
+                                DWORD response_len, struct CommandContext *ctx);
+static HRESULT LoadUpload(Upload *upload, bool async,
+                          ConnectionContext *context, char *response,
+                          DWORD response_len);
+
+// Loads a DLL image by applying a patch to a raw image retained in the image
+// cache by an earlier load, then relocates it and invokes its entrypoint.
+static HRESULT HandleDeltaLoad(const char *command, char *response,
+                               DWORD response_len, struct CommandContext *ctx);
+
+// Receives several DLL images in a single transfer and loads them in dependency
+// order.
+static HRESULT HandleLoadBundle(const char *command, char *response,
+                                DWORD response_len,
+                                struct CommandContext *ctx);
+
+// Loads a new build of a previously loaded DLL and swaps it in place of the
+// running image without unregistering its command processors.
+static HRESULT HandleReload(const char *command, char *response,
+                            DWORD response_len, struct CommandContext *ctx);
+
+// Invokes the shutdown hook of a previously loaded DLL, removes its command
+// processors and registry entries, and frees its image.
+static HRESULT HandleUnload(const char *command, char *response,
+                            DWORD response_len, struct CommandContext *ctx);
+
+// Reports and configures the cache of previously loaded raw DLL images.
+static HRESULT HandleCache(const char *command, char *response,
+                           DWORD response_len, struct CommandContext *ctx);
+
 #ifndef LEAN_BUILD
 // Registers a method exported by some module. E.g.,
 // "xboxkrnl.exe @ 1 (_AvGetSavedDataAddress@0) = 0x8003FE0E"
@@ -79,73 +359,516 @@ static HRESULT HandleInstall(const char *command, char *response,
                              DWORD response_len, struct CommandContext *ctx);
 #endif
 
+// Registered in place of the XBDM methods of the same name so that command
+// processors registered by loaded DLLs are dispatched through
+// DispatchPluginCommand and may be replaced or removed later.
+static HRESULT_API RegisterPluginCommandProcessor(const char *prefix,
+                                                  ProcessorProc proc);
+static HRESULT_API RegisterPluginCommandProcessorEx(
+    const char *prefix, ProcessorProc proc,
+    CreateThreadFunc create_thread_func);
+
+// Forwards a command to the current implementation of the plugin command
+// processor registered for its prefix.
+static HRESULT_API DispatchPluginCommand(const char *command, char *response,
+                                         DWORD response_len,
+                                         struct CommandContext *ctx);
+
+// Invokes the handler registered via DDXTRegisterCommand for the `name_len`
+// character subcommand at `subcommand`, as with DispatchPluginCommand.
+static HRESULT DispatchRegisteredCommand(const char *command,
+                                         const char *subcommand,
+                                         uint32_t name_len, char *response,
+                                         DWORD response_len,
+                                         struct CommandContext *ctx);
+
+// Returns true if a "reload" of the given plugin is still receiving its image.
+// The plugin must not be freed until the transfer completes or is abandoned.
+static bool HasPendingReload(const LoadedPlugin *plugin);
+
+// Fails if any loaded DLL imported from `plugin`. Imports are bound when a DLL
+// is loaded, so its dependents would be left calling into the freed image.
+static HRESULT CheckNoDependents(const LoadedPlugin *plugin, char *response,
+                                 DWORD response_len);
+
+// Discards responses in progress that were started by `plugin` or whose
+// continuation lies within the given image. Returns the number discarded. The
+// loader lock must be held.
+static uint32_t DiscardPluginContexts(const LoadedPlugin *plugin,
+                                      const uint8_t *image,
+                                      uint32_t image_size);
+
 static HRESULT_API SendMethodAddresses(struct CommandContext *ctx,
                                        char *response, DWORD response_len);
 static HRESULT_API ReceiveImageData(struct CommandContext *ctx, char *response,
                                     DWORD response_len);
-
+static HRESULT_API ReceiveBundleData(struct CommandContext *ctx, char *response,
+                                     DWORD response_len);
+static HRESULT_API ReceiveUploadPart(struct CommandContext *ctx, char *response,
+                                     DWORD response_len);
+static HRESULT_API SendMissingRanges(struct CommandContext *ctx, char *response,
+                                     DWORD response_len);
+
+static HRESULT ReceiveImage(const char *command, char *response,
+                            DWORD response_len, struct CommandContext *ctx,
+                            LoadedPlugin *reload_target);
+static void ResetReceiveImageContext(ReceiveImageDataContext *ctx,
+                                     uint32_t size,
+                                     LoadedPlugin *reload_target, bool async);
+static HRESULT BeginReceiveImage(ReceiveImageDataContext *ctx, uint32_t size,
+                                 const char *hash, LoadedPlugin *reload_target,
+                                 bool async, char *response,
+                                 DWORD response_len);
 static HRESULT ReceiveImageDataComplete(ReceiveImageDataContext *ctx,
                                         char *response, DWORD response_len);
-static bool RegisterExport(const char *name, const char *alias,
-                           uint32_t ordinal, uint32_t address);
+static HRESULT LoadBundle(ReceiveBundleDataContext *ctx, char *response,
+                          DWORD response_len);
+static bool LoadBundleImage(DLLContext *ctx, const ImageBundleEntry *entry);
+static bool StartPlugin(void *image, uint32_t image_size,
+                        DXTMainProc entrypoint, bool async);
+static HRESULT LinkPluginExports(const LoadedPlugin *plugin);
+static void ReplacePlugin(LoadedPlugin *plugin, void *image,
+                          uint32_t image_size, DXTMainProc entrypoint);
+static uint32_t ReleasePluginImage(uint8_t *image, uint32_t image_size);
+static void InitDLLContext(DLLContext *ctx);
+static HRESULT SetDLLLoaderError(const char *message, const DLLContext *ctx,
+                                 char *response, DWORD response_len);
+static bool ConsumeImageData(void *sink_context, const void *data,
+                             uint32_t size);
+static void ReleaseReceiveResources(ReceiveImageDataContext *ctx);
+static HRESULT AbortDecoding(ReceiveImageDataContext *ctx, char *response,
+                             DWORD response_len);
+static bool ParseDigest(const char *hex, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+// Keep in sync with name used in dynamic_dxt_loader.dll.def
+static const char kDynamicDXTLoaderDLLName[] = "dynamic_dxt_loader.dll";
+
+// Methods exported by this DLL for use in DLLs to be loaded later.
+// Methods are registered for undecorated and __stdcall decorated versions of
+// the names to minimize dependencies on linker flags.
+//
+// Decorated names can be determined by using `nm` on the lib file generated
+// by building this project:
+// `nm -g libdynamic_dxt_loader.lib | grep "T _"`
+static const ModuleExport kLoaderExports[] = {
+    {2, "CPDelete@4", "CPDelete", (uint32_t)CPDelete},
+    {3, "CPParseCommandParameters@8", "CPParseCommandParameters",
+     (uint32_t)CPParseCommandParameters},
+    {4, "CPPrintError@12", "CPPrintError", (uint32_t)CPPrintError},
+    {5, "CPHasKey@8", "CPHasKey", (uint32_t)CPHasKey},
+    {6, "CPGetString@12", "CPGetString", (uint32_t)CPGetString},
+    {7, "CPGetUInt32@12", "CPGetUInt32", (uint32_t)CPGetUInt32},
+    {8, "CPGetInt32@12", "CPGetInt32", (uint32_t)CPGetInt32},
+    {9, "MRRegisterMethod@8", "MRRegisterMethod", (uint32_t)MRRegisterMethod},
+    {10, "MRGetMethodByOrdinal@12", "MRGetMethodByOrdinal",
+     (uint32_t)MRGetMethodByOrdinal},
+    {11, "MRGetMethodByName@12", "MRGetMethodByName",
+     (uint32_t)MRGetMethodByName},
+    {12, "MRGetModuleHandle@8", "MRGetModuleHandle",
+     (uint32_t)MRGetModuleHandle},
+    {13, "MRGetMethodByOrdinalInModule@12", "MRGetMethodByOrdinalInModule",
+     (uint32_t)MRGetMethodByOrdinalInModule},
+    {14, "MRGetMethodByNameInModule@12", "MRGetMethodByNameInModule",
+     (uint32_t)MRGetMethodByNameInModule},
+    {15, "MRRegisterMethods@16", "MRRegisterMethods",
+     (uint32_t)MRRegisterMethods},
+    {16, "CPParseCommandParametersToBuffer@16",
+     "CPParseCommandParametersToBuffer",
+     (uint32_t)CPParseCommandParametersToBuffer},
+    {17, "CPSlicesHasKey@8", "CPSlicesHasKey", (uint32_t)CPSlicesHasKey},
+    {18, "CPSlicesGetString@12", "CPSlicesGetString",
+     (uint32_t)CPSlicesGetString},
+    {19, "CPSlicesGetUInt32@12", "CPSlicesGetUInt32",
+     (uint32_t)CPSlicesGetUInt32},
+    {20, "CPSlicesGetInt32@12", "CPSlicesGetInt32", (uint32_t)CPSlicesGetInt32},
+    {21, "CPParseCommandParametersWithSchema@24",
+     "CPParseCommandParametersWithSchema",
+     (uint32_t)CPParseCommandParametersWithSchema},
+    {22, "CPPrintSchemaError@16", "CPPrintSchemaError",
+     (uint32_t)CPPrintSchemaError},
+    {23, "DDXTRegisterCommand@8", "DDXTRegisterCommand",
+     (uint32_t)DDXTRegisterCommand},
+};
+
+static const char kXBDMDLLName[] = "xbdm.dll";
+
+// XBDM methods that are replaced for DLLs loaded by this loader. Keep in sync
+// with xbdm.dll.def.
+static const ModuleExport kXBDMOverrides[] = {
+    {30, "DmRegisterCommandProcessor@8", "DmRegisterCommandProcessor",
+     (uint32_t)RegisterPluginCommandProcessor},
+    {72, "DmRegisterCommandProcessorEx@12", "DmRegisterCommandProcessorEx",
+     (uint32_t)RegisterPluginCommandProcessorEx},
+};
 
 HRESULT DXTMain(void) {
-  // Register methods exported by this DLL for use in DLLs to be loaded later.
-  // Methods are registered for undecorated and __stdcall decorated versions of
-  // the names to minimize dependencies on linker flags.
-  //
-  // Decorated names can be determined by using `nm` on the lib file generated
-  // by building this project:
-  // `nm -g libdynamic_dxt_loader.lib | grep "T _"`
-  RegisterExport("CPDelete@4", "CPDelete", 2, (uint32_t)CPDelete);
-  RegisterExport("CPParseCommandParameters@8", "CPParseCommandParameters", 3,
-                 (uint32_t)CPParseCommandParameters);
-  RegisterExport("CPPrintError@12", "CPPrintError", 4, (uint32_t)CPPrintError);
-  RegisterExport("CPHasKey@8", "CPHasKey", 5, (uint32_t)CPHasKey);
-  RegisterExport("CPGetString@12", "CPGetString", 6, (uint32_t)CPGetString);
-  RegisterExport("CPGetUInt32@12", "CPGetUInt32", 7, (uint32_t)CPGetUInt32);
-  RegisterExport("CPGetInt32@12", "CPGetInt32", 8, (uint32_t)CPGetInt32);
-  RegisterExport("MRRegisterMethod@8", "MRRegisterMethod", 9,
-                 (uint32_t)MRRegisterMethod);
-  RegisterExport("MRGetMethodByOrdinal@12", "MRGetMethodByOrdinal", 10,
-                 (uint32_t)MRGetMethodByOrdinal);
-  RegisterExport("MRGetMethodByName@12", "MRGetMethodByName", 11,
-                 (uint32_t)MRGetMethodByName);
+  MRRegisterMethods(kDynamicDXTLoaderDLLName, kLoaderExports,
+                    sizeof(kLoaderExports) / sizeof(kLoaderExports[0]),
+                    MR_FLAG_STATIC);
 
   LinkLoadedModules();
 
-  return DmRegisterCommandProcessor(kHandlerName, ProcessCommand);
+  uint32_t tick_count_address;
+  if (MRGetMethodByOrdinal(kXboxKernelName, ORDINAL_KE_TICK_COUNT,
+                           &tick_count_address)) {
+    tick_count = (const volatile ULONG *)tick_count_address;
+  }
+
+  // Explicitly registered exports take precedence over the lazily linked XBDM
+  // image.
+  MRRegisterMethods(kXBDMDLLName, kXBDMOverrides,
+                    sizeof(kXBDMOverrides) / sizeof(kXBDMOverrides[0]),
+                    MR_FLAG_STATIC);
+
+  // Loading a DLL can take long enough to stall unrelated XBDM traffic, so
+  // commands are processed on a dedicated thread where possible.
+  if (!ResolveKernelExports()) {
+    return DmRegisterCommandProcessor(kHandlerName, ProcessCommand);
+  }
+  return DmRegisterCommandProcessorEx(kHandlerName, ProcessCommand,
+                                      CreateCommandThread);
 }
 
+// Subcommands handled by the loader, sorted by name.
+static const CommandTableEntry kCommands[] = {
+    {"cache", (uint32_t)HandleCache, NULL},
+#ifndef LEAN_BUILD
+    {"export", (uint32_t)HandleRegisterModuleExport, NULL},
+#endif
+    {"hello", (uint32_t)HandleHello, NULL},
+#ifndef LEAN_BUILD
+    {"install", (uint32_t)HandleInstall, NULL},
+#endif
+    {"load", (uint32_t)HandleDynamicLoad, NULL},
+    {"loadbegin", (uint32_t)HandleLoadBegin, NULL},
+    {"loadbundle", (uint32_t)HandleLoadBundle, NULL},
+    {"loadcommit", (uint32_t)HandleLoadCommit, NULL},
+    {"loaddelta", (uint32_t)HandleDeltaLoad, NULL},
+    {"loadpart", (uint32_t)HandleLoadPart, NULL},
+    {"loadstatus", (uint32_t)HandleLoadStatus, NULL},
+    {"reload", (uint32_t)HandleReload, NULL},
+#ifndef LEAN_BUILD
+    {"reserve", (uint32_t)HandleReserve, NULL},
+#endif
+    {"unload", (uint32_t)HandleUnload, NULL},
+};
+
 static HRESULT_API ProcessCommand(const char *command, char *response,
                                   DWORD response_len,
                                   struct CommandContext *ctx) {
   const char *subcommand = command + sizeof(kHandlerName);
+  uint32_t name_len = CTGetNameLength(subcommand);
+
+  const CommandTableEntry *entry =
+      CTFindInTable(kCommands, sizeof(kCommands) / sizeof(kCommands[0]),
+                    subcommand, name_len);
+  if (!entry) {
+    return DispatchRegisteredCommand(command, subcommand, name_len, response,
+                                     response_len, ctx);
+  }
+
+  LockCommands();
+  uint32_t now = TickCount();
+  LockLoader();
+  DiscardAbandonedContexts(ctx, now, true);
+  UnlockLoader();
+
+  HRESULT ret = ((CommandHandler)entry->handler)(subcommand + name_len,
+                                                 response, response_len, ctx);
+  TrackResponse(ctx, ret, now, NULL);
 
-  if (!strncmp(subcommand, "hello", 5)) {
-    return HandleHello(command + 5, response, response_len, ctx);
+  UnlockCommands();
+  return ret;
+}
+
+static HRESULT_API ContinueCommand(struct CommandContext *ctx, char *response,
+                                   DWORD response_len) {
+  // Continuations of a plugin that is being replaced or unloaded wait until it
+  // is done, by which time their context has been discarded.
+  LockLoader();
+  ConnectionContext *context;
+  while ((context = FindConnectionContext(ctx)) && context->plugin &&
+         context->plugin->closing) {
+    YieldLoader();
   }
 
-  if (!strncmp(subcommand, "load", 4)) {
-    return HandleDynamicLoad(command + 4, response, response_len, ctx);
+  // The response may have been discarded after being idle for too long.
+  if (!context) {
+    UnlockLoader();
+    return SetXBDMError(XBOX_E_FAIL, "Response expired", response,
+                        response_len);
   }
 
-#ifndef LEAN_BUILD
-  if (!strncmp(subcommand, "reserve", 7)) {
-    return HandleReserve(command + 7, response, response_len, ctx);
+  context->last_activity = TickCount();
+  ContinuationProc handler = context->handler;
+  bool receiving = context->receiving;
+  LoadedPlugin *plugin = context->plugin;
+  if (plugin) {
+    ++plugin->pins;
   }
+  UnlockLoader();
 
-  if (!strncmp(subcommand, "install", 7)) {
-    return HandleInstall(command + 7, response, response_len, ctx);
+  // The loader's own continuations receive and load images, so they are
+  // serialized with its commands.
+  HRESULT ret;
+  if (plugin) {
+    ret = handler(ctx, response, response_len);
+  } else {
+    LockCommands();
+    ret = handler(ctx, response, response_len);
+    UnlockCommands();
   }
 
-  if (!strncmp(subcommand, "export", 6)) {
-    return HandleRegisterModuleExport(command + 6, response, response_len, ctx);
+  LockLoader();
+  if (plugin) {
+    --plugin->pins;
+  }
+  if (!XBOX_SUCCESS(ret) || (receiving && !ctx->bytes_remaining)) {
+    ReleaseConnectionContext(ctx);
+  }
+  UnlockLoader();
+  return ret;
+}
+
+static void TrackResponse(struct CommandContext *ctx, HRESULT ret,
+                          uint32_t now, LoadedPlugin *plugin) {
+  if (ret == XBOX_S_MULTILINE || ret == XBOX_S_SEND_BINARY) {
+    ConnectionContext *context = AcquireConnectionContext(ctx);
+    context->handler = ctx->handler;
+    context->receiving = ret == XBOX_S_SEND_BINARY;
+    context->last_activity = now;
+    context->plugin = plugin;
+    ctx->handler = ContinueCommand;
+  } else {
+    ReleaseConnectionContext(ctx);
+  }
+}
+
+static ConnectionContext *AcquireConnectionContext(struct CommandContext *ctx) {
+  LockLoader();
+  ConnectionContext *ret = FindConnectionContext(ctx);
+  for (uint32_t i = 0; !ret && i < MAX_CONNECTION_CONTEXTS; ++i) {
+    if (!connection_contexts[i].owner) {
+      ret = connection_contexts + i;
+      ret->owner = ctx;
+      ret->abandoned = false;
+    }
+  }
+
+  if (ret) {
+    ret->last_activity = TickCount();
+  }
+  UnlockLoader();
+  return ret;
+}
+
+static ConnectionContext *FindConnectionContext(struct CommandContext *ctx) {
+  LockLoader();
+  ConnectionContext *ret = NULL;
+  for (uint32_t i = 0; !ret && i < MAX_CONNECTION_CONTEXTS; ++i) {
+    ConnectionContext *context = connection_contexts + i;
+    if (context->owner == ctx && !context->abandoned) {
+      ret = context;
+    }
+  }
+  UnlockLoader();
+  return ret;
+}
+
+static void ReleaseConnectionContext(struct CommandContext *ctx) {
+  LockLoader();
+  ConnectionContext *context = FindConnectionContext(ctx);
+  if (context) {
+    context->owner = NULL;
+  }
+  UnlockLoader();
+}
+
+static void DiscardAbandonedContexts(struct CommandContext *ctx, uint32_t now,
+                                     bool release_resources) {
+  for (uint32_t i = 0; i < MAX_CONNECTION_CONTEXTS; ++i) {
+    ConnectionContext *context = connection_contexts + i;
+    if (!context->owner ||
+        (!context->abandoned && context->owner != ctx &&
+         now - context->last_activity <= UPLOAD_DEFAULT_TIMEOUT_MS)) {
+      continue;
+    }
+
+    if (!release_resources && (context->handler == ReceiveImageData ||
+                               context->handler == ReceiveBundleData)) {
+      context->abandoned = true;
+      continue;
+    }
+
+    if (context->handler == ReceiveImageData) {
+      ReceiveImageDataContext *receive_ctx =
+          &context->store.receive_image_data_context;
+      ReleaseReceiveResources(receive_ctx);
+      if (receive_ctx->relocation_needed) {
+        DLLFreeContext(&receive_ctx->dll_context, false);
+      }
+    } else if (context->handler == ReceiveBundleData) {
+      DmFreePool(context->store.receive_bundle_data_context.data);
+    }
+    context->owner = NULL;
+  }
+}
+
+static bool HasPendingReload(const LoadedPlugin *plugin) {
+  for (uint32_t i = 0; i < MAX_CONNECTION_CONTEXTS; ++i) {
+    const ConnectionContext *context = connection_contexts + i;
+    if (context->owner && !context->abandoned &&
+        context->handler == ReceiveImageData &&
+        context->store.receive_image_data_context.reload_target == plugin) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint32_t DiscardPluginContexts(const LoadedPlugin *plugin,
+                                      const uint8_t *image,
+                                      uint32_t image_size) {
+  uint32_t start = (uint32_t)image;
+  uint32_t ret = 0;
+  for (uint32_t i = 0; i < MAX_CONNECTION_CONTEXTS; ++i) {
+    ConnectionContext *context = connection_contexts + i;
+    if (context->owner &&
+        (context->plugin == plugin ||
+         (uint32_t)context->handler - start < image_size)) {
+      context->owner = NULL;
+      ++ret;
+    }
+  }
+  return ret;
+}
+
+static uint32_t TickCount(void) { return tick_count ? *tick_count : 0; }
+
+static HANDLE_API CreateCommandThread(LPSECURITY_ATTRIBUTES thread_attributes,
+                                      SIZE_T stack_size,
+                                      LPTHREAD_START_ROUTINE start_address,
+                                      LPVOID parameter, DWORD creation_flags,
+                                      LPDWORD thread_id) {
+  if (stack_size < COMMAND_THREAD_STACK_SIZE) {
+    stack_size = COMMAND_THREAD_STACK_SIZE;
+  }
+
+  // Debugger threads keep running while the title is stopped.
+  HANDLE handle;
+  HANDLE id;
+  NTSTATUS status = create_system_thread(
+      &handle, 0, stack_size, 0, &id, start_address, parameter,
+      (creation_flags & CREATE_SUSPENDED) != 0, true, NULL);
+  if (!NT_SUCCESS(status)) {
+    return NULL;
+  }
+
+  if (thread_id) {
+    *thread_id = (DWORD)id;
+  }
+  return handle;
+}
+
+static bool ResolveKernelExports(void) {
+  uint32_t create_thread;
+  uint32_t initialize;
+  uint32_t enter;
+  uint32_t leave;
+  uint32_t delay;
+  if (!MRGetMethodByOrdinal(kXboxKernelName,
+                            ORDINAL_PS_CREATE_SYSTEM_THREAD_EX,
+                            &create_thread) ||
+      !MRGetMethodByOrdinal(kXboxKernelName,
+                            ORDINAL_RTL_INITIALIZE_CRITICAL_SECTION,
+                            &initialize) ||
+      !MRGetMethodByOrdinal(kXboxKernelName,
+                            ORDINAL_RTL_ENTER_CRITICAL_SECTION, &enter) ||
+      !MRGetMethodByOrdinal(kXboxKernelName,
+                            ORDINAL_RTL_LEAVE_CRITICAL_SECTION, &leave) ||
+      !MRGetMethodByOrdinal(kXboxKernelName, ORDINAL_KE_DELAY_EXECUTION_THREAD,
+                            &delay)) {
+    return false;
+  }
+
+  ((CriticalSectionProc)initialize)(&command_lock);
+  ((CriticalSectionProc)initialize)(&loader_lock);
+  create_system_thread = (PsCreateSystemThreadExProc)create_thread;
+  enter_critical_section = (CriticalSectionProc)enter;
+  leave_critical_section = (CriticalSectionProc)leave;
+  delay_execution_thread = (KeDelayExecutionThreadProc)delay;
+  return true;
+}
+
+static void LockCommands(void) {
+  if (enter_critical_section) {
+    enter_critical_section(&command_lock);
+  }
+}
+
+static void UnlockCommands(void) {
+  if (leave_critical_section) {
+    leave_critical_section(&command_lock);
+  }
+}
+
+static void LockLoader(void) {
+  if (enter_critical_section) {
+    enter_critical_section(&loader_lock);
+  }
+}
+
+static void UnlockLoader(void) {
+  if (leave_critical_section) {
+    leave_critical_section(&loader_lock);
+  }
+}
+
+static void YieldLoader(void) {
+  UnlockLoader();
+  if (delay_execution_thread) {
+    LARGE_INTEGER interval;
+    interval.QuadPart = YIELD_INTERVAL;
+    // Waits in kernel mode, without being alertable.
+    delay_execution_thread(0, FALSE, &interval);
+  }
+  LockLoader();
+}
+
+static void RundownPlugin(LoadedPlugin *plugin) {
+  plugin->closing = true;
+  while (plugin->pins) {
+    YieldLoader();
+  }
+}
+
+static bool BeginAsyncEntrypoint(uint32_t image_base,
+                                 EntrypointProc entrypoint) {
+  // A plugin that is being replaced or unloaded no longer starts at
+  // `image_base` once that completes.
+  LockLoader();
+  LoadedPlugin *plugin;
+  while ((plugin = PTFindPlugin(image_base)) && plugin->closing) {
+    YieldLoader();
+  }
+
+  bool ret = plugin && plugin->entrypoint == (uint32_t)entrypoint;
+  if (ret) {
+    ++plugin->pins;
+  }
+  UnlockLoader();
+  return ret;
+}
+
+static void EndAsyncEntrypoint(uint32_t image_base, bool invoked) {
+  if (!invoked) {
+    return;
   }
-#endif
 
-  return SetXBDMErrorWithSuffix(XBOX_E_UNKNOWN_COMMAND, "Unknown command ",
-                                command, response, response_len);
+  // The pin keeps the plugin at `image_base` until it is released.
+  LockLoader();
+  --PTFindPlugin(image_base)->pins;
+  UnlockLoader();
 }
 
 static HRESULT_API SendMethodAddresses(struct CommandContext *ctx,
@@ -169,8 +892,14 @@ static HRESULT_API SendMethodAddresses(struct CommandContext *ctx,
 
 static HRESULT HandleHello(const char *command, char *response,
                            DWORD response_len, struct CommandContext *ctx) {
+  ConnectionContext *context = AcquireConnectionContext(ctx);
+  if (!context) {
+    return SetXBDMError(XBOX_E_MAX_CONNECTIONS_EXCEEDED,
+                        "Too many concurrent transfers", response,
+                        response_len);
+  }
   SendMethodAddressesContext *response_context =
-      &context_store.send_method_addresses_context;
+      &context->store.send_method_addresses_context;
   MREnumerateRegistryBegin(&response_context->cursor);
 
   ctx->user_data = response_context;
@@ -184,295 +913,1326 @@ static HRESULT HandleHello(const char *command, char *response,
 static HRESULT HandleDynamicLoad(const char *command, char *response,
                                  DWORD response_len,
                                  struct CommandContext *ctx) {
-  CommandParameters cp;
-  int32_t result = CPParseCommandParameters(command, &cp);
+  return ReceiveImage(command, response, response_len, ctx, NULL);
+}
+
+// Parses the parameters shared by the "load" and "reload" commands and prepares
+// to receive the image.
+static HRESULT ReceiveImage(const char *command, char *response,
+                            DWORD response_len, struct CommandContext *ctx,
+                            LoadedPlugin *reload_target) {
+  uint32_t size;
+  uint32_t compressed_size = 0;
+  const char *codec;
+  const char *hash;
+  uint32_t async = 0;
+  const CommandParameterSchema schema[] = {
+      {"size", CP_TYPE_UINT32, true, &size},
+      {"csize", CP_TYPE_UINT32, false, &compressed_size},
+      {"codec", CP_TYPE_STRING, false, &codec},
+      {"hash", CP_TYPE_STRING, false, &hash},
+      {"async", CP_TYPE_UINT32, false, &async},
+  };
+  char string_buffer[128];
+  const char *error_key;
+  int32_t result = CPParseCommandParametersWithSchema(
+      command, schema, sizeof(schema) / sizeof(schema[0]), string_buffer,
+      sizeof(string_buffer), &error_key);
   if (result < 0) {
-    return CPPrintError(result, response, response_len);
+    return CPPrintSchemaError(result, error_key, response, response_len);
+  }
+  if (async && (reload_target || !create_system_thread)) {
+    return SetXBDMError(XBOX_E_FAIL, "Invalid 'async' param", response,
+                        response_len);
+  }
+
+  ConnectionContext *context = AcquireConnectionContext(ctx);
+  if (!context) {
+    return SetXBDMError(XBOX_E_MAX_CONNECTIONS_EXCEEDED,
+                        "Too many concurrent transfers", response,
+                        response_len);
+  }
+  ReceiveImageDataContext *process_context =
+      &context->store.receive_image_data_context;
+  HRESULT ret = BeginReceiveImage(process_context, size, hash, reload_target,
+                                  async != 0, response, response_len);
+  if (ret != XBOX_S_SEND_BINARY) {
+    return ret;
+  }
+
+  uint32_t transfer_size = size;
+  if (codec) {
+    if (strcmp(codec, "lz4")) {
+      ReleaseReceiveResources(process_context);
+      return SetXBDMErrorWithSuffix(XBOX_E_FAIL, "Unsupported codec ", codec,
+                                    response, response_len);
+    }
+    if (!compressed_size) {
+      ReleaseReceiveResources(process_context);
+      return SetXBDMError(XBOX_E_FAIL, "Missing required 'csize' param",
+                          response, response_len);
+    }
+
+    uint8_t *window = DmAllocatePoolWithTag(LZ4_STREAM_WINDOW_SIZE, kTag);
+    if (!window) {
+      ReleaseReceiveResources(process_context);
+      return SetXBDMError(XBOX_E_ACCESS_DENIED, "Out of memory", response,
+                          response_len);
+    }
+    LZ4StreamBegin(&process_context->decoder, window, size, ConsumeImageData,
+                   process_context);
+    process_context->compressed = true;
+    transfer_size = compressed_size;
   }
 
+  // Data is received into the default XBDM buffer and copied (or decompressed
+  // via the decoder's history window) directly into the final image, so no
+  // staging buffer is needed.
+  ctx->user_data = process_context;
+  ctx->bytes_remaining = transfer_size;
+  ctx->handler = ReceiveImageData;
+
+  return XBOX_S_SEND_BINARY;
+}
+
+static HRESULT HandleDeltaLoad(const char *command, char *response,
+                               DWORD response_len, struct CommandContext *ctx) {
+  const char *base_hash;
   uint32_t size;
-  bool size_found = CPGetUInt32("size", &size, &cp);
-  CPDelete(&cp);
+  uint32_t patch_size;
+  const char *hash;
+  const CommandParameterSchema schema[] = {
+      {"base_hash", CP_TYPE_STRING, true, &base_hash},
+      {"size", CP_TYPE_UINT32, true, &size},
+      {"psize", CP_TYPE_UINT32, true, &patch_size},
+      {"hash", CP_TYPE_STRING, false, &hash},
+  };
+  char string_buffer[160];
+  const char *error_key;
+  int32_t result = CPParseCommandParametersWithSchema(
+      command, schema, sizeof(schema) / sizeof(schema[0]), string_buffer,
+      sizeof(string_buffer), &error_key);
+  if (result < 0) {
+    return CPPrintSchemaError(result, error_key, response, response_len);
+  }
 
-  if (!size_found) {
-    return SetXBDMError(XBOX_E_FAIL, "Missing required 'size' param", response,
+  uint8_t base_digest[SHA256_DIGEST_SIZE];
+  if (!ParseDigest(base_hash, base_digest)) {
+    return SetXBDMError(XBOX_E_FAIL, "Invalid 'base_hash' param", response,
                         response_len);
   }
+  const ImageCacheEntry *base = ICLookup(base_digest, 0);
+  if (!base) {
+    return SetXBDMError(XBOX_E_FILE_NOT_FOUND, "Base image not cached",
+                        response, response_len);
+  }
 
-  void *allocation = DmAllocatePoolWithTag(size, kTag);
-  if (!allocation) {
-    return SetXBDMError(XBOX_E_ACCESS_DENIED, "Allocation failed", response,
+  ConnectionContext *context = AcquireConnectionContext(ctx);
+  if (!context) {
+    return SetXBDMError(XBOX_E_MAX_CONNECTIONS_EXCEEDED,
+                        "Too many concurrent transfers", response,
                         response_len);
   }
 
+  // The base must outlive any evictions needed to cache the new image.
+  ICPin(base);
   ReceiveImageDataContext *process_context =
-      &context_store.receive_image_data_context;
-  process_context->dxt_main = NULL;
-  process_context->image_base = (void *)allocation;
-  process_context->raw_image_size = size;
-  process_context->num_tls_callbacks = 0;
-  process_context->tls_callbacks = NULL;
-  process_context->relocation_needed = true;
-
-  ctx->buffer = (void *)allocation;
-  ctx->buffer_size = size;
+      &context->store.receive_image_data_context;
+  HRESULT ret = BeginReceiveImage(process_context, size, hash, NULL, false,
+                                  response, response_len);
+  if (ret != XBOX_S_SEND_BINARY) {
+    ICUnpin(base);
+    return ret;
+  }
+
+  ImagePatchBegin(&process_context->patch, base->data, base->size, size,
+                  ConsumeImageData, process_context);
+  process_context->patched = true;
+  process_context->patch_base = base;
+
   ctx->user_data = process_context;
-  ctx->bytes_remaining = size;
+  ctx->bytes_remaining = patch_size;
   ctx->handler = ReceiveImageData;
 
   return XBOX_S_SEND_BINARY;
 }
 
-#ifndef LEAN_BUILD
-static HRESULT HandleReserve(const char *command, char *response,
-                             DWORD response_len, struct CommandContext *ctx) {
-  CommandParameters cp;
-  int32_t result = CPParseCommandParameters(command, &cp);
+static HRESULT HandleLoadBegin(const char *command, char *response,
+                               DWORD response_len, struct CommandContext *ctx) {
+  uint32_t size;
+  uint32_t autocommit = 0;
+  uint32_t async = 0;
+  const CommandParameterSchema schema[] = {
+      {"size", CP_TYPE_UINT32, true, &size},
+      {"autocommit", CP_TYPE_UINT32, false, &autocommit},
+      {"async", CP_TYPE_UINT32, false, &async},
+  };
+  const char *error_key;
+  int32_t result = CPParseCommandParametersWithSchema(
+      command, schema, sizeof(schema) / sizeof(schema[0]), NULL, 0,
+      &error_key);
   if (result < 0) {
-    return CPPrintError(result, response, response_len);
+    return CPPrintSchemaError(result, error_key, response, response_len);
   }
-
-  uint32_t size;
-  bool size_found = CPGetUInt32("size", &size, &cp);
-  CPDelete(&cp);
-
-  if (!size_found) {
-    return SetXBDMError(XBOX_E_FAIL, "Missing required 'size' param", response,
+  if (!size) {
+    return SetXBDMError(XBOX_E_FAIL, "Invalid 'size' param", response,
+                        response_len);
+  }
+  if (async && (!autocommit || !create_system_thread)) {
+    return SetXBDMError(XBOX_E_FAIL, "Invalid 'async' param", response,
                         response_len);
   }
 
-  void *allocation = DmAllocatePoolWithTag(size, kTag);
-  if (!allocation) {
-    return SetXBDMError(XBOX_E_ACCESS_DENIED, "Allocation failed", response,
+  uint32_t now = TickCount();
+  UMReclaimStale(now, UPLOAD_DEFAULT_TIMEOUT_MS);
+  Upload *upload = UMBegin(size, now);
+  if (!upload) {
+    return SetXBDMError(XBOX_E_ACCESS_DENIED, "Out of memory", response,
                         response_len);
   }
 
-  sprintf(response, "addr=0x%X", (uint32_t)allocation);
+  if (autocommit) {
+    upload->flags |= UPLOAD_FLAG_AUTO_COMMIT;
+  }
+  if (async) {
+    upload->flags |= UPLOAD_FLAG_ASYNC;
+  }
+
+  sprintf(response, "id=%u", upload->id);
   return XBOX_S_OK;
 }
-#endif
 
-static void *DLL_LOADER_API AllocateImage(size_t size) {
-  return DmAllocatePoolWithTag(size, kTag);
+// Returns the upload with the given ID after reclaiming any that are stale, or
+// sets an error in `response` and returns NULL.
+static Upload *FindUpload(uint32_t id, char *response, DWORD response_len) {
+  UMReclaimStale(TickCount(), UPLOAD_DEFAULT_TIMEOUT_MS);
+  Upload *upload = UMFind(id);
+  if (!upload) {
+    SetXBDMError(XBOX_E_FILE_NOT_FOUND, "No such upload", response,
+                 response_len);
+  }
+  return upload;
 }
 
-static HRESULT ReceiveImageDataComplete(ReceiveImageDataContext *receive_ctx,
-                                        char *response, DWORD response_len) {
-  if (!receive_ctx->relocation_needed) {
-    // TODO: Call any TLS callbacks.
-    receive_ctx->dxt_main();
+static HRESULT HandleLoadPart(const char *command, char *response,
+                              DWORD response_len, struct CommandContext *ctx) {
+  uint32_t id;
+  uint32_t offset;
+  uint32_t size;
+  const CommandParameterSchema schema[] = {
+      {"id", CP_TYPE_UINT32, true, &id},
+      {"offset", CP_TYPE_UINT32, true, &offset},
+      {"size", CP_TYPE_UINT32, true, &size},
+  };
+  const char *error_key;
+  int32_t result = CPParseCommandParametersWithSchema(
+      command, schema, sizeof(schema) / sizeof(schema[0]), NULL, 0,
+      &error_key);
+  if (result < 0) {
+    return CPPrintSchemaError(result, error_key, response, response_len);
+  }
 
-    sprintf(response, "image_base=0x%X entrypoint=0x%X",
-            (uint32_t)receive_ctx->image_base, (uint32_t)receive_ctx->dxt_main);
-    return XBOX_S_OK;
+  Upload *upload = FindUpload(id, response, response_len);
+  if (!upload) {
+    return XBOX_E_FILE_NOT_FOUND;
+  }
+  if (offset % UPLOAD_BLOCK_SIZE || offset >= upload->size) {
+    return SetXBDMError(XBOX_E_FAIL, "Invalid 'offset' param", response,
+                        response_len);
+  }
+  if (!size || size > upload->size - offset) {
+    return SetXBDMError(XBOX_E_FAIL, "Invalid 'size' param", response,
+                        response_len);
   }
 
-  DLLContext ctx;
-  memset(&ctx, 0, sizeof(ctx));
+  ConnectionContext *context = AcquireConnectionContext(ctx);
+  if (!context) {
+    return SetXBDMError(XBOX_E_MAX_CONNECTIONS_EXCEEDED,
+                        "Too many concurrent transfers", response,
+                        response_len);
+  }
+  ReceiveUploadPartContext *process_context =
+      &context->store.receive_upload_part_context;
+  process_context->upload_id = id;
+  process_context->offset = offset;
+  process_context->bytes_received = 0;
+  process_context->completed_upload = false;
+  upload->last_activity = TickCount();
+
+  // The upload may be reclaimed while the part is in flight, so data is
+  // received into the default XBDM buffer and copied into place.
+  ctx->user_data = process_context;
+  ctx->bytes_remaining = size;
+  ctx->handler = ReceiveUploadPart;
 
-  ctx.input.raw_data = receive_ctx->image_base;
-  ctx.input.raw_data_size = receive_ctx->raw_image_size;
-  ctx.input.alloc = AllocateImage;
-  ctx.input.free = DmFreePool;
-  ctx.input.resolve_import_by_ordinal = MRGetMethodByOrdinal;
-  ctx.input.resolve_import_by_name = MRGetMethodByName;
+  return XBOX_S_SEND_BINARY;
+}
 
-  if (!DLLLoad(&ctx)) {
-    sprintf(response, "DLLLoad failed %d::%d ", ctx.output.context,
-            ctx.output.status);
-    if (ctx.output.error_message[0]) {
-      strncat(response, ctx.output.error_message,
-              response_len - (strlen(response) + 1));
-    }
-    DLLFreeContext(&ctx, false);
-    DmFreePool(receive_ctx->image_base);
-    return XBOX_E_FAIL;
+static HRESULT HandleLoadStatus(const char *command, char *response,
+                                DWORD response_len,
+                                struct CommandContext *ctx) {
+  uint32_t id;
+  const CommandParameterSchema schema[] = {
+      {"id", CP_TYPE_UINT32, true, &id},
+  };
+  const char *error_key;
+  int32_t result = CPParseCommandParametersWithSchema(
+      command, schema, sizeof(schema) / sizeof(schema[0]), NULL, 0,
+      &error_key);
+  if (result < 0) {
+    return CPPrintSchemaError(result, error_key, response, response_len);
   }
 
-  // The raw image data is no longer needed.
-  DmFreePool(receive_ctx->image_base);
-
-  if (!DLLInvokeTLSCallbacks(&ctx)) {
-    sprintf(response, "Failed to invoke TLS callbacks %d::%d ",
-            ctx.output.context, ctx.output.status);
-    if (ctx.output.error_message[0]) {
-      strncat(response, ctx.output.error_message,
-              response_len - (strlen(response) + 1));
-    }
-    DLLFreeContext(&ctx, false);
-    return XBOX_E_FAIL;
+  Upload *upload = FindUpload(id, response, response_len);
+  if (!upload) {
+    return XBOX_E_FILE_NOT_FOUND;
   }
 
-  DXTMainProc entrypoint = (DXTMainProc)ctx.output.entrypoint;
-  sprintf(response, "image_base=0x%X entrypoint=0x%X",
-          (uint32_t)ctx.output.image, (uint32_t)entrypoint);
+  ConnectionContext *context = AcquireConnectionContext(ctx);
+  if (!context) {
+    return SetXBDMError(XBOX_E_MAX_CONNECTIONS_EXCEEDED,
+                        "Too many concurrent transfers", response,
+                        response_len);
+  }
+  SendMissingRangesContext *response_context =
+      &context->store.send_missing_ranges_context;
+  response_context->upload_id = id;
+  response_context->next_offset = 0;
 
-  entrypoint();
-  DLLFreeContext(&ctx, true);
+  ctx->user_data = response_context;
+  ctx->handler = SendMissingRanges;
 
-  return XBOX_S_OK;
+  sprintf(response, "id=%u size=%u received=%u", id, upload->size,
+          UMGetReceivedSize(upload));
+  return XBOX_S_MULTILINE;
 }
 
-static HRESULT_API ReceiveImageData(struct CommandContext *ctx, char *response,
-                                    DWORD response_len) {
-  ReceiveImageDataContext *process_context = ctx->user_data;
-
-  if (!ctx->data_size) {
-    // Unclear if this can ever happen. Presumably it'd indicate some sort of
-    // error and the image_base block should be freed.
-    return XBOX_E_UNEXPECTED;
+static HRESULT HandleLoadCommit(const char *command, char *response,
+                                DWORD response_len,
+                                struct CommandContext *ctx) {
+  uint32_t id;
+  uint32_t async = 0;
+  const CommandParameterSchema schema[] = {
+      {"id", CP_TYPE_UINT32, true, &id},
+      {"async", CP_TYPE_UINT32, false, &async},
+  };
+  const char *error_key;
+  int32_t result = CPParseCommandParametersWithSchema(
+      command, schema, sizeof(schema) / sizeof(schema[0]), NULL, 0,
+      &error_key);
+  if (result < 0) {
+    return CPPrintSchemaError(result, error_key, response, response_len);
+  }
+  if (async && !create_system_thread) {
+    return SetXBDMError(XBOX_E_FAIL, "Invalid 'async' param", response,
+                        response_len);
   }
 
-  ctx->buffer += ctx->data_size;
-  ctx->buffer_size -= ctx->data_size;
-  ctx->bytes_remaining -= ctx->data_size;
+  Upload *upload = FindUpload(id, response, response_len);
+  if (!upload) {
+    return XBOX_E_FILE_NOT_FOUND;
+  }
+  if (!UMIsComplete(upload)) {
+    return SetXBDMError(XBOX_E_FAIL, "Upload incomplete", response,
+                        response_len);
+  }
 
-  if (ctx->bytes_remaining) {
-    return XBOX_S_OK;
+  ConnectionContext *context = AcquireConnectionContext(ctx);
+  if (!context) {
+    return SetXBDMError(XBOX_E_MAX_CONNECTIONS_EXCEEDED,
+                        "Too many concurrent transfers", response,
+                        response_len);
   }
+  return LoadUpload(upload, async != 0, context, response, response_len);
+}
 
+static HRESULT LoadUpload(Upload *upload, bool async,
+                          ConnectionContext *context, char *response,
+                          DWORD response_len) {
+  ReceiveImageDataContext *process_context =
+      &context->store.receive_image_data_context;
+  BeginReceiveImage(process_context, upload->size, NULL, NULL, async, response,
+                    response_len);
+
+  // The image is copied into its final allocation, so the upload is no longer
+  // needed whether or not it loads.
+  bool written = DLLStreamWrite(&process_context->dll_context, upload->data,
+                                upload->size);
+  UMRelease(upload);
+  if (!written) {
+    return SetDLLLoaderError("DLLLoad failed", &process_context->dll_context,
+                             response, response_len);
+  }
   return ReceiveImageDataComplete(process_context, response, response_len);
 }
 
-#ifndef LEAN_BUILD
-static HRESULT HandleInstall(const char *command, char *response,
-                             DWORD response_len, struct CommandContext *ctx) {
-  CommandParameters cp;
-  int32_t result = CPParseCommandParameters(command, &cp);
+static HRESULT HandleLoadBundle(const char *command, char *response,
+                                DWORD response_len,
+                                struct CommandContext *ctx) {
+  uint32_t size;
+  const CommandParameterSchema schema[] = {
+      {"size", CP_TYPE_UINT32, true, &size},
+  };
+  const char *error_key;
+  int32_t result = CPParseCommandParametersWithSchema(
+      command, schema, sizeof(schema) / sizeof(schema[0]), NULL, 0,
+      &error_key);
   if (result < 0) {
-    return CPPrintError(result, response, response_len);
+    return CPPrintSchemaError(result, error_key, response, response_len);
   }
-
-  uint32_t base;
-  bool base_found = CPGetUInt32("base", &base, &cp);
-  uint32_t length;
-  bool length_found = CPGetUInt32("length", &length, &cp);
-  uint32_t dxt_main;
-  bool main_found = CPGetUInt32("entrypoint", &dxt_main, &cp);
-  CPDelete(&cp);
-
-  if (!base_found) {
-    return SetXBDMError(XBOX_E_FAIL, "Missing required 'base' param", response,
+  if (!size) {
+    return SetXBDMError(XBOX_E_FAIL, "Invalid 'size' param", response,
                         response_len);
   }
-  if (!length_found) {
-    return SetXBDMError(XBOX_E_FAIL, "Missing required 'length' param",
-                        response, response_len);
-  }
-  if (!main_found) {
-    return SetXBDMError(XBOX_E_FAIL, "Missing required 'entrypoint' param",
-                        response, response_len);
-  }
-  if (!base) {
-    return SetXBDMError(XBOX_E_FAIL, "Invalid 'base' param", response,
+
+  ConnectionContext *context = AcquireConnectionContext(ctx);
+  if (!context) {
+    return SetXBDMError(XBOX_E_MAX_CONNECTIONS_EXCEEDED,
+                        "Too many concurrent transfers", response,
                         response_len);
   }
-  if (!length) {
-    return SetXBDMError(XBOX_E_FAIL, "Invalid 'length' param", response,
+  ReceiveBundleDataContext *process_context =
+      &context->store.receive_bundle_data_context;
+  process_context->data = DmAllocatePoolWithTag(size, kTag);
+  if (!process_context->data) {
+    return SetXBDMError(XBOX_E_ACCESS_DENIED, "Out of memory", response,
                         response_len);
   }
-  if (dxt_main < base) {
-    return SetXBDMError(XBOX_E_FAIL, "Invalid 'entrypoint' param, < base",
-                        response, response_len);
-  }
-  if (dxt_main >= base + length) {
-    return SetXBDMError(XBOX_E_FAIL, "Invalid 'entrypoint' param, > image",
-                        response, response_len);
-  }
-
-  ReceiveImageDataContext *process_context =
-      &context_store.receive_image_data_context;
-  process_context->dxt_main = (DXTMainProc)dxt_main;
-  process_context->image_base = (void *)base;
-  process_context->raw_image_size = length;
-  process_context->num_tls_callbacks = 0;
-  process_context->tls_callbacks = NULL;
-  process_context->relocation_needed = false;
+  process_context->size = size;
 
-  ctx->buffer = (void *)base;
-  ctx->buffer_size = length;
+  // Images must be parsed as a whole to determine their dependencies, so the
+  // bundle is received in place and loaded once complete.
+  ctx->buffer = process_context->data;
+  ctx->buffer_size = size;
 
   ctx->user_data = process_context;
-  ctx->bytes_remaining = length;
-  ctx->handler = ReceiveImageData;
+  ctx->bytes_remaining = size;
+  ctx->handler = ReceiveBundleData;
 
   return XBOX_S_SEND_BINARY;
 }
-#endif  // LEAN_BUILD
 
-#ifndef LEAN_BUILD
-static HRESULT HandleRegisterModuleExport(const char *command, char *response,
-                                          DWORD response_len,
-                                          struct CommandContext *ctx) {
-  CommandParameters cp;
-  int32_t result = CPParseCommandParameters(command, &cp);
+static HRESULT HandleReload(const char *command, char *response,
+                            DWORD response_len, struct CommandContext *ctx) {
+  const char *name;
+  const CommandParameterSchema schema[] = {
+      {"name", CP_TYPE_STRING, true, &name},
+  };
+  char string_buffer[128];
+  const char *error_key;
+  int32_t result = CPParseCommandParametersWithSchema(
+      command, schema, sizeof(schema) / sizeof(schema[0]), string_buffer,
+      sizeof(string_buffer), &error_key);
   if (result < 0) {
-    return CPPrintError(result, response, response_len);
+    return CPPrintSchemaError(result, error_key, response, response_len);
   }
 
-  ModuleExport entry;
+  LoadedPlugin *plugin = PTFindPluginByName(name);
+  if (!plugin) {
+    return SetXBDMErrorWithSuffix(XBOX_E_FILE_NOT_FOUND, "No DLL named ", name,
+                                  response, response_len);
+  }
+  HRESULT ret = CheckNoDependents(plugin, response, response_len);
+  if (!XBOX_SUCCESS(ret)) {
+    return ret;
+  }
 
-  const char *module_name;
-  bool name_found = CPGetString("module", &module_name, &cp);
-  const char *export_name;
-  bool export_name_found = CPGetString("name", &export_name, &cp);
-  const char *alias;
-  bool alias_found = CPGetString("alias", &alias, &cp);
-  bool ordinal_found = CPGetUInt32("ordinal", &entry.ordinal, &cp);
-  bool address_found = CPGetUInt32("addr", &entry.address, &cp);
+  return ReceiveImage(command, response, response_len, ctx, plugin);
+}
 
-  if (!ordinal_found) {
-    CPDelete(&cp);
-    return SetXBDMError(XBOX_E_FAIL, "Missing required 'ordinal' param",
+static HRESULT HandleUnload(const char *command, char *response,
+                            DWORD response_len, struct CommandContext *ctx) {
+  uint32_t base;
+  const CommandParameterSchema schema[] = {
+      {"base", CP_TYPE_UINT32, true, &base},
+  };
+  const char *error_key;
+  int32_t result = CPParseCommandParametersWithSchema(
+      command, schema, sizeof(schema) / sizeof(schema[0]), NULL, 0,
+      &error_key);
+  if (result < 0) {
+    return CPPrintSchemaError(result, error_key, response, response_len);
+  }
+
+  LoadedPlugin *plugin = PTFindPlugin(base);
+  if (!plugin) {
+    return SetXBDMError(XBOX_E_FILE_NOT_FOUND, "No DLL loaded at 'base'",
                         response, response_len);
   }
-  if (!address_found) {
-    CPDelete(&cp);
-    return SetXBDMError(XBOX_E_FAIL, "Missing required 'address' param",
+  if (HasPendingReload(plugin)) {
+    return SetXBDMError(XBOX_E_ACCESS_DENIED, "DLL has a reload in progress",
                         response, response_len);
   }
+  HRESULT ret = CheckNoDependents(plugin, response, response_len);
+  if (!XBOX_SUCCESS(ret)) {
+    return ret;
+  }
 
-  if (!name_found) {
-    CPDelete(&cp);
-    return SetXBDMError(XBOX_E_FAIL, "Missing required 'module' param",
-                        response, response_len);
+  LockLoader();
+  RundownPlugin(plugin);
+  UnlockLoader();
+
+  // The hook may unregister some of the plugin's command processors itself.
+  if (plugin->shutdown) {
+    ((PluginShutdownProc)plugin->shutdown)();
+  }
+
+  LockLoader();
+  uint32_t num_processors = 0;
+  for (PluginCommandProcessor *processor = PTGetCommandProcessors(); processor;
+       processor = processor->next) {
+    if (processor->owner == plugin) {
+      DmRegisterCommandProcessor(processor->prefix, NULL);
+      ++num_processors;
+    }
+  }
+  uint32_t num_commands = CTRemoveOwner(plugin, false);
+  DiscardPluginContexts(plugin, plugin->image, plugin->image_size);
+
+  uint32_t num_exports = ReleasePluginImage(plugin->image, plugin->image_size);
+  PTRemovePlugin(plugin);
+  UnlockLoader();
+
+  sprintf(response, "exports=%u processors=%u commands=%u", num_exports,
+          num_processors, num_commands);
+  return XBOX_S_OK;
+}
+
+static HRESULT CheckNoDependents(const LoadedPlugin *plugin, char *response,
+                                 DWORD response_len) {
+  const LoadedPlugin *dependent = PTFindDependent(plugin);
+  if (!dependent) {
+    return XBOX_S_OK;
+  }
+  return SetXBDMErrorWithSuffix(XBOX_E_ACCESS_DENIED, "DLL is imported by ",
+                                *dependent->name ? dependent->name : "a DLL",
+                                response, response_len);
+}
+
+static HRESULT HandleCache(const char *command, char *response,
+                           DWORD response_len, struct CommandContext *ctx) {
+  uint32_t budget = ICGetBudget();
+  bool flush;
+  const CommandParameterSchema schema[] = {
+      {"budget", CP_TYPE_UINT32, false, &budget},
+      {"flush", CP_TYPE_FLAG, false, &flush},
+  };
+  const char *error_key;
+  int32_t result = CPParseCommandParametersWithSchema(
+      command, schema, sizeof(schema) / sizeof(schema[0]), NULL, 0,
+      &error_key);
+  if (result < 0) {
+    return CPPrintSchemaError(result, error_key, response, response_len);
+  }
+
+  if (flush) {
+    ICReset();
+  }
+  ICSetBudget(budget);
+
+  sprintf(response, "budget=0x%X used=0x%X entries=%u", ICGetBudget(),
+          ICGetUsage(), ICGetNumEntries());
+  return XBOX_S_OK;
+}
+
+#ifndef LEAN_BUILD
+static HRESULT HandleReserve(const char *command, char *response,
+                             DWORD response_len, struct CommandContext *ctx) {
+  uint32_t size;
+  const CommandParameterSchema schema[] = {
+      {"size", CP_TYPE_UINT32, true, &size},
+  };
+  const char *error_key;
+  int32_t result = CPParseCommandParametersWithSchema(
+      command, schema, sizeof(schema) / sizeof(schema[0]), NULL, 0,
+      &error_key);
+  if (result < 0) {
+    return CPPrintSchemaError(result, error_key, response, response_len);
+  }
+
+  void *allocation = DmAllocatePoolWithTag(size, kTag);
+  if (!allocation) {
+    return SetXBDMError(XBOX_E_ACCESS_DENIED, "Allocation failed", response,
+                        response_len);
+  }
+
+  sprintf(response, "addr=0x%X", (uint32_t)allocation);
+  return XBOX_S_OK;
+}
+#endif
+
+static void *DLL_LOADER_API AllocateImage(size_t size) {
+  return DmAllocatePoolWithTag(size, kTag);
+}
+
+// Clears any state left in `ctx` by the previous user of its connection
+// context, which must be done before an image of `size` bytes is received.
+static void ResetReceiveImageContext(ReceiveImageDataContext *ctx,
+                                     uint32_t size,
+                                     LoadedPlugin *reload_target, bool async) {
+  ctx->dxt_main = NULL;
+  ctx->image_base = NULL;
+  ctx->raw_image_size = size;
+  ctx->num_tls_callbacks = 0;
+  ctx->tls_callbacks = NULL;
+  ctx->relocation_needed = true;
+  ctx->compressed = false;
+  ctx->patched = false;
+  ctx->patch_base = NULL;
+  ctx->verify_digest = false;
+  ctx->cache_entry = NULL;
+  ctx->from_cache = false;
+  ctx->reload_target = reload_target;
+  ctx->async = async;
+  InitDLLContext(&ctx->dll_context);
+  ctx->dll_context.input.raw_data_size = size;
+}
+
+// Prepares `ctx` to receive a raw image of `size` bytes, which replaces the
+// image of `reload_target` if it is non-NULL. If `async` is set the image's
+// entrypoint is invoked on a worker thread. If `hash` is given and a matching
+// image is cached, the cached image is loaded immediately. Returns
+// XBOX_S_SEND_BINARY if the caller should proceed to receive the image.
+static HRESULT BeginReceiveImage(ReceiveImageDataContext *ctx, uint32_t size,
+                                 const char *hash, LoadedPlugin *reload_target,
+                                 bool async, char *response,
+                                 DWORD response_len) {
+  ResetReceiveImageContext(ctx, size, reload_target, async);
+  DLLStreamBegin(&ctx->dll_context);
+
+  if (!hash) {
+    return XBOX_S_SEND_BINARY;
+  }
+
+  if (!ParseDigest(hash, ctx->expected_digest)) {
+    return SetXBDMError(XBOX_E_FAIL, "Invalid 'hash' param", response,
+                        response_len);
+  }
+
+  const ImageCacheEntry *entry = ICLookup(ctx->expected_digest, size);
+  if (entry) {
+    if (!DLLStreamWrite(&ctx->dll_context, entry->data, entry->size)) {
+      return SetDLLLoaderError("DLLLoad failed", &ctx->dll_context, response,
+                               response_len);
+    }
+    ctx->from_cache = true;
+    return ReceiveImageDataComplete(ctx, response, response_len);
+  }
+
+  ctx->verify_digest = true;
+  SHA256Init(&ctx->sha256);
+  ctx->cache_entry = ICReserve(size);
+  ctx->cache_entry_used = 0;
+  return XBOX_S_SEND_BINARY;
+}
+
+static HRESULT ReceiveImageDataComplete(ReceiveImageDataContext *receive_ctx,
+                                        char *response, DWORD response_len) {
+  if (!receive_ctx->relocation_needed) {
+    // TODO: Call any TLS callbacks.
+    if (!StartPlugin(receive_ctx->image_base, receive_ctx->raw_image_size,
+                     receive_ctx->dxt_main, false)) {
+      return SetXBDMError(XBOX_E_ACCESS_DENIED, "Out of memory", response,
+                          response_len);
+    }
+
+    sprintf(response, "image_base=0x%X entrypoint=0x%X",
+            (uint32_t)receive_ctx->image_base, (uint32_t)receive_ctx->dxt_main);
+    return XBOX_S_OK;
+  }
+
+  DLLContext *ctx = &receive_ctx->dll_context;
+  if (!DLLStreamEnd(ctx)) {
+    return SetDLLLoaderError("DLLLoad failed", ctx, response, response_len);
+  }
+
+  if (!DLLInvokeTLSCallbacks(ctx)) {
+    HRESULT ret = SetDLLLoaderError("Failed to invoke TLS callbacks", ctx,
+                                    response, response_len);
+    DLLFreeContext(ctx, false);
+    return ret;
   }
 
-  char *module_name_saved = PoolStrdup(module_name, kTag);
-  if (!module_name_saved) {
-    CPDelete(&cp);
+  DXTMainProc entrypoint = (DXTMainProc)ctx->output.entrypoint;
+  sprintf(response, "%simage_base=0x%X entrypoint=0x%X",
+          receive_ctx->from_cache ? "cached " : "", (uint32_t)ctx->output.image,
+          (uint32_t)entrypoint);
+
+  uint32_t image_size = ctx->output.header.OptionalHeader.SizeOfImage;
+  if (receive_ctx->reload_target) {
+    // Only a new build of the same DLL may take over its command processors.
+    const char *name = PTGetImageName(ctx->output.image, image_size);
+    if (strcmp(name, receive_ctx->reload_target->name)) {
+      DLLFreeContext(ctx, false);
+      return SetXBDMErrorWithSuffix(XBOX_E_FAIL, "Image is not named ",
+                                    receive_ctx->reload_target->name, response,
+                                    response_len);
+    }
+    // A DLL importing from the target may have been loaded while the new
+    // build was being received.
+    HRESULT ret = CheckNoDependents(receive_ctx->reload_target, response,
+                                    response_len);
+    if (!XBOX_SUCCESS(ret)) {
+      DLLFreeContext(ctx, false);
+      return ret;
+    }
+    ReplacePlugin(receive_ctx->reload_target, ctx->output.image, image_size,
+                  entrypoint);
+  } else if (!StartPlugin(ctx->output.image, image_size, entrypoint,
+                          receive_ctx->async)) {
+    DLLFreeContext(ctx, false);
     return SetXBDMError(XBOX_E_ACCESS_DENIED, "Out of memory", response,
                         response_len);
   }
+  DLLFreeContext(ctx, true);
+
+  return XBOX_S_OK;
+}
+
+// Loads each image in the received bundle in dependency order, appending
+// "<name>=<image_base>" or "<name>=failed:<context>::<status>" to the response
+// for each. Images that depend on a failed image are reported as "skipped".
+static HRESULT LoadBundle(ReceiveBundleDataContext *ctx, char *response,
+                          DWORD response_len) {
+  ImageBundleEntry entries[IMAGE_BUNDLE_MAX_IMAGES];
+  uint32_t order[IMAGE_BUNDLE_MAX_IMAGES];
+  uint32_t dependencies[IMAGE_BUNDLE_MAX_IMAGES];
+  uint32_t count;
+  ImageBundleStatus status = IBParse(ctx->data, ctx->size, entries, &count);
+  if (status == IBS_OK) {
+    status = IBSortByDependencies(entries, count, order, dependencies);
+  }
+  if (status != IBS_OK) {
+    sprintf(response, "Invalid bundle %d", status);
+    return XBOX_E_FAIL;
+  }
+
+  sprintf(response, "count=%u", count);
+  uint32_t failed = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t index = order[i];
+    const ImageBundleEntry *entry = entries + index;
+    DLLContext *dll_ctx = &ctx->dll_context;
+
+    char result[32];
+    if (dependencies[index] & failed) {
+      strcpy(result, "skipped");
+      failed |= 1U << index;
+    } else if (LoadBundleImage(dll_ctx, entry)) {
+      sprintf(result, "0x%X", (uint32_t)dll_ctx->output.image);
+    } else {
+      sprintf(result, "failed:%d::%d", dll_ctx->output.context,
+              dll_ctx->output.status);
+      failed |= 1U << index;
+    }
+
+    uint32_t used = strlen(response);
+    if (used >= response_len) {
+      continue;
+    }
+    if (entry->name) {
+      snprintf(response + used, response_len - used, " %s=%s", entry->name,
+               result);
+    } else {
+      snprintf(response + used, response_len - used, " #%u=%s", index, result);
+    }
+  }
+
+  return failed ? XBOX_E_FAIL : XBOX_S_OK;
+}
+
+// Loads, relocates, and starts a single image from a bundle. On failure the
+// error is reported via `ctx->output`.
+static bool LoadBundleImage(DLLContext *ctx, const ImageBundleEntry *entry) {
+  InitDLLContext(ctx);
+  ctx->input.raw_data = entry->data;
+  ctx->input.raw_data_size = entry->size;
+  if (!DLLLoad(ctx)) {
+    return false;
+  }
+
+  if (!DLLInvokeTLSCallbacks(ctx)) {
+    DLLFreeContext(ctx, false);
+    return false;
+  }
+
+  if (!StartPlugin(ctx->output.image,
+                   ctx->output.header.OptionalHeader.SizeOfImage,
+                   (DXTMainProc)ctx->output.entrypoint, false)) {
+    ctx->output.status = DLLL_OUT_OF_MEMORY;
+    DLLFreeContext(ctx, false);
+    return false;
+  }
+
+  DLLFreeContext(ctx, true);
+  return true;
+}
+
+// Records the image in the plugin table so that it may be unloaded later and
+// publishes its exports, then invokes its entrypoint. The image must be
+// recorded first so that any command processors registered by the entrypoint
+// are attributed to it.
+static bool StartPlugin(void *image, uint32_t image_size,
+                        DXTMainProc entrypoint, bool async) {
+  LockLoader();
+  LoadedPlugin *plugin = PTAddPlugin(image, image_size, (uint32_t)entrypoint);
+  if (plugin && !XBOX_SUCCESS(LinkPluginExports(plugin))) {
+    PTRemovePlugin(plugin);
+    plugin = NULL;
+  }
+  UnlockLoader();
+  if (!plugin) {
+    return false;
+  }
+
+  // The plugin cannot be unloaded while the command lock is held, so the
+  // entrypoint runs without the loader lock.
+  if (!async) {
+    entrypoint();
+    return true;
+  }
+
+  // The worker pins the plugin while the entrypoint runs.
+  uint32_t start = (uint32_t)image;
+  if (!EWInvokeAsync(&kEntrypointWorkerHooks, start, entrypoint)) {
+    LockLoader();
+    MRUnregisterAddressRange(start, start + image_size);
+    PTRemovePlugin(plugin);
+    UnlockLoader();
+    return false;
+  }
+  return true;
+}
+
+// Registers the exports of the plugin's image under its DLL name so that they
+// may be imported by subsequently loaded DLLs.
+static HRESULT LinkPluginExports(const LoadedPlugin *plugin) {
+  if (!*plugin->name) {
+    return XBOX_S_OK;
+  }
+  return LinkModuleExports(plugin->name, plugin->image);
+}
+
+// Swaps the image of a loaded DLL for a newly loaded build. Command processors
+// registered by the old build remain registered with XBDM throughout. They are
+// forwarded to the new build's handlers once its entrypoint registers them
+// again, and are removed if it does not.
+static void ReplacePlugin(LoadedPlugin *plugin, void *image,
+                          uint32_t image_size, DXTMainProc entrypoint) {
+  uint8_t *old_image = plugin->image;
+  uint32_t old_image_size = plugin->image_size;
+
+  // Commands for the plugin wait for the swap to complete once its handlers
+  // that are already running have returned.
+  LockLoader();
+  RundownPlugin(plugin);
+  reloading_plugin = plugin;
+  for (PluginCommandProcessor *processor = PTGetCommandProcessors(); processor;
+       processor = processor->next) {
+    if (processor->owner == plugin) {
+      processor->proc = NULL;
+    }
+  }
+  CTReleaseOwner(plugin);
+  UnlockLoader();
+
+  if (plugin->shutdown) {
+    ((PluginShutdownProc)plugin->shutdown)();
+  }
+
+  // Drop the old build's exports so that they do not shadow those of the new
+  // build. The image itself is retained until the swap completes.
+  LockLoader();
+  reloading_plugin = NULL;
+  uint32_t start = (uint32_t)old_image;
+  MRUnregisterAddressRange(start, start + old_image_size);
+  PTReplacePluginImage(plugin, image, image_size, (uint32_t)entrypoint);
+  LinkPluginExports(plugin);
+  UnlockLoader();
+
+  entrypoint();
+
+  LockLoader();
+  PluginCommandProcessor *processor = PTGetCommandProcessors();
+  while (processor) {
+    PluginCommandProcessor *next = processor->next;
+    if (processor->owner == plugin && !processor->proc) {
+      DmRegisterCommandProcessor(processor->prefix, NULL);
+      PTRemoveCommandProcessor(processor);
+    }
+    processor = next;
+  }
+  CTRemoveOwner(plugin, true);
+
+  DiscardPluginContexts(plugin, old_image, old_image_size);
+  plugin->closing = false;
+  UnlockLoader();
+  DmFreePool(old_image);
+}
+
+// Removes any registry entries referencing the given image and frees it.
+// Returns the number of exports removed.
+static uint32_t ReleasePluginImage(uint8_t *image, uint32_t image_size) {
+  uint32_t start = (uint32_t)image;
+  uint32_t ret = MRUnregisterAddressRange(start, start + image_size);
+  DmFreePool(image);
+  return ret;
+}
+
+// Registers `proc` for `prefix`. Processors implemented by a loaded DLL are
+// recorded in the plugin table and registered with XBDM via
+// DispatchPluginCommand. `create_thread_func` is NULL for processors registered
+// via DmRegisterCommandProcessor.
+static HRESULT RegisterCommandProcessor(const char *prefix, ProcessorProc proc,
+                                        CreateThreadFunc create_thread_func) {
+  PluginCommandProcessor *processor = PTFindCommandProcessor(prefix);
+  if (!proc) {
+    if (processor && processor->owner == reloading_plugin) {
+      // Keep the prefix registered so that the new build can claim it.
+      processor->proc = NULL;
+      return XBOX_S_OK;
+    }
+    if (processor) {
+      PTRemoveCommandProcessor(processor);
+    }
+    return DmRegisterCommandProcessor(prefix, NULL);
+  }
+
+  LoadedPlugin *owner = PTFindPluginContaining((uint32_t)proc);
+  if (!owner) {
+    if (processor) {
+      PTRemoveCommandProcessor(processor);
+    }
+    if (create_thread_func) {
+      return DmRegisterCommandProcessorEx(prefix, proc, create_thread_func);
+    }
+    return DmRegisterCommandProcessor(prefix, proc);
+  }
+
+  if (processor) {
+    // The trampoline is already registered for this prefix.
+    processor->owner = owner;
+    processor->proc = proc;
+    return XBOX_S_OK;
+  }
+
+  processor = PTAddCommandProcessor(owner, prefix, proc);
+  if (!processor) {
+    return XBOX_E_ACCESS_DENIED;
+  }
+
+  HRESULT ret;
+  if (create_thread_func) {
+    ret = DmRegisterCommandProcessorEx(prefix, DispatchPluginCommand,
+                                       create_thread_func);
+  } else {
+    ret = DmRegisterCommandProcessor(prefix, DispatchPluginCommand);
+  }
+  if (!XBOX_SUCCESS(ret)) {
+    PTRemoveCommandProcessor(processor);
+  }
+  return ret;
+}
+
+static HRESULT_API RegisterPluginCommandProcessor(const char *prefix,
+                                                  ProcessorProc proc) {
+  LockLoader();
+  HRESULT ret = RegisterCommandProcessor(prefix, proc, NULL);
+  UnlockLoader();
+  return ret;
+}
+
+static HRESULT_API RegisterPluginCommandProcessorEx(
+    const char *prefix, ProcessorProc proc,
+    CreateThreadFunc create_thread_func) {
+  LockLoader();
+  HRESULT ret = RegisterCommandProcessor(prefix, proc, create_thread_func);
+  UnlockLoader();
+  return ret;
+}
+
+static HRESULT_API DispatchPluginCommand(const char *command, char *response,
+                                         DWORD response_len,
+                                         struct CommandContext *ctx) {
+  // XBDM invokes this on its own threads. Commands that arrive while the owner
+  // is being replaced wait until the swap completes. `proc` is only cleared
+  // while the owner is closing, so it is NULL afterwards only if the new build
+  // did not claim the prefix again.
+  LockLoader();
+  PluginCommandProcessor *processor;
+  while ((processor = PTFindCommandProcessorForCommand(command)) &&
+         processor->owner->closing) {
+    YieldLoader();
+  }
+
+  if (!processor || !processor->proc) {
+    UnlockLoader();
+    return SetXBDMErrorWithSuffix(XBOX_E_UNKNOWN_COMMAND, "Unknown command ",
+                                  command, response, response_len);
+  }
+  return InvokePluginHandler(processor->owner, processor->proc, command,
+                             response, response_len, ctx);
+}
+
+static HRESULT InvokePluginHandler(LoadedPlugin *plugin, ProcessorProc handler,
+                                   const char *command, char *response,
+                                   DWORD response_len,
+                                   struct CommandContext *ctx) {
+  // Transfers of images and bundles that this connection abandoned are left
+  // for the next ddxt command to free, as the command lock is not held.
+  uint32_t now = TickCount();
+  DiscardAbandonedContexts(ctx, now, false);
+  if (!AcquireConnectionContext(ctx)) {
+    UnlockLoader();
+    return SetXBDMError(XBOX_E_MAX_CONNECTIONS_EXCEEDED,
+                        "Too many concurrent transfers", response,
+                        response_len);
+  }
+  if (plugin) {
+    ++plugin->pins;
+  }
+  UnlockLoader();
+
+  HRESULT ret = handler(command, response, response_len, ctx);
+
+  LockLoader();
+  if (plugin) {
+    --plugin->pins;
+  }
+  TrackResponse(ctx, ret, now, plugin);
+  UnlockLoader();
+  return ret;
+}
+
+// Returns true if `name` takes the form "<plugin>.<command>", which keeps it
+// distinct from the loader's own subcommands.
+static bool IsValidCommandName(const char *name) {
+  const char *separator = strchr(name, '.');
+  if (!separator || separator == name || !separator[1]) {
+    return false;
+  }
+  return CTGetNameLength(name) == strlen(name);
+}
+
+HRESULT_API DDXTRegisterCommand(const char *name, ProcessorProc handler) {
+  if (!name || !IsValidCommandName(name)) {
+    return XBOX_E_FAIL;
+  }
+
+  LockLoader();
+  HRESULT ret = XBOX_S_OK;
+  CommandTableEntry *entry = CTFind(name, strlen(name));
+  if (!handler) {
+    if (!entry) {
+      ret = XBOX_E_FILE_NOT_FOUND;
+    } else if (entry->owner && entry->owner == reloading_plugin) {
+      // Keep the name registered so that the new build can claim it.
+      entry->handler = 0;
+    } else {
+      CTRemove(entry);
+    }
+  } else {
+    LoadedPlugin *owner = PTFindPluginContaining((uint32_t)handler);
+    if (entry) {
+      entry->handler = (uint32_t)handler;
+      entry->owner = owner;
+    } else if (!CTAdd(name, (uint32_t)handler, owner)) {
+      ret = XBOX_E_ACCESS_DENIED;
+    }
+  }
+  UnlockLoader();
+  return ret;
+}
+
+static HRESULT DispatchRegisteredCommand(const char *command,
+                                         const char *subcommand,
+                                         uint32_t name_len, char *response,
+                                         DWORD response_len,
+                                         struct CommandContext *ctx) {
+  // As with DispatchPluginCommand, a cleared handler is only visible once a
+  // reload has completed without the new build claiming the name again.
+  LockLoader();
+  const CommandTableEntry *entry;
+  while ((entry = CTFind(subcommand, name_len)) && entry->owner &&
+         ((const LoadedPlugin *)entry->owner)->closing) {
+    YieldLoader();
+  }
+
+  if (!entry || !entry->handler) {
+    UnlockLoader();
+    return SetXBDMErrorWithSuffix(XBOX_E_UNKNOWN_COMMAND, "Unknown command ",
+                                  command, response, response_len);
+  }
+  return InvokePluginHandler((LoadedPlugin *)entry->owner,
+                             (ProcessorProc)entry->handler, command, response,
+                             response_len, ctx);
+}
+
+static HRESULT_API ReceiveImageData(struct CommandContext *ctx, char *response,
+                                    DWORD response_len) {
+  ReceiveImageDataContext *process_context = ctx->user_data;
+
+  if (!ctx->data_size) {
+    // Unclear if this can ever happen. Presumably it'd indicate some sort of
+    // error and the partially loaded image should be freed.
+    ReleaseReceiveResources(process_context);
+    if (process_context->relocation_needed) {
+      DLLFreeContext(&process_context->dll_context, false);
+    }
+    return XBOX_E_UNEXPECTED;
+  }
+
+  if (process_context->compressed) {
+    if (!LZ4StreamWrite(&process_context->decoder, ctx->buffer,
+                        ctx->data_size)) {
+      return AbortDecoding(process_context, response, response_len);
+    }
+  } else if (process_context->patched) {
+    if (!ImagePatchWrite(&process_context->patch, ctx->buffer,
+                         ctx->data_size)) {
+      return AbortDecoding(process_context, response, response_len);
+    }
+  } else if (process_context->relocation_needed) {
+    if (!ConsumeImageData(process_context, ctx->buffer, ctx->data_size)) {
+      ReleaseReceiveResources(process_context);
+      return SetDLLLoaderError("DLLLoad failed", &process_context->dll_context,
+                               response, response_len);
+    }
+  } else {
+    ctx->buffer += ctx->data_size;
+    ctx->buffer_size -= ctx->data_size;
+  }
+  ctx->bytes_remaining -= ctx->data_size;
+
+  if (ctx->bytes_remaining) {
+    return XBOX_S_OK;
+  }
+
+  if (process_context->compressed) {
+    if (!LZ4StreamEnd(&process_context->decoder)) {
+      return AbortDecoding(process_context, response, response_len);
+    }
+  } else if (process_context->patched) {
+    if (!ImagePatchEnd(&process_context->patch)) {
+      return AbortDecoding(process_context, response, response_len);
+    }
+  }
+
+  if (process_context->verify_digest) {
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    SHA256Final(&process_context->sha256, digest);
+    if (memcmp(digest, process_context->expected_digest, sizeof(digest))) {
+      ReleaseReceiveResources(process_context);
+      DLLFreeContext(&process_context->dll_context, false);
+      return SetXBDMError(XBOX_E_FAIL, "Image hash mismatch", response,
+                          response_len);
+    }
+
+    if (process_context->cache_entry) {
+      ICCommit(process_context->cache_entry, digest);
+      process_context->cache_entry = NULL;
+    }
+  }
+  ReleaseReceiveResources(process_context);
+
+  return ReceiveImageDataComplete(process_context, response, response_len);
+}
+
+static HRESULT_API ReceiveBundleData(struct CommandContext *ctx, char *response,
+                                     DWORD response_len) {
+  ReceiveBundleDataContext *process_context = ctx->user_data;
+
+  if (!ctx->data_size) {
+    DmFreePool(process_context->data);
+    return XBOX_E_UNEXPECTED;
+  }
+
+  ctx->buffer += ctx->data_size;
+  ctx->buffer_size -= ctx->data_size;
+  ctx->bytes_remaining -= ctx->data_size;
+  if (ctx->bytes_remaining) {
+    return XBOX_S_OK;
+  }
+
+  HRESULT ret = LoadBundle(process_context, response, response_len);
+  DmFreePool(process_context->data);
+  return ret;
+}
+
+static HRESULT_API ReceiveUploadPart(struct CommandContext *ctx, char *response,
+                                     DWORD response_len) {
+  ReceiveUploadPartContext *process_context = ctx->user_data;
+  if (!ctx->data_size) {
+    return XBOX_E_UNEXPECTED;
+  }
+
+  Upload *upload = UMFind(process_context->upload_id);
+  if (!upload) {
+    return SetXBDMError(XBOX_E_FILE_NOT_FOUND, "No such upload", response,
+                        response_len);
+  }
+  uint32_t offset = process_context->offset + process_context->bytes_received;
+  uint8_t *dest = UMBeginWrite(upload, process_context->offset, offset,
+                               ctx->data_size);
+  if (!dest) {
+    return SetXBDMError(XBOX_E_FAIL, "Part exceeds upload", response,
+                        response_len);
+  }
+
+  // Parts received over other connections cover other ranges, so the copy
+  // does not need to hold up their bookkeeping.
+  UnlockCommands();
+  memcpy(dest, ctx->buffer, ctx->data_size);
+  LockCommands();
+
+  if (UMEndWrite(upload, process_context->offset, offset + ctx->data_size,
+                 TickCount())) {
+    process_context->completed_upload = true;
+  }
+  process_context->bytes_received += ctx->data_size;
+  ctx->bytes_remaining -= ctx->data_size;
+  if (ctx->bytes_remaining) {
+    return XBOX_S_OK;
+  }
+
+  // The upload may have been released by "loadcommit" during the part.
+  upload = UMFind(process_context->upload_id);
+  if (!upload) {
+    return SetXBDMError(XBOX_E_FILE_NOT_FOUND, "No such upload", response,
+                        response_len);
+  }
+  if (process_context->completed_upload &&
+      (upload->flags & UPLOAD_FLAG_AUTO_COMMIT)) {
+    return LoadUpload(upload, (upload->flags & UPLOAD_FLAG_ASYNC) != 0,
+                      FindConnectionContext(ctx), response, response_len);
+  }
+
+  sprintf(response, "received=%u", UMGetReceivedSize(upload));
+  return XBOX_S_OK;
+}
+
+static HRESULT_API SendMissingRanges(struct CommandContext *ctx, char *response,
+                                     DWORD response_len) {
+  SendMissingRangesContext *rctx = ctx->user_data;
+
+  uint32_t offset;
+  uint32_t size;
+  Upload *upload = UMFind(rctx->upload_id);
+  if (!upload ||
+      !UMFindMissingRange(upload, rctx->next_offset, &offset, &size)) {
+    return XBOX_S_NO_MORE_DATA;
+  }
+
+  rctx->next_offset = offset + size;
+  sprintf(ctx->buffer, "offset=0x%X size=0x%X", offset, size);
+  return XBOX_S_OK;
+}
+
+#ifndef LEAN_BUILD
+static HRESULT HandleInstall(const char *command, char *response,
+                             DWORD response_len, struct CommandContext *ctx) {
+  uint32_t base;
+  uint32_t length;
+  uint32_t dxt_main;
+  const CommandParameterSchema schema[] = {
+      {"base", CP_TYPE_UINT32, true, &base},
+      {"length", CP_TYPE_UINT32, true, &length},
+      {"entrypoint", CP_TYPE_UINT32, true, &dxt_main},
+  };
+  const char *error_key;
+  int32_t result = CPParseCommandParametersWithSchema(
+      command, schema, sizeof(schema) / sizeof(schema[0]), NULL, 0,
+      &error_key);
+  if (result < 0) {
+    return CPPrintSchemaError(result, error_key, response, response_len);
+  }
+  if (!base) {
+    return SetXBDMError(XBOX_E_FAIL, "Invalid 'base' param", response,
+                        response_len);
+  }
+  if (!length) {
+    return SetXBDMError(XBOX_E_FAIL, "Invalid 'length' param", response,
+                        response_len);
+  }
+  if (dxt_main < base) {
+    return SetXBDMError(XBOX_E_FAIL, "Invalid 'entrypoint' param, < base",
+                        response, response_len);
+  }
+  if (dxt_main >= base + length) {
+    return SetXBDMError(XBOX_E_FAIL, "Invalid 'entrypoint' param, > image",
+                        response, response_len);
+  }
+
+  ConnectionContext *context = AcquireConnectionContext(ctx);
+  if (!context) {
+    return SetXBDMError(XBOX_E_MAX_CONNECTIONS_EXCEEDED,
+                        "Too many concurrent transfers", response,
+                        response_len);
+  }
+  ReceiveImageDataContext *process_context =
+      &context->store.receive_image_data_context;
+  ResetReceiveImageContext(process_context, length, NULL, false);
+  process_context->dxt_main = (DXTMainProc)dxt_main;
+  process_context->image_base = (void *)base;
+  process_context->relocation_needed = false;
+
+  ctx->buffer = (void *)base;
+  ctx->buffer_size = length;
+
+  ctx->user_data = process_context;
+  ctx->bytes_remaining = length;
+  ctx->handler = ReceiveImageData;
+
+  return XBOX_S_SEND_BINARY;
+}
+#endif  // LEAN_BUILD
+
+#ifndef LEAN_BUILD
+static HRESULT HandleRegisterModuleExport(const char *command, char *response,
+                                          DWORD response_len,
+                                          struct CommandContext *ctx) {
+  ModuleExport entry;
+  const char *module_name;
+  const char *export_name;
+  const char *alias;
+  const CommandParameterSchema schema[] = {
+      {"module", CP_TYPE_STRING, true, &module_name},
+      {"name", CP_TYPE_STRING, false, &export_name},
+      {"alias", CP_TYPE_STRING, false, &alias},
+      {"ordinal", CP_TYPE_UINT32, true, &entry.ordinal},
+      {"addr", CP_TYPE_UINT32, true, &entry.address},
+  };
+  char string_buffer[COMMAND_PARAMETER_BUFFER_SIZE];
+  const char *error_key;
+  int32_t result = CPParseCommandParametersWithSchema(
+      command, schema, sizeof(schema) / sizeof(schema[0]), string_buffer,
+      sizeof(string_buffer), &error_key);
+  if (result < 0) {
+    return CPPrintSchemaError(result, error_key, response, response_len);
+  }
 
   entry.method_name = NULL;
-  if (export_name_found) {
+  if (export_name) {
     entry.method_name = PoolStrdup(export_name, kTag);
     if (!entry.method_name) {
-      DmFreePool(module_name_saved);
-      CPDelete(&cp);
       return SetXBDMError(XBOX_E_ACCESS_DENIED, "Out of memory", response,
                           response_len);
     }
   }
 
   entry.alias = NULL;
-  if (alias_found) {
+  if (alias) {
     entry.alias = PoolStrdup(alias, kTag);
     if (!entry.alias) {
       if (entry.method_name) {
         DmFreePool(entry.method_name);
       }
-      DmFreePool(module_name_saved);
-      CPDelete(&cp);
       return SetXBDMError(XBOX_E_ACCESS_DENIED, "Out of memory", response,
                           response_len);
     }
   }
 
-  CPDelete(&cp);
-
-  if (!MRRegisterMethod(module_name_saved, &entry)) {
+  if (!MRRegisterMethod(module_name, &entry)) {
     if (entry.method_name) {
       DmFreePool(entry.method_name);
     }
@@ -480,39 +2240,124 @@ static HRESULT HandleRegisterModuleExport(const char *command, char *response,
       DmFreePool(entry.alias);
     }
 
-    DmFreePool(module_name_saved);
     return SetXBDMError(XBOX_E_FAIL, "Registration failed", response,
                         response_len);
   }
 
   // Note: The module registry now owns entry.method_name.
 
-  DmFreePool(module_name_saved);
   return XBOX_S_OK;
 }
 #endif  // LEAN_BUILD
 
-static bool RegisterExport(const char *name, const char *alias,
-                           uint32_t ordinal, uint32_t address) {
-  // Keep in sync with name used in dynamic_dxt_loader.dll.def
-  static const char kDynamicDXTLoaderDLLName[] = "dynamic_dxt_loader.dll";
+static void InitDLLContext(DLLContext *ctx) {
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->input.alloc = AllocateImage;
+  ctx->input.free = DmFreePool;
+  ctx->input.resolve_import_by_ordinal = MRGetMethodByOrdinal;
+  ctx->input.resolve_import_by_name = MRGetMethodByName;
+  ctx->input.resolve_module = MRGetModuleHandle;
+  ctx->input.resolve_import_by_ordinal_in_module = MRGetMethodByOrdinalInModule;
+  ctx->input.resolve_import_by_name_in_module = MRGetMethodByNameInModule;
+  ctx->input.resolve_import_by_name_with_hint_in_module =
+      MRGetMethodByNameWithHintInModule;
+  ctx->input.resolve_module_timestamp = MRGetModuleTimestamp;
+}
 
-  ModuleExport entry;
-  entry.method_name = PoolStrdup(name, kTag);
-  if (!entry.method_name) {
-    return false;
+static HRESULT SetDLLLoaderError(const char *message, const DLLContext *ctx,
+                                 char *response, DWORD response_len) {
+  sprintf(response, "%s %d::%d ", message, ctx->output.context,
+          ctx->output.status);
+  if (ctx->output.error_message[0]) {
+    strncat(response, ctx->output.error_message,
+            response_len - (strlen(response) + 1));
   }
-  if (!alias) {
-    entry.alias = NULL;
+  return XBOX_E_FAIL;
+}
+
+static bool ConsumeImageData(void *sink_context, const void *data,
+                             uint32_t size) {
+  ReceiveImageDataContext *receive_ctx = sink_context;
+  if (receive_ctx->verify_digest) {
+    SHA256Update(&receive_ctx->sha256, data, size);
+
+    ImageCacheEntry *entry = receive_ctx->cache_entry;
+    if (entry) {
+      if (size > entry->size - receive_ctx->cache_entry_used) {
+        ICRelease(entry);
+        receive_ctx->cache_entry = NULL;
+      } else {
+        memcpy(entry->data + receive_ctx->cache_entry_used, data, size);
+        receive_ctx->cache_entry_used += size;
+      }
+    }
+  }
+
+  return DLLStreamWrite(&receive_ctx->dll_context, data, size);
+}
+
+static void ReleaseReceiveResources(ReceiveImageDataContext *ctx) {
+  if (ctx->compressed) {
+    DmFreePool(ctx->decoder.window);
+    ctx->compressed = false;
+  }
+  if (ctx->cache_entry) {
+    ICRelease(ctx->cache_entry);
+    ctx->cache_entry = NULL;
+  }
+  if (ctx->patched) {
+    ICUnpin(ctx->patch_base);
+    ctx->patch_base = NULL;
+    ctx->patched = false;
+  }
+}
+
+static HRESULT AbortDecoding(ReceiveImageDataContext *ctx, char *response,
+                             DWORD response_len) {
+  const char *message;
+  int32_t status;
+  bool sink_failed;
+  if (ctx->compressed) {
+    message = "Decompression failed";
+    status = ctx->decoder.status;
+    sink_failed = ctx->decoder.status == LZ4S_SINK_FAILED;
   } else {
-    entry.alias = PoolStrdup(alias, kTag);
-    if (!entry.alias) {
-      DmFreePool(entry.method_name);
-      entry.method_name = NULL;
+    message = "Patch failed";
+    status = ctx->patch.status;
+    sink_failed = ctx->patch.status == IPS_SINK_FAILED;
+  }
+  ReleaseReceiveResources(ctx);
+
+  // DLLStreamWrite releases the context itself on failure.
+  if (sink_failed) {
+    return SetDLLLoaderError("DLLLoad failed", &ctx->dll_context, response,
+                             response_len);
+  }
+
+  DLLFreeContext(&ctx->dll_context, false);
+  sprintf(response, "%s %d", message, status);
+  return XBOX_E_FAIL;
+}
+
+static bool ParseDigest(const char *hex, uint8_t digest[SHA256_DIGEST_SIZE]) {
+  for (uint32_t i = 0; i < SHA256_DIGEST_SIZE * 2; ++i) {
+    char c = hex[i];
+    uint8_t nibble;
+    if (c >= '0' && c <= '9') {
+      nibble = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      nibble = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      nibble = c - 'A' + 10;
+    } else {
       return false;
     }
+
+    if (i & 1) {
+      digest[i / 2] |= nibble;
+    } else {
+      digest[i / 2] = nibble << 4;
+    }
   }
-  entry.ordinal = ordinal;
-  entry.address = address;
-  return MRRegisterMethod(kDynamicDXTLoaderDLLName, &entry);
+  return !hex[SHA256_DIGEST_SIZE * 2];
 }
@@ -0,0 +1,26 @@
+#ifndef DYNDXT_LOADER_DYNAMIC_DXT_LOADER_H
+#define DYNDXT_LOADER_DYNAMIC_DXT_LOADER_H
+
+#include "xbdm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Registers `handler` for "ddxt!<name>" commands without consuming one of
+//! XBDM's command processor slots. `name` must take the form
+//! "<plugin>.<command>" and is matched case-insensitively. The handler is
+//! invoked with the full command string, exactly as a processor registered via
+//! DmRegisterCommandProcessor would be. Passing a NULL `handler` removes the
+//! registration.
+//!
+//! Commands registered by a DLL loaded via "ddxt!load" are removed when it is
+//! unloaded, and carried over to a new build on "ddxt!reload" if its
+//! entrypoint registers them again.
+HRESULT_API DDXTRegisterCommand(const char *name, ProcessorProc handler);
+
+#ifdef __cplusplus
+};  // extern "C"
+#endif
+
+#endif  // DYNDXT_LOADER_DYNAMIC_DXT_LOADER_H
@@ -0,0 +1,53 @@
+#include "entrypoint_worker.h"
+
+#include <stdio.h>
+
+static const uint32_t kTag = 0x64647877;  // 'ddxw'
+
+// State handed to the worker thread, which frees it once the entrypoint has
+// been reported.
+typedef struct EntrypointJob {
+  const EntrypointWorkerHooks *hooks;
+  uint32_t image_base;
+  EntrypointProc entrypoint;
+} EntrypointJob;
+
+static DWORD EW_THREAD_API RunEntrypoint(LPVOID parameter) {
+  EntrypointJob *job = (EntrypointJob *)parameter;
+  const EntrypointWorkerHooks *hooks = job->hooks;
+
+  HRESULT result = XBOX_E_FILE_NOT_FOUND;
+  bool invoked =
+      !hooks->begin || hooks->begin(job->image_base, job->entrypoint);
+  if (invoked) {
+    result = job->entrypoint();
+  }
+  if (hooks->end) {
+    hooks->end(job->image_base, invoked);
+  }
+
+  char notification[EW_MAX_NOTIFICATION_LEN];
+  sprintf(notification, "ddxt!loaded image_base=0x%X hr=0x%X", job->image_base,
+          (uint32_t)result);
+  DmSendNotificationString(notification);
+
+  DmFreePool(job);
+  return 0;
+}
+
+bool EWInvokeAsync(const EntrypointWorkerHooks *hooks, uint32_t image_base,
+                   EntrypointProc entrypoint) {
+  EntrypointJob *job = DmAllocatePoolWithTag(sizeof(*job), kTag);
+  if (!job) {
+    return false;
+  }
+  job->hooks = hooks;
+  job->image_base = image_base;
+  job->entrypoint = entrypoint;
+
+  if (!hooks->create_thread(NULL, 0, RunEntrypoint, job, 0, NULL)) {
+    DmFreePool(job);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,50 @@
+#ifndef DYNDXT_LOADER_ENTRYPOINT_WORKER_H
+#define DYNDXT_LOADER_ENTRYPOINT_WORKER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "xbdm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef _WIN32
+#define EW_THREAD_API __attribute__((stdcall))
+#else
+#define EW_THREAD_API
+#endif  // #ifdef _WIN32
+
+// Maximum length of a notification sent by the worker.
+#define EW_MAX_NOTIFICATION_LEN 64
+
+// Entrypoint of a loaded DLL.
+typedef HRESULT (*EntrypointProc)(void);
+
+typedef struct EntrypointWorkerHooks {
+  // Creates the worker thread. Compatible with CreateThread.
+  CreateThreadFunc create_thread;
+
+  // Optional method called on the worker thread before the entrypoint is
+  // invoked, e.g., to keep the image from being unloaded while it runs. Returns
+  // false if the image at `image_base` has been unloaded in the meantime, in
+  // which case the entrypoint is skipped and XBOX_E_FILE_NOT_FOUND is reported.
+  bool (*begin)(uint32_t image_base, EntrypointProc entrypoint);
+
+  // Optional method called on the worker thread after `begin`, whether or not
+  // the entrypoint was invoked. `invoked` is the result of `begin`.
+  void (*end)(uint32_t image_base, bool invoked);
+} EntrypointWorkerHooks;
+
+// Invokes `entrypoint` of the DLL loaded at `image_base` on a new thread, then
+// sends "ddxt!loaded image_base=0x<base> hr=0x<result>" via
+// DmSendNotificationString. Returns false if the thread could not be started.
+bool EWInvokeAsync(const EntrypointWorkerHooks *hooks, uint32_t image_base,
+                   EntrypointProc entrypoint);
+
+#ifdef __cplusplus
+};  // extern "C"
+#endif
+
+#endif  // DYNDXT_LOADER_ENTRYPOINT_WORKER_H
@@ -0,0 +1,199 @@
+#include "image_bundle.h"
+
+#include <string.h>
+
+#include "winapi/winnt.h"
+
+static uint32_t ReadUInt32(const uint8_t *data) {
+  uint32_t ret;
+  memcpy(&ret, data, sizeof(ret));
+  return ret;
+}
+
+// Returns a pointer to `size` bytes at `offset` within the raw image, or NULL
+// if the range is outside of the image.
+static const void *RawRange(const ImageBundleEntry *entry, uint32_t offset,
+                            uint32_t size) {
+  if (offset > entry->size || size > entry->size - offset) {
+    return NULL;
+  }
+  return entry->data + offset;
+}
+
+static const IMAGE_NT_HEADERS32 *FindNTHeader(const ImageBundleEntry *entry) {
+  const IMAGE_DOS_HEADER *dos_header =
+      RawRange(entry, 0, sizeof(IMAGE_DOS_HEADER));
+  if (!dos_header || dos_header->e_magic != IMAGE_DOS_SIGNATURE) {
+    return NULL;
+  }
+
+  const IMAGE_NT_HEADERS32 *nt_header =
+      RawRange(entry, dos_header->e_lfanew, sizeof(IMAGE_NT_HEADERS32));
+  if (!nt_header || nt_header->Signature != IMAGE_NT_SIGNATURE) {
+    return NULL;
+  }
+  return nt_header;
+}
+
+// Maps `rva` to its offset within the raw image via the section table.
+static bool RVAToOffset(const ImageBundleEntry *entry,
+                        const IMAGE_NT_HEADERS32 *nt_header, uint32_t rva,
+                        uint32_t *offset) {
+  if (rva < nt_header->OptionalHeader.SizeOfHeaders) {
+    *offset = rva;
+    return true;
+  }
+
+  uint32_t section_table_offset =
+      (uint32_t)((const uint8_t *)&nt_header->OptionalHeader - entry->data) +
+      nt_header->FileHeader.SizeOfOptionalHeader;
+  const IMAGE_SECTION_HEADER *sections = RawRange(
+      entry, section_table_offset,
+      nt_header->FileHeader.NumberOfSections * sizeof(IMAGE_SECTION_HEADER));
+  if (!sections) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < nt_header->FileHeader.NumberOfSections; ++i) {
+    const IMAGE_SECTION_HEADER *section = sections + i;
+    if (rva >= section->VirtualAddress &&
+        rva - section->VirtualAddress < section->SizeOfRawData) {
+      *offset = section->PointerToRawData + (rva - section->VirtualAddress);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns the NUL-terminated string at `rva`, or NULL if it does not lie
+// entirely within the raw image.
+static const char *RawString(const ImageBundleEntry *entry,
+                             const IMAGE_NT_HEADERS32 *nt_header,
+                             uint32_t rva) {
+  uint32_t offset;
+  if (!RVAToOffset(entry, nt_header, rva, &offset)) {
+    return NULL;
+  }
+  const char *ret = RawRange(entry, offset, 1);
+  if (ret && !memchr(ret, 0, entry->size - offset)) {
+    return NULL;
+  }
+  return ret;
+}
+
+// Finds the offset of the given data directory within the raw image. Returns
+// false if the image does not have the directory.
+static bool FindDirectory(const ImageBundleEntry *entry,
+                          const IMAGE_NT_HEADERS32 *nt_header, uint32_t index,
+                          uint32_t *offset) {
+  const IMAGE_DATA_DIRECTORY *directory_info =
+      nt_header->OptionalHeader.DataDirectory + index;
+  return directory_info->Size &&
+         RVAToOffset(entry, nt_header, directory_info->VirtualAddress, offset);
+}
+
+static const char *FindName(const ImageBundleEntry *entry) {
+  const IMAGE_NT_HEADERS32 *nt_header = FindNTHeader(entry);
+  if (!nt_header) {
+    return NULL;
+  }
+  uint32_t offset;
+  if (!FindDirectory(entry, nt_header, IMAGE_DIRECTORY_ENTRY_EXPORT, &offset)) {
+    return NULL;
+  }
+  const IMAGE_EXPORT_DIRECTORY *directory =
+      RawRange(entry, offset, sizeof(IMAGE_EXPORT_DIRECTORY));
+  if (!directory) {
+    return NULL;
+  }
+  return RawString(entry, nt_header, directory->Name);
+}
+
+// Returns true if any of the image's import descriptors reference `name`.
+static bool Imports(const ImageBundleEntry *entry, const char *name) {
+  const IMAGE_NT_HEADERS32 *nt_header = FindNTHeader(entry);
+  if (!nt_header) {
+    return false;
+  }
+
+  uint32_t offset;
+  if (!FindDirectory(entry, nt_header, IMAGE_DIRECTORY_ENTRY_IMPORT, &offset)) {
+    return false;
+  }
+
+  const IMAGE_IMPORT_DESCRIPTOR *descriptor;
+  while ((descriptor = RawRange(entry, offset, sizeof(*descriptor))) &&
+         descriptor->Name) {
+    const char *import_name = RawString(entry, nt_header, descriptor->Name);
+    if (import_name && !strcmp(import_name, name)) {
+      return true;
+    }
+    offset += sizeof(*descriptor);
+  }
+  return false;
+}
+
+ImageBundleStatus IBParse(const void *data, uint32_t size,
+                          ImageBundleEntry *entries, uint32_t *count) {
+  const uint8_t *bundle = (const uint8_t *)data;
+  if (size < 2 * sizeof(uint32_t) || ReadUInt32(bundle) != IMAGE_BUNDLE_MAGIC) {
+    return IBS_INVALID_HEADER;
+  }
+
+  uint32_t num_images = ReadUInt32(bundle + sizeof(uint32_t));
+  if (!num_images || num_images > IMAGE_BUNDLE_MAX_IMAGES) {
+    return IBS_INVALID_COUNT;
+  }
+
+  uint32_t header_size = (2 + num_images) * sizeof(uint32_t);
+  if (size < header_size) {
+    return IBS_INVALID_HEADER;
+  }
+
+  uint32_t offset = header_size;
+  for (uint32_t i = 0; i < num_images; ++i) {
+    uint32_t image_size = ReadUInt32(bundle + (2 + i) * sizeof(uint32_t));
+    if (image_size > size - offset) {
+      return IBS_SIZE_MISMATCH;
+    }
+    entries[i].data = bundle + offset;
+    entries[i].size = image_size;
+    entries[i].name = FindName(entries + i);
+    offset += image_size;
+  }
+  if (offset != size) {
+    return IBS_SIZE_MISMATCH;
+  }
+
+  *count = num_images;
+  return IBS_OK;
+}
+
+ImageBundleStatus IBSortByDependencies(const ImageBundleEntry *entries,
+                                       uint32_t count, uint32_t *order,
+                                       uint32_t *dependencies) {
+  for (uint32_t i = 0; i < count; ++i) {
+    dependencies[i] = 0;
+    for (uint32_t j = 0; j < count; ++j) {
+      if (i != j && entries[j].name && Imports(entries + i, entries[j].name)) {
+        dependencies[i] |= 1U << j;
+      }
+    }
+  }
+
+  uint32_t placed = 0;
+  for (uint32_t position = 0; position < count; ++position) {
+    uint32_t i = 0;
+    while (i < count &&
+           ((placed & (1U << i)) || (dependencies[i] & ~placed))) {
+      ++i;
+    }
+    if (i == count) {
+      return IBS_DEPENDENCY_CYCLE;
+    }
+    order[position] = i;
+    placed |= 1U << i;
+  }
+
+  return IBS_OK;
+}
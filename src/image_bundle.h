@@ -0,0 +1,64 @@
+#ifndef DYNDXT_LOADER_IMAGE_BUNDLE_H
+#define DYNDXT_LOADER_IMAGE_BUNDLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A bundle packs several raw DLL images into a single transfer:
+//
+//   uint32_t magic          IMAGE_BUNDLE_MAGIC
+//   uint32_t count          Number of images, at most IMAGE_BUNDLE_MAX_IMAGES
+//   uint32_t sizes[count]   Size of each image in bytes
+//   <image data...>         The images, concatenated in the same order
+//
+// All values are little endian.
+#define IMAGE_BUNDLE_MAGIC 0x4E425844  // "DXBN"
+#define IMAGE_BUNDLE_MAX_IMAGES 32
+
+typedef enum ImageBundleStatus {
+  IBS_OK = 0,
+
+  // The data does not start with a valid bundle header.
+  IBS_INVALID_HEADER = 1,
+
+  // The bundle contains no images or more than IMAGE_BUNDLE_MAX_IMAGES.
+  IBS_INVALID_COUNT = 2,
+
+  // The image sizes do not add up to the size of the bundle.
+  IBS_SIZE_MISMATCH = 3,
+
+  // The images import from each other in a cycle.
+  IBS_DEPENDENCY_CYCLE = 4,
+} ImageBundleStatus;
+
+typedef struct ImageBundleEntry {
+  // The raw image, pointing into the bundle.
+  const uint8_t *data;
+  uint32_t size;
+  // The DLL name from the image's export directory, or NULL if it has none.
+  const char *name;
+} ImageBundleEntry;
+
+// Splits the bundle at `data` into its images. `entries` must have room for
+// IMAGE_BUNDLE_MAX_IMAGES elements. The entries reference `data`, which must
+// remain valid while they are in use.
+ImageBundleStatus IBParse(const void *data, uint32_t size,
+                          ImageBundleEntry *entries, uint32_t *count);
+
+// Populates `order` with the indices of `entries` such that every image is
+// preceded by any images in the bundle whose names appear in its import
+// descriptors. Independent images retain their bundle order. Bit `j` of
+// `dependencies[i]` is set if image `i` imports image `j`.
+ImageBundleStatus IBSortByDependencies(const ImageBundleEntry *entries,
+                                       uint32_t count, uint32_t *order,
+                                       uint32_t *dependencies);
+
+#ifdef __cplusplus
+};  // extern "C"
+#endif
+
+#endif  // DYNDXT_LOADER_IMAGE_BUNDLE_H
@@ -0,0 +1,130 @@
+#include "image_cache.h"
+
+#include <string.h>
+
+#include "xbdm.h"
+
+static const uint32_t kTag = 0x64647863;  // 'ddxc'
+
+// Entries ordered from most to least recently used.
+static ImageCacheEntry *entries = NULL;
+static uint32_t budget = IMAGE_CACHE_DEFAULT_BUDGET;
+static uint32_t usage = 0;
+
+static void FreeEntry(ImageCacheEntry *entry) {
+  usage -= entry->size;
+  DmFreePool(entry);
+}
+
+// Evicts least recently used entries that are not pinned until `size`
+// additional bytes fit within the budget.
+static void EvictFor(uint32_t size) {
+  while (usage > budget || budget - usage < size) {
+    ImageCacheEntry **victim = NULL;
+    for (ImageCacheEntry **prev = &entries; *prev; prev = &(*prev)->next) {
+      if (!(*prev)->pin_count) {
+        victim = prev;
+      }
+    }
+    if (!victim) {
+      return;
+    }
+
+    ImageCacheEntry *entry = *victim;
+    *victim = entry->next;
+    FreeEntry(entry);
+  }
+}
+
+void ICSetBudget(uint32_t new_budget) {
+  budget = new_budget;
+  EvictFor(0);
+}
+
+uint32_t ICGetBudget(void) { return budget; }
+
+uint32_t ICGetUsage(void) { return usage; }
+
+uint32_t ICGetNumEntries(void) {
+  uint32_t ret = 0;
+  for (ImageCacheEntry *entry = entries; entry; entry = entry->next) {
+    ++ret;
+  }
+  return ret;
+}
+
+const ImageCacheEntry *ICLookup(const uint8_t digest[SHA256_DIGEST_SIZE],
+                                uint32_t size) {
+  ImageCacheEntry **prev = &entries;
+  for (ImageCacheEntry *entry = entries; entry; entry = entry->next) {
+    if ((!size || entry->size == size) &&
+        !memcmp(entry->digest, digest, SHA256_DIGEST_SIZE)) {
+      *prev = entry->next;
+      entry->next = entries;
+      entries = entry;
+      return entry;
+    }
+    prev = &entry->next;
+  }
+  return NULL;
+}
+
+ImageCacheEntry *ICReserve(uint32_t size) {
+  if (size > budget) {
+    return NULL;
+  }
+  EvictFor(size);
+  if (usage > budget || budget - usage < size) {
+    // Other reservations or pinned entries are outstanding.
+    return NULL;
+  }
+
+  ImageCacheEntry *entry =
+      DmAllocatePoolWithTag(sizeof(ImageCacheEntry) + size, kTag);
+  if (!entry) {
+    return NULL;
+  }
+
+  entry->next = NULL;
+  entry->size = size;
+  entry->pin_count = 0;
+  entry->data = (uint8_t *)(entry + 1);
+  usage += size;
+  return entry;
+}
+
+void ICCommit(ImageCacheEntry *entry,
+              const uint8_t digest[SHA256_DIGEST_SIZE]) {
+  if (ICLookup(digest, entry->size)) {
+    ICRelease(entry);
+    return;
+  }
+
+  memcpy(entry->digest, digest, SHA256_DIGEST_SIZE);
+  entry->next = entries;
+  entries = entry;
+}
+
+void ICRelease(ImageCacheEntry *entry) { FreeEntry(entry); }
+
+void ICPin(const ImageCacheEntry *entry) {
+  ++((ImageCacheEntry *)entry)->pin_count;
+}
+
+void ICUnpin(const ImageCacheEntry *entry) {
+  --((ImageCacheEntry *)entry)->pin_count;
+  EvictFor(0);
+}
+
+void ICReset(void) {
+  ImageCacheEntry **prev = &entries;
+  while (*prev) {
+    ImageCacheEntry *entry = *prev;
+    if (entry->pin_count) {
+      prev = &entry->next;
+      continue;
+    }
+    *prev = entry->next;
+    FreeEntry(entry);
+  }
+}
@@ -0,0 +1,67 @@
+#ifndef DYNDXT_LOADER_IMAGE_CACHE_H
+#define DYNDXT_LOADER_IMAGE_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sha256.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Default number of bytes of raw image data that may be retained.
+#define IMAGE_CACHE_DEFAULT_BUDGET (1024 * 1024)
+
+// A raw DLL image retained by the cache.
+typedef struct ImageCacheEntry {
+  struct ImageCacheEntry *next;
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  uint32_t size;
+  uint8_t *data;
+  // Number of outstanding ICPin calls. Pinned entries are never evicted.
+  uint32_t pin_count;
+} ImageCacheEntry;
+
+// Sets the maximum number of bytes of image data that may be retained,
+// evicting the least recently used entries as needed.
+void ICSetBudget(uint32_t budget);
+uint32_t ICGetBudget(void);
+
+// Returns the number of bytes of image data that are currently retained or
+// reserved.
+uint32_t ICGetUsage(void);
+uint32_t ICGetNumEntries(void);
+
+// Returns the entry for the image with the given digest and size, marking it as
+// the most recently used, or NULL if no such image is cached. A `size` of 0
+// matches an image of any size. Unless pinned, the entry is valid until the
+// next call to ICReserve, ICSetBudget, or ICReset.
+const ImageCacheEntry *ICLookup(const uint8_t digest[SHA256_DIGEST_SIZE],
+                                uint32_t size);
+
+// Allocates an entry that may hold `size` bytes of image data, evicting least
+// recently used entries to stay within the budget. Returns NULL if the image
+// cannot fit within the budget. The caller must pass the result to either
+// ICCommit or ICRelease.
+ImageCacheEntry *ICReserve(uint32_t size);
+
+// Adds a fully populated entry returned by ICReserve to the cache. `data` must
+// have been verified to match `digest`.
+void ICCommit(ImageCacheEntry *entry, const uint8_t digest[SHA256_DIGEST_SIZE]);
+
+// Frees an entry returned by ICReserve without adding it to the cache.
+void ICRelease(ImageCacheEntry *entry);
+
+// Prevents the given entry from being evicted until a matching call to ICUnpin.
+void ICPin(const ImageCacheEntry *entry);
+void ICUnpin(const ImageCacheEntry *entry);
+
+// Frees all cached images that are not pinned.
+void ICReset(void);
+
+#ifdef __cplusplus
+};  // extern "C"
+#endif
+
+#endif  // DYNDXT_LOADER_IMAGE_CACHE_H
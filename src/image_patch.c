@@ -0,0 +1,142 @@
+#include "image_patch.h"
+
+#include <string.h>
+
+void ImagePatchBegin(ImagePatchDecoder *decoder, const void *base,
+                     uint32_t base_size, uint32_t output_size,
+                     ImagePatchSink sink, void *sink_context) {
+  memset(decoder, 0, sizeof(*decoder));
+  decoder->base = (const uint8_t *)base;
+  decoder->base_size = base_size;
+  decoder->output_size = output_size;
+  decoder->sink = sink;
+  decoder->sink_context = sink_context;
+}
+
+static uint32_t NumArguments(uint8_t opcode) {
+  return opcode == IMAGE_PATCH_OP_COPY ? 2 : 1;
+}
+
+static bool Emit(ImagePatchDecoder *decoder, const uint8_t *data,
+                 uint32_t size) {
+  decoder->output_position += size;
+  if (!decoder->sink(decoder->sink_context, data, size)) {
+    decoder->status = IPS_SINK_FAILED;
+    return false;
+  }
+  return true;
+}
+
+static bool ReserveOutput(ImagePatchDecoder *decoder, uint32_t size) {
+  if (size > decoder->output_size - decoder->output_position) {
+    decoder->status = IPS_OUTPUT_OVERRUN;
+    return false;
+  }
+  return true;
+}
+
+// Executes the current operation once all of its arguments have been read.
+static bool CompleteArguments(ImagePatchDecoder *decoder) {
+  if (decoder->opcode == IMAGE_PATCH_OP_INSERT) {
+    if (!ReserveOutput(decoder, decoder->arguments[0])) {
+      return false;
+    }
+    decoder->state =
+        decoder->arguments[0] ? IPS_STATE_INSERT_DATA : IPS_STATE_OPCODE;
+    return true;
+  }
+
+  uint32_t offset = decoder->arguments[0];
+  uint32_t length = decoder->arguments[1];
+  if (offset > decoder->base_size || length > decoder->base_size - offset) {
+    decoder->status = IPS_INVALID_COPY;
+    return false;
+  }
+  if (!ReserveOutput(decoder, length)) {
+    return false;
+  }
+
+  decoder->state = IPS_STATE_OPCODE;
+  return !length || Emit(decoder, decoder->base + offset, length);
+}
+
+bool ImagePatchWrite(ImagePatchDecoder *decoder, const void *data,
+                     uint32_t size) {
+  if (decoder->status != IPS_OK) {
+    return false;
+  }
+
+  const uint8_t *read_ptr = (const uint8_t *)data;
+  const uint8_t *end = read_ptr + size;
+  while (read_ptr < end) {
+    switch (decoder->state) {
+      case IPS_STATE_OPCODE:
+        decoder->opcode = *read_ptr++;
+        if (decoder->opcode != IMAGE_PATCH_OP_COPY &&
+            decoder->opcode != IMAGE_PATCH_OP_INSERT) {
+          decoder->status = IPS_CORRUPT_INPUT;
+          return false;
+        }
+        decoder->num_arguments = 0;
+        decoder->arguments[0] = 0;
+        decoder->arguments[1] = 0;
+        decoder->argument_shift = 0;
+        decoder->state = IPS_STATE_ARGUMENT;
+        break;
+
+      case IPS_STATE_ARGUMENT: {
+        uint8_t value = *read_ptr++;
+        uint32_t bits = value & 0x7F;
+        if (decoder->argument_shift > 28 ||
+            (decoder->argument_shift == 28 && bits > 0x0F)) {
+          decoder->status = IPS_CORRUPT_INPUT;
+          return false;
+        }
+        decoder->arguments[decoder->num_arguments] |=
+            bits << decoder->argument_shift;
+        decoder->argument_shift += 7;
+        if (value & 0x80) {
+          break;
+        }
+
+        decoder->argument_shift = 0;
+        if (++decoder->num_arguments == NumArguments(decoder->opcode)) {
+          if (!CompleteArguments(decoder)) {
+            return false;
+          }
+        }
+      } break;
+
+      case IPS_STATE_INSERT_DATA: {
+        uint32_t available = end - read_ptr;
+        uint32_t length = decoder->arguments[0];
+        if (length > available) {
+          length = available;
+        }
+        if (!Emit(decoder, read_ptr, length)) {
+          return false;
+        }
+        read_ptr += length;
+        decoder->arguments[0] -= length;
+        if (!decoder->arguments[0]) {
+          decoder->state = IPS_STATE_OPCODE;
+        }
+      } break;
+    }
+  }
+
+  return true;
+}
+
+bool ImagePatchEnd(ImagePatchDecoder *decoder) {
+  if (decoder->status != IPS_OK) {
+    return false;
+  }
+
+  if (decoder->state != IPS_STATE_OPCODE ||
+      decoder->output_position != decoder->output_size) {
+    decoder->status = IPS_TRUNCATED_INPUT;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,100 @@
+#ifndef DYNDXT_LOADER_IMAGE_PATCH_H
+#define DYNDXT_LOADER_IMAGE_PATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A patch is a sequence of operations that build a new image from a base
+// image. Each operation starts with an opcode byte followed by LEB128 encoded
+// unsigned 32-bit arguments:
+//
+//   IMAGE_PATCH_OP_COPY <base_offset> <length>
+//     Appends `length` bytes of the base image starting at `base_offset`.
+//   IMAGE_PATCH_OP_INSERT <length> <data...>
+//     Appends the `length` bytes of data that follow.
+//
+// The patch ends once the expected output size has been produced.
+#define IMAGE_PATCH_OP_COPY 0x01
+#define IMAGE_PATCH_OP_INSERT 0x02
+
+typedef enum ImagePatchStatus {
+  IPS_OK = 0,
+
+  // The patch contains an unknown opcode or a malformed argument.
+  IPS_CORRUPT_INPUT = 1,
+
+  // A copy operation references data beyond the end of the base image.
+  IPS_INVALID_COPY = 2,
+
+  // The patch produces more than the expected output size.
+  IPS_OUTPUT_OVERRUN = 3,
+
+  // The patch ended in the middle of an operation or before the expected
+  // output size was reached.
+  IPS_TRUNCATED_INPUT = 4,
+
+  // The output sink rejected data.
+  IPS_SINK_FAILED = 5,
+} ImagePatchStatus;
+
+// Receives patched data in order.
+// Returns false to abort patching.
+typedef bool (*ImagePatchSink)(void *sink_context, const void *data,
+                               uint32_t size);
+
+typedef enum ImagePatchState {
+  IPS_STATE_OPCODE = 0,
+  IPS_STATE_ARGUMENT,
+  IPS_STATE_INSERT_DATA,
+} ImagePatchState;
+
+// Incrementally applies a patch. Operations may be split across writes at any
+// byte boundary.
+typedef struct ImagePatchDecoder {
+  const uint8_t *base;
+  uint32_t base_size;
+
+  ImagePatchSink sink;
+  void *sink_context;
+
+  // Total number of bytes that the patch is expected to produce.
+  uint32_t output_size;
+  // Number of bytes produced so far.
+  uint32_t output_position;
+
+  ImagePatchState state;
+  uint8_t opcode;
+  // Arguments of the current operation.
+  uint32_t arguments[2];
+  uint32_t num_arguments;
+  // Decoding state for the LEB128 argument that is being read.
+  uint32_t argument_shift;
+
+  ImagePatchStatus status;
+} ImagePatchDecoder;
+
+// Prepares the given decoder to apply a patch against `base` that produces
+// `output_size` bytes. `base` must remain valid until patching has completed.
+void ImagePatchBegin(ImagePatchDecoder *decoder, const void *base,
+                     uint32_t base_size, uint32_t output_size,
+                     ImagePatchSink sink, void *sink_context);
+
+// Applies the given chunk of the patch, passing output to the decoder's sink
+// before returning. On failure `status` is set and all subsequent writes will
+// fail.
+bool ImagePatchWrite(ImagePatchDecoder *decoder, const void *data,
+                     uint32_t size);
+
+// Verifies that the patch ended on an operation boundary after producing
+// exactly `output_size` bytes.
+bool ImagePatchEnd(ImagePatchDecoder *decoder);
+
+#ifdef __cplusplus
+};  // extern "C"
+#endif
+
+#endif  // DYNDXT_LOADER_IMAGE_PATCH_H
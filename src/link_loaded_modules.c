@@ -7,12 +7,11 @@
 
 // static const uint32_t kTag = 0x64786C6C;  // 'dxll'
 
-static HRESULT RegisterModuleExports(const char *module_name,
-                                     void *module_base) {
+HRESULT LinkModuleExports(const char *module_name, const void *module_base) {
   const uint8_t *image = (const uint8_t *)module_base;
   const uint8_t *read_ptr = image;
 
-  IMAGE_DOS_HEADER *dos_header = (IMAGE_DOS_HEADER *)read_ptr;
+  const IMAGE_DOS_HEADER *dos_header = (const IMAGE_DOS_HEADER *)read_ptr;
   if (dos_header->e_magic != IMAGE_DOS_SIGNATURE) {
     DbgPrint("Bad DOS header for %s at 0x%x\n", module_name, module_base);
     return XBOX_E_TYPE_INVALID;
@@ -36,26 +35,13 @@ static HRESULT RegisterModuleExports(const char *module_name,
   const IMAGE_EXPORT_DIRECTORY *directory =
       (const IMAGE_EXPORT_DIRECTORY *)(image + directory_info->VirtualAddress);
 
-  uint32_t *function_array =
-      (uint32_t *)(image + directory->AddressOfFunctions);
-  ModuleExport export = {0};
-  for (uint32_t i = 0; i < directory->NumberOfFunctions; ++i) {
-    export.ordinal = i + directory->Base;
-
-    // TODO: Handle forwarded exports.
-    export.address = function_array[export.ordinal - directory->Base] +
-                     (intptr_t)module_base;
-
-    if (!MRRegisterMethod(module_name, &export)) {
-      DbgPrint("Failed to register %s @ %d (%s)\n", module_name, export.ordinal,
-               export.method_name ? export.method_name : "");
-      return XBOX_E_FAIL;
-    }
+  // Exports are resolved from the module's image on demand rather than being
+  // copied into the registry.
+  if (!MRRegisterLazyModule(module_name, image, directory, 0)) {
+    DbgPrint("Failed to register %s at 0x%x\n", module_name, module_base);
+    return XBOX_E_FAIL;
   }
 
-  // TODO: Consider adding support for names as well.
-  // The most kernel and xbdm images do not have any names.
-
   return XBOX_S_OK;
 }
 
@@ -66,7 +52,11 @@ HRESULT LinkLoadedModules(void) {
   HRESULT ret = XBOX_S_OK;
   while (DmWalkLoadedModules(&token, &module_info) == XBOX_S_OK &&
          ret == XBOX_S_OK) {
-    ret = RegisterModuleExports(module_info.name, module_info.base);
+    // Modules enumerated by DmWalkLoadedModules are not expected to be
+    // unloaded while the loader is running.
+    ret = LinkModuleExports(module_info.name, module_info.base);
+    // Allows imports bound against this build by dyndxt_bind to be trusted.
+    MRSetModuleTimestamp(module_info.name, module_info.timestamp);
   }
   DmCloseLoadedModules(token);
 
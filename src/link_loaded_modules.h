@@ -9,6 +9,12 @@ extern "C" {
 
 HRESULT LinkLoadedModules(void);
 
+// Registers the exports of the PE image at `module_base` with the module
+// registry under `module_name`. Exports are resolved from the image's export
+// directory on demand, so the image must remain valid until it is detached via
+// MRUnregisterAddressRange.
+HRESULT LinkModuleExports(const char *module_name, const void *module_base);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -0,0 +1,225 @@
+#include "lz4_stream.h"
+
+#include <string.h>
+
+#define WINDOW_MASK (LZ4_STREAM_WINDOW_SIZE - 1)
+
+// Length nibble value indicating that additional length bytes follow.
+#define LENGTH_EXTENDED 0x0F
+
+// Matches are always at least this many bytes long.
+#define MIN_MATCH 4
+
+void LZ4StreamBegin(LZ4StreamDecoder *decoder, uint8_t *window,
+                    uint32_t output_size, LZ4StreamSink sink,
+                    void *sink_context) {
+  memset(decoder, 0, sizeof(*decoder));
+  decoder->window = window;
+  decoder->output_size = output_size;
+  decoder->sink = sink;
+  decoder->sink_context = sink_context;
+}
+
+// Passes any output that has not yet been consumed to the sink. Output is
+// flushed whenever the window wraps, so the pending range is always contiguous.
+static bool Flush(LZ4StreamDecoder *decoder) {
+  uint32_t pending = decoder->output_position - decoder->output_flushed;
+  if (!pending) {
+    return true;
+  }
+
+  const uint8_t *start =
+      decoder->window + (decoder->output_flushed & WINDOW_MASK);
+  decoder->output_flushed = decoder->output_position;
+  if (!decoder->sink(decoder->sink_context, start, pending)) {
+    decoder->status = LZ4S_SINK_FAILED;
+    return false;
+  }
+  return true;
+}
+
+// Returns the number of bytes that may be written before the window wraps.
+static uint32_t WindowSpace(const LZ4StreamDecoder *decoder) {
+  return LZ4_STREAM_WINDOW_SIZE - (decoder->output_position & WINDOW_MASK);
+}
+
+// Advances the output position by `size` bytes that have already been written
+// into the window, flushing if the window has wrapped.
+static bool Commit(LZ4StreamDecoder *decoder, uint32_t size) {
+  decoder->output_position += size;
+  if (decoder->output_position & WINDOW_MASK) {
+    return true;
+  }
+  return Flush(decoder);
+}
+
+static bool ReserveOutput(LZ4StreamDecoder *decoder, uint32_t size) {
+  if (size > decoder->output_size - decoder->output_position) {
+    decoder->status = LZ4S_OUTPUT_OVERRUN;
+    return false;
+  }
+  return true;
+}
+
+// Copies up to `literal_length` literals from the input into the window.
+static bool CopyLiterals(LZ4StreamDecoder *decoder, const uint8_t **read_ptr,
+                         const uint8_t *end) {
+  while (decoder->literal_length && *read_ptr < end) {
+    uint32_t available = end - *read_ptr;
+    uint32_t size = decoder->literal_length;
+    if (size > available) {
+      size = available;
+    }
+    uint32_t space = WindowSpace(decoder);
+    if (size > space) {
+      size = space;
+    }
+
+    memcpy(decoder->window + (decoder->output_position & WINDOW_MASK),
+           *read_ptr, size);
+    *read_ptr += size;
+    decoder->literal_length -= size;
+    if (!Commit(decoder, size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Copies `match_length` bytes from `match_offset` bytes back in the output.
+// The source and destination may overlap, in which case the copy repeats the
+// most recent output.
+static bool CopyMatch(LZ4StreamDecoder *decoder) {
+  if (!ReserveOutput(decoder, decoder->match_length)) {
+    return false;
+  }
+
+  uint32_t remaining = decoder->match_length;
+  while (remaining) {
+    uint32_t size = WindowSpace(decoder);
+    if (size > remaining) {
+      size = remaining;
+    }
+
+    uint8_t *dest = decoder->window + (decoder->output_position & WINDOW_MASK);
+    uint32_t source = decoder->output_position - decoder->match_offset;
+    for (uint32_t i = 0; i < size; ++i) {
+      dest[i] = decoder->window[(source + i) & WINDOW_MASK];
+    }
+
+    remaining -= size;
+    if (!Commit(decoder, size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool LZ4StreamWrite(LZ4StreamDecoder *decoder, const void *data,
+                    uint32_t size) {
+  if (decoder->status != LZ4S_OK) {
+    return false;
+  }
+
+  const uint8_t *read_ptr = (const uint8_t *)data;
+  const uint8_t *end = read_ptr + size;
+  while (read_ptr < end) {
+    switch (decoder->state) {
+      case LZ4S_STATE_TOKEN: {
+        uint8_t token = *read_ptr++;
+        decoder->literal_length = token >> 4;
+        decoder->match_length = token & LENGTH_EXTENDED;
+        if (decoder->literal_length == LENGTH_EXTENDED) {
+          decoder->state = LZ4S_STATE_LITERAL_LENGTH;
+        } else {
+          decoder->state = LZ4S_STATE_LITERALS;
+        }
+      } break;
+
+      case LZ4S_STATE_LITERAL_LENGTH: {
+        uint8_t value = *read_ptr++;
+        decoder->literal_length += value;
+        if (!ReserveOutput(decoder, decoder->literal_length)) {
+          return false;
+        }
+        if (value != 0xFF) {
+          decoder->state = LZ4S_STATE_LITERALS;
+        }
+      } break;
+
+      case LZ4S_STATE_LITERALS:
+        // Validate the complete run up front so that overruns are detected
+        // before any of the run is written.
+        if (!ReserveOutput(decoder, decoder->literal_length)) {
+          return false;
+        }
+        if (!CopyLiterals(decoder, &read_ptr, end)) {
+          return false;
+        }
+        if (!decoder->literal_length) {
+          decoder->state = LZ4S_STATE_OFFSET_LOW;
+        }
+        break;
+
+      case LZ4S_STATE_OFFSET_LOW:
+        decoder->match_offset = *read_ptr++;
+        decoder->state = LZ4S_STATE_OFFSET_HIGH;
+        break;
+
+      case LZ4S_STATE_OFFSET_HIGH:
+        decoder->match_offset |= (uint32_t)(*read_ptr++) << 8;
+        if (!decoder->match_offset ||
+            decoder->match_offset > decoder->output_position) {
+          decoder->status = LZ4S_CORRUPT_INPUT;
+          return false;
+        }
+        if (decoder->match_length == LENGTH_EXTENDED) {
+          decoder->state = LZ4S_STATE_MATCH_LENGTH;
+          break;
+        }
+        decoder->match_length += MIN_MATCH;
+        if (!CopyMatch(decoder)) {
+          return false;
+        }
+        decoder->state = LZ4S_STATE_TOKEN;
+        break;
+
+      case LZ4S_STATE_MATCH_LENGTH: {
+        uint8_t value = *read_ptr++;
+        decoder->match_length += value;
+        if (!ReserveOutput(decoder, decoder->match_length)) {
+          return false;
+        }
+        if (value == 0xFF) {
+          break;
+        }
+        decoder->match_length += MIN_MATCH;
+        if (!CopyMatch(decoder)) {
+          return false;
+        }
+        decoder->state = LZ4S_STATE_TOKEN;
+      } break;
+    }
+  }
+
+  // A zero length literal run does not consume any input.
+  if (decoder->state == LZ4S_STATE_LITERALS && !decoder->literal_length) {
+    decoder->state = LZ4S_STATE_OFFSET_LOW;
+  }
+
+  return Flush(decoder);
+}
+
+bool LZ4StreamEnd(LZ4StreamDecoder *decoder) {
+  if (decoder->status != LZ4S_OK) {
+    return false;
+  }
+
+  // The final sequence of a block consists solely of literals.
+  if (decoder->state != LZ4S_STATE_OFFSET_LOW ||
+      decoder->output_position != decoder->output_size) {
+    decoder->status = LZ4S_TRUNCATED_INPUT;
+    return false;
+  }
+  return true;
+}
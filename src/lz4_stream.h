@@ -0,0 +1,93 @@
+#ifndef DYNDXT_LOADER_LZ4_STREAM_H
+#define DYNDXT_LOADER_LZ4_STREAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Size of the history window required by the decoder. LZ4 match offsets are
+// 16 bits, so any match may reference up to 64KiB of previous output.
+#define LZ4_STREAM_WINDOW_SIZE 0x10000
+
+typedef enum LZ4StreamStatus {
+  LZ4S_OK = 0,
+
+  // The compressed data is malformed.
+  LZ4S_CORRUPT_INPUT = 1,
+
+  // The compressed data expands beyond the expected output size.
+  LZ4S_OUTPUT_OVERRUN = 2,
+
+  // The stream ended in the middle of a sequence or before the expected
+  // output size was reached.
+  LZ4S_TRUNCATED_INPUT = 3,
+
+  // The output sink rejected decompressed data.
+  LZ4S_SINK_FAILED = 4,
+} LZ4StreamStatus;
+
+// Receives decompressed data in order.
+// Returns false to abort decompression.
+typedef bool (*LZ4StreamSink)(void *sink_context, const void *data,
+                              uint32_t size);
+
+typedef enum LZ4StreamState {
+  LZ4S_STATE_TOKEN = 0,
+  LZ4S_STATE_LITERAL_LENGTH,
+  LZ4S_STATE_LITERALS,
+  LZ4S_STATE_OFFSET_LOW,
+  LZ4S_STATE_OFFSET_HIGH,
+  LZ4S_STATE_MATCH_LENGTH,
+} LZ4StreamState;
+
+// Incrementally decodes an LZ4 block format stream. The stream is treated as a
+// single block, so matches may reference any of the previous 64KiB of output
+// regardless of how the compressed data is split across writes.
+typedef struct LZ4StreamDecoder {
+  // Ring buffer of LZ4_STREAM_WINDOW_SIZE bytes holding the most recent
+  // output.
+  uint8_t *window;
+
+  LZ4StreamSink sink;
+  void *sink_context;
+
+  // Total number of bytes that the stream is expected to decompress to.
+  uint32_t output_size;
+  // Number of bytes decompressed so far.
+  uint32_t output_position;
+  // Number of bytes that have been passed to `sink`.
+  uint32_t output_flushed;
+
+  LZ4StreamState state;
+  uint32_t literal_length;
+  uint32_t match_length;
+  uint32_t match_offset;
+
+  LZ4StreamStatus status;
+} LZ4StreamDecoder;
+
+// Prepares the given decoder to decompress a stream of `output_size` bytes.
+// `window` must be LZ4_STREAM_WINDOW_SIZE bytes and must remain valid until
+// decoding has completed.
+void LZ4StreamBegin(LZ4StreamDecoder *decoder, uint8_t *window,
+                    uint32_t output_size, LZ4StreamSink sink,
+                    void *sink_context);
+
+// Decompresses the given chunk of compressed data, passing the output to the
+// decoder's sink before returning. Chunks may be split at any byte boundary.
+// On failure `status` is set and all subsequent writes will fail.
+bool LZ4StreamWrite(LZ4StreamDecoder *decoder, const void *data,
+                    uint32_t size);
+
+// Verifies that the stream ended on a sequence boundary after producing exactly
+// `output_size` bytes.
+bool LZ4StreamEnd(LZ4StreamDecoder *decoder);
+
+#ifdef __cplusplus
+};  // extern "C"
+#endif
+
+#endif  // DYNDXT_LOADER_LZ4_STREAM_H
@@ -4,99 +4,345 @@
 #include <stdint.h>
 #include <string.h>
 
-#include "util.h"
+#include "pool_arena.h"
+#include "winapi/winnt.h"
 #include "xbdm.h"
 
 // 'dxmr' - ddxt module registry
 static const uint32_t kTag = 0x64786D72;
 
-struct ExportNode;
-typedef struct ExportNode {
-  struct ExportNode *next;
-  ModuleExport entry;
-} ExportNode;
+// Size of the chunks from which export nodes, tables, and strings are
+// allocated.
+#define REGISTRY_ARENA_CHUNK_SIZE 2048
+
+// Initial number of slots in a module's ordinal index.
+#define ORDINAL_INDEX_INITIAL_CAPACITY 16
+
+// Number of unused slots that may be added to an ordinal index beyond twice the
+// number of exports it already holds. Ordinals that would require more padding
+// than this are treated as outliers.
+#define ORDINAL_INDEX_MAX_GAP 64
+
+// Initial number of slots in a module's name index. Must be a power of 2.
+#define NAME_INDEX_INITIAL_CAPACITY 16
+
+// Initial number of slots in a module's hint index.
+#define HINT_INDEX_INITIAL_CAPACITY 16
+
+// Slot in a module's open addressing name index. Each export contributes an
+// entry for its method_name and its alias.
+typedef struct NameIndexEntry {
+  // Points at the method_name or alias of `entry`. NULL for empty slots and
+  // kDeletedName for tombstones.
+  const char *name;
+  uint32_t hash;
+  ModuleExport *entry;
+} NameIndexEntry;
+
+// Links exports whose ordinals are too distant from the indexed range.
+typedef struct OutlierNode {
+  struct OutlierNode *next;
+  ModuleExport *entry;
+} OutlierNode;
+
+// An export array registered with MR_FLAG_STATIC, whose strings are never
+// freed.
+typedef struct StaticExports {
+  struct StaticExports *next;
+  const ModuleExport *exports;
+  uint32_t count;
+} StaticExports;
 
 // Captures information about methods exported from a particular module.
+//
+// Exports are referenced by pointer so that tables registered with
+// MR_FLAG_STATIC may be used in place. Exports registered without that flag
+// are copied into the registry arena, but continue to reference the caller's
+// strings, which the registry frees once the export is replaced or removed.
 struct ModuleExportTable;
 typedef struct ModuleExportTable {
   struct ModuleExportTable *next;
   char *module_name;
-  ExportNode *exports;
+
+  // Exports are generally dense and contiguous starting at the module's
+  // IMAGE_EXPORT_DIRECTORY.Base, so they are indexed directly by
+  // `ordinal - ordinal_base`.
+  ModuleExport **ordinals;
+  uint32_t ordinal_base;
+  uint32_t ordinal_capacity;
+
+  OutlierNode *outliers;
+
+  // Arrays registered with MR_FLAG_STATIC, which own none of their strings.
+  StaticExports *static_exports;
+
+  // Linear probing hash index over the names and aliases of all exports.
+  NameIndexEntry *names;
+  uint32_t name_capacity;
+  // Number of occupied slots, including tombstones.
+  uint32_t name_slots_used;
+  uint32_t num_names;
+
+  // Named exports sorted by HintName, mirroring the export name pointer table
+  // of a PE image so that the hints in an importer's IMAGE_IMPORT_BY_NAME
+  // entries index directly into it.
+  ModuleExport **hints;
+  uint32_t hint_capacity;
+  uint32_t num_hints;
+  // Number of entries in the hint index whose name matches their predecessor.
+  uint32_t num_shared_hint_names;
+
+  uint32_t num_exports;
+
+  // Optional in-memory PE export table from which ordinals that have not been
+  // registered explicitly are resolved on demand.
+  const uint8_t *image_base;
+  const IMAGE_EXPORT_DIRECTORY *image_exports;
+  uint32_t image_flags;
+  // Number of non-empty entries in the image's export address table.
+  uint32_t num_image_exports;
+  // Number of explicitly registered exports that hide an image export.
+  uint32_t num_shadowed_image_exports;
+
+  // TimeDateStamp of the loaded build of the module, or 0 if imports bound by
+  // a host tool must not be trusted.
+  uint32_t timestamp;
 } ModuleExportTable;
 
 static ModuleExportTable *export_table = NULL;
 
-static bool AppendExport(ModuleExportTable *table,
-                         const ModuleExport *module_export);
-static bool AppendExportTable(const char *module_name,
-                              const ModuleExport *module_export);
+// Backs all ModuleExportTable, OutlierNode, StaticExports, and non-static
+// ModuleExport instances as well as module names. The ordinal and name indices
+// are resized over time and are allocated from the pool directly.
+static PoolArena registry_arena;
+
+// Marks name index slots whose entry has been removed.
+static const char kDeletedName[] = "";
+
+static ModuleExportTable *FindOrCreateExportTable(const char *module_name);
+static bool AppendExports(ModuleExportTable *table,
+                          const ModuleExport *exports, uint32_t count,
+                          uint32_t flags);
+static ModuleExport *FindExportByOrdinal(const ModuleExportTable *table,
+                                         uint32_t ordinal);
+static ModuleExport *NextExport(const ModuleExportTable *table,
+                                const ModuleExport *entry);
+static ModuleExport *FindExportByName(const ModuleExportTable *table,
+                                      const char *name);
+static bool LookupImageExport(const ModuleExportTable *table, uint32_t ordinal,
+                              uint32_t *address);
+static bool LookupImageExportByName(const ModuleExportTable *table,
+                                    const char *name, uint32_t *ordinal);
+static ModuleExport *FindExportByHint(const ModuleExportTable *table,
+                                      const char *name, uint32_t hint);
+static bool LookupImageExportByHint(const ModuleExportTable *table,
+                                    const char *name, uint32_t hint,
+                                    uint32_t *ordinal);
+static const char *FindImageExportName(const ModuleExportTable *table,
+                                       uint32_t ordinal);
+static uint32_t RemoveExportsInRange(ModuleExportTable *table, uint32_t start,
+                                     uint32_t end);
+static void ReleaseExportStrings(const ModuleExportTable *table,
+                                 const ModuleExport *entry);
 
 bool MR_API MRRegisterMethod(const char *module_name,
                              const ModuleExport *module_export) {
-  ModuleExportTable *e = export_table;
-  while (e) {
-    if (!strcmp(e->module_name, module_name)) {
-      return AppendExport(e, module_export);
+  return MRRegisterMethods(module_name, module_export, 1, 0);
+}
+
+bool MR_API MRRegisterMethods(const char *module_name,
+                              const ModuleExport *exports, uint32_t count,
+                              uint32_t flags) {
+  if (!registry_arena.chunk_size) {
+    PoolArenaInit(&registry_arena, REGISTRY_ARENA_CHUNK_SIZE, kTag);
+  }
+
+  ModuleExportTable *table = FindOrCreateExportTable(module_name);
+  if (!table) {
+    return false;
+  }
+
+  // The module's exports no longer match those of the build it was bound
+  // against.
+  table->timestamp = 0;
+  return AppendExports(table, exports, count, flags);
+}
+
+bool MR_API MRRegisterLazyModule(const char *module_name,
+                                 const void *image_base,
+                                 const void *export_directory,
+                                 uint32_t flags) {
+  if (!registry_arena.chunk_size) {
+    PoolArenaInit(&registry_arena, REGISTRY_ARENA_CHUNK_SIZE, kTag);
+  }
+
+  ModuleExportTable *table = FindOrCreateExportTable(module_name);
+  if (!table) {
+    return false;
+  }
+
+  table->image_base = (const uint8_t *)image_base;
+  table->image_exports = (const IMAGE_EXPORT_DIRECTORY *)export_directory;
+  table->image_flags = flags;
+  table->timestamp = 0;
+
+  const uint32_t *functions =
+      (const uint32_t *)(table->image_base +
+                         table->image_exports->AddressOfFunctions);
+  table->num_image_exports = 0;
+  for (uint32_t i = 0; i < table->image_exports->NumberOfFunctions; ++i) {
+    if (functions[i]) {
+      ++table->num_image_exports;
+    }
+  }
+
+  table->num_shadowed_image_exports = 0;
+  uint32_t unused;
+  for (ModuleExport *entry = NextExport(table, NULL); entry;
+       entry = NextExport(table, entry)) {
+    if (LookupImageExport(table, entry->ordinal, &unused)) {
+      ++table->num_shadowed_image_exports;
     }
-    e = e->next;
   }
 
-  return AppendExportTable(module_name, module_export);
+  return true;
+}
+
+bool MR_API MRSetModuleTimestamp(const char *module_name,
+                                 uint32_t timestamp) {
+  ModuleExportTable *table;
+  if (!MRGetModuleHandle(module_name, (void **)&table)) {
+    return false;
+  }
+  table->timestamp = timestamp;
+  return true;
+}
+
+bool MR_API MRGetModuleTimestamp(const char *module_name,
+                                 uint32_t *timestamp) {
+  ModuleExportTable *table;
+  if (!MRGetModuleHandle(module_name, (void **)&table) || !table->timestamp) {
+    return false;
+  }
+  *timestamp = table->timestamp;
+  return true;
 }
 
 bool MR_API MRGetMethodByOrdinal(const char *module_name, uint32_t ordinal,
                                  uint32_t *result) {
-  *result = 0;
+  void *handle;
+  if (!MRGetModuleHandle(module_name, &handle)) {
+    *result = 0;
+    return false;
+  }
+  return MRGetMethodByOrdinalInModule(handle, ordinal, result);
+}
+
+bool MR_API MRGetMethodByName(const char *module_name, const char *name,
+                              uint32_t *result) {
+  void *handle;
+  if (!MRGetModuleHandle(module_name, &handle)) {
+    *result = 0;
+    return false;
+  }
+  return MRGetMethodByNameInModule(handle, name, result);
+}
 
+bool MR_API MRGetModuleHandle(const char *module_name, void **handle) {
   ModuleExportTable *table = export_table;
   while (table && strcmp(table->module_name, module_name)) {
     table = table->next;
   }
+
+  *handle = table;
+  return table != NULL;
+}
+
+bool MR_API MRGetMethodByOrdinalInModule(void *handle, uint32_t ordinal,
+                                         uint32_t *result) {
+  *result = 0;
+
+  ModuleExportTable *table = (ModuleExportTable *)handle;
   if (!table) {
     return false;
   }
 
-  ExportNode *node = table->exports;
-  while (node && node->entry.ordinal != ordinal) {
-    node = node->next;
+  ModuleExport *entry = FindExportByOrdinal(table, ordinal);
+  if (entry) {
+    *result = entry->address;
+    return true;
   }
-  if (!node) {
+
+  if (!LookupImageExport(table, ordinal, result)) {
     return false;
   }
 
-  *result = node->entry.address;
+  if (table->image_flags & MR_FLAG_MEMOIZE) {
+    // Failure to memoize is harmless as the image can be consulted again.
+    ModuleExport memo = {ordinal, NULL, NULL, *result};
+    AppendExports(table, &memo, 1, 0);
+  }
   return true;
 }
 
-bool MR_API MRGetMethodByName(const char *module_name, const char *name,
-                              uint32_t *result) {
+bool MR_API MRGetMethodByNameInModule(void *handle, const char *name,
+                                      uint32_t *result) {
   *result = 0;
 
-  ModuleExportTable *table = export_table;
-  while (table && strcmp(table->module_name, module_name)) {
-    table = table->next;
-  }
+  ModuleExportTable *table = (ModuleExportTable *)handle;
   if (!table) {
     return false;
   }
 
-  ExportNode *node = table->exports;
-  while (node) {
-    if (node->entry.method_name && !strcmp(node->entry.method_name, name)) {
-      break;
-    }
-    if (node->entry.alias && !strcmp(node->entry.alias, name)) {
-      break;
-    }
-    node = node->next;
+  ModuleExport *entry = FindExportByName(table, name);
+  if (entry) {
+    *result = entry->address;
+    return true;
   }
 
-  if (!node) {
+  // Explicitly registered exports take precedence over the image, even if the
+  // image associates a different name with the ordinal.
+  uint32_t ordinal;
+  if (!LookupImageExportByName(table, name, &ordinal)) {
     return false;
   }
+  entry = FindExportByOrdinal(table, ordinal);
+  if (entry) {
+    *result = entry->address;
+    return true;
+  }
+  return LookupImageExport(table, ordinal, result);
+}
 
-  *result = node->entry.address;
-  return true;
+bool MR_API MRGetMethodByNameWithHintInModule(void *handle, const char *name,
+                                              uint32_t hint, uint32_t *result) {
+  *result = 0;
+
+  ModuleExportTable *table = (ModuleExportTable *)handle;
+  if (!table) {
+    return false;
+  }
+
+  ModuleExport *entry = FindExportByHint(table, name, hint);
+  if (entry) {
+    *result = entry->address;
+    return true;
+  }
+
+  // Explicitly registered names take precedence over the image, so its name
+  // table may only be consulted directly if there are none.
+  uint32_t ordinal;
+  if (!table->num_names &&
+      LookupImageExportByHint(table, name, hint, &ordinal)) {
+    entry = FindExportByOrdinal(table, ordinal);
+    if (entry) {
+      *result = entry->address;
+      return true;
+    }
+    return LookupImageExport(table, ordinal, result);
+  }
+
+  return MRGetMethodByNameInModule(handle, name, result);
 }
 
 uint32_t MR_API MRGetNumRegisteredModules(void) {
@@ -114,11 +360,8 @@ uint32_t MR_API MRGetTotalNumExports(void) {
 
   ModuleExportTable *table = export_table;
   while (table) {
-    ExportNode *node = table->exports;
-    while (node) {
-      ++ret;
-      node = node->next;
-    }
+    ret += table->num_exports + table->num_image_exports -
+           table->num_shadowed_image_exports;
     table = table->next;
   }
 
@@ -127,130 +370,862 @@ uint32_t MR_API MRGetTotalNumExports(void) {
 
 void MR_API MREnumerateRegistryBegin(ModuleRegistryCursor *cursor) {
   cursor->module_ = export_table;
-  cursor->export_ = export_table->exports;
+  cursor->export_ = NULL;
+  cursor->index_ = 0;
+}
+
+static bool IsImageOrdinal(const ModuleExportTable *table, uint32_t ordinal) {
+  const IMAGE_EXPORT_DIRECTORY *directory = table->image_exports;
+  return directory && ordinal >= directory->Base &&
+         ordinal - directory->Base < directory->NumberOfFunctions;
+}
+
+// Returns the export following the one most recently returned via `cursor`
+// within the given table.
+//
+// Lazily linked modules are enumerated in two phases. First, every ordinal
+// covered by the image's export table is visited in order, preferring
+// explicitly registered exports over the image. Then any registered exports
+// outside of the image's ordinal range are visited.
+static ModuleExport *NextTableExport(const ModuleExportTable *table,
+                                     ModuleRegistryCursor *cursor) {
+  ModuleExport *previous = (ModuleExport *)cursor->export_;
+  if (!table->image_exports) {
+    return NextExport(table, previous);
+  }
+
+  const IMAGE_EXPORT_DIRECTORY *directory = table->image_exports;
+  while (cursor->index_ < directory->NumberOfFunctions) {
+    uint32_t ordinal = directory->Base + cursor->index_++;
+    ModuleExport *entry = FindExportByOrdinal(table, ordinal);
+    if (entry) {
+      return entry;
+    }
+
+    uint32_t address;
+    if (LookupImageExport(table, ordinal, &address)) {
+      cursor->scratch_.ordinal = ordinal;
+      cursor->scratch_.method_name =
+          (char *)FindImageExportName(table, ordinal);
+      cursor->scratch_.alias = NULL;
+      cursor->scratch_.address = address;
+      return &cursor->scratch_;
+    }
+  }
+
+  ModuleExport *entry = NULL;
+  if (previous && previous != &cursor->scratch_ &&
+      !IsImageOrdinal(table, previous->ordinal)) {
+    entry = NextExport(table, previous);
+  } else {
+    entry = NextExport(table, NULL);
+  }
+  while (entry && IsImageOrdinal(table, entry->ordinal)) {
+    entry = NextExport(table, entry);
+  }
+  return entry;
 }
 
 bool MR_API MREnumerateRegistry(const char **module_name,
                                 const ModuleExport **module_export,
                                 ModuleRegistryCursor *cursor) {
-  if (!cursor->module_ || !cursor->export_) {
-    return false;
-  }
-
   ModuleExportTable *table = (ModuleExportTable *)cursor->module_;
-  *module_name = table->module_name;
-  ExportNode *node = (ExportNode *)cursor->export_;
-  *module_export = &node->entry;
+  while (table) {
+    ModuleExport *entry = NextTableExport(table, cursor);
+    if (entry) {
+      cursor->module_ = table;
+      cursor->export_ = entry;
+      *module_name = table->module_name;
+      *module_export = entry;
+      return true;
+    }
 
-  node = node->next;
-  if (!node) {
     table = table->next;
-    if (table) {
-      node = table->exports;
-    }
+    cursor->export_ = NULL;
+    cursor->index_ = 0;
   }
 
-  cursor->module_ = table;
-  cursor->export_ = node;
+  cursor->module_ = NULL;
+  cursor->export_ = NULL;
+  return false;
+}
 
-  return true;
+uint32_t MR_API MRUnregisterAddressRange(uint32_t start, uint32_t end) {
+  uint32_t ret = 0;
+  ModuleExportTable **link = &export_table;
+  while (*link) {
+    ModuleExportTable *table = *link;
+    ret += RemoveExportsInRange(table, start, end);
+
+    uint32_t image_base = (uint32_t)(intptr_t)table->image_base;
+    if (table->image_exports && image_base >= start && image_base < end) {
+      table->image_base = NULL;
+      table->image_exports = NULL;
+      table->image_flags = 0;
+      table->num_image_exports = 0;
+      table->num_shadowed_image_exports = 0;
+    }
+
+    if (table->num_exports || table->image_exports) {
+      link = &table->next;
+      continue;
+    }
+
+    // The table itself lives in the arena and is reclaimed on reset.
+    *link = table->next;
+    if (table->ordinals) {
+      DmFreePool(table->ordinals);
+    }
+    if (table->names) {
+      DmFreePool(table->names);
+    }
+    if (table->hints) {
+      DmFreePool(table->hints);
+    }
+  }
+
+  return ret;
 }
 
 void MR_API MRResetRegistry(void) {
   ModuleExportTable *table = export_table;
   while (table) {
-    ExportNode *node = table->exports;
-    while (node) {
-      ExportNode *node_delete = node;
-      node = node->next;
-      if (node_delete->entry.method_name) {
-        DmFreePool(node_delete->entry.method_name);
-      }
-      if (node_delete->entry.alias) {
-        DmFreePool(node_delete->entry.alias);
-      }
-      DmFreePool(node_delete);
+    for (ModuleExport *entry = NextExport(table, NULL); entry;
+         entry = NextExport(table, entry)) {
+      ReleaseExportStrings(table, entry);
+    }
+    if (table->ordinals) {
+      DmFreePool(table->ordinals);
+    }
+    if (table->names) {
+      DmFreePool(table->names);
+    }
+    if (table->hints) {
+      DmFreePool(table->hints);
     }
-    ModuleExportTable *table_delete = table;
     table = table->next;
-
-    DmFreePool(table_delete->module_name);
-    DmFreePool(table_delete);
   }
   export_table = NULL;
+
+  PoolArenaReset(&registry_arena);
+}
+
+
+static bool IsIndexed(const ModuleExportTable *table, uint32_t ordinal) {
+  return table->ordinals && ordinal >= table->ordinal_base &&
+         ordinal - table->ordinal_base < table->ordinal_capacity;
+}
+
+// Returns the slot referencing the export with the given ordinal, or NULL if
+// no such export is registered.
+static ModuleExport **FindExportSlot(const ModuleExportTable *table,
+                                     uint32_t ordinal) {
+  if (IsIndexed(table, ordinal)) {
+    ModuleExport **slot = table->ordinals + (ordinal - table->ordinal_base);
+    return *slot ? slot : NULL;
+  }
+
+  OutlierNode *node = table->outliers;
+  while (node && node->entry->ordinal != ordinal) {
+    node = node->next;
+  }
+  return node ? &node->entry : NULL;
+}
+
+static ModuleExport *FindExportByOrdinal(const ModuleExportTable *table,
+                                         uint32_t ordinal) {
+  ModuleExport **slot = FindExportSlot(table, ordinal);
+  return slot ? *slot : NULL;
+}
+
+// Returns the export following `entry` (or the first export if `entry` is
+// NULL). Indexed exports are visited in ordinal order, followed by any
+// outliers.
+static ModuleExport *NextExport(const ModuleExportTable *table,
+                                const ModuleExport *entry) {
+  uint32_t index = 0;
+  if (entry) {
+    if (!IsIndexed(table, entry->ordinal) ||
+        table->ordinals[entry->ordinal - table->ordinal_base] != entry) {
+      const OutlierNode *node = table->outliers;
+      while (node && node->entry != entry) {
+        node = node->next;
+      }
+      return node && node->next ? node->next->entry : NULL;
+    }
+    index = entry->ordinal - table->ordinal_base + 1;
+  }
+
+  for (; index < table->ordinal_capacity; ++index) {
+    if (table->ordinals[index]) {
+      return table->ordinals[index];
+    }
+  }
+
+  return table->outliers ? table->outliers->entry : NULL;
 }
 
-static bool SetExportEntry(ExportNode **n, const ModuleExport *module_export) {
-  *n = (ExportNode *)DmAllocatePoolWithTag(sizeof(**n), kTag);
-  if (!n) {
+// Resizes the ordinal index to cover [base, base + capacity), moving any
+// outliers that fall into the new range into the index.
+static bool ResizeOrdinalIndex(ModuleExportTable *table, uint32_t base,
+                               uint32_t capacity) {
+  ModuleExport **ordinals = (ModuleExport **)DmAllocatePoolWithTag(
+      capacity * sizeof(*ordinals), kTag);
+  if (!ordinals) {
     return false;
   }
-  (*n)->next = NULL;
-  memcpy(&(*n)->entry, module_export, sizeof((*n)->entry));
+  memset(ordinals, 0, capacity * sizeof(*ordinals));
+
+  if (table->ordinals) {
+    memcpy(ordinals + (table->ordinal_base - base), table->ordinals,
+           table->ordinal_capacity * sizeof(*ordinals));
+    DmFreePool(table->ordinals);
+  }
+
+  table->ordinals = ordinals;
+  table->ordinal_base = base;
+  table->ordinal_capacity = capacity;
+
+  OutlierNode **link = &table->outliers;
+  while (*link) {
+    OutlierNode *node = *link;
+    if (IsIndexed(table, node->entry->ordinal)) {
+      *link = node->next;
+      table->ordinals[node->entry->ordinal - base] = node->entry;
+    } else {
+      link = &node->next;
+    }
+  }
+
   return true;
 }
 
-static bool AppendExport(ModuleExportTable *table,
-                         const ModuleExport *module_export) {
-  ExportNode *n = table->exports;
-  if (!n) {
-    return SetExportEntry(&table->exports, module_export);
+// Attempts to grow the ordinal index such that it covers [first, last], given
+// that `pending` exports are about to be added to the table. Returns false if
+// the range is too sparse to index, in which case ordinals outside of the
+// current index should be treated as outliers.
+static bool GrowOrdinalIndex(ModuleExportTable *table, uint32_t first,
+                             uint32_t last, uint32_t pending) {
+  uint32_t capacity = ORDINAL_INDEX_INITIAL_CAPACITY;
+  uint32_t new_base = first;
+  uint32_t new_last = last;
+  bool grow_down = false;
+  if (table->ordinals) {
+    capacity = table->ordinal_capacity;
+    uint32_t base = table->ordinal_base;
+    uint32_t base_last = base + capacity - 1;
+    grow_down = first < base && last <= base_last;
+    if (base < new_base) {
+      new_base = base;
+    }
+    if (base_last > new_last) {
+      new_last = base_last;
+    }
   }
 
-  // Replace any existing entry.
-  ExportNode *last = n;
-  while (n) {
-    if (n->entry.ordinal == module_export->ordinal) {
-      if (n->entry.method_name) {
-        DmFreePool(n->entry.method_name);
+  uint32_t exports = table->num_exports + pending;
+  if (new_last - new_base >= 2 * exports + ORDINAL_INDEX_MAX_GAP) {
+    return false;
+  }
+
+  uint32_t required = new_last - new_base + 1;
+  while (capacity < required) {
+    capacity *= 2;
+  }
+
+  // Leave room for further growth in the direction of the new ordinals.
+  if (grow_down) {
+    uint32_t slack = capacity - required;
+    new_base = new_base > slack ? new_base - slack : 0;
+  }
+
+  // Keep the end of the index representable.
+  uint32_t max_base = 0u - capacity;
+  if (new_base > max_base) {
+    new_base = max_base;
+  }
+
+  return ResizeOrdinalIndex(table, new_base, capacity);
+}
+
+// Resolves the given ordinal via the table's in-memory image, if any.
+static bool LookupImageExport(const ModuleExportTable *table, uint32_t ordinal,
+                              uint32_t *address) {
+  if (!IsImageOrdinal(table, ordinal)) {
+    return false;
+  }
+
+  const IMAGE_EXPORT_DIRECTORY *directory = table->image_exports;
+  const uint32_t *functions =
+      (const uint32_t *)(table->image_base + directory->AddressOfFunctions);
+  uint32_t rva = functions[ordinal - directory->Base];
+  if (!rva) {
+    return false;
+  }
+
+  // TODO: Handle forwarded exports.
+  *address = rva + (intptr_t)table->image_base;
+  return true;
+}
+
+// Resolves the given name to an ordinal via the table's in-memory image, if
+// any. The image's name table is sorted, as required by the PE format.
+static bool LookupImageExportByName(const ModuleExportTable *table,
+                                    const char *name, uint32_t *ordinal) {
+  const IMAGE_EXPORT_DIRECTORY *directory = table->image_exports;
+  if (!directory || !directory->NumberOfNames) {
+    return false;
+  }
+
+  const uint32_t *names =
+      (const uint32_t *)(table->image_base + directory->AddressOfNames);
+  const uint16_t *name_ordinals =
+      (const uint16_t *)(table->image_base + directory->AddressOfNameOrdinals);
+  uint32_t low = 0;
+  uint32_t high = directory->NumberOfNames;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    int cmp = strcmp((const char *)(table->image_base + names[mid]), name);
+    if (!cmp) {
+      *ordinal = directory->Base + name_ordinals[mid];
+      return true;
+    }
+    if (cmp < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return false;
+}
+
+// Resolves the given name to an ordinal via the entry at position `hint` in the
+// name table of the table's in-memory image, if any.
+static bool LookupImageExportByHint(const ModuleExportTable *table,
+                                    const char *name, uint32_t hint,
+                                    uint32_t *ordinal) {
+  const IMAGE_EXPORT_DIRECTORY *directory = table->image_exports;
+  if (!directory || hint >= directory->NumberOfNames) {
+    return false;
+  }
+
+  const uint32_t *names =
+      (const uint32_t *)(table->image_base + directory->AddressOfNames);
+  if (strcmp((const char *)(table->image_base + names[hint]), name)) {
+    return false;
+  }
+
+  const uint16_t *name_ordinals =
+      (const uint16_t *)(table->image_base + directory->AddressOfNameOrdinals);
+  *ordinal = directory->Base + name_ordinals[hint];
+  return true;
+}
+
+// Returns the name associated with the given ordinal by the table's in-memory
+// image, or NULL if it is exported by ordinal only.
+static const char *FindImageExportName(const ModuleExportTable *table,
+                                       uint32_t ordinal) {
+  const IMAGE_EXPORT_DIRECTORY *directory = table->image_exports;
+  const uint16_t *name_ordinals =
+      (const uint16_t *)(table->image_base + directory->AddressOfNameOrdinals);
+  for (uint32_t i = 0; i < directory->NumberOfNames; ++i) {
+    if (directory->Base + name_ordinals[i] == ordinal) {
+      const uint32_t *names =
+          (const uint32_t *)(table->image_base + directory->AddressOfNames);
+      return (const char *)(table->image_base + names[i]);
+    }
+  }
+  return NULL;
+}
+
+// FNV-1a hash of the given string.
+static uint32_t HashName(const char *name) {
+  uint32_t hash = 0x811C9DC5;
+  while (*name) {
+    hash ^= (uint8_t)*name++;
+    hash *= 0x01000193;
+  }
+  return hash;
+}
+
+static NameIndexEntry *FindNameIndexEntry(const ModuleExportTable *table,
+                                          const char *name, uint32_t hash) {
+  if (!table->names) {
+    return NULL;
+  }
+
+  uint32_t mask = table->name_capacity - 1;
+  for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+    NameIndexEntry *slot = table->names + i;
+    if (!slot->name) {
+      return NULL;
+    }
+    if (slot->name != kDeletedName && slot->hash == hash &&
+        !strcmp(slot->name, name)) {
+      return slot;
+    }
+  }
+}
+
+static ModuleExport *FindExportByName(const ModuleExportTable *table,
+                                      const char *name) {
+  NameIndexEntry *slot = FindNameIndexEntry(table, name, HashName(name));
+  return slot ? slot->entry : NULL;
+}
+
+// Inserts or replaces the entry for `name`. Returns true if a previously empty
+// slot was consumed. The caller must guarantee that at least one slot is empty.
+static bool InsertNameIndexEntry(NameIndexEntry *names, uint32_t capacity,
+                                 const char *name, uint32_t hash,
+                                 ModuleExport *entry) {
+  uint32_t mask = capacity - 1;
+  NameIndexEntry *target = NULL;
+  for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+    NameIndexEntry *slot = names + i;
+    if (!slot->name) {
+      bool consumed = !target;
+      if (!target) {
+        target = slot;
       }
-      if (n->entry.alias) {
-        DmFreePool(n->entry.alias);
+      target->name = name;
+      target->hash = hash;
+      target->entry = entry;
+      return consumed;
+    }
+
+    if (slot->name == kDeletedName) {
+      if (!target) {
+        target = slot;
       }
-      memcpy(&n->entry, module_export, sizeof(n->entry));
+    } else if (slot->hash == hash && !strcmp(slot->name, name)) {
+      slot->name = name;
+      slot->entry = entry;
+      return false;
+    }
+  }
+}
+
+// Rebuilds the name index with the given capacity, discarding tombstones.
+static bool ResizeNameIndex(ModuleExportTable *table, uint32_t capacity) {
+  NameIndexEntry *names =
+      (NameIndexEntry *)DmAllocatePoolWithTag(capacity * sizeof(*names), kTag);
+  if (!names) {
+    return false;
+  }
+  memset(names, 0, capacity * sizeof(*names));
+
+  for (uint32_t i = 0; i < table->name_capacity; ++i) {
+    NameIndexEntry *slot = table->names + i;
+    if (slot->name && slot->name != kDeletedName) {
+      InsertNameIndexEntry(names, capacity, slot->name, slot->hash,
+                           slot->entry);
+    }
+  }
+
+  if (table->names) {
+    DmFreePool(table->names);
+  }
+  table->names = names;
+  table->name_capacity = capacity;
+  table->name_slots_used = table->num_names;
+  return true;
+}
+
+// Ensures that `count` names may be added to the index without exceeding a 75%
+// load factor.
+static bool ReserveNameIndex(ModuleExportTable *table, uint32_t count) {
+  uint32_t capacity = NAME_INDEX_INITIAL_CAPACITY;
+  if (table->names) {
+    if ((table->name_slots_used + count) * 4 <= table->name_capacity * 3) {
       return true;
     }
-    last = n;
-    n = n->next;
+    // Rebuilding in place is sufficient if the index is mostly tombstones.
+    capacity = table->name_capacity;
   }
 
-  return SetExportEntry(&last->next, module_export);
+  while ((table->num_names + count) * 2 > capacity) {
+    capacity *= 2;
+  }
+  return ResizeNameIndex(table, capacity);
+}
+
+// Adds `name` to the index. ReserveNameIndex must have been called beforehand.
+static void IndexName(ModuleExportTable *table, const char *name,
+                      ModuleExport *entry) {
+  if (!name) {
+    return;
+  }
+
+  uint32_t hash = HashName(name);
+  if (!FindNameIndexEntry(table, name, hash)) {
+    ++table->num_names;
+  }
+  if (InsertNameIndexEntry(table->names, table->name_capacity, name, hash,
+                           entry)) {
+    ++table->name_slots_used;
+  }
 }
 
-static bool SetExportTableEntry(ModuleExportTable **dest,
-                                const char *module_name) {
-  *dest = (ModuleExportTable *)DmAllocatePoolWithTag(sizeof(**dest), kTag);
-  if (!*dest) {
+// Removes `name` from the index if it currently resolves to `entry`. If some
+// other export shares the name, the index is updated to point at it instead.
+static void UnindexName(ModuleExportTable *table, const char *name,
+                        const ModuleExport *entry) {
+  if (!name) {
+    return;
+  }
+
+  NameIndexEntry *slot = FindNameIndexEntry(table, name, HashName(name));
+  if (!slot || slot->entry != entry) {
+    return;
+  }
+
+  ModuleExport *other = NextExport(table, NULL);
+  while (other) {
+    if (other != entry) {
+      if (other->method_name && !strcmp(other->method_name, name)) {
+        slot->name = other->method_name;
+        slot->entry = other;
+        return;
+      }
+      if (other->alias && !strcmp(other->alias, name)) {
+        slot->name = other->alias;
+        slot->entry = other;
+        return;
+      }
+    }
+    other = NextExport(table, other);
+  }
+
+  slot->name = kDeletedName;
+  slot->entry = NULL;
+  --table->num_names;
+}
+
+// Returns the name under which `entry` would appear in the export name table of
+// a PE image. Import libraries generally reference the undecorated alias.
+static const char *HintName(const ModuleExport *entry) {
+  return entry->alias ? entry->alias : entry->method_name;
+}
+
+// Ensures that `count` exports may be added to the hint index.
+static bool ReserveHintIndex(ModuleExportTable *table, uint32_t count) {
+  if (table->num_hints + count <= table->hint_capacity) {
+    return true;
+  }
+
+  uint32_t capacity = table->hint_capacity ? table->hint_capacity
+                                           : HINT_INDEX_INITIAL_CAPACITY;
+  while (table->num_hints + count > capacity) {
+    capacity *= 2;
+  }
+
+  ModuleExport **hints = (ModuleExport **)DmAllocatePoolWithTag(
+      capacity * sizeof(*hints), kTag);
+  if (!hints) {
     return false;
   }
-  (*dest)->next = NULL;
-  (*dest)->module_name = PoolStrdup(module_name, kTag);
-  if (!(*dest)->module_name) {
-    DmFreePool(*dest);
-    *dest = NULL;
+  if (table->hints) {
+    memcpy(hints, table->hints, table->num_hints * sizeof(*hints));
+    DmFreePool(table->hints);
+  }
+  table->hints = hints;
+  table->hint_capacity = capacity;
+  return true;
+}
+
+// Returns the position of the first entry in the hint index whose name is not
+// less than (or, if `upper` is set, greater than) `name`.
+static uint32_t FindHintPosition(const ModuleExportTable *table,
+                                 const char *name, bool upper) {
+  uint32_t low = 0;
+  uint32_t high = table->num_hints;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    int cmp = strcmp(HintName(table->hints[mid]), name);
+    if (cmp < 0 || (upper && !cmp)) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+// Returns true if the entries at `first` and `first + 1` in the hint index
+// share a name.
+static bool SharesHintName(const ModuleExportTable *table, uint32_t first) {
+  return first + 1 < table->num_hints &&
+         !strcmp(HintName(table->hints[first]),
+                 HintName(table->hints[first + 1]));
+}
+
+// Adds `entry` to the hint index. ReserveHintIndex must have been called
+// beforehand.
+static void IndexHint(ModuleExportTable *table, ModuleExport *entry) {
+  const char *name = HintName(entry);
+  if (!name) {
+    return;
+  }
+
+  uint32_t position = FindHintPosition(table, name, true);
+  memmove(table->hints + position + 1, table->hints + position,
+          (table->num_hints - position) * sizeof(*table->hints));
+  table->hints[position] = entry;
+  ++table->num_hints;
+  if (position && SharesHintName(table, position - 1)) {
+    ++table->num_shared_hint_names;
+  }
+}
+
+static void UnindexHint(ModuleExportTable *table, const ModuleExport *entry) {
+  const char *name = HintName(entry);
+  if (!name) {
+    return;
+  }
+
+  uint32_t position = FindHintPosition(table, name, false);
+  while (position < table->num_hints && table->hints[position] != entry) {
+    ++position;
+  }
+  if (position == table->num_hints) {
+    return;
+  }
+
+  // Entries are inserted after any others with the same name, so the removed
+  // entry shares its name with a predecessor unless it is the first of a run,
+  // in which case it shares it with its successor.
+  if ((position && SharesHintName(table, position - 1)) ||
+      SharesHintName(table, position)) {
+    --table->num_shared_hint_names;
+  }
+
+  --table->num_hints;
+  memmove(table->hints + position, table->hints + position + 1,
+          (table->num_hints - position) * sizeof(*table->hints));
+}
+
+static bool IsKnownAs(const ModuleExport *entry, const char *name) {
+  return (entry->method_name && !strcmp(entry->method_name, name)) ||
+         (entry->alias && !strcmp(entry->alias, name));
+}
+
+// Returns the export identified by `hint` if it is known by `name`. The hint is
+// interpreted as a position in the hint index, as specified by the PE format,
+// and failing that as an ordinal, as written by llvm-dlltool for import
+// libraries generated from a .def file. Names shared by several exports are
+// left to the name index, which tracks which of them takes precedence.
+static ModuleExport *FindExportByHint(const ModuleExportTable *table,
+                                      const char *name, uint32_t hint) {
+  if (table->num_shared_hint_names) {
+    return NULL;
+  }
+
+  if (hint < table->num_hints && IsKnownAs(table->hints[hint], name)) {
+    return table->hints[hint];
+  }
+
+  ModuleExport *entry = FindExportByOrdinal(table, hint);
+  if (entry && IsKnownAs(entry, name)) {
+    return entry;
+  }
+  return NULL;
+}
+
+static bool IsStaticExport(const ModuleExportTable *table,
+                           const ModuleExport *entry) {
+  for (const StaticExports *node = table->static_exports; node;
+       node = node->next) {
+    if (entry >= node->exports && entry < node->exports + node->count) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Frees the strings taken over by the given export unless it was registered
+// with MR_FLAG_STATIC. The export itself is reclaimed on reset.
+static void ReleaseExportStrings(const ModuleExportTable *table,
+                                 const ModuleExport *entry) {
+  if (IsStaticExport(table, entry)) {
+    return;
+  }
+  if (entry->method_name) {
+    DmFreePool(entry->method_name);
+  }
+  if (entry->alias && entry->alias != entry->method_name) {
+    DmFreePool(entry->alias);
+  }
+}
+
+static bool AppendExports(ModuleExportTable *table,
+                          const ModuleExport *exports, uint32_t count,
+                          uint32_t flags) {
+  if (!count) {
+    return true;
+  }
+
+  // Perform every allocation up front so that a failure leaves the table
+  // untouched.
+  if (!ReserveNameIndex(table, count * 2) || !ReserveHintIndex(table, count)) {
     return false;
   }
-  (*dest)->exports = NULL;
+
+  uint32_t first = exports[0].ordinal;
+  uint32_t last = first;
+  for (uint32_t i = 1; i < count; ++i) {
+    if (exports[i].ordinal < first) {
+      first = exports[i].ordinal;
+    } else if (exports[i].ordinal > last) {
+      last = exports[i].ordinal;
+    }
+  }
+  if (!IsIndexed(table, first) || !IsIndexed(table, last)) {
+    GrowOrdinalIndex(table, first, last, count);
+  }
+
+  uint32_t num_outliers = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t ordinal = exports[i].ordinal;
+    if (!IsIndexed(table, ordinal) && !FindExportSlot(table, ordinal) &&
+        !GrowOrdinalIndex(table, ordinal, ordinal, count)) {
+      ++num_outliers;
+    }
+  }
+
+  OutlierNode *outliers = NULL;
+  if (num_outliers) {
+    outliers = (OutlierNode *)PoolArenaAllocate(
+        &registry_arena, num_outliers * sizeof(*outliers));
+    if (!outliers) {
+      return false;
+    }
+  }
+
+  ModuleExport *entries;
+  if (flags & MR_FLAG_STATIC) {
+    StaticExports *node = (StaticExports *)PoolArenaAllocate(
+        &registry_arena, sizeof(*node));
+    if (!node) {
+      return false;
+    }
+    node->exports = exports;
+    node->count = count;
+    node->next = table->static_exports;
+    table->static_exports = node;
+    entries = (ModuleExport *)exports;
+  } else {
+    entries = (ModuleExport *)PoolArenaAllocate(&registry_arena,
+                                                count * sizeof(*entries));
+    if (!entries) {
+      return false;
+    }
+    memcpy(entries, exports, count * sizeof(*entries));
+  }
+
+  for (uint32_t i = 0; i < count; ++i) {
+    ModuleExport *entry = entries + i;
+    ModuleExport **slot = FindExportSlot(table, entry->ordinal);
+    if (slot) {
+      // Replace the existing entry. Any storage it occupies in the arena is
+      // retained until the registry is reset.
+      UnindexName(table, (*slot)->method_name, *slot);
+      UnindexName(table, (*slot)->alias, *slot);
+      UnindexHint(table, *slot);
+      ReleaseExportStrings(table, *slot);
+      *slot = entry;
+    } else {
+      if (IsIndexed(table, entry->ordinal)) {
+        table->ordinals[entry->ordinal - table->ordinal_base] = entry;
+      } else {
+        OutlierNode *node = outliers++;
+        node->entry = entry;
+        node->next = table->outliers;
+        table->outliers = node;
+      }
+
+      ++table->num_exports;
+      uint32_t unused;
+      if (LookupImageExport(table, entry->ordinal, &unused)) {
+        ++table->num_shadowed_image_exports;
+      }
+    }
+
+    IndexName(table, entry->method_name, entry);
+    IndexName(table, entry->alias, entry);
+    IndexHint(table, entry);
+  }
 
   return true;
 }
 
-static bool AppendExportTable(const char *module_name,
-                              const ModuleExport *module_export) {
-  ModuleExportTable *e = export_table;
-  if (!e) {
-    if (!SetExportTableEntry(&export_table, module_name)) {
-      return false;
+// Updates the name index and export counts for an export that is about to be
+// unlinked from the table.
+static void RemoveExport(ModuleExportTable *table, ModuleExport *entry) {
+  UnindexName(table, entry->method_name, entry);
+  UnindexName(table, entry->alias, entry);
+  UnindexHint(table, entry);
+  ReleaseExportStrings(table, entry);
+
+  --table->num_exports;
+  uint32_t unused;
+  if (LookupImageExport(table, entry->ordinal, &unused)) {
+    --table->num_shadowed_image_exports;
+  }
+}
+
+static bool InRange(const ModuleExport *entry, uint32_t start, uint32_t end) {
+  return entry->address >= start && entry->address < end;
+}
+
+// Removes every export in the given table whose address lies within
+// [start, end), returning the number of exports removed.
+static uint32_t RemoveExportsInRange(ModuleExportTable *table, uint32_t start,
+                                     uint32_t end) {
+  uint32_t ret = 0;
+  for (uint32_t i = 0; i < table->ordinal_capacity; ++i) {
+    ModuleExport *entry = table->ordinals[i];
+    if (entry && InRange(entry, start, end)) {
+      RemoveExport(table, entry);
+      table->ordinals[i] = NULL;
+      ++ret;
     }
-    return AppendExport(export_table, module_export);
   }
 
-  while (e->next) {
-    e = e->next;
+  OutlierNode **link = &table->outliers;
+  while (*link) {
+    OutlierNode *node = *link;
+    if (InRange(node->entry, start, end)) {
+      RemoveExport(table, node->entry);
+      *link = node->next;
+      ++ret;
+    } else {
+      link = &node->next;
+    }
   }
 
-  if (!SetExportTableEntry(&e->next, module_name)) {
-    return false;
+  return ret;
+}
+
+static ModuleExportTable *FindOrCreateExportTable(const char *module_name) {
+  ModuleExportTable **link = &export_table;
+  while (*link) {
+    if (!strcmp((*link)->module_name, module_name)) {
+      return *link;
+    }
+    link = &(*link)->next;
   }
-  return AppendExport(e->next, module_export);
+
+  ModuleExportTable *table = (ModuleExportTable *)PoolArenaAllocate(
+      &registry_arena, sizeof(*table));
+  if (!table) {
+    return NULL;
+  }
+  memset(table, 0, sizeof(*table));
+  table->module_name = PoolArenaStrdup(&registry_arena, module_name);
+  if (!table->module_name) {
+    return NULL;
+  }
+
+  *link = table;
+  return table;
 }
@@ -26,6 +26,9 @@ typedef struct ModuleExport {
 typedef struct ModuleRegistryCursor {
   void *module_;
   void *export_;
+  uint32_t index_;
+  // Holds exports that are synthesized from a lazily linked module.
+  ModuleExport scratch_;
 } ModuleRegistryCursor;
 
 // Registers the given export for the given module.
@@ -35,6 +38,45 @@ typedef struct ModuleRegistryCursor {
 bool MR_API MRRegisterMethod(const char *module_name,
                              const ModuleExport *module_export);
 
+// Flags for MRRegisterMethods.
+// The export array and every string it references are scoped beyond the
+// lifetime of the registry and must not be modified. Entries are referenced in
+// place rather than copied, and the strings are never freed.
+#define MR_FLAG_STATIC 0x00000001
+
+// Registers `count` exports for the given module in a single pass.
+// Unless MR_FLAG_STATIC is set, the strings within each export are subject to
+// the same ownership rules as MRRegisterMethod and are only taken over if
+// registration succeeds.
+bool MR_API MRRegisterMethods(const char *module_name,
+                              const ModuleExport *exports, uint32_t count,
+                              uint32_t flags);
+
+// Flags for MRRegisterLazyModule.
+// Records exports in the registry as they are resolved.
+#define MR_FLAG_MEMOIZE 0x00000001
+
+// Registers a module whose exports are resolved on demand (by ordinal or by
+// name) from the IMAGE_EXPORT_DIRECTORY of its in-memory image rather than
+// being copied into the registry. `image_base` and `export_directory` must
+// remain valid for the lifetime of the registry or until the module is
+// detached by MRUnregisterAddressRange. Exports registered explicitly for the
+// same module take precedence over the image's export table.
+bool MR_API MRRegisterLazyModule(const char *module_name,
+                                 const void *image_base,
+                                 const void *export_directory, uint32_t flags);
+
+// Records the TimeDateStamp of the loaded build of a registered module so that
+// imports bound against that build by a host tool may be used without being
+// resolved. The timestamp is discarded if exports are subsequently registered
+// for the module, as they may differ from those of the build. Returns false if
+// the module is not registered.
+bool MR_API MRSetModuleTimestamp(const char *module_name, uint32_t timestamp);
+
+// Retrieves the timestamp recorded by MRSetModuleTimestamp. Returns false if
+// the module has no valid timestamp.
+bool MR_API MRGetModuleTimestamp(const char *module_name, uint32_t *timestamp);
+
 // Returns the previously registered address for the given module + ordinal pair
 // (e.g., "xbdm.dll", 30  should return the address of the
 // DmRegisterCommandProcessor method).
@@ -47,9 +89,34 @@ bool MR_API MRGetMethodByOrdinal(const char *module_name, uint32_t ordinal,
 bool MR_API MRGetMethodByName(const char *module_name, const char *name,
                               uint32_t *result);
 
+// Retrieves an opaque handle for the given module that may be used with the
+// *InModule methods to avoid a module lookup per call. The handle is valid
+// until the next call to MRResetRegistry or until the module is removed by
+// MRUnregisterAddressRange.
+bool MR_API MRGetModuleHandle(const char *module_name, void **handle);
+
+// Returns the previously registered address for the given ordinal within the
+// module identified by `handle`.
+bool MR_API MRGetMethodByOrdinalInModule(void *handle, uint32_t ordinal,
+                                         uint32_t *result);
+
+// Returns the previously registered address for the given export name within
+// the module identified by `handle`.
+bool MR_API MRGetMethodByNameInModule(void *handle, const char *name,
+                                      uint32_t *result);
+
+// Behaves like MRGetMethodByNameInModule, but first checks the named export at
+// position `hint` in the module's name table (i.e., the Hint of an
+// IMAGE_IMPORT_BY_NAME), which is ordered like the export name pointer table of
+// a PE image. Falls back to a full lookup if the hint is stale.
+bool MR_API MRGetMethodByNameWithHintInModule(void *handle, const char *name,
+                                              uint32_t hint, uint32_t *result);
+
 // WARNING: These methods are intended to be called without any concurrent
 // modification to the registry. Concurrent mutation may lead to incorrect data
 // or crashes.
+// Exports of lazily linked modules are included. Exports returned by
+// MREnumerateRegistry are only valid until the next call with the same cursor.
 uint32_t MR_API MRGetNumRegisteredModules(void);
 uint32_t MR_API MRGetTotalNumExports(void);
 void MR_API MREnumerateRegistryBegin(ModuleRegistryCursor *cursor);
@@ -57,6 +124,15 @@ bool MR_API MREnumerateRegistry(const char **module_name,
                                 const ModuleExport **module_export,
                                 ModuleRegistryCursor *cursor);
 
+// Removes every explicitly registered export whose address lies within
+// [start, end) and detaches any lazily linked module whose image starts within
+// that range. Modules that are left without exports are removed entirely.
+// Returns the number of explicitly registered exports that were removed.
+//
+// Arena storage used by the removed exports is retained until the next call to
+// MRResetRegistry.
+uint32_t MR_API MRUnregisterAddressRange(uint32_t start, uint32_t end);
+
 void MR_API MRResetRegistry(void);
 
 #ifdef __cplusplus
@@ -43,7 +43,11 @@ HRESULT __attribute__((dllexport, no_stack_protector, stdcall)) DXTMainCRTStartu
   return DXTMain();
 }
 
-void DLLMainShutdown(void) { _PDCLIB_xbox_libc_deinit(); }
+// Invoked by the loader via `ddxt!unload` before the image is freed. Exported
+// by name so that the loader can locate it (see plugin_table.h).
+void __attribute__((dllexport)) DLLMainShutdown(void) {
+  _PDCLIB_xbox_libc_deinit();
+}
 
 #ifdef __cplusplus
 };  // extern "C"
@@ -0,0 +1,374 @@
+#include "plugin_table.h"
+
+#include <string.h>
+
+#include "winapi/winnt.h"
+#include "xbdm.h"
+
+static const uint32_t kTag = 0x64647870;  // 'ddxp'
+
+// Records that `importer` imported from the exports of `provider` when it was
+// loaded.
+typedef struct PluginDependency {
+  struct PluginDependency *next;
+  const LoadedPlugin *importer;
+  const LoadedPlugin *provider;
+} PluginDependency;
+
+static LoadedPlugin *plugins = NULL;
+static PluginCommandProcessor *command_processors = NULL;
+static PluginDependency *dependencies = NULL;
+
+// Returns a pointer to `size` bytes at `rva` within the image, or NULL if the
+// range is outside of the image.
+static const void *ImageRange(const LoadedPlugin *plugin, uint32_t rva,
+                              uint32_t size) {
+  if (rva > plugin->image_size || size > plugin->image_size - rva) {
+    return NULL;
+  }
+  return plugin->image + rva;
+}
+
+// Returns the image's data directory with the given index, or NULL if it has
+// none.
+static const IMAGE_DATA_DIRECTORY *FindDataDirectory(const LoadedPlugin *plugin,
+                                                     uint32_t index) {
+  const IMAGE_DOS_HEADER *dos_header =
+      ImageRange(plugin, 0, sizeof(IMAGE_DOS_HEADER));
+  if (!dos_header || dos_header->e_magic != IMAGE_DOS_SIGNATURE) {
+    return NULL;
+  }
+
+  const IMAGE_NT_HEADERS32 *nt_header =
+      ImageRange(plugin, dos_header->e_lfanew, sizeof(IMAGE_NT_HEADERS32));
+  if (!nt_header || nt_header->Signature != IMAGE_NT_SIGNATURE) {
+    return NULL;
+  }
+
+  const IMAGE_DATA_DIRECTORY *directory_info =
+      nt_header->OptionalHeader.DataDirectory + index;
+  return directory_info->Size ? directory_info : NULL;
+}
+
+// Returns the image's export directory, or NULL if it has none.
+static const IMAGE_EXPORT_DIRECTORY *FindExportDirectory(
+    const LoadedPlugin *plugin) {
+  const IMAGE_DATA_DIRECTORY *directory_info =
+      FindDataDirectory(plugin, IMAGE_DIRECTORY_ENTRY_EXPORT);
+  if (!directory_info) {
+    return NULL;
+  }
+  return ImageRange(plugin, directory_info->VirtualAddress,
+                    sizeof(IMAGE_EXPORT_DIRECTORY));
+}
+
+// Returns the NUL-terminated string at `rva`, or NULL if it does not lie
+// entirely within the image.
+static const char *ImageString(const LoadedPlugin *plugin, uint32_t rva) {
+  const char *ret = ImageRange(plugin, rva, 1);
+  if (ret && !memchr(ret, 0, plugin->image_size - rva)) {
+    return NULL;
+  }
+  return ret;
+}
+
+// Resolves the named export via the image's export directory. Returns 0 if the
+// image does not export the given name.
+static uint32_t FindExportByName(const LoadedPlugin *plugin, const char *name) {
+  const IMAGE_EXPORT_DIRECTORY *directory = FindExportDirectory(plugin);
+  if (!directory) {
+    return 0;
+  }
+
+  const uint32_t *names =
+      ImageRange(plugin, directory->AddressOfNames,
+                 directory->NumberOfNames * sizeof(uint32_t));
+  const uint16_t *name_ordinals =
+      ImageRange(plugin, directory->AddressOfNameOrdinals,
+                 directory->NumberOfNames * sizeof(uint16_t));
+  const uint32_t *functions =
+      ImageRange(plugin, directory->AddressOfFunctions,
+                 directory->NumberOfFunctions * sizeof(uint32_t));
+  if (!names || !name_ordinals || !functions) {
+    return 0;
+  }
+
+  for (uint32_t i = 0; i < directory->NumberOfNames; ++i) {
+    const char *export_name = ImageString(plugin, names[i]);
+    if (!export_name || strcmp(export_name, name)) {
+      continue;
+    }
+
+    uint16_t index = name_ordinals[i];
+    if (index >= directory->NumberOfFunctions || !functions[index]) {
+      return 0;
+    }
+    return (uint32_t)(intptr_t)plugin->image + functions[index];
+  }
+
+  return 0;
+}
+
+static void SetImage(LoadedPlugin *plugin, void *image, uint32_t image_size,
+                     uint32_t entrypoint) {
+  plugin->image = (uint8_t *)image;
+  plugin->image_size = image_size;
+  plugin->entrypoint = entrypoint;
+  plugin->shutdown = FindExportByName(plugin, PLUGIN_SHUTDOWN_EXPORT_NAME);
+}
+
+// Returns the DLL name from the image's export directory, or an empty string.
+static const char *GetImageName(const LoadedPlugin *plugin) {
+  const IMAGE_EXPORT_DIRECTORY *directory = FindExportDirectory(plugin);
+  const char *name = directory ? ImageString(plugin, directory->Name) : NULL;
+  return name ? name : "";
+}
+
+const char *PTGetImageName(const void *image, uint32_t image_size) {
+  LoadedPlugin probe;
+  probe.image = (uint8_t *)image;
+  probe.image_size = image_size;
+  return GetImageName(&probe);
+}
+
+static bool HasDependency(const LoadedPlugin *importer,
+                          const LoadedPlugin *provider) {
+  for (PluginDependency *dependency = dependencies; dependency;
+       dependency = dependency->next) {
+    if (dependency->importer == importer && dependency->provider == provider) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Records a dependency of `importer` on each loaded plugin named by the import
+// directory of its image. Returns false if allocation fails.
+static bool AddDependencies(const LoadedPlugin *importer) {
+  const IMAGE_DATA_DIRECTORY *directory_info =
+      FindDataDirectory(importer, IMAGE_DIRECTORY_ENTRY_IMPORT);
+  if (!directory_info) {
+    return true;
+  }
+
+  uint32_t rva = directory_info->VirtualAddress;
+  const IMAGE_IMPORT_DESCRIPTOR *descriptor;
+  while ((descriptor = ImageRange(importer, rva, sizeof(*descriptor))) &&
+         descriptor->Name) {
+    rva += sizeof(*descriptor);
+    const char *name = ImageString(importer, descriptor->Name);
+    const LoadedPlugin *provider = name ? PTFindPluginByName(name) : NULL;
+    if (!provider || provider == importer ||
+        HasDependency(importer, provider)) {
+      continue;
+    }
+
+    PluginDependency *dependency = (PluginDependency *)DmAllocatePoolWithTag(
+        sizeof(*dependency), kTag);
+    if (!dependency) {
+      return false;
+    }
+    dependency->importer = importer;
+    dependency->provider = provider;
+    dependency->next = dependencies;
+    dependencies = dependency;
+  }
+  return true;
+}
+
+// Removes the dependencies of `importer`, as well as any dependencies on
+// `provider`. Either may be NULL.
+static void RemoveDependencies(const LoadedPlugin *importer,
+                               const LoadedPlugin *provider) {
+  PluginDependency **link = &dependencies;
+  while (*link) {
+    PluginDependency *dependency = *link;
+    if ((importer && dependency->importer == importer) ||
+        (provider && dependency->provider == provider)) {
+      *link = dependency->next;
+      DmFreePool(dependency);
+    } else {
+      link = &dependency->next;
+    }
+  }
+}
+
+LoadedPlugin *PTAddPlugin(void *image, uint32_t image_size,
+                          uint32_t entrypoint) {
+  LoadedPlugin probe;
+  SetImage(&probe, image, image_size, entrypoint);
+  const char *name = GetImageName(&probe);
+
+  // The name is stored inline after the record.
+  uint32_t name_len = strlen(name) + 1;
+  LoadedPlugin *plugin =
+      (LoadedPlugin *)DmAllocatePoolWithTag(sizeof(*plugin) + name_len, kTag);
+  if (!plugin) {
+    return NULL;
+  }
+
+  *plugin = probe;
+  plugin->name = (char *)(plugin + 1);
+  memcpy(plugin->name, name, name_len);
+  plugin->pins = 0;
+  plugin->closing = false;
+
+  // Dependencies are recorded before the plugin is added so that an image that
+  // shares the name of one it imports from is not taken to depend on itself.
+  if (!AddDependencies(plugin)) {
+    RemoveDependencies(plugin, NULL);
+    DmFreePool(plugin);
+    return NULL;
+  }
+
+  plugin->next = plugins;
+  plugins = plugin;
+  return plugin;
+}
+
+bool PTReplacePluginImage(LoadedPlugin *plugin, void *image,
+                          uint32_t image_size, uint32_t entrypoint) {
+  SetImage(plugin, image, image_size, entrypoint);
+  RemoveDependencies(plugin, NULL);
+  return AddDependencies(plugin);
+}
+
+LoadedPlugin *PTFindPlugin(uint32_t image_base) {
+  for (LoadedPlugin *plugin = plugins; plugin; plugin = plugin->next) {
+    if ((uint32_t)(intptr_t)plugin->image == image_base) {
+      return plugin;
+    }
+  }
+  return NULL;
+}
+
+LoadedPlugin *PTFindPluginByName(const char *name) {
+  for (LoadedPlugin *plugin = plugins; plugin; plugin = plugin->next) {
+    if (*plugin->name && !strcmp(plugin->name, name)) {
+      return plugin;
+    }
+  }
+  return NULL;
+}
+
+const LoadedPlugin *PTFindDependent(const LoadedPlugin *provider) {
+  for (PluginDependency *dependency = dependencies; dependency;
+       dependency = dependency->next) {
+    if (dependency->provider == provider) {
+      return dependency->importer;
+    }
+  }
+  return NULL;
+}
+
+LoadedPlugin *PTFindPluginContaining(uint32_t address) {
+  for (LoadedPlugin *plugin = plugins; plugin; plugin = plugin->next) {
+    uint32_t start = (uint32_t)(intptr_t)plugin->image;
+    if (address >= start && address - start < plugin->image_size) {
+      return plugin;
+    }
+  }
+  return NULL;
+}
+
+void PTRemovePlugin(LoadedPlugin *plugin) {
+  LoadedPlugin **link = &plugins;
+  while (*link && *link != plugin) {
+    link = &(*link)->next;
+  }
+  if (*link) {
+    *link = plugin->next;
+  }
+
+  PluginCommandProcessor **processor_link = &command_processors;
+  while (*processor_link) {
+    PluginCommandProcessor *processor = *processor_link;
+    if (processor->owner == plugin) {
+      *processor_link = processor->next;
+      DmFreePool(processor);
+    } else {
+      processor_link = &processor->next;
+    }
+  }
+
+  RemoveDependencies(plugin, plugin);
+  DmFreePool(plugin);
+}
+
+uint32_t PTGetNumPlugins(void) {
+  uint32_t ret = 0;
+  for (LoadedPlugin *plugin = plugins; plugin; plugin = plugin->next) {
+    ++ret;
+  }
+  return ret;
+}
+
+PluginCommandProcessor *PTAddCommandProcessor(LoadedPlugin *owner,
+                                              const char *prefix,
+                                              ProcessorProc proc) {
+  // The prefix is stored inline after the record.
+  uint32_t prefix_len = strlen(prefix) + 1;
+  PluginCommandProcessor *processor = (PluginCommandProcessor *)
+      DmAllocatePoolWithTag(sizeof(*processor) + prefix_len, kTag);
+  if (!processor) {
+    return NULL;
+  }
+  processor->owner = owner;
+  processor->proc = proc;
+  processor->prefix = (char *)(processor + 1);
+  memcpy(processor->prefix, prefix, prefix_len);
+
+  processor->next = command_processors;
+  command_processors = processor;
+  return processor;
+}
+
+static char ToLower(char c) {
+  return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+// Returns true if `prefix` matches the start of `str` and is followed by
+// `terminator`, ignoring case.
+static bool MatchPrefix(const char *prefix, const char *str, char terminator) {
+  while (*prefix) {
+    if (ToLower(*prefix++) != ToLower(*str++)) {
+      return false;
+    }
+  }
+  return *str == terminator;
+}
+
+PluginCommandProcessor *PTFindCommandProcessor(const char *prefix) {
+  for (PluginCommandProcessor *processor = command_processors; processor;
+       processor = processor->next) {
+    if (MatchPrefix(processor->prefix, prefix, 0)) {
+      return processor;
+    }
+  }
+  return NULL;
+}
+
+PluginCommandProcessor *PTFindCommandProcessorForCommand(const char *command) {
+  for (PluginCommandProcessor *processor = command_processors; processor;
+       processor = processor->next) {
+    if (MatchPrefix(processor->prefix, command, '!')) {
+      return processor;
+    }
+  }
+  return NULL;
+}
+
+PluginCommandProcessor *PTGetCommandProcessors(void) {
+  return command_processors;
+}
+
+void PTRemoveCommandProcessor(PluginCommandProcessor *processor) {
+  PluginCommandProcessor **link = &command_processors;
+  while (*link && *link != processor) {
+    link = &(*link)->next;
+  }
+  if (*link) {
+    *link = processor->next;
+    DmFreePool(processor);
+  }
+}
@@ -0,0 +1,108 @@
+#ifndef DYNDXT_LOADER_PLUGIN_TABLE_H
+#define DYNDXT_LOADER_PLUGIN_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "xbdm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Name of the optional export invoked before a plugin is unloaded.
+#define PLUGIN_SHUTDOWN_EXPORT_NAME "DLLMainShutdown"
+
+// A plugin image that has been loaded and whose entrypoint has been invoked.
+typedef struct LoadedPlugin {
+  struct LoadedPlugin *next;
+  // The relocated image, allocated via DmAllocatePoolWithTag.
+  uint8_t *image;
+  uint32_t image_size;
+  uint32_t entrypoint;
+  // Address of the image's shutdown hook, or 0 if it does not export one.
+  uint32_t shutdown;
+  // The DLL name from the image's export directory, or an empty string.
+  char *name;
+  // Number of handlers in the image that the loader is running without holding
+  // its lock. The image may not be freed or replaced while this is nonzero.
+  uint32_t pins;
+  // Set by the loader while the plugin is being unloaded or replaced, during
+  // which it may not be pinned.
+  bool closing;
+} LoadedPlugin;
+
+// A command processor registered by a plugin. XBDM dispatches the prefix to a
+// loader-owned trampoline that forwards to `proc`, allowing the implementation
+// to be replaced without unregistering the prefix.
+typedef struct PluginCommandProcessor {
+  struct PluginCommandProcessor *next;
+  LoadedPlugin *owner;
+  // Handler within the owner's image. NULL while the owner is being replaced.
+  ProcessorProc proc;
+  char *prefix;
+} PluginCommandProcessor;
+
+// Adds a plugin to the table, locating its name and shutdown hook via the
+// export table in the image's headers (if present). Each loaded plugin named by
+// the image's import directory is recorded as a dependency. Returns NULL if
+// allocation fails.
+LoadedPlugin *PTAddPlugin(void *image, uint32_t image_size,
+                          uint32_t entrypoint);
+
+// Returns the DLL name from the export directory of the given image, as
+// recorded by PTAddPlugin, or an empty string if it has none.
+const char *PTGetImageName(const void *image, uint32_t image_size);
+
+// Replaces the image of an existing plugin, locating the new image's shutdown
+// hook and recording its dependencies in place of those of the old image. The
+// plugin's name and command processors are retained. Returns false if the new
+// dependencies could not all be recorded.
+bool PTReplacePluginImage(LoadedPlugin *plugin, void *image,
+                          uint32_t image_size, uint32_t entrypoint);
+
+// Returns the plugin whose image starts at the given address, or NULL.
+LoadedPlugin *PTFindPlugin(uint32_t image_base);
+
+// Returns the plugin with the given DLL name, or NULL.
+LoadedPlugin *PTFindPluginByName(const char *name);
+
+// Returns a plugin that imported from `provider` when it was loaded, or NULL if
+// none did.
+const LoadedPlugin *PTFindDependent(const LoadedPlugin *provider);
+
+// Returns the plugin whose image contains the given address, or NULL.
+LoadedPlugin *PTFindPluginContaining(uint32_t address);
+
+// Removes the given plugin, any command processors it owns, and any
+// dependencies to or from it from the table and frees their bookkeeping. The
+// image itself is not freed.
+void PTRemovePlugin(LoadedPlugin *plugin);
+
+uint32_t PTGetNumPlugins(void);
+
+// Records that `owner` handles commands with the given prefix via `proc`.
+// Returns NULL if allocation fails.
+PluginCommandProcessor *PTAddCommandProcessor(LoadedPlugin *owner,
+                                              const char *prefix,
+                                              ProcessorProc proc);
+
+// Returns the processor registered for `prefix`, or NULL. Prefixes are
+// compared case-insensitively.
+PluginCommandProcessor *PTFindCommandProcessor(const char *prefix);
+
+// Returns the processor responsible for the given "<prefix>!<command>" string,
+// or NULL.
+PluginCommandProcessor *PTFindCommandProcessorForCommand(const char *command);
+
+// Returns the first registered processor. The remainder may be visited via
+// `next`.
+PluginCommandProcessor *PTGetCommandProcessors(void);
+
+void PTRemoveCommandProcessor(PluginCommandProcessor *processor);
+
+#ifdef __cplusplus
+};  // extern "C"
+#endif
+
+#endif  // DYNDXT_LOADER_PLUGIN_TABLE_H
@@ -0,0 +1,93 @@
+#include "pool_arena.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "xbdm.h"
+
+#define ARENA_ALIGNMENT 4
+
+typedef struct PoolArenaChunk {
+  struct PoolArenaChunk *next;
+  uint32_t used;
+  uint32_t size;
+} PoolArenaChunk;
+
+// Allocations begin immediately after the chunk header.
+#define CHUNK_DATA(chunk) ((uint8_t *)((chunk) + 1))
+
+void PoolArenaInit(PoolArena *arena, uint32_t chunk_size, uint32_t tag) {
+  arena->chunks = NULL;
+  arena->chunk_size = chunk_size;
+  arena->tag = tag;
+}
+
+static PoolArenaChunk *AllocateChunk(PoolArena *arena, uint32_t size) {
+  PoolArenaChunk *chunk = (PoolArenaChunk *)DmAllocatePoolWithTag(
+      sizeof(*chunk) + size, arena->tag);
+  if (!chunk) {
+    return NULL;
+  }
+  chunk->used = 0;
+  chunk->size = size;
+  return chunk;
+}
+
+void *PoolArenaAllocate(PoolArena *arena, uint32_t size) {
+  size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+  PoolArenaChunk *chunk = arena->chunks;
+  if (chunk && chunk->size - chunk->used >= size) {
+    void *ret = CHUNK_DATA(chunk) + chunk->used;
+    chunk->used += size;
+    return ret;
+  }
+
+  if (size > arena->chunk_size) {
+    // Oversized requests get a dedicated chunk that is placed behind the
+    // current chunk so that the remaining space in the latter is not lost.
+    chunk = AllocateChunk(arena, size);
+    if (!chunk) {
+      return NULL;
+    }
+    chunk->used = size;
+    if (arena->chunks) {
+      chunk->next = arena->chunks->next;
+      arena->chunks->next = chunk;
+    } else {
+      chunk->next = NULL;
+      arena->chunks = chunk;
+    }
+    return CHUNK_DATA(chunk);
+  }
+
+  chunk = AllocateChunk(arena, arena->chunk_size);
+  if (!chunk) {
+    return NULL;
+  }
+  chunk->used = size;
+  chunk->next = arena->chunks;
+  arena->chunks = chunk;
+  return CHUNK_DATA(chunk);
+}
+
+char *PoolArenaStrdup(PoolArena *arena, const char *source) {
+  uint32_t size = strlen(source) + 1;
+  char *ret = (char *)PoolArenaAllocate(arena, size);
+  if (!ret) {
+    return ret;
+  }
+
+  memcpy(ret, source, size);
+  return ret;
+}
+
+void PoolArenaReset(PoolArena *arena) {
+  PoolArenaChunk *chunk = arena->chunks;
+  while (chunk) {
+    PoolArenaChunk *chunk_delete = chunk;
+    chunk = chunk->next;
+    DmFreePool(chunk_delete);
+  }
+  arena->chunks = NULL;
+}
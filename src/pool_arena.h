@@ -0,0 +1,39 @@
+#ifndef DYNDXT_LOADER_POOL_ARENA_H
+#define DYNDXT_LOADER_POOL_ARENA_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct PoolArenaChunk;
+
+// Bump allocator that carves small allocations out of large DmAllocatePool
+// chunks. Individual allocations may not be freed; all memory is released at
+// once by PoolArenaReset.
+typedef struct PoolArena {
+  struct PoolArenaChunk *chunks;
+  uint32_t chunk_size;
+  uint32_t tag;
+} PoolArena;
+
+// Initializes an empty arena. No memory is allocated until the first call to
+// PoolArenaAllocate.
+void PoolArenaInit(PoolArena *arena, uint32_t chunk_size, uint32_t tag);
+
+// Returns a block of at least `size` bytes, aligned to 4 bytes. Requests larger
+// than the arena's chunk size are given a dedicated chunk.
+void *PoolArenaAllocate(PoolArena *arena, uint32_t size);
+
+// Copies the given string into the arena.
+char *PoolArenaStrdup(PoolArena *arena, const char *source);
+
+// Frees every chunk owned by the arena, invalidating all allocations.
+void PoolArenaReset(PoolArena *arena);
+
+#ifdef __cplusplus
+};  // extern "C"
+#endif
+
+#endif  // DYNDXT_LOADER_POOL_ARENA_H
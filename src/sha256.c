@@ -0,0 +1,134 @@
+#include "sha256.h"
+
+#include <string.h>
+
+static const uint32_t kRoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void ProcessBlock(SHA256Context *ctx, const uint8_t *block) {
+  uint32_t w[64];
+  for (uint32_t i = 0; i < 16; ++i) {
+    w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+           ((uint32_t)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+  }
+  for (uint32_t i = 16; i < 64; ++i) {
+    uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = ctx->state[0];
+  uint32_t b = ctx->state[1];
+  uint32_t c = ctx->state[2];
+  uint32_t d = ctx->state[3];
+  uint32_t e = ctx->state[4];
+  uint32_t f = ctx->state[5];
+  uint32_t g = ctx->state[6];
+  uint32_t h = ctx->state[7];
+
+  for (uint32_t i = 0; i < 64; ++i) {
+    uint32_t s1 = ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25);
+    uint32_t ch = (e & f) ^ (~e & g);
+    uint32_t t1 = h + s1 + ch + kRoundConstants[i] + w[i];
+    uint32_t s0 = ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22);
+    uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+    uint32_t t2 = s0 + maj;
+
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+
+  ctx->state[0] += a;
+  ctx->state[1] += b;
+  ctx->state[2] += c;
+  ctx->state[3] += d;
+  ctx->state[4] += e;
+  ctx->state[5] += f;
+  ctx->state[6] += g;
+  ctx->state[7] += h;
+}
+
+void SHA256Init(SHA256Context *ctx) {
+  ctx->state[0] = 0x6a09e667;
+  ctx->state[1] = 0xbb67ae85;
+  ctx->state[2] = 0x3c6ef372;
+  ctx->state[3] = 0xa54ff53a;
+  ctx->state[4] = 0x510e527f;
+  ctx->state[5] = 0x9b05688c;
+  ctx->state[6] = 0x1f83d9ab;
+  ctx->state[7] = 0x5be0cd19;
+  ctx->total_bytes = 0;
+  ctx->block_used = 0;
+}
+
+void SHA256Update(SHA256Context *ctx, const void *data, uint32_t size) {
+  const uint8_t *read_ptr = (const uint8_t *)data;
+  ctx->total_bytes += size;
+
+  if (ctx->block_used) {
+    uint32_t needed = sizeof(ctx->block) - ctx->block_used;
+    uint32_t copy_size = size < needed ? size : needed;
+    memcpy(ctx->block + ctx->block_used, read_ptr, copy_size);
+    ctx->block_used += copy_size;
+    read_ptr += copy_size;
+    size -= copy_size;
+    if (ctx->block_used < sizeof(ctx->block)) {
+      return;
+    }
+    ProcessBlock(ctx, ctx->block);
+    ctx->block_used = 0;
+  }
+
+  while (size >= sizeof(ctx->block)) {
+    ProcessBlock(ctx, read_ptr);
+    read_ptr += sizeof(ctx->block);
+    size -= sizeof(ctx->block);
+  }
+
+  memcpy(ctx->block, read_ptr, size);
+  ctx->block_used = size;
+}
+
+void SHA256Final(SHA256Context *ctx, uint8_t digest[SHA256_DIGEST_SIZE]) {
+  uint64_t total_bits = ctx->total_bytes * 8;
+
+  ctx->block[ctx->block_used++] = 0x80;
+  if (ctx->block_used > sizeof(ctx->block) - sizeof(total_bits)) {
+    memset(ctx->block + ctx->block_used, 0,
+           sizeof(ctx->block) - ctx->block_used);
+    ProcessBlock(ctx, ctx->block);
+    ctx->block_used = 0;
+  }
+  memset(ctx->block + ctx->block_used, 0,
+         sizeof(ctx->block) - sizeof(total_bits) - ctx->block_used);
+  for (uint32_t i = 0; i < sizeof(total_bits); ++i) {
+    ctx->block[sizeof(ctx->block) - 1 - i] = (uint8_t)(total_bits >> (i * 8));
+  }
+  ProcessBlock(ctx, ctx->block);
+
+  for (uint32_t i = 0; i < 8; ++i) {
+    digest[i * 4] = (uint8_t)(ctx->state[i] >> 24);
+    digest[i * 4 + 1] = (uint8_t)(ctx->state[i] >> 16);
+    digest[i * 4 + 2] = (uint8_t)(ctx->state[i] >> 8);
+    digest[i * 4 + 3] = (uint8_t)ctx->state[i];
+  }
+}
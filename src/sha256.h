@@ -0,0 +1,33 @@
+#ifndef DYNDXT_LOADER_SHA256_H
+#define DYNDXT_LOADER_SHA256_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHA256_DIGEST_SIZE 32
+
+// Incremental SHA-256 state.
+typedef struct SHA256Context {
+  uint32_t state[8];
+  uint64_t total_bytes;
+  uint8_t block[64];
+  uint32_t block_used;
+} SHA256Context;
+
+void SHA256Init(SHA256Context *ctx);
+
+// Hashes the next `size` bytes of the message.
+void SHA256Update(SHA256Context *ctx, const void *data, uint32_t size);
+
+// Completes the hash and writes the digest to `digest`. The context must be
+// reinitialized before it may be reused.
+void SHA256Final(SHA256Context *ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+#ifdef __cplusplus
+};  // extern "C"
+#endif
+
+#endif  // DYNDXT_LOADER_SHA256_H
@@ -0,0 +1,207 @@
+#include "upload_manager.h"
+
+#include <string.h>
+
+#include "xbdm.h"
+
+static const uint32_t kTag = 0x64647875;  // 'ddxu'
+
+#define BITS_PER_WORD 32
+
+static Upload *uploads = NULL;
+static uint32_t next_id = 1;
+
+static bool IsReceived(const Upload *upload, uint32_t block) {
+  return (upload->received[block / BITS_PER_WORD] &
+          (1u << (block % BITS_PER_WORD))) != 0;
+}
+
+static void MarkReceived(Upload *upload, uint32_t block) {
+  if (!IsReceived(upload, block)) {
+    upload->received[block / BITS_PER_WORD] |= 1u << (block % BITS_PER_WORD);
+    ++upload->num_received_blocks;
+  }
+}
+
+static uint32_t BlockSize(const Upload *upload, uint32_t block) {
+  if (block + 1 < upload->num_blocks) {
+    return UPLOAD_BLOCK_SIZE;
+  }
+  return upload->size - block * UPLOAD_BLOCK_SIZE;
+}
+
+Upload *UMBegin(uint32_t size, uint32_t now) {
+  if (!size) {
+    return NULL;
+  }
+
+  uint32_t num_blocks = (size + UPLOAD_BLOCK_SIZE - 1) / UPLOAD_BLOCK_SIZE;
+  uint32_t bitmap_size =
+      (num_blocks + BITS_PER_WORD - 1) / BITS_PER_WORD * sizeof(uint32_t);
+  Upload *upload = DmAllocatePoolWithTag(sizeof(*upload) + bitmap_size, kTag);
+  if (!upload) {
+    return NULL;
+  }
+  upload->data = DmAllocatePoolWithTag(size, kTag);
+  if (!upload->data) {
+    DmFreePool(upload);
+    return NULL;
+  }
+
+  upload->id = next_id++;
+  upload->size = size;
+  upload->last_activity = now;
+  upload->num_blocks = num_blocks;
+  upload->num_received_blocks = 0;
+  upload->received = (uint32_t *)(upload + 1);
+  memset(upload->received, 0, bitmap_size);
+  upload->num_writers = 0;
+  upload->released = false;
+  upload->flags = 0;
+
+  upload->next = uploads;
+  uploads = upload;
+  return upload;
+}
+
+Upload *UMFind(uint32_t id) {
+  for (Upload *upload = uploads; upload; upload = upload->next) {
+    if (upload->id == id) {
+      return upload;
+    }
+  }
+  return NULL;
+}
+
+static void FreeUpload(Upload *upload) {
+  DmFreePool(upload->data);
+  DmFreePool(upload);
+}
+
+uint8_t *UMBeginWrite(Upload *upload, uint32_t run_start, uint32_t offset,
+                      uint32_t size) {
+  if (run_start % UPLOAD_BLOCK_SIZE || run_start > offset ||
+      offset > upload->size || size > upload->size - offset) {
+    return NULL;
+  }
+  ++upload->num_writers;
+  return upload->data + offset;
+}
+
+bool UMEndWrite(Upload *upload, uint32_t run_start, uint32_t end,
+                uint32_t now) {
+  --upload->num_writers;
+  if (upload->released) {
+    if (!upload->num_writers) {
+      FreeUpload(upload);
+    }
+    return false;
+  }
+
+  upload->last_activity = now;
+  if (UMIsComplete(upload)) {
+    return false;
+  }
+
+  // Walk back from the end of the run to the first block that is not yet
+  // marked, as earlier writes of the run will have marked the rest.
+  uint32_t first = run_start / UPLOAD_BLOCK_SIZE;
+  uint32_t block = end / UPLOAD_BLOCK_SIZE;
+  if (block >= upload->num_blocks) {
+    block = upload->num_blocks - 1;
+  }
+  while (block > first && !IsReceived(upload, block - 1)) {
+    --block;
+  }
+  for (; block < upload->num_blocks; ++block) {
+    uint32_t block_end = block * UPLOAD_BLOCK_SIZE + BlockSize(upload, block);
+    if (block_end > end) {
+      break;
+    }
+    MarkReceived(upload, block);
+  }
+  return UMIsComplete(upload);
+}
+
+bool UMWrite(Upload *upload, uint32_t run_start, uint32_t offset,
+             const void *data, uint32_t size, uint32_t now) {
+  uint8_t *dest = UMBeginWrite(upload, run_start, offset, size);
+  if (!dest) {
+    return false;
+  }
+  memcpy(dest, data, size);
+  UMEndWrite(upload, run_start, offset + size, now);
+  return true;
+}
+
+bool UMIsComplete(const Upload *upload) {
+  return upload->num_received_blocks == upload->num_blocks;
+}
+
+uint32_t UMGetReceivedSize(const Upload *upload) {
+  uint32_t ret = upload->num_received_blocks * UPLOAD_BLOCK_SIZE;
+  uint32_t last_block = upload->num_blocks - 1;
+  if (IsReceived(upload, last_block)) {
+    ret -= UPLOAD_BLOCK_SIZE - BlockSize(upload, last_block);
+  }
+  return ret;
+}
+
+bool UMFindMissingRange(const Upload *upload, uint32_t start, uint32_t *offset,
+                        uint32_t *size) {
+  uint32_t block = start / UPLOAD_BLOCK_SIZE;
+  while (block < upload->num_blocks && IsReceived(upload, block)) {
+    ++block;
+  }
+  if (block >= upload->num_blocks) {
+    return false;
+  }
+
+  uint32_t first = block;
+  while (block < upload->num_blocks && !IsReceived(upload, block)) {
+    ++block;
+  }
+
+  *offset = first * UPLOAD_BLOCK_SIZE;
+  uint32_t end = block * UPLOAD_BLOCK_SIZE;
+  if (end > upload->size) {
+    end = upload->size;
+  }
+  *size = end - *offset;
+  return true;
+}
+
+void UMRelease(Upload *upload) {
+  for (Upload **prev = &uploads; *prev; prev = &(*prev)->next) {
+    if (*prev == upload) {
+      *prev = upload->next;
+      break;
+    }
+  }
+
+  if (upload->num_writers) {
+    upload->released = true;
+    return;
+  }
+  FreeUpload(upload);
+}
+
+uint32_t UMReclaimStale(uint32_t now, uint32_t timeout) {
+  uint32_t ret = 0;
+  Upload *upload = uploads;
+  while (upload) {
+    Upload *next = upload->next;
+    if (now - upload->last_activity > timeout) {
+      UMRelease(upload);
+      ++ret;
+    }
+    upload = next;
+  }
+  return ret;
+}
+
+void UMReset(void) {
+  while (uploads) {
+    UMRelease(uploads);
+  }
+}
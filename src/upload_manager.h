@@ -0,0 +1,95 @@
+#ifndef DYNDXT_LOADER_UPLOAD_MANAGER_H
+#define DYNDXT_LOADER_UPLOAD_MANAGER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Granularity at which received data is tracked. Parts must start on a block
+// boundary.
+#define UPLOAD_BLOCK_SIZE 0x1000
+
+// Number of milliseconds after which an idle upload may be reclaimed.
+#define UPLOAD_DEFAULT_TIMEOUT_MS (5 * 60 * 1000)
+
+// A raw image that is received in parts, in any order and possibly over
+// several connections at once.
+//
+// Callers must serialize calls to these methods, except that the data of a
+// write may be copied between UMBeginWrite and UMEndWrite without holding
+// whatever lock does so. Concurrent writes must target disjoint ranges.
+typedef struct Upload {
+  struct Upload *next;
+  uint32_t id;
+  uint32_t size;
+  uint8_t *data;
+  // Time of the last UMBegin or UMWrite call, in milliseconds.
+  uint32_t last_activity;
+  uint32_t num_blocks;
+  uint32_t num_received_blocks;
+  // Bitmap with a set bit for each block that has been received in full.
+  uint32_t *received;
+  // Number of writes between UMBeginWrite and UMEndWrite. A released upload is
+  // freed once the last of them ends.
+  uint32_t num_writers;
+  bool released;
+  // Arbitrary flags defined by the caller.
+  uint32_t flags;
+} Upload;
+
+// Allocates a new upload of `size` bytes. Returns NULL if `size` is 0 or
+// allocation fails.
+Upload *UMBegin(uint32_t size, uint32_t now);
+
+// Returns the upload with the given ID, or NULL.
+Upload *UMFind(uint32_t id);
+
+// Begins a write of `size` bytes to `offset` within the upload. The data must
+// continue a contiguous run that began at `run_start`, which must be a multiple
+// of UPLOAD_BLOCK_SIZE. Returns the location to which the data should be
+// copied, or NULL if the range does not fit within the upload. The upload
+// remains allocated until the matching UMEndWrite, even if it is released.
+uint8_t *UMBeginWrite(Upload *upload, uint32_t run_start, uint32_t offset,
+                      uint32_t size);
+
+// Ends a write begun by UMBeginWrite once its data has been copied, marking
+// every block covered entirely by the run [`run_start`, `end`) as received.
+// Returns true if this write completed the upload. If the upload has been
+// released it is freed once no writes remain and must not be used again.
+bool UMEndWrite(Upload *upload, uint32_t run_start, uint32_t end,
+                uint32_t now);
+
+// Copies `size` bytes to `offset` within the upload via UMBeginWrite and
+// UMEndWrite. Returns false if the range does not fit within the upload.
+bool UMWrite(Upload *upload, uint32_t run_start, uint32_t offset,
+             const void *data, uint32_t size, uint32_t now);
+
+bool UMIsComplete(const Upload *upload);
+
+// Returns the number of bytes within blocks that have been received in full.
+uint32_t UMGetReceivedSize(const Upload *upload);
+
+// Finds the first range of blocks at or after `start` that have not been
+// received. Returns false if there is none.
+bool UMFindMissingRange(const Upload *upload, uint32_t start, uint32_t *offset,
+                        uint32_t *size);
+
+// Frees the given upload and its data, or if writes are in progress, removes it
+// so that the last UMEndWrite frees it.
+void UMRelease(Upload *upload);
+
+// Frees every upload that has been idle for more than `timeout` milliseconds.
+// Returns the number of uploads that were freed.
+uint32_t UMReclaimStale(uint32_t now, uint32_t timeout);
+
+// Frees every upload.
+void UMReset(void);
+
+#ifdef __cplusplus
+};  // extern "C"
+#endif
+
+#endif  // DYNDXT_LOADER_UPLOAD_MANAGER_H
@@ -1,6 +1,8 @@
 #define BOOST_TEST_MODULE DXTLibraryTests
 #include <boost/test/unit_test.hpp>
 
+#include <string>
+
 #include "command_processor_util.h"
 
 #define TEST_KEY(cp, index, value)                        \
@@ -425,4 +427,263 @@ BOOST_AUTO_TEST_CASE(realistic_test) {
   CPDelete(&cp);
 }
 
+// Trailing escapes within a quoted value must not read past the input.
+BOOST_AUTO_TEST_CASE(quoted_value_trailing_escape_test) {
+  CommandParameters cp;
+
+  BOOST_TEST(CPParseCommandParameters("test=\"value\\", &cp) ==
+             PCP_ERR_INVALID_INPUT_UNTERMINATED_QUOTED_KEY);
+  BOOST_TEST(cp.keys == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(buffer_parse_test) {
+  uint8_t buffer[256];
+  CommandParameterSlices cp;
+
+  BOOST_TEST(CPParseCommandParametersToBuffer(
+                 "ddxt!load  test=value test2=\"quoted \\\" value\" test3 "
+                 "test4=\"\"",
+                 buffer, sizeof(buffer), &cp) == 5);
+  BOOST_TEST(cp.entries == 5);
+
+  BOOST_TEST(cp.slices[0].key_length == 9);
+  SAFE_TEST_STRING(cp.slices[0].key, "ddxt!load");
+  BOOST_TEST(cp.slices[0].value == nullptr);
+
+  SAFE_TEST_STRING(cp.slices[1].key, "test");
+  SAFE_TEST_STRING(cp.slices[1].value, "value");
+  BOOST_TEST(cp.slices[1].value_length == 5);
+
+  SAFE_TEST_STRING(cp.slices[2].key, "test2");
+  SAFE_TEST_STRING(cp.slices[2].value, "quoted \" value");
+  BOOST_TEST(cp.slices[2].value_length == 14);
+
+  SAFE_TEST_STRING(cp.slices[3].key, "test3");
+  BOOST_TEST(cp.slices[3].value == nullptr);
+
+  SAFE_TEST_STRING(cp.slices[4].key, "test4");
+  BOOST_TEST(cp.slices[4].value == nullptr);
+
+  // Slices must reference the buffer rather than the input.
+  for (int32_t i = 0; i < cp.entries; ++i) {
+    auto key = reinterpret_cast<const uint8_t *>(cp.slices[i].key);
+    BOOST_TEST((key >= buffer && key < buffer + sizeof(buffer)));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(buffer_parse_errors_test) {
+  uint8_t buffer[256];
+  CommandParameterSlices cp;
+
+  BOOST_TEST(CPParseCommandParametersToBuffer(nullptr, buffer, sizeof(buffer),
+                                              &cp) == PCP_ERR_INVALID_INPUT);
+  BOOST_TEST(CPParseCommandParametersToBuffer("", buffer, sizeof(buffer),
+                                              nullptr) ==
+             PCP_ERR_INVALID_INPUT);
+  BOOST_TEST(CPParseCommandParametersToBuffer("    ", buffer, sizeof(buffer),
+                                              &cp) == 0);
+  BOOST_TEST(cp.entries == 0);
+  BOOST_TEST(CPParseCommandParametersToBuffer("=value", buffer, sizeof(buffer),
+                                              &cp) == PCP_ERR_INVALID_KEY);
+  BOOST_TEST(cp.entries == 0);
+  BOOST_TEST(CPParseCommandParametersToBuffer("test=\"value", buffer,
+                                              sizeof(buffer), &cp) ==
+             PCP_ERR_INVALID_INPUT_UNTERMINATED_QUOTED_KEY);
+}
+
+BOOST_AUTO_TEST_CASE(buffer_too_small_test) {
+  static const char kParams[] = "a=1 b=2 c=3";
+  uint8_t buffer[CP_PARAMETER_BUFFER_SIZE(3, sizeof(kParams) - 1)];
+  CommandParameterSlices cp;
+
+  BOOST_TEST(CPParseCommandParametersToBuffer(kParams, buffer, sizeof(buffer),
+                                              &cp) == 3);
+
+  // Too small for the final entry.
+  BOOST_TEST(CPParseCommandParametersToBuffer(kParams, buffer,
+                                              sizeof(buffer) -
+                                                  sizeof(void *) -
+                                                  sizeof(CommandParameterSlice),
+                                              &cp) == PCP_ERR_BUFFER_TOO_SMALL);
+  BOOST_TEST(cp.entries == 0);
+
+  // Too small for the parameter string itself.
+  BOOST_TEST(CPParseCommandParametersToBuffer(kParams, buffer, 4, &cp) ==
+             PCP_ERR_BUFFER_TOO_SMALL);
+
+  char message[64];
+  CPPrintError(PCP_ERR_BUFFER_TOO_SMALL, message, sizeof(message));
+  BOOST_TEST(std::string(message) == "Too many parameters for parse buffer");
+}
+
+BOOST_AUTO_TEST_CASE(buffer_accessors_test) {
+  uint8_t buffer[512];
+  CommandParameterSlices cp;
+  BOOST_TEST(CPParseCommandParametersToBuffer(
+                 "ddxt!install base=0xb00ee000 length=0x5000 "
+                 "entrypoint=0xb00ef000 neg=-12 name=\"a \\\"b\\\"\" bad=12z",
+                 buffer, sizeof(buffer), &cp) == 7);
+
+  BOOST_TEST(CPSlicesHasKey("ddxt!install", &cp));
+  BOOST_TEST(!CPSlicesHasKey("ddxt", &cp));
+  BOOST_TEST(!CPSlicesHasKey("base=", &cp));
+
+  uint32_t result;
+  BOOST_TEST(CPSlicesGetUInt32("base", &result, &cp));
+  BOOST_TEST(result == 0xb00ee000);
+  BOOST_TEST(CPSlicesGetUInt32("length", &result, &cp));
+  BOOST_TEST(result == 0x5000);
+  BOOST_TEST(!CPSlicesGetUInt32("bad", &result, &cp));
+  BOOST_TEST(result == 0);
+  BOOST_TEST(!CPSlicesGetUInt32("missing", &result, &cp));
+
+  int32_t signed_result;
+  BOOST_TEST(CPSlicesGetInt32("neg", &signed_result, &cp));
+  BOOST_TEST(signed_result == -12);
+
+  const char *string_result;
+  BOOST_TEST(CPSlicesGetString("name", &string_result, &cp));
+  SAFE_TEST_STRING(string_result, "a \"b\"");
+  BOOST_TEST(!CPSlicesGetString("ddxt!install", &string_result, &cp));
+  BOOST_TEST(string_result == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(schema_parse_test) {
+  uint32_t base = 0;
+  int32_t offset = 0;
+  const char *name = nullptr;
+  const char *alias = nullptr;
+  bool verbose = false;
+  bool quiet = true;
+  const CommandParameterSchema schema[] = {
+      {"base", CP_TYPE_UINT32, true, &base},
+      {"offset", CP_TYPE_INT32, false, &offset},
+      {"name", CP_TYPE_STRING, true, &name},
+      {"alias", CP_TYPE_STRING, false, &alias},
+      {"verbose", CP_TYPE_FLAG, false, &verbose},
+      {"quiet", CP_TYPE_FLAG, false, &quiet},
+  };
+  char buffer[64];
+  const char *error_key = "unset";
+
+  BOOST_TEST(CPParseCommandParametersWithSchema(
+                 "ddxt!cmd unknown=1 base=0x1000 name=\"a \\\"b\\\"\" "
+                 "offset=-8 verbose base=0x2000",
+                 schema, sizeof(schema) / sizeof(schema[0]), buffer,
+                 sizeof(buffer), &error_key) == 4);
+  BOOST_TEST(error_key == nullptr);
+  BOOST_TEST(base == 0x1000);
+  BOOST_TEST(offset == -8);
+  SAFE_TEST_STRING(name, "a \"b\"");
+  BOOST_TEST(alias == nullptr);
+  BOOST_TEST(verbose);
+  BOOST_TEST(!quiet);
+}
+
+BOOST_AUTO_TEST_CASE(schema_parse_errors_test) {
+  uint32_t size = 0;
+  const char *name = nullptr;
+  const CommandParameterSchema schema[] = {
+      {"size", CP_TYPE_UINT32, true, &size},
+      {"name", CP_TYPE_STRING, false, &name},
+  };
+  const uint32_t entries = sizeof(schema) / sizeof(schema[0]);
+  char buffer[8];
+  const char *error_key;
+
+  BOOST_TEST(CPParseCommandParametersWithSchema("name=test", schema, entries,
+                                                buffer, sizeof(buffer),
+                                                &error_key) ==
+             PCP_ERR_MISSING_REQUIRED_KEY);
+  SAFE_TEST_STRING(error_key, "size");
+
+  BOOST_TEST(CPParseCommandParametersWithSchema("size=12z", schema, entries,
+                                                buffer, sizeof(buffer),
+                                                &error_key) ==
+             PCP_ERR_INVALID_VALUE);
+  SAFE_TEST_STRING(error_key, "size");
+
+  BOOST_TEST(CPParseCommandParametersWithSchema("size=1 name=too_long", schema,
+                                                entries, buffer,
+                                                sizeof(buffer), &error_key) ==
+             PCP_ERR_BUFFER_TOO_SMALL);
+  BOOST_TEST(CPParseCommandParametersWithSchema("size=1 name=test", schema,
+                                                entries, nullptr, 0,
+                                                &error_key) ==
+             PCP_ERR_BUFFER_TOO_SMALL);
+  BOOST_TEST(CPParseCommandParametersWithSchema("size=\"1", schema, entries,
+                                                buffer, sizeof(buffer),
+                                                &error_key) ==
+             PCP_ERR_INVALID_INPUT_UNTERMINATED_QUOTED_KEY);
+  BOOST_TEST(CPParseCommandParametersWithSchema(nullptr, schema, entries,
+                                                buffer, sizeof(buffer),
+                                                &error_key) ==
+             PCP_ERR_INVALID_INPUT);
+
+  char message[64];
+  CPPrintSchemaError(PCP_ERR_MISSING_REQUIRED_KEY, "size", message,
+                     sizeof(message));
+  BOOST_TEST(std::string(message) == "Missing required 'size' param");
+  CPPrintSchemaError(PCP_ERR_INVALID_VALUE, "size", message, sizeof(message));
+  BOOST_TEST(std::string(message) == "Invalid 'size' param");
+  CPPrintSchemaError(PCP_ERR_BUFFER_TOO_SMALL, nullptr, message,
+                     sizeof(message));
+  BOOST_TEST(std::string(message) == "Too many parameters for parse buffer");
+}
+
+BOOST_AUTO_TEST_CASE(schema_unquoted_backslash_test) {
+  const char *path = nullptr;
+  const char *name = nullptr;
+  const CommandParameterSchema schema[] = {
+      {"path", CP_TYPE_STRING, true, &path},
+      {"name", CP_TYPE_STRING, false, &name},
+  };
+  char buffer[64];
+  const char *error_key;
+
+  // Only quoted values are unescaped, matching CPParseCommandParameters.
+  BOOST_TEST(CPParseCommandParametersWithSchema(
+                 "ddxt!cmd path=e:\\dxt\\a.dll name=\"x\\\\y\"", schema,
+                 sizeof(schema) / sizeof(schema[0]), buffer, sizeof(buffer),
+                 &error_key) == 2);
+  SAFE_TEST_STRING(path, "e:\\dxt\\a.dll");
+  SAFE_TEST_STRING(name, "x\\y");
+
+  BOOST_TEST(CPParseCommandParametersWithSchema(
+                 "ddxt!cmd path=e:\\", schema,
+                 sizeof(schema) / sizeof(schema[0]), buffer, sizeof(buffer),
+                 &error_key) == 1);
+  SAFE_TEST_STRING(path, "e:\\");
+}
+
+BOOST_AUTO_TEST_CASE(schema_max_entries_test) {
+  // The last entry occupies the top bit of the set of keys that were found.
+  std::string keys[CP_MAX_SCHEMA_ENTRIES];
+  uint32_t values[CP_MAX_SCHEMA_ENTRIES] = {0};
+  CommandParameterSchema schema[CP_MAX_SCHEMA_ENTRIES];
+  for (uint32_t i = 0; i < CP_MAX_SCHEMA_ENTRIES; ++i) {
+    keys[i] = "k" + std::to_string(i);
+    schema[i] = {keys[i].c_str(), CP_TYPE_UINT32, true, values + i};
+  }
+  std::string command = "ddxt!cmd";
+  for (uint32_t i = 0; i < CP_MAX_SCHEMA_ENTRIES - 1; ++i) {
+    command += " " + keys[i] + "=" + std::to_string(i + 1);
+  }
+  const char *error_key;
+
+  BOOST_TEST(CPParseCommandParametersWithSchema(command.c_str(), schema,
+                                                CP_MAX_SCHEMA_ENTRIES, nullptr,
+                                                0, &error_key) ==
+             PCP_ERR_MISSING_REQUIRED_KEY);
+  SAFE_TEST_STRING(error_key, "k31");
+
+  command += " k31=32";
+  BOOST_TEST(CPParseCommandParametersWithSchema(command.c_str(), schema,
+                                                CP_MAX_SCHEMA_ENTRIES, nullptr,
+                                                0, &error_key) ==
+             CP_MAX_SCHEMA_ENTRIES);
+  BOOST_TEST(values[0] == 1);
+  BOOST_TEST(values[CP_MAX_SCHEMA_ENTRIES - 1] == CP_MAX_SCHEMA_ENTRIES);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,101 @@
+#define BOOST_TEST_MODULE DXTLibraryTests
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+
+#include "command_table.h"
+#include "xbdm_stubs.h"
+
+static const CommandTableEntry kTable[] = {
+    {"cache", 1, nullptr},
+    {"hello", 2, nullptr},
+    {"load", 3, nullptr},
+    {"loadbegin", 4, nullptr},
+    {"loadbundle", 5, nullptr},
+    {"unload", 6, nullptr},
+};
+static const uint32_t kTableSize = sizeof(kTable) / sizeof(kTable[0]);
+
+// Returns the handler that `command` dispatches to within kTable, or 0.
+static uint32_t Lookup(const char *command) {
+  const CommandTableEntry *entry =
+      CTFindInTable(kTable, kTableSize, command, CTGetNameLength(command));
+  return entry ? entry->handler : 0;
+}
+
+BOOST_AUTO_TEST_CASE(find_in_table_test) {
+  BOOST_TEST(CTGetNameLength("load size=0x10") == 4);
+  BOOST_TEST(CTGetNameLength("hello") == 5);
+  BOOST_TEST(CTGetNameLength("") == 0);
+
+  for (uint32_t i = 0; i < kTableSize; ++i) {
+    BOOST_TEST(Lookup(kTable[i].name) == kTable[i].handler);
+  }
+  BOOST_TEST(Lookup("load size=0x10") == 3);
+  BOOST_TEST(Lookup("LoadBundle size=0x10") == 5);
+
+  // Names must match in full rather than by prefix.
+  BOOST_TEST(Lookup("loa") == 0);
+  BOOST_TEST(Lookup("loadb") == 0);
+  BOOST_TEST(Lookup("loadbeginx") == 0);
+  BOOST_TEST(Lookup("aaa") == 0);
+  BOOST_TEST(Lookup("zzz") == 0);
+  BOOST_TEST(Lookup("") == 0);
+}
+
+BOOST_AUTO_TEST_CASE(register_test) {
+  int plugin_a;
+  int plugin_b;
+  const char *names[] = {"b.zeta", "a.status", "b.alpha", "a.dump", "c.x"};
+  for (uint32_t i = 0; i < 5; ++i) {
+    BOOST_TEST_REQUIRE(CTAdd(names[i], 100 + i, i < 4 ? &plugin_a : nullptr));
+  }
+  CTFind("b.alpha", 7)->owner = &plugin_b;
+  CTFind("b.zeta", 6)->owner = &plugin_b;
+
+  uint32_t count;
+  const CommandTableEntry *entries = CTGetEntries(&count);
+  BOOST_TEST_REQUIRE(count == 5);
+  for (uint32_t i = 1; i < count; ++i) {
+    BOOST_TEST(strcmp(entries[i - 1].name, entries[i].name) < 0);
+  }
+
+  CommandTableEntry *entry = CTFind("A.Dump now", 6);
+  BOOST_TEST_REQUIRE(entry);
+  BOOST_TEST(entry->handler == 103);
+  BOOST_TEST(!CTFind("a.du", 4));
+
+  // Entries whose handler is not claimed again after a release are removed.
+  CTReleaseOwner(&plugin_b);
+  BOOST_TEST(CTFind("b.alpha", 7)->handler == 0);
+  CTFind("b.alpha", 7)->handler = 200;
+  BOOST_TEST(CTRemoveOwner(&plugin_b, true) == 1);
+  BOOST_TEST(!CTFind("b.zeta", 6));
+  BOOST_TEST(CTFind("b.alpha", 7)->handler == 200);
+
+  BOOST_TEST(CTRemoveOwner(&plugin_a, false) == 2);
+  CTRemove(CTFind("c.x", 3));
+  CTGetEntries(&count);
+  BOOST_TEST(count == 1);
+
+  CTReset();
+  CTGetEntries(&count);
+  BOOST_TEST(count == 0);
+  BOOST_TEST(GetPoolUsage().blocks == 0);
+}
+
+BOOST_AUTO_TEST_CASE(growth_test) {
+  char name[16];
+  for (uint32_t i = 0; i < 100; ++i) {
+    snprintf(name, sizeof(name), "p.cmd%u", (i * 37) % 100);
+    BOOST_TEST_REQUIRE(CTAdd(name, i + 1, nullptr));
+  }
+  for (uint32_t i = 0; i < 100; ++i) {
+    snprintf(name, sizeof(name), "p.cmd%u", (i * 37) % 100);
+    CommandTableEntry *entry = CTFind(name, strlen(name));
+    BOOST_TEST_REQUIRE(entry);
+    BOOST_TEST(entry->handler == i + 1);
+  }
+
+  CTReset();
+  BOOST_TEST(GetPoolUsage().blocks == 0);
+}
@@ -0,0 +1,181 @@
+// Compares loading a large synthetic DLL with separate section copy and
+// relocation passes against the fused single pass.
+//
+// Usage: dll_loader_benchmark [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "dll_loader.h"
+
+static constexpr uint32_t kHeaderSize = 0x400;
+static constexpr uint32_t kPageSize = 0x1000;
+static constexpr uint32_t kImageBase = 0x10000;
+// One HIGHLOW fixup per this many bytes of section data.
+static constexpr uint32_t kFixupStride = 16;
+static constexpr uint16_t kRelocationHighLow = 3;
+
+static double TimeMicroseconds(uint32_t iterations,
+                               const std::function<void()> &body) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; ++i) {
+    body();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         iterations;
+}
+
+static void AppendUInt16(std::vector<uint8_t> *output, uint16_t value) {
+  output->push_back(value & 0xFF);
+  output->push_back(value >> 8);
+}
+
+static void AppendUInt32(std::vector<uint8_t> *output, uint32_t value) {
+  AppendUInt16(output, value & 0xFFFF);
+  AppendUInt16(output, value >> 16);
+}
+
+// Builds a raw DLL with a code and a data section of the given sizes (in
+// pages), each with a fixup every kFixupStride bytes, followed by their
+// relocation section.
+static std::vector<uint8_t> BuildImage(uint32_t code_pages,
+                                       uint32_t data_pages) {
+  uint32_t code_rva = kPageSize;
+  uint32_t data_rva = code_rva + code_pages * kPageSize;
+  uint32_t reloc_rva = data_rva + data_pages * kPageSize;
+
+  std::vector<uint8_t> relocations;
+  for (uint32_t page = 0; page < code_pages + data_pages; ++page) {
+    AppendUInt32(&relocations, code_rva + page * kPageSize);
+    AppendUInt32(&relocations, 8 + (kPageSize / kFixupStride) * 2);
+    for (uint32_t offset = 0; offset < kPageSize; offset += kFixupStride) {
+      AppendUInt16(&relocations, (kRelocationHighLow << 12) | offset);
+    }
+  }
+  uint32_t reloc_size = relocations.size();
+  uint32_t reloc_raw_size = (reloc_size + kPageSize - 1) & ~(kPageSize - 1);
+  uint32_t image_size = reloc_rva + reloc_raw_size;
+
+  std::vector<uint8_t> raw(image_size - kPageSize + kHeaderSize);
+  auto dos_header = reinterpret_cast<IMAGE_DOS_HEADER *>(raw.data());
+  dos_header->e_magic = IMAGE_DOS_SIGNATURE;
+  dos_header->e_lfanew = sizeof(*dos_header);
+
+  auto nt_header =
+      reinterpret_cast<IMAGE_NT_HEADERS32 *>(raw.data() + dos_header->e_lfanew);
+  nt_header->Signature = IMAGE_NT_SIGNATURE;
+  nt_header->FileHeader.Machine = IMAGE_FILE_MACHINE_I386;
+  nt_header->FileHeader.NumberOfSections = 3;
+  nt_header->FileHeader.SizeOfOptionalHeader = sizeof(IMAGE_OPTIONAL_HEADER32);
+  nt_header->OptionalHeader.ImageBase = kImageBase;
+  nt_header->OptionalHeader.SizeOfImage = image_size;
+  nt_header->OptionalHeader.SizeOfHeaders = kHeaderSize;
+  nt_header->OptionalHeader.DllCharacteristics =
+      IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE;
+  IMAGE_DATA_DIRECTORY *reloc_directory =
+      nt_header->OptionalHeader.DataDirectory + IMAGE_DIRECTORY_ENTRY_BASERELOC;
+  reloc_directory->VirtualAddress = reloc_rva;
+  reloc_directory->Size = reloc_size;
+
+  auto sections = reinterpret_cast<IMAGE_SECTION_HEADER *>(nt_header + 1);
+  const uint32_t rvas[] = {code_rva, data_rva, reloc_rva};
+  const uint32_t sizes[] = {code_pages * kPageSize, data_pages * kPageSize,
+                            reloc_raw_size};
+  for (uint32_t i = 0; i < 3; ++i) {
+    sections[i].VirtualAddress = rvas[i];
+    sections[i].Misc.VirtualSize = sizes[i];
+    sections[i].SizeOfRawData = sizes[i];
+    sections[i].PointerToRawData = rvas[i] - kPageSize + kHeaderSize;
+  }
+
+  // Fill the code and data sections with absolute addresses into the image.
+  uint8_t *section_data = raw.data() + kHeaderSize;
+  for (uint32_t offset = 0; offset < reloc_rva - code_rva;
+       offset += sizeof(uint32_t)) {
+    uint32_t value = kImageBase + code_rva + offset;
+    memcpy(section_data + offset, &value, sizeof(value));
+  }
+  memcpy(raw.data() + sections[2].PointerToRawData, relocations.data(),
+         reloc_size);
+  return raw;
+}
+
+static bool ResolveImportByOrdinal(const char *, uint32_t, uint32_t *) {
+  return false;
+}
+
+static bool ResolveImportByName(const char *, const char *, uint32_t *) {
+  return false;
+}
+
+static void InitContext(DLLContext *ctx, const std::vector<uint8_t> &raw,
+                        bool fuse_relocation) {
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->input.raw_data = raw.data();
+  ctx->input.raw_data_size = raw.size();
+  ctx->input.alloc = malloc;
+  ctx->input.free = free;
+  ctx->input.resolve_import_by_ordinal = ResolveImportByOrdinal;
+  ctx->input.resolve_import_by_name = ResolveImportByName;
+  ctx->input.fuse_relocation = fuse_relocation;
+}
+
+static void BenchmarkLoad(uint32_t iterations, uint32_t code_pages,
+                          uint32_t data_pages) {
+  auto raw = BuildImage(code_pages, data_pages);
+
+  // Both modes must produce identical images for a fixed base.
+  DLLContext separate;
+  DLLContext fused;
+  InitContext(&separate, raw, false);
+  InitContext(&fused, raw, true);
+  if (!DLLParse(&separate) || !DLLRelocate(&separate, 0xB0000000) ||
+      !DLLParseAndRelocate(&fused, 0xB0000000)) {
+    fprintf(stderr, "Failed to load synthetic image %d::%d / %d::%d\n",
+            separate.output.context, separate.output.status,
+            fused.output.context, fused.output.status);
+    exit(1);
+  }
+  uint32_t image_size = separate.output.header.OptionalHeader.SizeOfImage;
+  if (memcmp(separate.output.image, fused.output.image, image_size)) {
+    fprintf(stderr, "Fused relocation produced a different image\n");
+    exit(1);
+  }
+  DLLFreeContext(&separate, false);
+  DLLFreeContext(&fused, false);
+
+  double results[2];
+  for (int fuse = 0; fuse < 2; ++fuse) {
+    results[fuse] = TimeMicroseconds(iterations, [&raw, fuse]() {
+      DLLContext ctx;
+      InitContext(&ctx, raw, fuse);
+      if (!DLLLoad(&ctx)) {
+        fprintf(stderr, "DLLLoad failed %d::%d\n", ctx.output.context,
+                ctx.output.status);
+        exit(1);
+      }
+      DLLFreeContext(&ctx, false);
+    });
+  }
+
+  uint32_t fixups = (code_pages + data_pages) * (kPageSize / kFixupStride);
+  printf("load %6u KiB, %7u fixups: separate %10.2f us, fused %10.2f us\n",
+         image_size / 1024, fixups, results[0], results[1]);
+}
+
+int main(int argc, char **argv) {
+  uint32_t iterations = 50;
+  if (argc > 1) {
+    iterations = strtoul(argv[1], nullptr, 0);
+  }
+
+  BenchmarkLoad(iterations, 16, 4);
+  BenchmarkLoad(iterations, 256, 64);
+  BenchmarkLoad(iterations, 1024, 256);
+  return 0;
+}
@@ -15,6 +15,15 @@ static bool ResolveImportByOrdinalAlwaysSucceed(const char *, uint32_t,
 static bool ResolveImportByNameAlwaysSucceed(const char *, const char *,
                                              uint32_t *);
 
+static bool ResolveModuleCounting(const char *, void **);
+static bool ResolveImportByOrdinalInModuleCounting(void *, uint32_t,
+                                                   uint32_t *);
+static bool ResolveImportByNameInModuleCounting(void *, const char *,
+                                                uint32_t *);
+
+static uint32_t resolve_module_calls = 0;
+static uint32_t resolve_in_module_calls = 0;
+
 BOOST_AUTO_TEST_SUITE(dll_loader_suite)
 
 BOOST_AUTO_TEST_CASE(empty_raw_data_test) {
@@ -171,6 +180,198 @@ BOOST_AUTO_TEST_CASE(relocation_test) {
 
   DLLFreeContext(&ctx, false);
 }
+
+BOOST_AUTO_TEST_CASE(fused_relocation_test) {
+  DLLContext ctx;
+
+  memset(&ctx, 0, sizeof(ctx));
+
+  ctx.input.raw_data = kDynDXTLoader;
+  ctx.input.raw_data_size = sizeof(kDynDXTLoader);
+  ctx.input.alloc = malloc;
+  ctx.input.free = free;
+  ctx.input.resolve_import_by_ordinal = ResolveImportByOrdinalAlwaysSucceed;
+  ctx.input.resolve_import_by_name = ResolveImportByNameAlwaysSucceed;
+
+  BOOST_REQUIRE(DLLParseAndRelocate(&ctx, 0xB00D7000));
+
+  uint32_t image_size = ctx.output.header.OptionalHeader.SizeOfImage;
+  BOOST_TEST(image_size == sizeof(kRelocatedB00D7000));
+  BOOST_TEST(ctx.output.entrypoint ==
+             0xB00D7000 + ctx.output.header.OptionalHeader.AddressOfEntryPoint);
+  BOOST_TEST(!memcmp(ctx.output.image, kRelocatedB00D7000, image_size));
+  DLLFreeContext(&ctx, false);
+
+  // Relocating in place while loading must match relocating afterwards.
+  ctx.input.fuse_relocation = true;
+  BOOST_REQUIRE(DLLLoad(&ctx));
+  BOOST_TEST(memcmp(ctx.output.image, kRelocatedB00D7000, image_size));
+  BOOST_REQUIRE(DLLRelocate(&ctx, 0xB00D7000));
+  BOOST_TEST(!memcmp(ctx.output.image, kRelocatedB00D7000, image_size));
+
+  DLLFreeContext(&ctx, false);
+}
+
+BOOST_AUTO_TEST_CASE(module_handle_resolution_test) {
+  DLLContext ctx;
+
+  memset(&ctx, 0, sizeof(ctx));
+
+  ctx.input.raw_data = kDynDXTLoader;
+  ctx.input.raw_data_size = sizeof(kDynDXTLoader);
+  ctx.input.alloc = malloc;
+  ctx.input.free = free;
+  ctx.input.resolve_import_by_ordinal = ResolveImportByOrdinalAlwaysFail;
+  ctx.input.resolve_import_by_name = ResolveImportByNameAlwaysFail;
+  ctx.input.resolve_module = ResolveModuleCounting;
+  ctx.input.resolve_import_by_ordinal_in_module =
+      ResolveImportByOrdinalInModuleCounting;
+  ctx.input.resolve_import_by_name_in_module =
+      ResolveImportByNameInModuleCounting;
+
+  resolve_module_calls = 0;
+  resolve_in_module_calls = 0;
+  BOOST_TEST(DLLLoad(&ctx));
+
+  // The golden DLL imports 3 methods from xbdm.dll and 56 from xboxkrnl.exe.
+  BOOST_TEST(resolve_module_calls == 2);
+  BOOST_TEST(resolve_in_module_calls == 59);
+
+  DLLRelocate(&ctx, 0xB00D7000);
+  uint32_t image_size = ctx.output.header.OptionalHeader.SizeOfImage;
+  BOOST_TEST(!memcmp(ctx.output.image, kRelocatedB00D7000, image_size));
+
+  DLLFreeContext(&ctx, false);
+}
+
+BOOST_AUTO_TEST_CASE(stream_invalid_signature_test) {
+  DLLContext ctx;
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.input.alloc = malloc;
+  ctx.input.free = free;
+
+  DLLStreamBegin(&ctx);
+  uint8_t garbage[sizeof(IMAGE_DOS_HEADER)] = {0};
+  BOOST_TEST(!DLLStreamWrite(&ctx, garbage, sizeof(garbage)));
+  BOOST_TEST(ctx.output.context == DLLL_DOS_HEADER);
+  BOOST_TEST(ctx.output.status == DLLL_INVALID_SIGNATURE);
+
+  // Subsequent writes should continue to fail.
+  BOOST_TEST(!DLLStreamWrite(&ctx, kDynDXTLoader, sizeof(kDynDXTLoader)));
+
+  DLLFreeContext(&ctx, false);
+}
+
+BOOST_AUTO_TEST_CASE(stream_truncated_test) {
+  DLLContext ctx;
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.input.alloc = malloc;
+  ctx.input.free = free;
+  ctx.input.resolve_import_by_ordinal = ResolveImportByOrdinalAlwaysSucceed;
+  ctx.input.resolve_import_by_name = ResolveImportByNameAlwaysSucceed;
+
+  DLLStreamBegin(&ctx);
+  BOOST_TEST(DLLStreamWrite(&ctx, kDynDXTLoader, sizeof(kDynDXTLoader) / 2));
+  BOOST_TEST(!DLLStreamEnd(&ctx));
+  BOOST_TEST(ctx.output.context == DLLL_LOAD_SECTION);
+  BOOST_TEST(ctx.output.status == DLLL_FILE_TOO_SMALL);
+  BOOST_TEST(ctx.output.image == nullptr);
+
+  DLLFreeContext(&ctx, false);
+}
+
+BOOST_AUTO_TEST_CASE(stream_relocation_test) {
+  static const uint32_t kChunkSizes[] = {1, 7, 64, 511, 4096,
+                                         sizeof(kDynDXTLoader)};
+
+  for (auto chunk_size : kChunkSizes) {
+    BOOST_TEST_CONTEXT("Chunk size " << chunk_size) {
+      DLLContext ctx;
+
+      memset(&ctx, 0, sizeof(ctx));
+      ctx.input.alloc = malloc;
+      ctx.input.free = free;
+      ctx.input.resolve_import_by_ordinal =
+          ResolveImportByOrdinalAlwaysSucceed;
+      ctx.input.resolve_import_by_name = ResolveImportByNameAlwaysSucceed;
+
+      DLLStreamBegin(&ctx);
+      const uint8_t *read_ptr = kDynDXTLoader;
+      uint32_t remaining = sizeof(kDynDXTLoader);
+      while (remaining) {
+        uint32_t size = remaining < chunk_size ? remaining : chunk_size;
+        BOOST_REQUIRE(DLLStreamWrite(&ctx, read_ptr, size));
+        read_ptr += size;
+        remaining -= size;
+      }
+      BOOST_REQUIRE(DLLStreamEnd(&ctx));
+
+      uint32_t image_size = ctx.output.header.OptionalHeader.SizeOfImage;
+      BOOST_TEST(image_size == sizeof(kRelocatedB00D7000));
+
+      DLLRelocate(&ctx, 0xB00D7000);
+      BOOST_TEST(!memcmp(ctx.output.image, kRelocatedB00D7000, image_size));
+
+      DLLFreeContext(&ctx, false);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(stream_wrapping_section_test) {
+  std::string raw(reinterpret_cast<const char *>(kDynDXTLoader),
+                  sizeof(kDynDXTLoader));
+  auto dos_header = reinterpret_cast<IMAGE_DOS_HEADER *>(&raw[0]);
+  auto nt_header =
+      reinterpret_cast<IMAGE_NT_HEADERS32 *>(&raw[dos_header->e_lfanew]);
+  auto section = reinterpret_cast<IMAGE_SECTION_HEADER *>(
+      reinterpret_cast<uint8_t *>(&nt_header->OptionalHeader) +
+      nt_header->FileHeader.SizeOfOptionalHeader);
+  // The end of the raw data wraps to a point the stream has already passed.
+  BOOST_REQUIRE(section->SizeOfRawData > 0x100);
+  section->PointerToRawData = 0xFFFFFF00;
+
+  DLLContext ctx;
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.input.alloc = malloc;
+  ctx.input.free = free;
+
+  DLLStreamBegin(&ctx);
+  BOOST_TEST(!DLLStreamWrite(&ctx, raw.data(), raw.size()));
+  BOOST_TEST(ctx.output.context == DLLL_LOAD_SECTION);
+  BOOST_TEST(ctx.output.status == DLLL_INVALID_SECTION);
+
+  DLLFreeContext(&ctx, false);
+}
+
+BOOST_AUTO_TEST_CASE(stream_header_offset_test) {
+  static const int32_t kOffsets[] = {
+      -4, 0x7FFFFFF0, static_cast<int32_t>(sizeof(kDynDXTLoader))};
+
+  for (auto offset : kOffsets) {
+    BOOST_TEST_CONTEXT("e_lfanew " << offset) {
+      std::string raw(reinterpret_cast<const char *>(kDynDXTLoader),
+                      sizeof(kDynDXTLoader));
+      reinterpret_cast<IMAGE_DOS_HEADER *>(&raw[0])->e_lfanew = offset;
+
+      DLLContext ctx;
+
+      memset(&ctx, 0, sizeof(ctx));
+      ctx.input.raw_data_size = raw.size();
+      ctx.input.alloc = malloc;
+      ctx.input.free = free;
+
+      DLLStreamBegin(&ctx);
+      BOOST_TEST(!DLLStreamWrite(&ctx, raw.data(), raw.size()));
+      BOOST_TEST(ctx.output.context == DLLL_NT_HEADER);
+      BOOST_TEST(ctx.output.status != DLLL_OK);
+
+      DLLFreeContext(&ctx, false);
+    }
+  }
+}
 BOOST_AUTO_TEST_SUITE_END()
 
 static bool ResolveImportByOrdinalAlwaysFail(const char *, uint32_t,
@@ -197,3 +398,23 @@ static bool ResolveImportByNameAlwaysSucceed(const char *, const char *,
   *result = 0xABCDF00D;
   return true;
 }
+
+static bool ResolveModuleCounting(const char *module, void **handle) {
+  ++resolve_module_calls;
+  *handle = (void *)module;
+  return true;
+}
+
+static bool ResolveImportByOrdinalInModuleCounting(void *handle,
+                                                   uint32_t ordinal,
+                                                   uint32_t *result) {
+  ++resolve_in_module_calls;
+  return ResolveImportByOrdinalAlwaysSucceed((const char *)handle, ordinal,
+                                             result);
+}
+
+static bool ResolveImportByNameInModuleCounting(void *handle, const char *name,
+                                                uint32_t *result) {
+  ++resolve_in_module_calls;
+  return ResolveImportByNameAlwaysSucceed((const char *)handle, name, result);
+}
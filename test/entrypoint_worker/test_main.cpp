@@ -0,0 +1,121 @@
+#define BOOST_TEST_MODULE DXTLibraryTests
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "entrypoint_worker.h"
+#include "xbdm_stubs.h"
+
+static const uint32_t kImageBase = 0xB0010000;
+
+// Threads started via CreateWorkerThread, joined by JoinWorkerThreads.
+static std::vector<std::thread> worker_threads;
+static bool fail_thread_creation = false;
+
+static HANDLE CreateWorkerThread(LPSECURITY_ATTRIBUTES, SIZE_T,
+                                 LPTHREAD_START_ROUTINE start_address,
+                                 LPVOID parameter, DWORD, LPDWORD) {
+  if (fail_thread_creation) {
+    return nullptr;
+  }
+  worker_threads.emplace_back(start_address, parameter);
+  return reinterpret_cast<HANDLE>(worker_threads.size());
+}
+
+static void JoinWorkerThreads() {
+  for (auto &thread : worker_threads) {
+    thread.join();
+  }
+  worker_threads.clear();
+}
+
+static std::string LoadedNotification(uint32_t image_base, HRESULT result) {
+  char buffer[EW_MAX_NOTIFICATION_LEN];
+  snprintf(buffer, sizeof(buffer), "ddxt!loaded image_base=0x%X hr=0x%X",
+           image_base, (uint32_t)result);
+  return buffer;
+}
+
+static std::thread::id entrypoint_thread;
+static bool hooks_active = false;
+static bool entrypoint_saw_hooks = false;
+static bool image_loaded = true;
+static bool end_saw_invoked = false;
+
+static HRESULT SucceedingEntrypoint() {
+  entrypoint_thread = std::this_thread::get_id();
+  entrypoint_saw_hooks = hooks_active;
+  return XBOX_S_OK;
+}
+
+static HRESULT FailingEntrypoint() { return XBOX_E_ACCESS_DENIED; }
+
+static bool Begin(uint32_t image_base, EntrypointProc entrypoint) {
+  hooks_active = true;
+  return image_loaded && image_base == kImageBase;
+}
+
+static void End(uint32_t image_base, bool invoked) {
+  hooks_active = false;
+  end_saw_invoked = invoked;
+}
+
+BOOST_AUTO_TEST_CASE(invoke_async_reports_result_test) {
+  EntrypointWorkerHooks hooks = {CreateWorkerThread, nullptr, nullptr};
+  entrypoint_thread = std::this_thread::get_id();
+
+  BOOST_TEST(EWInvokeAsync(&hooks, kImageBase, SucceedingEntrypoint));
+  BOOST_TEST(EWInvokeAsync(&hooks, kImageBase + 0x10000, FailingEntrypoint));
+  JoinWorkerThreads();
+
+  BOOST_TEST(entrypoint_thread != std::this_thread::get_id());
+  auto notifications = TakeNotifications();
+  BOOST_TEST_REQUIRE(notifications.size() == 2);
+  // Each worker reports independently, so completion order is unspecified.
+  std::sort(notifications.begin(), notifications.end());
+  BOOST_TEST(notifications[0] == LoadedNotification(kImageBase, XBOX_S_OK));
+  BOOST_TEST(notifications[1] ==
+             LoadedNotification(kImageBase + 0x10000, XBOX_E_ACCESS_DENIED));
+  BOOST_TEST(GetPoolUsage().blocks == 0);
+}
+
+BOOST_AUTO_TEST_CASE(invoke_async_hooks_test) {
+  EntrypointWorkerHooks hooks = {CreateWorkerThread, Begin, End};
+
+  entrypoint_saw_hooks = false;
+  BOOST_TEST(EWInvokeAsync(&hooks, kImageBase, SucceedingEntrypoint));
+  JoinWorkerThreads();
+  BOOST_TEST(entrypoint_saw_hooks);
+  BOOST_TEST(!hooks_active);
+  BOOST_TEST(end_saw_invoked);
+
+  // The entrypoint of an image unloaded before the worker runs is skipped.
+  image_loaded = false;
+  entrypoint_saw_hooks = false;
+  BOOST_TEST(EWInvokeAsync(&hooks, kImageBase, SucceedingEntrypoint));
+  JoinWorkerThreads();
+  image_loaded = true;
+  BOOST_TEST(!entrypoint_saw_hooks);
+  BOOST_TEST(!hooks_active);
+  BOOST_TEST(!end_saw_invoked);
+
+  auto notifications = TakeNotifications();
+  BOOST_TEST_REQUIRE(notifications.size() == 2);
+  BOOST_TEST(notifications[0] == LoadedNotification(kImageBase, XBOX_S_OK));
+  BOOST_TEST(notifications[1] ==
+             LoadedNotification(kImageBase, XBOX_E_FILE_NOT_FOUND));
+  BOOST_TEST(GetPoolUsage().blocks == 0);
+}
+
+BOOST_AUTO_TEST_CASE(invoke_async_thread_failure_test) {
+  EntrypointWorkerHooks hooks = {CreateWorkerThread, nullptr, nullptr};
+
+  fail_thread_creation = true;
+  BOOST_TEST(!EWInvokeAsync(&hooks, kImageBase, SucceedingEntrypoint));
+  fail_thread_creation = false;
+
+  BOOST_TEST(TakeNotifications().empty());
+  BOOST_TEST(GetPoolUsage().blocks == 0);
+}
@@ -0,0 +1,198 @@
+#define BOOST_TEST_MODULE DXTLibraryTests
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "golden_dll.h"
+#include "image_bundle.h"
+#include "winapi/winnt.h"
+
+static const uint32_t kNTHeaderOffset = 0x40;
+static const uint32_t kSectionRVA = 0x1000;
+static const uint32_t kSectionOffset = 0x200;
+
+// Builds a minimal raw image with a single section holding an export directory
+// named `name` (if non-null) and import descriptors for each of `imports`.
+static std::vector<uint8_t> BuildImage(
+    const char *name, const std::vector<std::string> &imports) {
+  std::vector<uint8_t> image(kSectionOffset + 0x200);
+  auto dos_header = reinterpret_cast<IMAGE_DOS_HEADER *>(image.data());
+  dos_header->e_magic = IMAGE_DOS_SIGNATURE;
+  dos_header->e_lfanew = kNTHeaderOffset;
+
+  auto nt_header =
+      reinterpret_cast<IMAGE_NT_HEADERS32 *>(image.data() + kNTHeaderOffset);
+  nt_header->Signature = IMAGE_NT_SIGNATURE;
+  nt_header->FileHeader.NumberOfSections = 1;
+  nt_header->FileHeader.SizeOfOptionalHeader = sizeof(IMAGE_OPTIONAL_HEADER32);
+  nt_header->OptionalHeader.SizeOfHeaders = kSectionOffset;
+
+  auto section = reinterpret_cast<IMAGE_SECTION_HEADER *>(nt_header + 1);
+  section->VirtualAddress = kSectionRVA;
+  section->SizeOfRawData = 0x200;
+  section->PointerToRawData = kSectionOffset;
+
+  // Export directory at +0x00, import descriptors at +0x40, strings at +0x100.
+  uint8_t *section_data = image.data() + kSectionOffset;
+  uint32_t string_offset = 0x100;
+  auto add_string = [&](const std::string &value) {
+    strcpy(reinterpret_cast<char *>(section_data + string_offset),
+           value.c_str());
+    uint32_t rva = kSectionRVA + string_offset;
+    string_offset += 0x20;
+    return rva;
+  };
+
+  IMAGE_DATA_DIRECTORY *directories = nt_header->OptionalHeader.DataDirectory;
+  if (name) {
+    directories[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress = kSectionRVA;
+    directories[IMAGE_DIRECTORY_ENTRY_EXPORT].Size =
+        sizeof(IMAGE_EXPORT_DIRECTORY);
+    auto directory = reinterpret_cast<IMAGE_EXPORT_DIRECTORY *>(section_data);
+    directory->Name = add_string(name);
+  }
+
+  if (!imports.empty()) {
+    directories[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress =
+        kSectionRVA + 0x40;
+    directories[IMAGE_DIRECTORY_ENTRY_IMPORT].Size =
+        (imports.size() + 1) * sizeof(IMAGE_IMPORT_DESCRIPTOR);
+    auto descriptor =
+        reinterpret_cast<IMAGE_IMPORT_DESCRIPTOR *>(section_data + 0x40);
+    for (const auto &import : imports) {
+      (descriptor++)->Name = add_string(import);
+    }
+  }
+
+  return image;
+}
+
+static void AppendUInt32(std::vector<uint8_t> *output, uint32_t value) {
+  auto bytes = reinterpret_cast<const uint8_t *>(&value);
+  output->insert(output->end(), bytes, bytes + sizeof(value));
+}
+
+static std::vector<uint8_t> BuildBundle(
+    const std::vector<std::vector<uint8_t>> &images) {
+  std::vector<uint8_t> ret;
+  AppendUInt32(&ret, IMAGE_BUNDLE_MAGIC);
+  AppendUInt32(&ret, images.size());
+  for (const auto &image : images) {
+    AppendUInt32(&ret, image.size());
+  }
+  for (const auto &image : images) {
+    ret.insert(ret.end(), image.begin(), image.end());
+  }
+  return ret;
+}
+
+BOOST_AUTO_TEST_SUITE(image_bundle_suite)
+
+BOOST_AUTO_TEST_CASE(parse_and_sort_test) {
+  auto bundle = BuildBundle({
+      BuildImage("c.dll", {"xbdm.dll", "b.dll", "a.dll"}),
+      BuildImage("b.dll", {"a.dll"}),
+      BuildImage("a.dll", {"xbdm.dll", "xboxkrnl.exe"}),
+      BuildImage(nullptr, {"c.dll"}),
+  });
+
+  ImageBundleEntry entries[IMAGE_BUNDLE_MAX_IMAGES];
+  uint32_t count = 0;
+  BOOST_TEST(IBParse(bundle.data(), bundle.size(), entries, &count) == IBS_OK);
+  BOOST_TEST(count == 4);
+  BOOST_TEST(std::string(entries[0].name) == "c.dll");
+  BOOST_TEST(std::string(entries[2].name) == "a.dll");
+  BOOST_TEST(!entries[3].name);
+  BOOST_TEST(entries[1].data == bundle.data() + 6 * sizeof(uint32_t) +
+                                    entries[0].size);
+
+  uint32_t order[IMAGE_BUNDLE_MAX_IMAGES];
+  uint32_t dependencies[IMAGE_BUNDLE_MAX_IMAGES];
+  BOOST_TEST(IBSortByDependencies(entries, count, order, dependencies) ==
+             IBS_OK);
+  const std::vector<uint32_t> expected_order = {2, 1, 0, 3};
+  BOOST_TEST(std::vector<uint32_t>(order, order + count) == expected_order,
+             boost::test_tools::per_element());
+  const std::vector<uint32_t> expected_dependencies = {0b0110, 0b0100, 0,
+                                                       0b0001};
+  BOOST_TEST(std::vector<uint32_t>(dependencies, dependencies + count) ==
+                 expected_dependencies,
+             boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_CASE(dependency_cycle_test) {
+  auto bundle = BuildBundle({
+      BuildImage("a.dll", {}),
+      BuildImage("b.dll", {"c.dll"}),
+      BuildImage("c.dll", {"b.dll"}),
+  });
+
+  ImageBundleEntry entries[IMAGE_BUNDLE_MAX_IMAGES];
+  uint32_t count = 0;
+  BOOST_TEST(IBParse(bundle.data(), bundle.size(), entries, &count) == IBS_OK);
+
+  uint32_t order[IMAGE_BUNDLE_MAX_IMAGES];
+  uint32_t dependencies[IMAGE_BUNDLE_MAX_IMAGES];
+  BOOST_TEST(IBSortByDependencies(entries, count, order, dependencies) ==
+             IBS_DEPENDENCY_CYCLE);
+}
+
+BOOST_AUTO_TEST_CASE(golden_dll_test) {
+  std::vector<uint8_t> golden(kDynDXTLoader,
+                              kDynDXTLoader + sizeof(kDynDXTLoader));
+  ImageBundleEntry entries[IMAGE_BUNDLE_MAX_IMAGES];
+  uint32_t count = 0;
+  auto bundle = BuildBundle({golden, golden});
+  BOOST_TEST(IBParse(bundle.data(), bundle.size(), entries, &count) == IBS_OK);
+  BOOST_REQUIRE(entries[0].name);
+  std::string name = entries[0].name;
+
+  bundle = BuildBundle({BuildImage("plugin.dll", {"xbdm.dll", name}), golden});
+  BOOST_TEST(IBParse(bundle.data(), bundle.size(), entries, &count) == IBS_OK);
+  uint32_t order[IMAGE_BUNDLE_MAX_IMAGES];
+  uint32_t dependencies[IMAGE_BUNDLE_MAX_IMAGES];
+  BOOST_TEST(IBSortByDependencies(entries, count, order, dependencies) ==
+             IBS_OK);
+  BOOST_TEST(order[0] == 1);
+  BOOST_TEST(order[1] == 0);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_bundle_test) {
+  ImageBundleEntry entries[IMAGE_BUNDLE_MAX_IMAGES];
+  uint32_t count = 0;
+  auto image = BuildImage("a.dll", {});
+
+  auto bundle = BuildBundle({image});
+  bundle[0] ^= 0xFF;
+  BOOST_TEST(IBParse(bundle.data(), bundle.size(), entries, &count) ==
+             IBS_INVALID_HEADER);
+  BOOST_TEST(IBParse(bundle.data(), 6, entries, &count) == IBS_INVALID_HEADER);
+
+  bundle = BuildBundle({});
+  BOOST_TEST(IBParse(bundle.data(), bundle.size(), entries, &count) ==
+             IBS_INVALID_COUNT);
+  bundle = BuildBundle(std::vector<std::vector<uint8_t>>(
+      IMAGE_BUNDLE_MAX_IMAGES + 1, std::vector<uint8_t>(4)));
+  BOOST_TEST(IBParse(bundle.data(), bundle.size(), entries, &count) ==
+             IBS_INVALID_COUNT);
+
+  // The header claims more images than it has room for sizes.
+  bundle = BuildBundle({image, image});
+  BOOST_TEST(IBParse(bundle.data(), 12, entries, &count) == IBS_INVALID_HEADER);
+
+  // Truncated final image and trailing data.
+  BOOST_TEST(IBParse(bundle.data(), bundle.size() - 1, entries, &count) ==
+             IBS_SIZE_MISMATCH);
+  bundle.push_back(0);
+  BOOST_TEST(IBParse(bundle.data(), bundle.size(), entries, &count) ==
+             IBS_SIZE_MISMATCH);
+
+  // Images without valid headers are accepted but have no name.
+  bundle = BuildBundle({std::vector<uint8_t>(3)});
+  BOOST_TEST(IBParse(bundle.data(), bundle.size(), entries, &count) == IBS_OK);
+  BOOST_TEST(count == 1);
+  BOOST_TEST(!entries[0].name);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,183 @@
+#define BOOST_TEST_MODULE DXTLibraryTests
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+
+#include "image_cache.h"
+#include "sha256.h"
+#include "xbdm_stubs.h"
+
+static std::string HexDigest(const void *data, uint32_t size,
+                             uint32_t chunk_size) {
+  SHA256Context ctx;
+  SHA256Init(&ctx);
+  auto read_ptr = static_cast<const uint8_t *>(data);
+  while (size) {
+    uint32_t update_size = size < chunk_size ? size : chunk_size;
+    SHA256Update(&ctx, read_ptr, update_size);
+    read_ptr += update_size;
+    size -= update_size;
+  }
+
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  SHA256Final(&ctx, digest);
+
+  std::string ret;
+  char hex[3];
+  for (auto byte : digest) {
+    snprintf(hex, sizeof(hex), "%02x", byte);
+    ret += hex;
+  }
+  return ret;
+}
+
+// Reserves and commits an entry for `size` bytes filled with `fill`, using the
+// fill value as the digest.
+static bool AddEntry(uint32_t size, uint8_t fill) {
+  ImageCacheEntry *entry = ICReserve(size);
+  if (!entry) {
+    return false;
+  }
+  memset(entry->data, fill, size);
+
+  uint8_t digest[SHA256_DIGEST_SIZE] = {fill};
+  ICCommit(entry, digest);
+  return true;
+}
+
+static bool HasEntry(uint32_t size, uint8_t fill) {
+  uint8_t digest[SHA256_DIGEST_SIZE] = {fill};
+  const ImageCacheEntry *entry = ICLookup(digest, size);
+  return entry && entry->data[0] == fill && entry->data[size - 1] == fill;
+}
+
+BOOST_AUTO_TEST_SUITE(image_cache_suite)
+
+BOOST_AUTO_TEST_CASE(sha256_test) {
+  BOOST_TEST(
+      HexDigest("", 0, 1) ==
+      "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  BOOST_TEST(
+      HexDigest("abc", 3, 1) ==
+      "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+  static const char kTwoBlocks[] =
+      "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  for (uint32_t chunk_size : {1U, 13U, 64U, 1000U}) {
+    BOOST_TEST(
+        HexDigest(kTwoBlocks, sizeof(kTwoBlocks) - 1, chunk_size) ==
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+  }
+
+  std::vector<uint8_t> million_a(1000000, 'a');
+  BOOST_TEST(
+      HexDigest(million_a.data(), million_a.size(), 4096) ==
+      "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+BOOST_AUTO_TEST_CASE(lookup_test) {
+  ICReset();
+  ICSetBudget(IMAGE_CACHE_DEFAULT_BUDGET);
+
+  BOOST_TEST(AddEntry(100, 1));
+  BOOST_TEST(AddEntry(200, 2));
+  BOOST_TEST(ICGetNumEntries() == 2);
+  BOOST_TEST(ICGetUsage() == 300);
+
+  BOOST_TEST(HasEntry(100, 1));
+  BOOST_TEST(HasEntry(200, 2));
+  BOOST_TEST(!HasEntry(100, 2));
+  BOOST_TEST(!HasEntry(101, 1));
+
+  // Duplicate entries are discarded.
+  BOOST_TEST(AddEntry(100, 1));
+  BOOST_TEST(ICGetNumEntries() == 2);
+  BOOST_TEST(ICGetUsage() == 300);
+
+  ICReset();
+  BOOST_TEST(ICGetNumEntries() == 0);
+  BOOST_TEST(ICGetUsage() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(eviction_test) {
+  ICReset();
+  ICSetBudget(1000);
+
+  BOOST_TEST(AddEntry(400, 1));
+  BOOST_TEST(AddEntry(400, 2));
+  // Mark the first entry as most recently used.
+  BOOST_TEST(HasEntry(400, 1));
+
+  BOOST_TEST(AddEntry(400, 3));
+  BOOST_TEST(ICGetNumEntries() == 2);
+  BOOST_TEST(HasEntry(400, 1));
+  BOOST_TEST(!HasEntry(400, 2));
+  BOOST_TEST(HasEntry(400, 3));
+
+  // Images larger than the budget are never cached.
+  BOOST_TEST(!ICReserve(1001));
+  BOOST_TEST(ICGetNumEntries() == 2);
+
+  ICSetBudget(500);
+  BOOST_TEST(ICGetNumEntries() == 1);
+  BOOST_TEST(HasEntry(400, 3));
+  BOOST_TEST(ICGetUsage() == 400);
+
+  ICReset();
+  ICSetBudget(IMAGE_CACHE_DEFAULT_BUDGET);
+}
+
+BOOST_AUTO_TEST_CASE(release_reservation_test) {
+  ICReset();
+  ICSetBudget(1000);
+  PoolUsage baseline = GetPoolUsage();
+
+  ImageCacheEntry *first = ICReserve(600);
+  BOOST_TEST(first);
+  BOOST_TEST(ICGetUsage() == 600);
+
+  // Outstanding reservations count against the budget but are not evictable.
+  BOOST_TEST(!ICReserve(600));
+
+  ICRelease(first);
+  BOOST_TEST(ICGetUsage() == 0);
+  BOOST_TEST(ICGetNumEntries() == 0);
+
+  PoolUsage usage = GetPoolUsage();
+  BOOST_TEST(usage.blocks == baseline.blocks);
+  BOOST_TEST(usage.bytes == baseline.bytes);
+
+  ICSetBudget(IMAGE_CACHE_DEFAULT_BUDGET);
+}
+
+BOOST_AUTO_TEST_CASE(pin_test) {
+  ICReset();
+  ICSetBudget(1000);
+
+  BOOST_TEST(AddEntry(400, 1));
+  uint8_t digest[SHA256_DIGEST_SIZE] = {1};
+  const ImageCacheEntry *pinned = ICLookup(digest, 0);
+  BOOST_TEST(pinned);
+  ICPin(pinned);
+
+  // The pinned entry is retained even though it is least recently used.
+  BOOST_TEST(AddEntry(400, 2));
+  BOOST_TEST(AddEntry(400, 3));
+  BOOST_TEST(ICGetNumEntries() == 2);
+  BOOST_TEST(HasEntry(400, 1));
+  BOOST_TEST(HasEntry(400, 3));
+
+  ICReset();
+  BOOST_TEST(ICGetNumEntries() == 1);
+
+  // Pinned entries exceeding a reduced budget are evicted once unpinned.
+  ICSetBudget(100);
+  BOOST_TEST(ICGetNumEntries() == 1);
+  ICUnpin(pinned);
+  BOOST_TEST(ICGetNumEntries() == 0);
+  BOOST_TEST(ICGetUsage() == 0);
+
+  ICSetBudget(IMAGE_CACHE_DEFAULT_BUDGET);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
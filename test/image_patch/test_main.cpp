@@ -0,0 +1,163 @@
+#define BOOST_TEST_MODULE DXTLibraryTests
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+#include <vector>
+
+#include "golden_dll.h"
+#include "image_diff.h"
+#include "image_patch.h"
+
+static bool AppendOutput(void *sink_context, const void *data, uint32_t size) {
+  auto output = static_cast<std::vector<uint8_t> *>(sink_context);
+  auto bytes = static_cast<const uint8_t *>(data);
+  output->insert(output->end(), bytes, bytes + size);
+  return true;
+}
+
+static bool RejectOutput(void *sink_context, const void *data, uint32_t size) {
+  return false;
+}
+
+static std::vector<uint8_t> CreatePatch(const std::vector<uint8_t> &base,
+                                        const uint8_t *target,
+                                        uint32_t target_size) {
+  uint32_t patch_size = 0;
+  uint8_t *patch = IDCreatePatch(base.data(), base.size(), target, target_size,
+                                 &patch_size);
+  BOOST_REQUIRE(patch);
+  std::vector<uint8_t> ret(patch, patch + patch_size);
+  free(patch);
+  return ret;
+}
+
+// Applies `patch` to `base`, passing it to the decoder in chunks of at most
+// `chunk_size` bytes.
+static bool ApplyPatch(const std::vector<uint8_t> &base,
+                       const std::vector<uint8_t> &patch, uint32_t output_size,
+                       uint32_t chunk_size, std::vector<uint8_t> *output) {
+  ImagePatchDecoder decoder;
+  ImagePatchBegin(&decoder, base.data(), base.size(), output_size,
+                  AppendOutput, output);
+
+  for (uint32_t offset = 0; offset < patch.size(); offset += chunk_size) {
+    uint32_t size = patch.size() - offset;
+    if (size > chunk_size) {
+      size = chunk_size;
+    }
+    if (!ImagePatchWrite(&decoder, patch.data() + offset, size)) {
+      return false;
+    }
+  }
+  return ImagePatchEnd(&decoder);
+}
+
+BOOST_AUTO_TEST_SUITE(image_patch_suite)
+
+BOOST_AUTO_TEST_CASE(decode_reference_patch_test) {
+  const std::vector<uint8_t> base = {'a', 'b', 'c', 'd', 'e', 'f'};
+  // Copy "cde", insert "xy", copy "ab".
+  const std::vector<uint8_t> patch = {0x01, 0x02, 0x03, 0x02, 0x02,
+                                      'x',  'y',  0x01, 0x00, 0x02};
+  std::vector<uint8_t> output;
+
+  BOOST_TEST(ApplyPatch(base, patch, 7, 1, &output));
+  const std::vector<uint8_t> expected = {'c', 'd', 'e', 'x', 'y', 'a', 'b'};
+  BOOST_TEST((output == expected));
+}
+
+BOOST_AUTO_TEST_CASE(golden_dll_round_trip_test) {
+  // Simulate an earlier build of the golden DLL with modified, removed, and
+  // additional content.
+  std::vector<uint8_t> base(kDynDXTLoader,
+                            kDynDXTLoader + sizeof(kDynDXTLoader));
+  for (uint32_t i = 0x400; i < base.size(); i += 0x1000) {
+    base[i] ^= 0xFF;
+    base[i + 1] += 1;
+  }
+  base.erase(base.begin() + 0x2000, base.begin() + 0x2100);
+  base.insert(base.begin() + 0x5000, 0x180, 0xCC);
+
+  auto patch = CreatePatch(base, kDynDXTLoader, sizeof(kDynDXTLoader));
+  BOOST_TEST(patch.size() < sizeof(kDynDXTLoader) / 20);
+
+  for (uint32_t chunk_size : {1U, 7U, 4096U}) {
+    std::vector<uint8_t> output;
+    BOOST_TEST(ApplyPatch(base, patch, sizeof(kDynDXTLoader), chunk_size,
+                          &output));
+    BOOST_TEST(output.size() == sizeof(kDynDXTLoader));
+    BOOST_TEST(!memcmp(output.data(), kDynDXTLoader, sizeof(kDynDXTLoader)),
+               "Mismatch with chunk size " << chunk_size);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(unrelated_base_round_trip_test) {
+  const std::vector<uint8_t> base(64, 0xAB);
+  auto patch = CreatePatch(base, kDynDXTLoader, sizeof(kDynDXTLoader));
+
+  std::vector<uint8_t> output;
+  BOOST_TEST(ApplyPatch(base, patch, sizeof(kDynDXTLoader), 4096, &output));
+  BOOST_TEST(output.size() == sizeof(kDynDXTLoader));
+  BOOST_TEST(!memcmp(output.data(), kDynDXTLoader, sizeof(kDynDXTLoader)));
+
+  // Empty targets produce empty patches.
+  patch = CreatePatch(base, kDynDXTLoader, 0);
+  BOOST_TEST(patch.empty());
+}
+
+BOOST_AUTO_TEST_CASE(corrupt_input_test) {
+  const std::vector<uint8_t> base = {'a', 'b', 'c', 'd'};
+  std::vector<uint8_t> output;
+  ImagePatchDecoder decoder;
+
+  // Unknown opcode.
+  const uint8_t bad_opcode[] = {0x03, 0x00};
+  ImagePatchBegin(&decoder, base.data(), base.size(), 4, AppendOutput,
+                  &output);
+  BOOST_TEST(!ImagePatchWrite(&decoder, bad_opcode, sizeof(bad_opcode)));
+  BOOST_TEST(decoder.status == IPS_CORRUPT_INPUT);
+  BOOST_TEST(!ImagePatchWrite(&decoder, bad_opcode, 1));
+
+  // Copy beyond the end of the base image.
+  const uint8_t bad_copy[] = {0x01, 0x02, 0x03};
+  ImagePatchBegin(&decoder, base.data(), base.size(), 4, AppendOutput,
+                  &output);
+  BOOST_TEST(!ImagePatchWrite(&decoder, bad_copy, sizeof(bad_copy)));
+  BOOST_TEST(decoder.status == IPS_INVALID_COPY);
+
+  // Argument that does not fit in 32 bits.
+  const uint8_t bad_argument[] = {0x02, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F};
+  ImagePatchBegin(&decoder, base.data(), base.size(), 4, AppendOutput,
+                  &output);
+  BOOST_TEST(!ImagePatchWrite(&decoder, bad_argument, sizeof(bad_argument)));
+  BOOST_TEST(decoder.status == IPS_CORRUPT_INPUT);
+
+  // Output larger than expected.
+  const uint8_t overrun[] = {0x01, 0x00, 0x04};
+  ImagePatchBegin(&decoder, base.data(), base.size(), 2, AppendOutput,
+                  &output);
+  BOOST_TEST(!ImagePatchWrite(&decoder, overrun, sizeof(overrun)));
+  BOOST_TEST(decoder.status == IPS_OUTPUT_OVERRUN);
+
+  // Patch ends mid-operation.
+  const uint8_t insert[] = {0x02, 0x02, 'x', 'y'};
+  ImagePatchBegin(&decoder, base.data(), base.size(), 2, AppendOutput,
+                  &output);
+  BOOST_TEST(ImagePatchWrite(&decoder, insert, 3));
+  BOOST_TEST(!ImagePatchEnd(&decoder));
+  BOOST_TEST(decoder.status == IPS_TRUNCATED_INPUT);
+
+  // Patch produces less output than expected.
+  ImagePatchBegin(&decoder, base.data(), base.size(), 3, AppendOutput,
+                  &output);
+  BOOST_TEST(ImagePatchWrite(&decoder, insert, sizeof(insert)));
+  BOOST_TEST(!ImagePatchEnd(&decoder));
+  BOOST_TEST(decoder.status == IPS_TRUNCATED_INPUT);
+
+  // Sink failures are propagated.
+  ImagePatchBegin(&decoder, base.data(), base.size(), 2, RejectOutput,
+                  nullptr);
+  BOOST_TEST(!ImagePatchWrite(&decoder, insert, sizeof(insert)));
+  BOOST_TEST(decoder.status == IPS_SINK_FAILED);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
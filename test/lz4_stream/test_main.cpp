@@ -0,0 +1,138 @@
+#define BOOST_TEST_MODULE DXTLibraryTests
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+
+#include "golden_dll.h"
+#include "lz4_compress.h"
+#include "lz4_stream.h"
+
+static bool AppendOutput(void *sink_context, const void *data, uint32_t size) {
+  auto output = static_cast<std::vector<uint8_t> *>(sink_context);
+  auto bytes = static_cast<const uint8_t *>(data);
+  output->insert(output->end(), bytes, bytes + size);
+  return true;
+}
+
+static bool RejectOutput(void *sink_context, const void *data, uint32_t size) {
+  return false;
+}
+
+static std::vector<uint8_t> Compress(const uint8_t *data, uint32_t size) {
+  std::vector<uint8_t> ret(LZ4CompressBound(size));
+  ret.resize(LZ4Compress(data, size, ret.data()));
+  return ret;
+}
+
+// Decompresses `compressed`, passing it to the decoder in chunks of at most
+// `chunk_size` bytes.
+static bool Decompress(const std::vector<uint8_t> &compressed,
+                       uint32_t output_size, uint32_t chunk_size,
+                       std::vector<uint8_t> *output) {
+  std::vector<uint8_t> window(LZ4_STREAM_WINDOW_SIZE);
+  LZ4StreamDecoder decoder;
+  LZ4StreamBegin(&decoder, window.data(), output_size, AppendOutput, output);
+
+  for (uint32_t offset = 0; offset < compressed.size(); offset += chunk_size) {
+    uint32_t size = compressed.size() - offset;
+    if (size > chunk_size) {
+      size = chunk_size;
+    }
+    if (!LZ4StreamWrite(&decoder, compressed.data() + offset, size)) {
+      return false;
+    }
+  }
+  return LZ4StreamEnd(&decoder);
+}
+
+BOOST_AUTO_TEST_SUITE(lz4_stream_suite)
+
+BOOST_AUTO_TEST_CASE(decode_reference_block_test) {
+  // "abc" followed by a 16 byte overlapping match and 5 trailing literals.
+  const std::vector<uint8_t> compressed = {0x3C, 'a', 'b', 'c', 0x03, 0x00,
+                                           0x50, 'b', 'c', 'a', 'b', 'c'};
+  std::vector<uint8_t> output;
+
+  BOOST_TEST(Decompress(compressed, 24, compressed.size(), &output));
+  std::string expected = "abcabcabcabcabcabcabcabc";
+  BOOST_TEST(std::string(output.begin(), output.end()) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(golden_dll_round_trip_test) {
+  auto compressed = Compress(kDynDXTLoader, sizeof(kDynDXTLoader));
+  BOOST_TEST(compressed.size() < sizeof(kDynDXTLoader) * 3 / 5);
+
+  for (uint32_t chunk_size : {1U, 7U, 1024U, 0x10000U}) {
+    std::vector<uint8_t> output;
+    BOOST_TEST(Decompress(compressed, sizeof(kDynDXTLoader), chunk_size,
+                          &output));
+    BOOST_TEST(output.size() == sizeof(kDynDXTLoader));
+    BOOST_TEST(!memcmp(output.data(), kDynDXTLoader, sizeof(kDynDXTLoader)),
+               "Mismatch with chunk size " << chunk_size);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(window_wrap_round_trip_test) {
+  // Large enough to wrap the history window several times, with repeats that
+  // reference data near the maximum match distance.
+  std::vector<uint8_t> input(LZ4_STREAM_WINDOW_SIZE * 3 + 123);
+  uint32_t state = 1;
+  for (uint32_t i = 0; i < LZ4_STREAM_WINDOW_SIZE - 16; ++i) {
+    state = state * 1103515245 + 12345;
+    input[i] = state >> 16;
+  }
+  for (uint32_t i = LZ4_STREAM_WINDOW_SIZE - 16; i < input.size(); ++i) {
+    input[i] = input[i - (LZ4_STREAM_WINDOW_SIZE - 16)];
+  }
+
+  auto compressed = Compress(input.data(), input.size());
+  BOOST_TEST(compressed.size() < input.size() / 2);
+
+  for (uint32_t chunk_size : {3U, 4096U}) {
+    std::vector<uint8_t> output;
+    BOOST_TEST(Decompress(compressed, input.size(), chunk_size, &output));
+    BOOST_TEST((output == input));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(short_input_round_trip_test) {
+  for (uint32_t size : {0U, 1U, 12U, 13U, 40U}) {
+    std::vector<uint8_t> input(size, 'x');
+    auto compressed = Compress(input.data(), input.size());
+    std::vector<uint8_t> output;
+    BOOST_TEST(Decompress(compressed, size, 1, &output));
+    BOOST_TEST((output == input));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(corrupt_input_test) {
+  std::vector<uint8_t> output;
+  std::vector<uint8_t> window(LZ4_STREAM_WINDOW_SIZE);
+  LZ4StreamDecoder decoder;
+
+  // Match offset beyond the start of the output.
+  const uint8_t bad_offset[] = {0x10, 'a', 0x02, 0x00};
+  LZ4StreamBegin(&decoder, window.data(), 64, AppendOutput, &output);
+  BOOST_TEST(!LZ4StreamWrite(&decoder, bad_offset, sizeof(bad_offset)));
+  BOOST_TEST(decoder.status == LZ4S_CORRUPT_INPUT);
+  BOOST_TEST(!LZ4StreamWrite(&decoder, bad_offset, 1));
+
+  // Output larger than expected.
+  const uint8_t overrun[] = {0x30, 'a', 'b', 'c'};
+  LZ4StreamBegin(&decoder, window.data(), 2, AppendOutput, &output);
+  BOOST_TEST(!LZ4StreamWrite(&decoder, overrun, sizeof(overrun)));
+  BOOST_TEST(decoder.status == LZ4S_OUTPUT_OVERRUN);
+
+  // Stream ends mid-sequence.
+  LZ4StreamBegin(&decoder, window.data(), 3, AppendOutput, &output);
+  BOOST_TEST(LZ4StreamWrite(&decoder, overrun, 3));
+  BOOST_TEST(!LZ4StreamEnd(&decoder));
+  BOOST_TEST(decoder.status == LZ4S_TRUNCATED_INPUT);
+
+  // Sink failures are propagated.
+  LZ4StreamBegin(&decoder, window.data(), 3, RejectOutput, nullptr);
+  BOOST_TEST(!LZ4StreamWrite(&decoder, overrun, sizeof(overrun)));
+  BOOST_TEST(decoder.status == LZ4S_SINK_FAILED);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,301 @@
+// Measures module registry registration and lookup costs.
+//
+// Usage: module_registry_benchmark [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "module_registry.h"
+#include "util.h"
+#include "winapi/winnt.h"
+#include "xbdm_stubs.h"
+
+// Number of ordinals exported by xboxkrnl.exe.
+static constexpr uint32_t kKernelExports = 370;
+
+static double TimeMicroseconds(uint32_t iterations,
+                               const std::function<void()> &body) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; ++i) {
+    body();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         iterations;
+}
+
+static void RegisterDenseModule(const char *module_name, uint32_t base,
+                                uint32_t count) {
+  ModuleExport entry = {0};
+  for (uint32_t i = 0; i < count; ++i) {
+    entry.ordinal = base + i;
+    entry.address = 0x80010000 + entry.ordinal;
+    MRRegisterMethod(module_name, &entry);
+  }
+}
+
+static void BenchmarkRegistration(uint32_t iterations, uint32_t count) {
+  double us = TimeMicroseconds(iterations, [count]() {
+    MRResetRegistry();
+    RegisterDenseModule("xboxkrnl.exe", 1, count);
+  });
+  printf("register %5u ordinals: %10.2f us\n", count, us);
+}
+
+static void BenchmarkBulkRegistration(uint32_t iterations, uint32_t count) {
+  std::vector<ModuleExport> exports(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    exports[i].ordinal = 1 + i;
+    exports[i].address = 0x80010000 + exports[i].ordinal;
+  }
+
+  double us = TimeMicroseconds(iterations, [&exports]() {
+    MRResetRegistry();
+    MRRegisterMethods("xboxkrnl.exe", exports.data(), exports.size(), 0);
+  });
+  printf("register %5u ordinals (bulk): %10.2f us\n", count, us);
+}
+
+// Mirrors the registration of the loader's own exports in DXTMain.
+static constexpr uint32_t kLoaderExports = 14;
+
+static void BenchmarkLoaderExportRegistration(uint32_t iterations) {
+  std::vector<std::string> names;
+  for (uint32_t i = 0; i < kLoaderExports; ++i) {
+    names.push_back("LoaderExport" + std::to_string(i));
+    names.push_back(names.back() + "@12");
+  }
+
+  double us = TimeMicroseconds(iterations, [&names]() {
+    MRResetRegistry();
+    for (uint32_t i = 0; i < kLoaderExports; ++i) {
+      ModuleExport entry;
+      entry.ordinal = 2 + i;
+      entry.method_name = PoolStrdup(names[i * 2 + 1].c_str(), 0);
+      entry.alias = PoolStrdup(names[i * 2].c_str(), 0);
+      entry.address = 0x10000 + i;
+      MRRegisterMethod("dynamic_dxt_loader.dll", &entry);
+    }
+  });
+  printf("register %5u loader exports (per call): %10.2f us\n",
+         kLoaderExports, us);
+
+  std::vector<ModuleExport> exports(kLoaderExports);
+  for (uint32_t i = 0; i < kLoaderExports; ++i) {
+    exports[i].ordinal = 2 + i;
+    exports[i].method_name = const_cast<char *>(names[i * 2 + 1].c_str());
+    exports[i].alias = const_cast<char *>(names[i * 2].c_str());
+    exports[i].address = 0x10000 + i;
+  }
+  us = TimeMicroseconds(iterations, [&exports]() {
+    MRResetRegistry();
+    MRRegisterMethods("dynamic_dxt_loader.dll", exports.data(),
+                      exports.size(), MR_FLAG_STATIC);
+  });
+  printf("register %5u loader exports (static):   %10.2f us\n",
+         kLoaderExports, us);
+}
+
+// Compares eagerly copying a module's export table into the registry against
+// linking it lazily from an in-memory image.
+static void BenchmarkLazyLink(uint32_t iterations, uint32_t count) {
+  std::vector<uint8_t> image(sizeof(IMAGE_EXPORT_DIRECTORY) +
+                             count * sizeof(uint32_t));
+  auto directory = reinterpret_cast<IMAGE_EXPORT_DIRECTORY *>(image.data());
+  directory->Base = 1;
+  directory->NumberOfFunctions = count;
+  directory->AddressOfFunctions = sizeof(*directory);
+  auto functions = reinterpret_cast<uint32_t *>(directory + 1);
+  for (uint32_t i = 0; i < count; ++i) {
+    functions[i] = 0x1000 + i * 0x10;
+  }
+
+  std::vector<ModuleExport> exports(count);
+  double eager_us = TimeMicroseconds(iterations, [&]() {
+    MRResetRegistry();
+    for (uint32_t i = 0; i < count; ++i) {
+      exports[i].ordinal = directory->Base + i;
+      exports[i].address = functions[i] + (intptr_t)image.data();
+    }
+    MRRegisterMethods("xboxkrnl.exe", exports.data(), count, 0);
+  });
+  PoolUsage eager_usage = GetPoolUsage();
+
+  double lazy_us = TimeMicroseconds(iterations, [&]() {
+    MRResetRegistry();
+    MRRegisterLazyModule("xboxkrnl.exe", image.data(), directory, 0);
+  });
+  PoolUsage lazy_usage = GetPoolUsage();
+
+  printf("link     %5u ordinals: eager %8.2f us / %6u bytes, lazy %8.2f us / "
+         "%6u bytes\n",
+         count, eager_us, eager_usage.bytes, lazy_us, lazy_usage.bytes);
+}
+
+static void BenchmarkOrdinalLookup(uint32_t iterations, uint32_t count) {
+  MRResetRegistry();
+  RegisterDenseModule("xboxkrnl.exe", 1, count);
+
+  volatile uint32_t sink = 0;
+  double us = TimeMicroseconds(iterations, [count, &sink]() {
+    uint32_t result;
+    for (uint32_t ordinal = 1; ordinal <= count; ++ordinal) {
+      MRGetMethodByOrdinal("xboxkrnl.exe", ordinal, &result);
+      sink = sink + result;
+    }
+  });
+  printf("lookup   %5u ordinals: %10.2f us (%.1f ns/lookup)\n", count, us,
+         us * 1000.0 / count);
+}
+
+static std::vector<std::string> RegisterNamedModule(const char *module_name,
+                                                    uint32_t count) {
+  std::vector<std::string> names;
+  ModuleExport entry = {0};
+  for (uint32_t i = 0; i < count; ++i) {
+    std::string alias = "KernelExport" + std::to_string(i);
+    std::string name = alias + "@8";
+    entry.ordinal = i + 1;
+    entry.method_name = PoolStrdup(name.c_str(), 0);
+    entry.alias = PoolStrdup(alias.c_str(), 0);
+    entry.address = 0x80010000 + entry.ordinal;
+    MRRegisterMethod(module_name, &entry);
+    names.push_back(name);
+    names.push_back(alias);
+  }
+  return names;
+}
+
+static void BenchmarkNameLookup(uint32_t iterations, uint32_t count) {
+  MRResetRegistry();
+  auto names = RegisterNamedModule("xboxkrnl.exe", count);
+
+  volatile uint32_t sink = 0;
+  double us = TimeMicroseconds(iterations, [&names, &sink]() {
+    uint32_t result;
+    for (const auto &name : names) {
+      MRGetMethodByName("xboxkrnl.exe", name.c_str(), &result);
+      sink = sink + result;
+    }
+  });
+  printf("lookup   %5zu names:    %10.2f us (%.1f ns/lookup)\n", names.size(),
+         us, us * 1000.0 / names.size());
+}
+
+// Compares unhinted lookups against lookups given the hint an import library
+// would record, for both explicitly registered and lazily linked modules.
+static void BenchmarkHintedNameLookup(uint32_t iterations, uint32_t count) {
+  MRResetRegistry();
+  std::vector<std::string> aliases;
+  std::vector<ModuleExport> exports(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    char alias[32];
+    snprintf(alias, sizeof(alias), "PluginExport%05u", i);
+    aliases.push_back(alias);
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    exports[i].ordinal = i + 1;
+    exports[i].alias = const_cast<char *>(aliases[i].c_str());
+    exports[i].address = 0x10000 + i;
+  }
+  MRRegisterMethods("plugin.dll", exports.data(), count, MR_FLAG_STATIC);
+
+  // An export directory naming every function, sorted as required by the PE
+  // format.
+  std::vector<uint8_t> image(sizeof(IMAGE_EXPORT_DIRECTORY) +
+                             count * (2 * sizeof(uint32_t) + sizeof(uint16_t)) +
+                             count * 32);
+  auto directory = reinterpret_cast<IMAGE_EXPORT_DIRECTORY *>(image.data());
+  directory->Base = 1;
+  directory->NumberOfFunctions = count;
+  directory->NumberOfNames = count;
+  directory->AddressOfFunctions = sizeof(*directory);
+  directory->AddressOfNames =
+      directory->AddressOfFunctions + count * sizeof(uint32_t);
+  directory->AddressOfNameOrdinals =
+      directory->AddressOfNames + count * sizeof(uint32_t);
+  uint32_t string_offset =
+      directory->AddressOfNameOrdinals + count * sizeof(uint16_t);
+  auto functions = reinterpret_cast<uint32_t *>(
+      image.data() + directory->AddressOfFunctions);
+  auto names =
+      reinterpret_cast<uint32_t *>(image.data() + directory->AddressOfNames);
+  auto name_ordinals = reinterpret_cast<uint16_t *>(
+      image.data() + directory->AddressOfNameOrdinals);
+  for (uint32_t i = 0; i < count; ++i) {
+    functions[i] = 0x1000 + i * 0x10;
+    names[i] = string_offset + i * 32;
+    name_ordinals[i] = i;
+    strcpy(reinterpret_cast<char *>(image.data() + names[i]),
+           aliases[i].c_str());
+  }
+  MRRegisterLazyModule("peer.dll", image.data(), directory, 0);
+
+  for (const char *module_name : {"plugin.dll", "peer.dll"}) {
+    void *handle;
+    MRGetModuleHandle(module_name, &handle);
+
+    volatile uint32_t sink = 0;
+    double us = TimeMicroseconds(iterations, [&]() {
+      uint32_t result;
+      for (const auto &alias : aliases) {
+        MRGetMethodByNameInModule(handle, alias.c_str(), &result);
+        sink = sink + result;
+      }
+    });
+    double hinted_us = TimeMicroseconds(iterations, [&]() {
+      uint32_t result;
+      for (uint32_t i = 0; i < count; ++i) {
+        MRGetMethodByNameWithHintInModule(handle, aliases[i].c_str(), i,
+                                          &result);
+        sink = sink + result;
+      }
+    });
+    printf("lookup   %5u names in %-10s: %8.1f ns/lookup, hinted %8.1f "
+           "ns/lookup\n",
+           count, module_name, us * 1000.0 / count, hinted_us * 1000.0 / count);
+  }
+}
+
+static void ReportPoolUsage(uint32_t count) {
+  MRResetRegistry();
+  PoolUsage baseline = GetPoolUsage();
+  RegisterNamedModule("xboxkrnl.exe", count);
+  PoolUsage usage = GetPoolUsage();
+
+  uint32_t blocks = usage.blocks - baseline.blocks;
+  uint32_t bytes = usage.bytes - baseline.bytes;
+  printf("pool     %5u exports:  %10u bytes in %u blocks (%.1f bytes, %.2f "
+         "blocks/export)\n",
+         count, bytes, blocks, (double)bytes / count, (double)blocks / count);
+}
+
+int main(int argc, char **argv) {
+  uint32_t iterations = 200;
+  if (argc > 1) {
+    iterations = strtoul(argv[1], nullptr, 0);
+  }
+
+  BenchmarkRegistration(iterations, kKernelExports);
+  BenchmarkRegistration(iterations, kKernelExports * 4);
+  BenchmarkBulkRegistration(iterations, kKernelExports);
+  BenchmarkBulkRegistration(iterations, kKernelExports * 4);
+  BenchmarkLoaderExportRegistration(iterations);
+  MRResetRegistry();
+  BenchmarkLazyLink(iterations, kKernelExports);
+  BenchmarkOrdinalLookup(iterations, kKernelExports);
+  BenchmarkOrdinalLookup(iterations, kKernelExports * 4);
+  BenchmarkNameLookup(iterations, kKernelExports);
+  BenchmarkNameLookup(iterations, kKernelExports * 4);
+  BenchmarkHintedNameLookup(iterations, 4096);
+  ReportPoolUsage(kKernelExports);
+  ReportPoolUsage(kKernelExports * 4);
+
+  MRResetRegistry();
+  return 0;
+}
@@ -1,8 +1,12 @@
 #define BOOST_TEST_MODULE DXTLibraryTests
 #include <boost/test/unit_test.hpp>
 #include <string>
+#include <vector>
 
 #include "module_registry.h"
+#include "util.h"
+#include "winapi/winnt.h"
+#include "xbdm_stubs.h"
 
 static bool RegisterExport(const char *name, const char *alias,
                            uint32_t ordinal, uint32_t address);
@@ -97,6 +101,548 @@ BOOST_AUTO_TEST_CASE(resolve_by_name_and_alias_test) {
   BOOST_TEST(result == 0x00432100);
 }
 
+BOOST_AUTO_TEST_CASE(resolve_by_module_handle_test) {
+  MRResetRegistry();
+
+  RegisterExport("M1", "E1@0", "E1", 1, 0x00123400);
+  RegisterExport("M1", "E2@1234", "E2", 2, 0x00432100);
+  RegisterExport("M2", "E1@4", "E1", 1, 0x01);
+
+  void *handle;
+  BOOST_TEST(!MRGetModuleHandle("M3", &handle));
+  BOOST_TEST(handle == nullptr);
+
+  void *m2;
+  BOOST_TEST(MRGetModuleHandle("M2", &m2));
+  BOOST_TEST(MRGetModuleHandle("M1", &handle));
+  BOOST_TEST(handle != m2);
+
+  uint32_t result;
+  BOOST_TEST(MRGetMethodByOrdinalInModule(handle, 2, &result));
+  BOOST_TEST(result == 0x00432100);
+  BOOST_TEST(!MRGetMethodByOrdinalInModule(handle, 3, &result));
+  BOOST_TEST(result == 0);
+
+  BOOST_TEST(MRGetMethodByNameInModule(handle, "E1", &result));
+  BOOST_TEST(result == 0x00123400);
+  BOOST_TEST(MRGetMethodByNameInModule(m2, "E1@4", &result));
+  BOOST_TEST(result == 0x01);
+  BOOST_TEST(!MRGetMethodByNameInModule(m2, "E2", &result));
+
+  BOOST_TEST(!MRGetMethodByOrdinalInModule(nullptr, 1, &result));
+  BOOST_TEST(!MRGetMethodByNameInModule(nullptr, "E1", &result));
+}
+
+BOOST_AUTO_TEST_CASE(sparse_ordinals_test) {
+  MRResetRegistry();
+
+  // Ordinals below the initial base, far outliers, and values that later fall
+  // within the indexed range should all be retrievable.
+  static const uint32_t kOrdinals[] = {100, 90, 5000, 0xFFFFFFFF, 1, 200, 0};
+  for (auto ordinal : kOrdinals) {
+    RegisterExport("M1", nullptr, nullptr, ordinal, ordinal + 1);
+  }
+  for (uint32_t ordinal = 101; ordinal < 300; ++ordinal) {
+    RegisterExport("M1", nullptr, nullptr, ordinal, ordinal + 1);
+  }
+
+  const uint32_t expected_exports = 7 + 199 - 1;
+  BOOST_TEST(MRGetTotalNumExports() == expected_exports);
+
+  uint32_t result;
+  for (auto ordinal : kOrdinals) {
+    BOOST_TEST_CONTEXT("Ordinal " << ordinal) {
+      BOOST_TEST(MRGetMethodByOrdinal("M1", ordinal, &result));
+      BOOST_TEST(result == ordinal + 1);
+    }
+  }
+  for (uint32_t ordinal = 101; ordinal < 300; ++ordinal) {
+    BOOST_TEST(MRGetMethodByOrdinal("M1", ordinal, &result));
+    BOOST_TEST(result == ordinal + 1);
+  }
+  BOOST_TEST(!MRGetMethodByOrdinal("M1", 2, &result));
+  BOOST_TEST(!MRGetMethodByOrdinal("M1", 4999, &result));
+
+  // Overwriting an outlier should not add a new entry.
+  RegisterExport("M1", nullptr, nullptr, 5000, 0xF00D);
+  BOOST_TEST(MRGetTotalNumExports() == expected_exports);
+  BOOST_TEST(MRGetMethodByOrdinal("M1", 5000, &result));
+  BOOST_TEST(result == 0xF00D);
+
+  ModuleRegistryCursor cursor;
+  MREnumerateRegistryBegin(&cursor);
+  const char *module;
+  const ModuleExport *module_export;
+  uint32_t enumerated = 0;
+  while (MREnumerateRegistry(&module, &module_export, &cursor)) {
+    ++enumerated;
+  }
+  BOOST_TEST(enumerated == expected_exports);
+}
+
+BOOST_AUTO_TEST_CASE(resolve_by_name_with_collisions_test) {
+  MRResetRegistry();
+
+  // Enough names to force several index resizes and probe sequence collisions.
+  const uint32_t kNumExports = 500;
+  for (uint32_t i = 0; i < kNumExports; ++i) {
+    std::string name = "Export" + std::to_string(i) + "@4";
+    std::string alias = "Export" + std::to_string(i);
+    RegisterExport("M1", name.c_str(), alias.c_str(), i, 0x1000 + i);
+  }
+
+  uint32_t result;
+  for (uint32_t i = 0; i < kNumExports; ++i) {
+    BOOST_TEST_CONTEXT("Export " << i) {
+      std::string name = "Export" + std::to_string(i) + "@4";
+      BOOST_TEST(MRGetMethodByName("M1", name.c_str(), &result));
+      BOOST_TEST(result == 0x1000 + i);
+
+      std::string alias = "Export" + std::to_string(i);
+      BOOST_TEST(MRGetMethodByName("M1", alias.c_str(), &result));
+      BOOST_TEST(result == 0x1000 + i);
+    }
+  }
+  BOOST_TEST(!MRGetMethodByName("M1", "Export500", &result));
+  BOOST_TEST(!MRGetMethodByName("M1", "Export", &result));
+}
+
+BOOST_AUTO_TEST_CASE(replace_alias_updates_name_index_test) {
+  MRResetRegistry();
+
+  RegisterExport("M1", "E1@0", "E1", 1, 0x01);
+  RegisterExport("M1", "E2@0", "Shared", 2, 0x02);
+  RegisterExport("M1", "E3@0", "Shared", 3, 0x03);
+
+  // Replacing the export should drop its previous names.
+  RegisterExport("M1", "E1@0", "Renamed", 1, 0x11);
+
+  uint32_t result;
+  BOOST_TEST(!MRGetMethodByName("M1", "E1", &result));
+  BOOST_TEST(MRGetMethodByName("M1", "Renamed", &result));
+  BOOST_TEST(result == 0x11);
+  BOOST_TEST(MRGetMethodByName("M1", "E1@0", &result));
+  BOOST_TEST(result == 0x11);
+
+  // Replacing one of several exports sharing an alias should leave the alias
+  // resolvable through the remaining export.
+  RegisterExport("M1", "E3@0", nullptr, 3, 0x13);
+  BOOST_TEST(MRGetMethodByName("M1", "Shared", &result));
+  BOOST_TEST(result == 0x02);
+
+  RegisterExport("M1", nullptr, nullptr, 2, 0x12);
+  BOOST_TEST(!MRGetMethodByName("M1", "Shared", &result));
+  BOOST_TEST(!MRGetMethodByName("M1", "E2@0", &result));
+  BOOST_TEST(MRGetMethodByName("M1", "E3@0", &result));
+  BOOST_TEST(result == 0x13);
+
+  // Repeatedly renaming a single export must not exhaust the index.
+  for (uint32_t i = 0; i < 100; ++i) {
+    std::string alias = "Alias" + std::to_string(i);
+    RegisterExport("M1", nullptr, alias.c_str(), 4, i);
+  }
+  BOOST_TEST(MRGetTotalNumExports() == 4);
+  BOOST_TEST(!MRGetMethodByName("M1", "Alias98", &result));
+  BOOST_TEST(MRGetMethodByName("M1", "Alias99", &result));
+  BOOST_TEST(result == 99);
+}
+
+BOOST_AUTO_TEST_CASE(reset_releases_pool_memory_test) {
+  MRResetRegistry();
+  PoolUsage baseline = GetPoolUsage();
+
+  for (uint32_t i = 0; i < 200; ++i) {
+    std::string name = "Export" + std::to_string(i) + "@4";
+    std::string alias = "Export" + std::to_string(i);
+    RegisterExport("M1", name.c_str(), alias.c_str(), i, i);
+    RegisterExport("M2", name.c_str(), nullptr, i, i);
+  }
+
+  // Caller strings are retained until their export is replaced, while the
+  // registry's own storage is carved out of a small number of large blocks.
+  uint32_t caller_blocks = 200 * 3;
+  PoolUsage usage = GetPoolUsage();
+  BOOST_TEST(usage.blocks - baseline.blocks - caller_blocks < 40);
+
+  RegisterExport("M1", "Export0@4", nullptr, 0, 0);
+  PoolUsage replaced = GetPoolUsage();
+  BOOST_TEST(replaced.blocks == usage.blocks - 1);
+
+  uint32_t result;
+  BOOST_TEST(MRGetMethodByName("M1", "Export199", &result));
+  BOOST_TEST(result == 199);
+  BOOST_TEST(MRGetMethodByName("M2", "Export199@4", &result));
+  BOOST_TEST(result == 199);
+
+  MRResetRegistry();
+  usage = GetPoolUsage();
+  BOOST_TEST(usage.blocks == baseline.blocks);
+  BOOST_TEST(usage.bytes == baseline.bytes);
+}
+
+BOOST_AUTO_TEST_CASE(register_methods_bulk_test) {
+  MRResetRegistry();
+  PoolUsage baseline = GetPoolUsage();
+
+  // Dense run, a duplicate ordinal, and distant outliers in a single batch.
+  std::vector<ModuleExport> exports;
+  for (uint32_t ordinal = 1; ordinal <= 100; ++ordinal) {
+    exports.push_back({ordinal, nullptr, nullptr, ordinal});
+  }
+  exports.push_back({50, PoolStrdup("E50@0", 0), PoolStrdup("E50", 0), 0x50});
+  exports.push_back({100000, PoolStrdup("Far@0", 0), nullptr, 0xFA});
+  exports.push_back({0xFFFFFFFF, nullptr, nullptr, 0xFF});
+
+  BOOST_TEST(MRRegisterMethods("M1", exports.data(), exports.size(), 0));
+  BOOST_TEST(MRGetNumRegisteredModules() == 1);
+  BOOST_TEST(MRGetTotalNumExports() == 102);
+
+  uint32_t result;
+  BOOST_TEST(MRGetMethodByOrdinal("M1", 1, &result));
+  BOOST_TEST(result == 1);
+  BOOST_TEST(MRGetMethodByOrdinal("M1", 50, &result));
+  BOOST_TEST(result == 0x50);
+  BOOST_TEST(MRGetMethodByName("M1", "E50", &result));
+  BOOST_TEST(result == 0x50);
+  BOOST_TEST(MRGetMethodByName("M1", "Far@0", &result));
+  BOOST_TEST(result == 0xFA);
+  BOOST_TEST(MRGetMethodByOrdinal("M1", 0xFFFFFFFF, &result));
+  BOOST_TEST(result == 0xFF);
+
+  // The caller's strings are referenced rather than copied.
+  ModuleRegistryCursor cursor;
+  MREnumerateRegistryBegin(&cursor);
+  const char *module;
+  const ModuleExport *module_export;
+  while (MREnumerateRegistry(&module, &module_export, &cursor) &&
+         module_export->ordinal != 50) {
+  }
+  BOOST_TEST(module_export->method_name == exports[100].method_name);
+  BOOST_TEST(module_export->alias == exports[100].alias);
+
+  BOOST_TEST(MRRegisterMethods("M1", nullptr, 0, 0));
+  BOOST_TEST(MRGetTotalNumExports() == 102);
+
+  // Caller strings were released once registration succeeded.
+  MRResetRegistry();
+  BOOST_TEST(GetPoolUsage().blocks == baseline.blocks);
+}
+
+BOOST_AUTO_TEST_CASE(register_methods_static_test) {
+  MRResetRegistry();
+
+  static const ModuleExport kExports[] = {
+      {1, (char *)"E1@4", (char *)"E1", 0x01},
+      {2, (char *)"E2@8", (char *)"E2", 0x02},
+      {3, nullptr, nullptr, 0x03},
+  };
+  BOOST_TEST(MRRegisterMethods("M1", kExports, 3, MR_FLAG_STATIC));
+
+  uint32_t result;
+  BOOST_TEST(MRGetMethodByName("M1", "E2", &result));
+  BOOST_TEST(result == 0x02);
+
+  // Static entries are referenced in place.
+  ModuleRegistryCursor cursor;
+  MREnumerateRegistryBegin(&cursor);
+  const char *module;
+  const ModuleExport *module_export;
+  for (const auto &expected : kExports) {
+    BOOST_TEST(MREnumerateRegistry(&module, &module_export, &cursor));
+    BOOST_TEST(module_export == &expected);
+  }
+  BOOST_TEST(!MREnumerateRegistry(&module, &module_export, &cursor));
+
+  // Overriding a static entry must not modify the caller's array.
+  RegisterExport("M1", "E2@8", "Replaced", 2, 0x22);
+  BOOST_TEST(kExports[1].address == 0x02);
+  BOOST_TEST(!MRGetMethodByName("M1", "E2", &result));
+  BOOST_TEST(MRGetMethodByName("M1", "Replaced", &result));
+  BOOST_TEST(result == 0x22);
+  BOOST_TEST(MRGetMethodByName("M1", "E1", &result));
+  BOOST_TEST(result == 0x01);
+
+  // Resetting must not attempt to free the static strings.
+  MRResetRegistry();
+}
+
+// Minimal in-memory image containing only an export directory.
+struct LazyModuleImage {
+  IMAGE_EXPORT_DIRECTORY directory;
+  uint32_t functions[5];
+  uint32_t names[2];
+  uint16_t name_ordinals[2];
+  char strings[2][8];
+
+  explicit LazyModuleImage(uint32_t base) {
+    memset(&directory, 0, sizeof(directory));
+    directory.Base = base;
+    directory.NumberOfFunctions = 5;
+    directory.AddressOfFunctions = offsetof(LazyModuleImage, functions);
+    for (uint32_t i = 0; i < 5; ++i) {
+      functions[i] = 0x1000 + i * 0x10;
+    }
+    // Unused slot in the export address table.
+    functions[3] = 0;
+  }
+
+  // Names the exports at index 4 and 1, in the sorted order required by the PE
+  // format.
+  void AddNames() {
+    directory.NumberOfNames = 2;
+    directory.AddressOfNames = offsetof(LazyModuleImage, names);
+    directory.AddressOfNameOrdinals = offsetof(LazyModuleImage, name_ordinals);
+    strcpy(strings[0], "Alpha");
+    strcpy(strings[1], "Beta");
+    names[0] = offsetof(LazyModuleImage, strings[0]);
+    names[1] = offsetof(LazyModuleImage, strings[1]);
+    name_ordinals[0] = 4;
+    name_ordinals[1] = 1;
+  }
+
+  uint32_t Address(uint32_t index) const {
+    return functions[index] + (intptr_t)this;
+  }
+};
+
+BOOST_AUTO_TEST_CASE(lazy_module_test) {
+  MRResetRegistry();
+
+  LazyModuleImage image(10);
+  RegisterExport("M1", "Override@0", nullptr, 11, 0xF00D);
+  BOOST_TEST(
+      MRRegisterLazyModule("M1", &image, &image.directory, MR_FLAG_MEMOIZE));
+  RegisterExport("M1", "Extra@0", nullptr, 100, 0xE);
+
+  BOOST_TEST(MRGetNumRegisteredModules() == 1);
+  BOOST_TEST(MRGetTotalNumExports() == 5);
+
+  uint32_t result;
+  BOOST_TEST(MRGetMethodByOrdinal("M1", 10, &result));
+  BOOST_TEST(result == image.Address(0));
+  BOOST_TEST(MRGetMethodByOrdinal("M1", 11, &result));
+  BOOST_TEST(result == 0xF00D);
+  BOOST_TEST(!MRGetMethodByOrdinal("M1", 13, &result));
+  BOOST_TEST(!MRGetMethodByOrdinal("M1", 15, &result));
+  BOOST_TEST(MRGetMethodByOrdinal("M1", 14, &result));
+  BOOST_TEST(result == image.Address(4));
+  BOOST_TEST(MRGetMethodByName("M1", "Extra@0", &result));
+  BOOST_TEST(result == 0xE);
+
+  // Memoized lookups must not change the visible set of exports.
+  BOOST_TEST(MRGetTotalNumExports() == 5);
+
+  static const uint32_t kExpectedOrdinals[] = {10, 11, 12, 14, 100};
+  ModuleRegistryCursor cursor;
+  MREnumerateRegistryBegin(&cursor);
+  const char *module;
+  const ModuleExport *module_export;
+  for (auto ordinal : kExpectedOrdinals) {
+    BOOST_TEST_CONTEXT("Ordinal " << ordinal) {
+      BOOST_TEST(MREnumerateRegistry(&module, &module_export, &cursor));
+      BOOST_TEST(module_export->ordinal == ordinal);
+      BOOST_TEST(std::string(module) == "M1");
+    }
+  }
+  BOOST_TEST(!MREnumerateRegistry(&module, &module_export, &cursor));
+}
+
+BOOST_AUTO_TEST_CASE(enumerate_lazy_modules_test) {
+  MRResetRegistry();
+
+  LazyModuleImage image_1(1);
+  LazyModuleImage image_2(0);
+  RegisterExport("M0", "E1@0", nullptr, 1, 0x1);
+  BOOST_TEST(MRRegisterLazyModule("M1", &image_1, &image_1.directory, 0));
+  BOOST_TEST(MRRegisterLazyModule("M2", &image_2, &image_2.directory, 0));
+
+  BOOST_TEST(MRGetNumRegisteredModules() == 3);
+  BOOST_TEST(MRGetTotalNumExports() == 9);
+
+  ModuleRegistryCursor cursor;
+  MREnumerateRegistryBegin(&cursor);
+  const char *module;
+  const ModuleExport *module_export;
+  uint32_t enumerated = 0;
+  uint32_t address_sum = 0;
+  while (MREnumerateRegistry(&module, &module_export, &cursor)) {
+    ++enumerated;
+    address_sum += module_export->address;
+  }
+  BOOST_TEST(enumerated == 9);
+
+  uint32_t expected_sum = 0x1;
+  for (auto index : {0, 1, 2, 4}) {
+    expected_sum += image_1.Address(index) + image_2.Address(index);
+  }
+  BOOST_TEST(address_sum == expected_sum);
+}
+
+BOOST_AUTO_TEST_CASE(lazy_module_names_test) {
+  MRResetRegistry();
+
+  LazyModuleImage image(10);
+  image.AddNames();
+  RegisterExport("M1", "Override@0", nullptr, 11, 0xF00D);
+  BOOST_TEST(MRRegisterLazyModule("M1", &image, &image.directory, 0));
+
+  uint32_t result;
+  BOOST_TEST(MRGetMethodByName("M1", "Alpha", &result));
+  BOOST_TEST(result == image.Address(4));
+  // Explicit registrations shadow the image's export for the same ordinal.
+  BOOST_TEST(MRGetMethodByName("M1", "Beta", &result));
+  BOOST_TEST(result == 0xF00D);
+  BOOST_TEST(!MRGetMethodByName("M1", "Aardvark", &result));
+  BOOST_TEST(!MRGetMethodByName("M1", "Gamma", &result));
+
+  ModuleRegistryCursor cursor;
+  MREnumerateRegistryBegin(&cursor);
+  const char *module;
+  const ModuleExport *module_export;
+  bool found = false;
+  while (MREnumerateRegistry(&module, &module_export, &cursor)) {
+    if (module_export->ordinal == 14) {
+      BOOST_TEST(std::string(module_export->method_name) == "Alpha");
+      found = true;
+    } else if (module_export->ordinal != 11) {
+      BOOST_TEST(!module_export->method_name);
+    }
+  }
+  BOOST_TEST(found);
+}
+
+BOOST_AUTO_TEST_CASE(resolve_by_name_with_hint_test) {
+  MRResetRegistry();
+
+  // Hints index the exports sorted by alias, regardless of registration order.
+  BOOST_TEST(RegisterExport("M1", "Gamma@4", "Gamma", 2, 0x30));
+  BOOST_TEST(RegisterExport("M1", "Alpha@4", "Alpha", 3, 0x10));
+  BOOST_TEST(RegisterExport("M1", "Beta@8", "Beta", 4, 0x20));
+
+  void *handle;
+  BOOST_REQUIRE(MRGetModuleHandle("M1", &handle));
+  uint32_t result;
+  BOOST_TEST(MRGetMethodByNameWithHintInModule(handle, "Alpha", 0, &result));
+  BOOST_TEST(result == 0x10);
+  BOOST_TEST(MRGetMethodByNameWithHintInModule(handle, "Beta@8", 1, &result));
+  BOOST_TEST(result == 0x20);
+  // Hints may also be ordinals.
+  BOOST_TEST(MRGetMethodByNameWithHintInModule(handle, "Beta", 4, &result));
+  BOOST_TEST(result == 0x20);
+
+  // Stale hints fall back to a full lookup.
+  BOOST_TEST(MRGetMethodByNameWithHintInModule(handle, "Gamma", 0, &result));
+  BOOST_TEST(result == 0x30);
+  BOOST_TEST(MRGetMethodByNameWithHintInModule(handle, "Alpha", 1000, &result));
+  BOOST_TEST(result == 0x10);
+  BOOST_TEST(!MRGetMethodByNameWithHintInModule(handle, "Delta", 0, &result));
+
+  // Shared names resolve to the same export as an unhinted lookup.
+  BOOST_TEST(RegisterExport("M1", "Alpha@4", "Alpha", 5, 0x50));
+  BOOST_TEST(MRGetMethodByName("M1", "Alpha", &result));
+  BOOST_TEST(result == 0x50);
+  BOOST_TEST(MRGetMethodByNameWithHintInModule(handle, "Alpha", 0, &result));
+  BOOST_TEST(result == 0x50);
+  BOOST_TEST(MRGetMethodByNameWithHintInModule(handle, "Alpha", 3, &result));
+  BOOST_TEST(result == 0x50);
+
+  BOOST_TEST(MRUnregisterAddressRange(0x50, 0x51) == 1);
+  BOOST_TEST(MRGetMethodByNameWithHintInModule(handle, "Beta", 1, &result));
+  BOOST_TEST(result == 0x20);
+  BOOST_TEST(MRGetMethodByNameWithHintInModule(handle, "Alpha", 0, &result));
+  BOOST_TEST(result == 0x10);
+}
+
+BOOST_AUTO_TEST_CASE(lazy_module_hint_test) {
+  MRResetRegistry();
+
+  LazyModuleImage image(10);
+  image.AddNames();
+  BOOST_TEST(MRRegisterLazyModule("M1", &image, &image.directory, 0));
+
+  void *handle;
+  BOOST_REQUIRE(MRGetModuleHandle("M1", &handle));
+  uint32_t result;
+  BOOST_TEST(MRGetMethodByNameWithHintInModule(handle, "Alpha", 0, &result));
+  BOOST_TEST(result == image.Address(4));
+  BOOST_TEST(MRGetMethodByNameWithHintInModule(handle, "Beta", 1, &result));
+  BOOST_TEST(result == image.Address(1));
+  BOOST_TEST(MRGetMethodByNameWithHintInModule(handle, "Beta", 0, &result));
+  BOOST_TEST(result == image.Address(1));
+  BOOST_TEST(!MRGetMethodByNameWithHintInModule(handle, "Gamma", 1, &result));
+
+  // Explicit registrations shadow the image's export for the same ordinal.
+  BOOST_TEST(RegisterExport("M1", nullptr, nullptr, 11, 0xF00D));
+  BOOST_TEST(MRGetMethodByNameWithHintInModule(handle, "Beta", 1, &result));
+  BOOST_TEST(result == 0xF00D);
+}
+
+BOOST_AUTO_TEST_CASE(unregister_address_range_test) {
+  MRResetRegistry();
+
+  RegisterExport("M1", "E1@0", "E1", 1, 0x1000);
+  RegisterExport("M1", "E2@0", "E2", 2, 0x2000);
+  RegisterExport("M1", "Outlier@0", nullptr, 5000, 0x1800);
+  RegisterExport("M2", "E1@0", "E1", 1, 0x1FFF);
+  LazyModuleImage image(10);
+  BOOST_TEST(MRRegisterLazyModule("M3", &image, &image.directory, 0));
+  RegisterExport("M3", "Override@0", nullptr, 11, 0x1004);
+  BOOST_TEST(MRGetNumRegisteredModules() == 3);
+
+  BOOST_TEST(MRUnregisterAddressRange(0x1000, 0x2000) == 4);
+  BOOST_TEST(MRGetNumRegisteredModules() == 2);
+  BOOST_TEST(MRGetTotalNumExports() == 5);
+
+  uint32_t result;
+  BOOST_TEST(!MRGetMethodByName("M1", "E1", &result));
+  BOOST_TEST(!MRGetMethodByOrdinal("M1", 5000, &result));
+  BOOST_TEST(MRGetMethodByName("M1", "E2@0", &result));
+  BOOST_TEST(result == 0x2000);
+  BOOST_TEST(!MRGetMethodByName("M2", "E1", &result));
+
+  // The image export hidden by the removed override is visible again.
+  BOOST_TEST(MRGetMethodByOrdinal("M3", 11, &result));
+  BOOST_TEST(result == image.Address(1));
+
+  // Lazily linked modules are detached once their image is unloaded.
+  uint32_t image_start = (uint32_t)(intptr_t)&image;
+  BOOST_TEST(MRUnregisterAddressRange(image_start, image_start + 1) == 0);
+  BOOST_TEST(MRGetNumRegisteredModules() == 1);
+  BOOST_TEST(MRGetTotalNumExports() == 1);
+
+  // Modules may be registered again after removal.
+  RegisterExport("M2", "E1@0", "E1", 1, 0x3000);
+  BOOST_TEST(MRGetMethodByName("M2", "E1", &result));
+  BOOST_TEST(result == 0x3000);
+}
+
+BOOST_AUTO_TEST_CASE(module_timestamp_test) {
+  MRResetRegistry();
+
+  uint32_t timestamp;
+  BOOST_TEST(!MRSetModuleTimestamp("M1", 0x1234));
+  BOOST_TEST(RegisterExport("M1", "Method@0", nullptr, 1, 0x10));
+  BOOST_TEST(!MRGetModuleTimestamp("M1", &timestamp));
+
+  BOOST_TEST(MRSetModuleTimestamp("M1", 0x1234));
+  BOOST_TEST(MRGetModuleTimestamp("M1", &timestamp));
+  BOOST_TEST(timestamp == 0x1234);
+
+  // Overriding an export invalidates the build's timestamp.
+  BOOST_TEST(RegisterExport("M1", "Method@0", nullptr, 1, 0x20));
+  BOOST_TEST(!MRGetModuleTimestamp("M1", &timestamp));
+}
+
+BOOST_AUTO_TEST_CASE(enumerate_empty_registry_test) {
+  MRResetRegistry();
+
+  ModuleRegistryCursor cursor;
+  MREnumerateRegistryBegin(&cursor);
+  const char *module;
+  const ModuleExport *module_export;
+  BOOST_TEST(!MREnumerateRegistry(&module, &module_export, &cursor));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 static bool RegisterExport(const char *name, const char *alias,
@@ -111,7 +657,7 @@ static bool RegisterExport(const char *module, const char *name,
   if (!name) {
     entry.method_name = NULL;
   } else {
-    entry.method_name = strdup(name);
+    entry.method_name = PoolStrdup(name, 0);
     if (!entry.method_name) {
       return false;
     }
@@ -119,7 +665,7 @@ static bool RegisterExport(const char *module, const char *name,
   if (!alias) {
     entry.alias = NULL;
   } else {
-    entry.alias = strdup(alias);
+    entry.alias = PoolStrdup(alias, 0);
     if (!entry.alias) {
       return false;
     }
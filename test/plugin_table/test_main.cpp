@@ -0,0 +1,254 @@
+#define BOOST_TEST_MODULE DXTLibraryTests
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "plugin_table.h"
+#include "winapi/winnt.h"
+#include "xbdm_stubs.h"
+
+static const uint32_t kNTHeaderOffset = 0x40;
+static const uint32_t kExportDirectoryOffset = 0x200;
+static const uint32_t kShutdownRVA = 0x800;
+
+// Builds a minimal image named `name` whose export table names two functions,
+// the second of which is the shutdown hook.
+static std::vector<uint8_t> BuildImage(uint32_t size,
+                                       const char *name = "plugin.dll") {
+  std::vector<uint8_t> image(size);
+  auto dos_header = reinterpret_cast<IMAGE_DOS_HEADER *>(image.data());
+  dos_header->e_magic = IMAGE_DOS_SIGNATURE;
+  dos_header->e_lfanew = kNTHeaderOffset;
+
+  auto nt_header =
+      reinterpret_cast<IMAGE_NT_HEADERS32 *>(image.data() + kNTHeaderOffset);
+  nt_header->Signature = IMAGE_NT_SIGNATURE;
+  IMAGE_DATA_DIRECTORY *directory_info =
+      nt_header->OptionalHeader.DataDirectory + IMAGE_DIRECTORY_ENTRY_EXPORT;
+  directory_info->VirtualAddress = kExportDirectoryOffset;
+  directory_info->Size = 0x100;
+
+  auto directory = reinterpret_cast<IMAGE_EXPORT_DIRECTORY *>(
+      image.data() + kExportDirectoryOffset);
+  directory->Name = 0x2C0;
+  directory->Base = 1;
+  directory->NumberOfFunctions = 2;
+  directory->NumberOfNames = 2;
+  directory->AddressOfFunctions = 0x240;
+  directory->AddressOfNames = 0x250;
+  directory->AddressOfNameOrdinals = 0x260;
+
+  auto functions = reinterpret_cast<uint32_t *>(image.data() + 0x240);
+  functions[0] = 0x700;
+  functions[1] = kShutdownRVA;
+  auto names = reinterpret_cast<uint32_t *>(image.data() + 0x250);
+  names[0] = 0x280;
+  names[1] = 0x290;
+  auto name_ordinals = reinterpret_cast<uint16_t *>(image.data() + 0x260);
+  name_ordinals[0] = 0;
+  name_ordinals[1] = 1;
+  strcpy(reinterpret_cast<char *>(image.data() + 0x280), "DXTMain");
+  strcpy(reinterpret_cast<char *>(image.data() + 0x290),
+         PLUGIN_SHUTDOWN_EXPORT_NAME);
+  strcpy(reinterpret_cast<char *>(image.data() + 0x2C0), name);
+  return image;
+}
+
+static const uint32_t kImportDirectoryOffset = 0x300;
+static const uint32_t kImportNamesOffset = 0x380;
+
+// Adds an import directory naming each of `imports` to an image built by
+// BuildImage.
+static void AddImports(std::vector<uint8_t> &image,
+                       const std::vector<std::string> &imports) {
+  auto nt_header =
+      reinterpret_cast<IMAGE_NT_HEADERS32 *>(image.data() + kNTHeaderOffset);
+  IMAGE_DATA_DIRECTORY *directory_info =
+      nt_header->OptionalHeader.DataDirectory + IMAGE_DIRECTORY_ENTRY_IMPORT;
+  directory_info->VirtualAddress = kImportDirectoryOffset;
+  directory_info->Size = (imports.size() + 1) * sizeof(IMAGE_IMPORT_DESCRIPTOR);
+
+  auto descriptors = reinterpret_cast<IMAGE_IMPORT_DESCRIPTOR *>(
+      image.data() + kImportDirectoryOffset);
+  uint32_t name_offset = kImportNamesOffset;
+  for (const auto &name : imports) {
+    descriptors->Name = name_offset;
+    strcpy(reinterpret_cast<char *>(image.data() + name_offset), name.c_str());
+    name_offset += name.size() + 1;
+    ++descriptors;
+  }
+}
+
+static uint32_t Address(const std::vector<uint8_t> &image,
+                        uint32_t offset = 0) {
+  return (uint32_t)(intptr_t)image.data() + offset;
+}
+
+BOOST_AUTO_TEST_SUITE(plugin_table_suite)
+
+BOOST_AUTO_TEST_CASE(find_plugin_test) {
+  auto image_1 = BuildImage(0x1000);
+  std::vector<uint8_t> image_2(0x100);
+
+  LoadedPlugin *plugin_1 =
+      PTAddPlugin(image_1.data(), image_1.size(), Address(image_1, 0x700));
+  LoadedPlugin *plugin_2 = PTAddPlugin(image_2.data(), image_2.size(), 0);
+  BOOST_REQUIRE(plugin_1);
+  BOOST_REQUIRE(plugin_2);
+  BOOST_TEST(PTGetNumPlugins() == 2);
+
+  BOOST_TEST(plugin_1->shutdown == Address(image_1, kShutdownRVA));
+  BOOST_TEST(plugin_2->shutdown == 0);
+  BOOST_TEST(plugin_1->pins == 0);
+  BOOST_TEST(!plugin_1->closing);
+  BOOST_TEST(std::string(plugin_1->name) == "plugin.dll");
+  BOOST_TEST(std::string(plugin_2->name).empty());
+
+  BOOST_TEST(PTFindPluginByName("plugin.dll") == plugin_1);
+  BOOST_TEST(!PTFindPluginByName(""));
+
+  BOOST_TEST(PTFindPlugin(Address(image_1)) == plugin_1);
+  BOOST_TEST(PTFindPlugin(Address(image_2)) == plugin_2);
+  BOOST_TEST(!PTFindPlugin(Address(image_1, 4)));
+
+  BOOST_TEST(PTFindPluginContaining(Address(image_1, 0xFFF)) == plugin_1);
+  BOOST_TEST(PTFindPluginContaining(Address(image_2, 0x80)) == plugin_2);
+
+  PTRemovePlugin(plugin_1);
+  PTRemovePlugin(plugin_2);
+  BOOST_TEST(PTGetNumPlugins() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(truncated_export_table_test) {
+  // The export directory lies outside of the claimed image size.
+  auto image = BuildImage(0x1000);
+  LoadedPlugin *plugin = PTAddPlugin(image.data(), 0x210, 0);
+  BOOST_REQUIRE(plugin);
+  BOOST_TEST(plugin->shutdown == 0);
+  PTRemovePlugin(plugin);
+}
+
+BOOST_AUTO_TEST_CASE(image_name_test) {
+  auto image = BuildImage(0x1000, "other.dll");
+  std::vector<uint8_t> unnamed(0x100);
+  BOOST_TEST(std::string(PTGetImageName(image.data(), image.size())) ==
+             "other.dll");
+  BOOST_TEST(std::string(PTGetImageName(unnamed.data(), unnamed.size())) ==
+             "");
+  // The name lies outside of the claimed image size.
+  BOOST_TEST(std::string(PTGetImageName(image.data(), 0x2C4)) == "");
+}
+
+BOOST_AUTO_TEST_CASE(replace_image_test) {
+  auto image_1 = BuildImage(0x1000);
+  std::vector<uint8_t> image_2(0x2000);
+
+  LoadedPlugin *plugin = PTAddPlugin(image_1.data(), image_1.size(), 0);
+  BOOST_REQUIRE(plugin);
+  BOOST_TEST(plugin->shutdown != 0);
+
+  PTReplacePluginImage(plugin, image_2.data(), image_2.size(),
+                       Address(image_2, 0x10));
+  BOOST_TEST(plugin->image == image_2.data());
+  BOOST_TEST(plugin->image_size == 0x2000);
+  BOOST_TEST(plugin->entrypoint == Address(image_2, 0x10));
+  BOOST_TEST(plugin->shutdown == 0);
+  BOOST_TEST(PTFindPluginByName("plugin.dll") == plugin);
+  BOOST_TEST(!PTFindPluginContaining(Address(image_1, 0x10)));
+  BOOST_TEST(PTFindPluginContaining(Address(image_2, 0x1800)) == plugin);
+
+  PTRemovePlugin(plugin);
+}
+
+BOOST_AUTO_TEST_CASE(dependency_test) {
+  auto provider_image = BuildImage(0x1000, "provider.dll");
+  auto importer_image = BuildImage(0x1000, "importer.dll");
+  AddImports(importer_image, {"xbdm.dll", "provider.dll", "provider.dll"});
+  auto rebuilt_image = BuildImage(0x1000, "importer.dll");
+  AddImports(rebuilt_image, {"xbdm.dll"});
+
+  LoadedPlugin *provider =
+      PTAddPlugin(provider_image.data(), provider_image.size(), 0);
+  LoadedPlugin *importer =
+      PTAddPlugin(importer_image.data(), importer_image.size(), 0);
+  BOOST_REQUIRE(provider);
+  BOOST_REQUIRE(importer);
+  BOOST_TEST(PTFindDependent(provider) == importer);
+  BOOST_TEST(!PTFindDependent(importer));
+
+  // The dependencies follow the importer's current image.
+  BOOST_TEST(PTReplacePluginImage(importer, rebuilt_image.data(),
+                                  rebuilt_image.size(), 0));
+  BOOST_TEST(!PTFindDependent(provider));
+  BOOST_TEST(PTReplacePluginImage(importer, importer_image.data(),
+                                  importer_image.size(), 0));
+  BOOST_TEST(PTFindDependent(provider) == importer);
+
+  // A reloaded build of the provider does not depend on itself.
+  auto reloaded_image = BuildImage(0x1000, "provider.dll");
+  AddImports(reloaded_image, {"provider.dll"});
+  BOOST_TEST(PTReplacePluginImage(provider, reloaded_image.data(),
+                                  reloaded_image.size(), 0));
+  BOOST_TEST(PTFindDependent(provider) == importer);
+
+  PTRemovePlugin(importer);
+  BOOST_TEST(!PTFindDependent(provider));
+  PTRemovePlugin(provider);
+}
+
+static HRESULT_API Processor(const char *command, char *response,
+                             DWORD response_len, struct CommandContext *ctx) {
+  return 0;
+}
+
+BOOST_AUTO_TEST_CASE(command_processor_test) {
+  PoolUsage baseline = GetPoolUsage();
+
+  std::vector<uint8_t> image_1(0x100);
+  std::vector<uint8_t> image_2(0x100);
+  LoadedPlugin *plugin_1 = PTAddPlugin(image_1.data(), image_1.size(), 0);
+  LoadedPlugin *plugin_2 = PTAddPlugin(image_2.data(), image_2.size(), 0);
+
+  auto one = PTAddCommandProcessor(plugin_1, "one", Processor);
+  auto two = PTAddCommandProcessor(plugin_1, "two", Processor);
+  auto three = PTAddCommandProcessor(plugin_2, "three", nullptr);
+  BOOST_REQUIRE(one);
+  BOOST_REQUIRE(two);
+  BOOST_REQUIRE(three);
+  BOOST_TEST(one->owner == plugin_1);
+  BOOST_TEST(one->proc == Processor);
+
+  BOOST_TEST(PTFindCommandProcessor("one") == one);
+  BOOST_TEST(PTFindCommandProcessor("TWO") == two);
+  BOOST_TEST(!PTFindCommandProcessor("on"));
+  BOOST_TEST(!PTFindCommandProcessor("ones"));
+
+  BOOST_TEST(PTFindCommandProcessorForCommand("one!hello") == one);
+  BOOST_TEST(PTFindCommandProcessorForCommand("Three!x y=1") == three);
+  BOOST_TEST(!PTFindCommandProcessorForCommand("two"));
+  BOOST_TEST(!PTFindCommandProcessorForCommand("twofold!x"));
+
+  uint32_t count = 0;
+  for (auto processor = PTGetCommandProcessors(); processor;
+       processor = processor->next) {
+    ++count;
+  }
+  BOOST_TEST(count == 3);
+
+  PTRemoveCommandProcessor(one);
+  BOOST_TEST(!PTFindCommandProcessor("one"));
+
+  // Removing a plugin removes the processors it owns.
+  PTRemovePlugin(plugin_1);
+  BOOST_TEST(!PTFindCommandProcessor("two"));
+  BOOST_TEST(PTFindCommandProcessor("three") == three);
+  PTRemovePlugin(plugin_2);
+  BOOST_TEST(!PTGetCommandProcessors());
+
+  PoolUsage usage = GetPoolUsage();
+  BOOST_TEST(usage.blocks == baseline.blocks);
+  BOOST_TEST(usage.bytes == baseline.bytes);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,242 @@
+#define BOOST_TEST_MODULE DXTLibraryTests
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+
+#include "bind.h"
+#include "dll_loader.h"
+#include "golden_dll.h"
+#include "prelink.h"
+#include "registry_snapshot.h"
+#include "relocated_B00D7000.h"
+
+// Builds a snapshot matching the predictable fake addresses that were used to
+// generate the golden relocated image.
+static std::string BuildGoldenSnapshot();
+
+static bool ResolveImportByOrdinalCounting(const char *, uint32_t,
+                                           uint32_t *);
+static bool ResolveImportByNameCounting(const char *, const char *,
+                                        uint32_t *);
+static bool ResolveModuleTimestamp(const char *, uint32_t *);
+
+static const uint32_t kKernelTimestamp = 0x3C3A2F5B;
+static uint32_t loaded_kernel_timestamp = 0;
+static uint32_t resolve_kernel_calls = 0;
+static uint32_t resolve_other_calls = 0;
+
+BOOST_AUTO_TEST_SUITE(prelink_suite)
+
+BOOST_AUTO_TEST_CASE(parse_snapshot_test) {
+  RegistrySnapshot snapshot;
+  uint32_t error_line;
+
+  BOOST_TEST(RSParse("Registered exports\n"
+                     "# Comment\n"
+                     "\n"
+                     "xbdm.dll @ 2   = 0x00080002\n"
+                     "loader.dll @ 3 CPParse@8 CPParse = 0xB00D7010\r\n"
+                     "M1 @ 4 OnlyName = 0x4",
+                     &snapshot, &error_line));
+  BOOST_TEST(snapshot.num_entries == 3);
+
+  uint32_t result;
+  BOOST_TEST(RSGetMethodByOrdinal(&snapshot, "xbdm.dll", 2, &result));
+  BOOST_TEST(result == 0x00080002);
+  BOOST_TEST(!RSGetMethodByOrdinal(&snapshot, "xbdm.dll", 3, &result));
+
+  BOOST_TEST(RSGetMethodByName(&snapshot, "loader.dll", "CPParse@8", &result));
+  BOOST_TEST(result == 0xB00D7010);
+  BOOST_TEST(RSGetMethodByName(&snapshot, "loader.dll", "CPParse", &result));
+  BOOST_TEST(result == 0xB00D7010);
+  BOOST_TEST(RSGetMethodByName(&snapshot, "M1", "OnlyName", &result));
+  BOOST_TEST(result == 0x4);
+  BOOST_TEST(!RSGetMethodByName(&snapshot, "xbdm.dll", "CPParse", &result));
+
+  RSFree(&snapshot);
+}
+
+BOOST_AUTO_TEST_CASE(parse_malformed_snapshot_test) {
+  RegistrySnapshot snapshot;
+  uint32_t error_line;
+
+  BOOST_TEST(!RSParse("xbdm.dll @ 2 = 0x1\n"
+                      "xbdm.dll @ three = 0x2\n",
+                      &snapshot, &error_line));
+  BOOST_TEST(error_line == 2);
+  BOOST_TEST(snapshot.entries == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(unresolved_import_test) {
+  RegistrySnapshot snapshot;
+  uint32_t error_line;
+  BOOST_REQUIRE(RSParse("xbdm.dll @ 2 = 0x1\n", &snapshot, &error_line));
+
+  DLLContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.input.raw_data = kDynDXTLoader;
+  ctx.input.raw_data_size = sizeof(kDynDXTLoader);
+
+  BOOST_TEST(!PLPrelinkImage(&ctx, &snapshot, 0xB00D7000));
+  BOOST_TEST(ctx.output.context == DLLL_RESOLVE_IMPORTS);
+  BOOST_TEST(ctx.output.status == DLLL_UNRESOLVED_IMPORT);
+  BOOST_TEST(!strcmp(ctx.output.error_message, "xbdm.dll @ 9"));
+
+  DLLFreeContext(&ctx, false);
+  RSFree(&snapshot);
+}
+
+BOOST_AUTO_TEST_CASE(golden_prelink_test) {
+  RegistrySnapshot snapshot;
+  uint32_t error_line;
+  BOOST_REQUIRE(
+      RSParse(BuildGoldenSnapshot().c_str(), &snapshot, &error_line));
+
+  DLLContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.input.raw_data = kDynDXTLoader;
+  ctx.input.raw_data_size = sizeof(kDynDXTLoader);
+
+  BOOST_REQUIRE(PLPrelinkImage(&ctx, &snapshot, 0xB00D7000));
+
+  uint32_t image_size = ctx.output.header.OptionalHeader.SizeOfImage;
+  BOOST_TEST(image_size == sizeof(kRelocatedB00D7000));
+  BOOST_TEST(ctx.output.entrypoint ==
+             0xB00D7000 + ctx.output.header.OptionalHeader.AddressOfEntryPoint);
+
+  auto loaded = reinterpret_cast<const uint8_t *>(ctx.output.image);
+  const uint8_t *golden = kRelocatedB00D7000;
+  for (auto i = 0; i < image_size; ++i, ++loaded, ++golden) {
+    BOOST_TEST_CONTEXT("[0x" << std::hex << i << "]") {
+      BOOST_TEST(*loaded == *golden);
+    }
+  }
+
+  DLLFreeContext(&ctx, false);
+  RSFree(&snapshot);
+}
+
+BOOST_AUTO_TEST_CASE(bind_test) {
+  RegistrySnapshot snapshot;
+  uint32_t error_line;
+  BOOST_REQUIRE(
+      RSParse(BuildGoldenSnapshot().c_str(), &snapshot, &error_line));
+
+  std::vector<uint8_t> raw(kDynDXTLoader,
+                           kDynDXTLoader + sizeof(kDynDXTLoader));
+  const BoundModule modules[] = {{"xboxkrnl.exe", kKernelTimestamp}};
+  DLLContext ctx;
+  uint32_t num_bound;
+  BOOST_REQUIRE(BNBindImage(raw.data(), raw.size(), &snapshot, modules, 1,
+                            &ctx, &num_bound) == BIND_OK);
+  BOOST_TEST(num_bound == 1);
+  RSFree(&snapshot);
+
+  auto load = [&raw, &ctx](uint32_t timestamp) {
+    loaded_kernel_timestamp = timestamp;
+    resolve_kernel_calls = 0;
+    resolve_other_calls = 0;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.input.raw_data = raw.data();
+    ctx.input.raw_data_size = raw.size();
+    ctx.input.alloc = malloc;
+    ctx.input.free = free;
+    ctx.input.resolve_import_by_ordinal = ResolveImportByOrdinalCounting;
+    ctx.input.resolve_import_by_name = ResolveImportByNameCounting;
+    ctx.input.resolve_module_timestamp = ResolveModuleTimestamp;
+    return DLLLoad(&ctx);
+  };
+
+  // The kernel imports are taken from the bound import address table as-is.
+  BOOST_REQUIRE(load(kKernelTimestamp));
+  BOOST_TEST(resolve_kernel_calls == 0);
+  BOOST_TEST(resolve_other_calls == 3);
+
+  auto image = reinterpret_cast<const uint8_t *>(ctx.output.image);
+  auto descriptor = reinterpret_cast<const IMAGE_IMPORT_DESCRIPTOR *>(
+      image + ctx.output.header.OptionalHeader
+                  .DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT]
+                  .VirtualAddress);
+  for (; descriptor->Name; ++descriptor) {
+    if (strcmp(reinterpret_cast<const char *>(image + descriptor->Name),
+               "xboxkrnl.exe")) {
+      continue;
+    }
+    auto lookup = reinterpret_cast<const uint32_t *>(
+        image + descriptor->DUMMYUNIONNAME.OriginalFirstThunk);
+    auto iat =
+        reinterpret_cast<const uint32_t *>(image + descriptor->FirstThunk);
+    for (; *lookup; ++lookup, ++iat) {
+      BOOST_TEST(*iat == (12 << 16) + (*lookup & 0xFFFF));
+    }
+  }
+  DLLFreeContext(&ctx, false);
+
+  // A different kernel build falls back to resolving each import.
+  BOOST_REQUIRE(load(kKernelTimestamp + 1));
+  BOOST_TEST(resolve_kernel_calls == 56);
+  BOOST_TEST(resolve_other_calls == 3);
+  DLLFreeContext(&ctx, false);
+}
+
+BOOST_AUTO_TEST_CASE(bind_unresolved_import_test) {
+  RegistrySnapshot snapshot;
+  uint32_t error_line;
+  BOOST_REQUIRE(RSParse("xbdm.dll @ 2 = 0x1\n", &snapshot, &error_line));
+
+  std::vector<uint8_t> raw(kDynDXTLoader,
+                           kDynDXTLoader + sizeof(kDynDXTLoader));
+  const BoundModule modules[] = {{"xboxkrnl.exe", kKernelTimestamp}};
+  DLLContext ctx;
+  uint32_t num_bound;
+  BOOST_TEST(BNBindImage(raw.data(), raw.size(), &snapshot, modules, 1, &ctx,
+                         &num_bound) == BIND_LOAD_FAILED);
+  BOOST_TEST(ctx.output.status == DLLL_UNRESOLVED_IMPORT);
+  BOOST_TEST(num_bound == 0);
+  BOOST_TEST(!memcmp(raw.data(), kDynDXTLoader, raw.size()));
+
+  RSFree(&snapshot);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+static bool ResolveImportByOrdinalCounting(const char *image, uint32_t ordinal,
+                                           uint32_t *result) {
+  if (!strcmp(image, "xboxkrnl.exe")) {
+    ++resolve_kernel_calls;
+  } else {
+    ++resolve_other_calls;
+  }
+  *result = 0;
+  return true;
+}
+
+static bool ResolveImportByNameCounting(const char *image, const char *name,
+                                        uint32_t *result) {
+  ++resolve_other_calls;
+  *result = 0;
+  return true;
+}
+
+static bool ResolveModuleTimestamp(const char *image, uint32_t *timestamp) {
+  if (strcmp(image, "xboxkrnl.exe")) {
+    return false;
+  }
+  *timestamp = loaded_kernel_timestamp;
+  return true;
+}
+
+static std::string BuildGoldenSnapshot() {
+  static const char *kModules[] = {"xbdm.dll", "xboxkrnl.exe"};
+
+  std::string ret = "Registered exports\n";
+  char line[128];
+  for (auto module : kModules) {
+    for (uint32_t ordinal = 1; ordinal < 400; ++ordinal) {
+      snprintf(line, sizeof(line), "%s @ %d   = 0x%08X\n", module, ordinal,
+               (uint32_t)((strlen(module) << 16) + ordinal));
+      ret += line;
+    }
+  }
+  return ret;
+}
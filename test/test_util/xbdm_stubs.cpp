@@ -1,15 +1,57 @@
 #include "xbdm_stubs.h"
 
+#include <stddef.h>
 #include <stdlib.h>
+
+#include <mutex>
+
 #include "xbdm.h"
 
+// Each block is preceded by its requested size so that DmFreePool can keep the
+// usage counters up to date.
+typedef union BlockHeader {
+  uint32_t size;
+  max_align_t alignment;
+} BlockHeader;
+
+static PoolUsage pool_usage = {0, 0};
+
+// Notifications may be sent from any thread.
+static std::mutex notifications_mutex;
+static std::vector<std::string> notifications;
+
 // Allocate a new block of memory with the given tag.
 PVOID_API DmAllocatePoolWithTag(DWORD size, DWORD tag) {
-  return malloc(size);
+  BlockHeader *header = (BlockHeader *)malloc(sizeof(BlockHeader) + size);
+  if (!header) {
+    return NULL;
+  }
+  header->size = size;
+  ++pool_usage.blocks;
+  pool_usage.bytes += size;
+  return header + 1;
 }
 
 // Free the given block, which was previously allocated via
 // DmAllocatePoolWithTag.
 VOID_API DmFreePool(void *block) {
-  free(block);
+  BlockHeader *header = (BlockHeader *)block - 1;
+  --pool_usage.blocks;
+  pool_usage.bytes -= header->size;
+  free(header);
+}
+
+PoolUsage GetPoolUsage() { return pool_usage; }
+
+HRESULT_API DmSendNotificationString(const char *message) {
+  std::lock_guard<std::mutex> lock(notifications_mutex);
+  notifications.emplace_back(message);
+  return XBOX_S_OK;
+}
+
+std::vector<std::string> TakeNotifications() {
+  std::lock_guard<std::mutex> lock(notifications_mutex);
+  std::vector<std::string> ret;
+  ret.swap(notifications);
+  return ret;
 }
@@ -1,6 +1,25 @@
 #ifndef DYNDXT_LOADER_TEST_TEST_UTIL_XBDM_STUBS_H_
 #define DYNDXT_LOADER_TEST_TEST_UTIL_XBDM_STUBS_H_
 
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
 #include "winapi/winnt.h"
 
+// Snapshot of outstanding DmAllocatePoolWithTag allocations.
+typedef struct PoolUsage {
+  uint32_t blocks;
+  uint32_t bytes;
+} PoolUsage;
+
+// Returns the number and total size of blocks that have been allocated via
+// DmAllocatePoolWithTag and not yet released via DmFreePool.
+PoolUsage GetPoolUsage();
+
+// Returns and clears the messages that have been passed to
+// DmSendNotificationString.
+std::vector<std::string> TakeNotifications();
+
 #endif  // DYNDXT_LOADER_TEST_TEST_UTIL_XBDM_STUBS_H_
@@ -0,0 +1,278 @@
+// Measures upload throughput when a single image is sent as disjoint parts over
+// several connections at once.
+//
+// Each connection is served by its own thread running a stand-in for the XBDM
+// command loop: it reads a "loadpart" command line from a loopback TCP socket
+// and then passes the binary payload to a ReceiveUploadPart-style handler one
+// receive buffer at a time, with a mutex standing in for the loader lock. The
+// handler either holds the lock for the whole chunk or only for the upload
+// bookkeeping around the copy.
+//
+// Usage: upload_manager_benchmark [image_size_mib] [iterations]
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "upload_manager.h"
+
+// Size of the buffer into which XBDM receives binary data before invoking the
+// command's handler.
+static constexpr uint32_t kReceiveBufferSize = 0x4000;
+static constexpr uint32_t kMaxCommandLength = 512;
+
+static std::mutex loader_lock;
+static std::atomic<uint32_t> completions;
+
+static void Fail(const char *message) {
+  perror(message);
+  exit(1);
+}
+
+static bool ReadFully(int fd, void *buffer, size_t size) {
+  auto *dest = static_cast<uint8_t *>(buffer);
+  while (size) {
+    ssize_t received = recv(fd, dest, size, 0);
+    if (received <= 0) {
+      return false;
+    }
+    dest += received;
+    size -= received;
+  }
+  return true;
+}
+
+static bool WriteFully(int fd, const void *buffer, size_t size) {
+  auto *source = static_cast<const uint8_t *>(buffer);
+  while (size) {
+    ssize_t sent = send(fd, source, size, 0);
+    if (sent <= 0) {
+      return false;
+    }
+    source += sent;
+    size -= sent;
+  }
+  return true;
+}
+
+// Mirrors the loader's handling of one receive buffer of a "loadpart" body.
+static bool ReceiveChunk(uint32_t id, uint32_t run_start, uint32_t offset,
+                         const uint8_t *data, uint32_t size,
+                         bool unlocked_copy) {
+  std::unique_lock<std::mutex> lock(loader_lock);
+  Upload *upload = UMFind(id);
+  if (!upload) {
+    return false;
+  }
+  uint8_t *dest = UMBeginWrite(upload, run_start, offset, size);
+  if (!dest) {
+    return false;
+  }
+  if (unlocked_copy) {
+    lock.unlock();
+    memcpy(dest, data, size);
+    lock.lock();
+  } else {
+    memcpy(dest, data, size);
+  }
+  if (UMEndWrite(upload, run_start, offset + size, 0)) {
+    ++completions;
+  }
+  return true;
+}
+
+// Serves a single "loadpart" command on the given connection.
+static void ServeConnection(int fd, bool unlocked_copy) {
+  char command[kMaxCommandLength];
+  uint32_t length = 0;
+  while (length + 1 < sizeof(command)) {
+    if (recv(fd, command + length, 1, 0) != 1) {
+      Fail("recv");
+    }
+    if (command[length] == '\n') {
+      break;
+    }
+    ++length;
+  }
+  command[length] = 0;
+
+  uint32_t id;
+  uint32_t offset;
+  uint32_t size;
+  if (sscanf(command, "ddxt!loadpart id=%u offset=0x%X size=0x%X", &id,
+             &offset, &size) != 3) {
+    fprintf(stderr, "Bad command '%s'\n", command);
+    exit(1);
+  }
+
+  std::vector<uint8_t> buffer(kReceiveBufferSize);
+  uint32_t received = 0;
+  while (received < size) {
+    uint32_t chunk = size - received;
+    if (chunk > kReceiveBufferSize) {
+      chunk = kReceiveBufferSize;
+    }
+    if (!ReadFully(fd, buffer.data(), chunk) ||
+        !ReceiveChunk(id, offset, offset + received, buffer.data(), chunk,
+                      unlocked_copy)) {
+      Fail("receive part");
+    }
+    received += chunk;
+  }
+
+  static const char kResponse[] = "203- binary response follows\r\n";
+  WriteFully(fd, kResponse, sizeof(kResponse) - 1);
+}
+
+static void SendPart(uint16_t port, uint32_t id, const uint8_t *image,
+                     uint32_t offset, uint32_t size) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    Fail("socket");
+  }
+  int enable = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address))) {
+    Fail("connect");
+  }
+
+  char command[kMaxCommandLength];
+  int length = snprintf(command, sizeof(command),
+                        "ddxt!loadpart id=%u offset=0x%X size=0x%X\n", id,
+                        offset, size);
+  char response[64];
+  if (!WriteFully(fd, command, length) ||
+      !WriteFully(fd, image + offset, size) ||
+      recv(fd, response, sizeof(response), 0) <= 0) {
+    Fail("send part");
+  }
+  close(fd);
+}
+
+// Uploads `image` split into `num_connections` block aligned parts, each sent
+// over its own connection. Returns the elapsed time in seconds.
+static double UploadImage(int listener, uint16_t port,
+                          const std::vector<uint8_t> &image,
+                          uint32_t num_connections, bool unlocked_copy) {
+  uint32_t size = image.size();
+  uint32_t num_blocks = (size + UPLOAD_BLOCK_SIZE - 1) / UPLOAD_BLOCK_SIZE;
+  uint32_t blocks_per_part =
+      (num_blocks + num_connections - 1) / num_connections;
+
+  auto start = std::chrono::steady_clock::now();
+  Upload *upload;
+  {
+    std::lock_guard<std::mutex> lock(loader_lock);
+    upload = UMBegin(size, 0);
+  }
+  if (!upload) {
+    Fail("UMBegin");
+  }
+  uint32_t id = upload->id;
+
+  std::vector<std::thread> servers;
+  std::vector<std::thread> clients;
+  for (uint32_t i = 0; i < num_connections; ++i) {
+    uint32_t offset = i * blocks_per_part * UPLOAD_BLOCK_SIZE;
+    if (offset >= size) {
+      break;
+    }
+    uint32_t part_size = blocks_per_part * UPLOAD_BLOCK_SIZE;
+    if (part_size > size - offset) {
+      part_size = size - offset;
+    }
+    clients.emplace_back(SendPart, port, id, image.data(), offset, part_size);
+  }
+  for (uint32_t i = 0; i < clients.size(); ++i) {
+    int fd = accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+      Fail("accept");
+    }
+    servers.emplace_back([fd, unlocked_copy] {
+      ServeConnection(fd, unlocked_copy);
+      close(fd);
+    });
+  }
+  for (auto &thread : clients) {
+    thread.join();
+  }
+  for (auto &thread : servers) {
+    thread.join();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  if (!UMIsComplete(upload) || memcmp(upload->data, image.data(), size)) {
+    fprintf(stderr, "Upload mismatch\n");
+    exit(1);
+  }
+  UMRelease(upload);
+  return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char **argv) {
+  uint32_t image_size_mib = argc > 1 ? strtoul(argv[1], nullptr, 0) : 64;
+  uint32_t iterations = argc > 2 ? strtoul(argv[2], nullptr, 0) : 5;
+  if (!image_size_mib || !iterations) {
+    fprintf(stderr, "Usage: %s [image_size_mib] [iterations]\n", argv[0]);
+    return 1;
+  }
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0) {
+    Fail("socket");
+  }
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t address_len = sizeof(address);
+  if (bind(listener, reinterpret_cast<sockaddr *>(&address), address_len) ||
+      listen(listener, 64) ||
+      getsockname(listener, reinterpret_cast<sockaddr *>(&address),
+                  &address_len)) {
+    Fail("listen");
+  }
+  uint16_t port = ntohs(address.sin_port);
+
+  std::vector<uint8_t> image(image_size_mib << 20);
+  for (uint32_t i = 0; i < image.size(); ++i) {
+    image[i] = static_cast<uint8_t>(i * 7 + (i >> 12));
+  }
+  double megabytes = image.size() / (1024.0 * 1024.0);
+
+  printf("%u MiB image, %u iterations, %u byte receive buffer\n",
+         image_size_mib, iterations, kReceiveBufferSize);
+  printf("%12s %18s %18s\n", "connections", "locked copy MB/s",
+         "unlocked copy MB/s");
+  for (uint32_t num_connections : {1u, 2u, 4u, 8u}) {
+    double locked = 0;
+    double unlocked = 0;
+    for (uint32_t i = 0; i < iterations; ++i) {
+      locked += UploadImage(listener, port, image, num_connections, false);
+      unlocked += UploadImage(listener, port, image, num_connections, true);
+    }
+    printf("%12u %18.1f %18.1f\n", num_connections,
+           megabytes * iterations / locked, megabytes * iterations / unlocked);
+  }
+
+  if (completions != 2 * 4 * iterations) {
+    fprintf(stderr, "Expected one completion per upload\n");
+    return 1;
+  }
+  close(listener);
+  return 0;
+}
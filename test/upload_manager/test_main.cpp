@@ -0,0 +1,160 @@
+#define BOOST_TEST_MODULE DXTLibraryTests
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+#include <vector>
+
+#include "upload_manager.h"
+#include "xbdm_stubs.h"
+
+static std::vector<uint8_t> Pattern(uint32_t size) {
+  std::vector<uint8_t> ret(size);
+  for (uint32_t i = 0; i < size; ++i) {
+    ret[i] = static_cast<uint8_t>(i * 7 + (i >> 8));
+  }
+  return ret;
+}
+
+// Sends [offset, offset + size) as a single part split into chunks of at most
+// `chunk_size` bytes.
+static bool WritePart(Upload *upload, const std::vector<uint8_t> &source,
+                      uint32_t offset, uint32_t size, uint32_t chunk_size,
+                      uint32_t now = 0) {
+  uint32_t written = 0;
+  while (written < size) {
+    uint32_t chunk = size - written < chunk_size ? size - written : chunk_size;
+    if (!UMWrite(upload, offset, offset + written,
+                 source.data() + offset + written, chunk, now)) {
+      return false;
+    }
+    written += chunk;
+  }
+  return true;
+}
+
+BOOST_AUTO_TEST_CASE(out_of_order_parts_test) {
+  const uint32_t size = UPLOAD_BLOCK_SIZE * 5 + 100;
+  auto source = Pattern(size);
+  Upload *upload = UMBegin(size, 0);
+  BOOST_TEST_REQUIRE(upload);
+  BOOST_TEST(UMFind(upload->id) == upload);
+
+  uint32_t offset;
+  uint32_t missing_size;
+  BOOST_TEST(UMFindMissingRange(upload, 0, &offset, &missing_size));
+  BOOST_TEST(offset == 0);
+  BOOST_TEST(missing_size == size);
+
+  // The final, partial block and a middle block, in odd sized chunks that
+  // straddle block boundaries.
+  BOOST_TEST(WritePart(upload, source, UPLOAD_BLOCK_SIZE * 4,
+                       UPLOAD_BLOCK_SIZE + 100, 1000));
+  BOOST_TEST(WritePart(upload, source, UPLOAD_BLOCK_SIZE * 2,
+                       UPLOAD_BLOCK_SIZE, 999));
+  BOOST_TEST(!UMIsComplete(upload));
+  BOOST_TEST(UMGetReceivedSize(upload) == UPLOAD_BLOCK_SIZE * 2 + 100);
+
+  BOOST_TEST(UMFindMissingRange(upload, 0, &offset, &missing_size));
+  BOOST_TEST(offset == 0);
+  BOOST_TEST(missing_size == UPLOAD_BLOCK_SIZE * 2);
+  BOOST_TEST(UMFindMissingRange(upload, offset + missing_size, &offset,
+                                &missing_size));
+  BOOST_TEST(offset == UPLOAD_BLOCK_SIZE * 3);
+  BOOST_TEST(missing_size == UPLOAD_BLOCK_SIZE);
+  BOOST_TEST(!UMFindMissingRange(upload, offset + missing_size, &offset,
+                                 &missing_size));
+
+  BOOST_TEST(WritePart(upload, source, UPLOAD_BLOCK_SIZE * 3,
+                       UPLOAD_BLOCK_SIZE, 4096));
+  BOOST_TEST(WritePart(upload, source, 0, UPLOAD_BLOCK_SIZE * 2, 1500));
+  BOOST_TEST(UMIsComplete(upload));
+  BOOST_TEST(UMGetReceivedSize(upload) == size);
+  BOOST_TEST(!memcmp(upload->data, source.data(), size));
+
+  UMRelease(upload);
+  BOOST_TEST(GetPoolUsage().blocks == 0);
+}
+
+BOOST_AUTO_TEST_CASE(interrupted_part_test) {
+  const uint32_t size = UPLOAD_BLOCK_SIZE * 4;
+  auto source = Pattern(size);
+  Upload *upload = UMBegin(size, 0);
+  BOOST_TEST_REQUIRE(upload);
+
+  // A part that is cut off keeps the blocks it completed.
+  BOOST_TEST(WritePart(upload, source, 0, UPLOAD_BLOCK_SIZE * 2 + 10, 512));
+  BOOST_TEST(UMGetReceivedSize(upload) == UPLOAD_BLOCK_SIZE * 2);
+
+  uint32_t offset;
+  uint32_t missing_size;
+  BOOST_TEST(UMFindMissingRange(upload, 0, &offset, &missing_size));
+  BOOST_TEST(offset == UPLOAD_BLOCK_SIZE * 2);
+  BOOST_TEST(missing_size == UPLOAD_BLOCK_SIZE * 2);
+
+  // Writes outside of the upload or from an unaligned part are rejected.
+  BOOST_TEST(!UMWrite(upload, 0, size - 4, source.data(), 8, 0));
+  BOOST_TEST(!UMWrite(upload, 10, 10, source.data(), 8, 0));
+  BOOST_TEST(!UMWrite(upload, UPLOAD_BLOCK_SIZE, 0, source.data(), 8, 0));
+
+  UMRelease(upload);
+  BOOST_TEST(GetPoolUsage().blocks == 0);
+}
+
+BOOST_AUTO_TEST_CASE(reclaim_stale_test) {
+  auto source = Pattern(UPLOAD_BLOCK_SIZE);
+  Upload *idle = UMBegin(UPLOAD_BLOCK_SIZE, 1000);
+  Upload *active = UMBegin(UPLOAD_BLOCK_SIZE, 1000);
+  BOOST_TEST_REQUIRE(idle);
+  BOOST_TEST_REQUIRE(active);
+  BOOST_TEST(idle->id != active->id);
+  uint32_t idle_id = idle->id;
+
+  BOOST_TEST(WritePart(active, source, 0, 100, 100, 5000));
+  BOOST_TEST(UMReclaimStale(5500, 4000) == 1);
+  BOOST_TEST(!UMFind(idle_id));
+  BOOST_TEST(UMFind(active->id) == active);
+
+  UMRelease(active);
+
+  // Elapsed time is computed modulo 2^32 so that the tick count may wrap.
+  Upload *wrapped = UMBegin(UPLOAD_BLOCK_SIZE, 0xFFFFF000);
+  BOOST_TEST_REQUIRE(wrapped);
+  BOOST_TEST(UMReclaimStale(0x100, 0x2000) == 0);
+  BOOST_TEST(UMReclaimStale(0x1100, 0x2000) == 1);
+
+  BOOST_TEST(!UMBegin(0, 0));
+  BOOST_TEST(GetPoolUsage().blocks == 0);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_writers_test) {
+  const uint32_t size = UPLOAD_BLOCK_SIZE * 3;
+  auto source = Pattern(size);
+  Upload *upload = UMBegin(size, 0);
+  BOOST_TEST_REQUIRE(upload);
+
+  // Parts over separate connections interleave; only the write that fills
+  // the final missing block reports completion.
+  uint8_t *first = UMBeginWrite(upload, 0, 0, UPLOAD_BLOCK_SIZE);
+  uint8_t *last = UMBeginWrite(upload, UPLOAD_BLOCK_SIZE, UPLOAD_BLOCK_SIZE,
+                               UPLOAD_BLOCK_SIZE * 2);
+  BOOST_TEST_REQUIRE(first);
+  BOOST_TEST_REQUIRE(last);
+  BOOST_TEST(!UMBeginWrite(upload, 0, size, 1));
+  memcpy(last, source.data() + UPLOAD_BLOCK_SIZE, UPLOAD_BLOCK_SIZE * 2);
+  BOOST_TEST(!UMEndWrite(upload, UPLOAD_BLOCK_SIZE, size, 0));
+  memcpy(first, source.data(), UPLOAD_BLOCK_SIZE);
+  BOOST_TEST(UMEndWrite(upload, 0, UPLOAD_BLOCK_SIZE, 0));
+  BOOST_TEST(!memcmp(upload->data, source.data(), size));
+
+  // A redundant write that ends after completion does not report it again.
+  BOOST_TEST(UMBeginWrite(upload, 0, 0, 10));
+  BOOST_TEST(!UMEndWrite(upload, 0, 10, 0));
+
+  // An upload released during a write is freed when the write ends.
+  BOOST_TEST(UMBeginWrite(upload, 0, 0, 10));
+  uint32_t id = upload->id;
+  UMRelease(upload);
+  BOOST_TEST(!UMFind(id));
+  BOOST_TEST(GetPoolUsage().blocks == 2);
+  BOOST_TEST(!UMEndWrite(upload, 0, 10, 0));
+  BOOST_TEST(GetPoolUsage().blocks == 0);
+}
@@ -0,0 +1,202 @@
+#include "bind.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prelink.h"
+
+// Marks an import descriptor whose binding is described by the bound import
+// directory.
+#define BOUND_IMPORT_TIMESTAMP 0xFFFFFFFF
+
+typedef struct BoundImportDescriptor {
+  uint32_t TimeDateStamp;
+  uint16_t OffsetModuleName;
+  uint16_t NumberOfModuleForwarderRefs;
+} BoundImportDescriptor;
+
+// Maps `size` bytes at `rva` to an offset within the raw file. Returns false if
+// the range is not backed by raw data.
+static bool RawOffset(const DLLContext *ctx, uint32_t raw_size, uint32_t rva,
+                      uint32_t size, uint32_t *offset) {
+  const IMAGE_NT_HEADERS32 *header = &ctx->output.header;
+  uint32_t header_size = header->OptionalHeader.SizeOfHeaders;
+  if (rva < header_size) {
+    *offset = rva;
+    return size <= header_size - rva && header_size <= raw_size;
+  }
+
+  for (uint32_t i = 0; i < header->FileHeader.NumberOfSections; ++i) {
+    const IMAGE_SECTION_HEADER *section = ctx->output.section_headers + i;
+    if (rva < section->VirtualAddress ||
+        rva - section->VirtualAddress >= section->SizeOfRawData) {
+      continue;
+    }
+    uint32_t section_offset = rva - section->VirtualAddress;
+    *offset = section->PointerToRawData + section_offset;
+    return size <= section->SizeOfRawData - section_offset &&
+           *offset <= raw_size && size <= raw_size - *offset;
+  }
+  return false;
+}
+
+static const BoundModule *FindModule(const BoundModule *modules,
+                                     uint32_t num_modules, const char *name) {
+  for (uint32_t i = 0; i < num_modules; ++i) {
+    if (!strcmp(modules[i].name, name)) {
+      return modules + i;
+    }
+  }
+  return NULL;
+}
+
+// Returns the offset of the first byte after the section table, which is where
+// the bound import directory is placed.
+static uint32_t SectionTableEnd(const uint8_t *raw, const DLLContext *ctx) {
+  const IMAGE_DOS_HEADER *dos_header = (const IMAGE_DOS_HEADER *)raw;
+  const IMAGE_NT_HEADERS32 *header = &ctx->output.header;
+  return dos_header->e_lfanew + offsetof(IMAGE_NT_HEADERS32, OptionalHeader) +
+         header->FileHeader.SizeOfOptionalHeader +
+         header->FileHeader.NumberOfSections * sizeof(IMAGE_SECTION_HEADER);
+}
+
+// Writes the bound import directory for the given modules into the padding
+// between the section table and the first section.
+static BindStatus WriteBoundImportDirectory(uint8_t *raw, const DLLContext *ctx,
+                                            const BoundModule **modules,
+                                            uint32_t num_modules) {
+  const IMAGE_NT_HEADERS32 *header = &ctx->output.header;
+  uint32_t start = (SectionTableEnd(raw, ctx) + 3) & ~3;
+  uint32_t end = header->OptionalHeader.SizeOfHeaders;
+  for (uint32_t i = 0; i < header->FileHeader.NumberOfSections; ++i) {
+    const IMAGE_SECTION_HEADER *section = ctx->output.section_headers + i;
+    if (section->SizeOfRawData && section->PointerToRawData < end) {
+      end = section->PointerToRawData;
+    }
+  }
+
+  uint32_t descriptors_size = (num_modules + 1) * sizeof(BoundImportDescriptor);
+  uint32_t size = descriptors_size;
+  for (uint32_t i = 0; i < num_modules; ++i) {
+    size += strlen(modules[i]->name) + 1;
+  }
+  if (start > end || size > end - start) {
+    return BIND_NO_HEADER_SPACE;
+  }
+
+  uint8_t *directory = raw + start;
+  memset(directory, 0, size);
+  uint32_t name_offset = descriptors_size;
+  for (uint32_t i = 0; i < num_modules; ++i) {
+    BoundImportDescriptor descriptor = {modules[i]->timestamp,
+                                        (uint16_t)name_offset, 0};
+    memcpy(directory + i * sizeof(descriptor), &descriptor,
+           sizeof(descriptor));
+    strcpy((char *)directory + name_offset, modules[i]->name);
+    name_offset += strlen(modules[i]->name) + 1;
+  }
+
+  const IMAGE_DOS_HEADER *dos_header = (const IMAGE_DOS_HEADER *)raw;
+  IMAGE_NT_HEADERS32 *raw_header =
+      (IMAGE_NT_HEADERS32 *)(raw + dos_header->e_lfanew);
+  IMAGE_DATA_DIRECTORY *directory_info =
+      raw_header->OptionalHeader.DataDirectory +
+      IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT;
+  directory_info->VirtualAddress = start;
+  directory_info->Size = size;
+  return BIND_OK;
+}
+
+static BindStatus BindImports(uint8_t *raw, uint32_t raw_size,
+                              const DLLContext *ctx,
+                              const BoundModule *modules, uint32_t num_modules,
+                              uint32_t *num_bound) {
+  const IMAGE_DATA_DIRECTORY *imports =
+      ctx->output.header.OptionalHeader.DataDirectory +
+      IMAGE_DIRECTORY_ENTRY_IMPORT;
+  if (!imports->Size) {
+    return BIND_OK;
+  }
+
+  const BoundModule **bound = calloc(num_modules, sizeof(*bound));
+  if (num_modules && !bound) {
+    return BIND_LOAD_FAILED;
+  }
+
+  BindStatus ret = BIND_OK;
+  const uint8_t *image = ctx->output.image;
+  uint32_t descriptor_rva = imports->VirtualAddress;
+  for (const IMAGE_IMPORT_DESCRIPTOR *descriptor =
+           (const IMAGE_IMPORT_DESCRIPTOR *)(image + descriptor_rva);
+       descriptor->Name && ret == BIND_OK;
+       ++descriptor, descriptor_rva += sizeof(*descriptor)) {
+    const char *name = (const char *)image + descriptor->Name;
+    const BoundModule *module = FindModule(modules, num_modules, name);
+    if (!module) {
+      continue;
+    }
+    if (!descriptor->DUMMYUNIONNAME.OriginalFirstThunk) {
+      ret = BIND_NO_LOOKUP_TABLE;
+      break;
+    }
+
+    // The loaded image holds the resolved addresses; copy them back into the
+    // raw file's import address table.
+    uint32_t lookup_rva = descriptor->DUMMYUNIONNAME.OriginalFirstThunk;
+    const uint32_t *lookup = (const uint32_t *)(image + lookup_rva);
+    uint32_t num_thunks = 0;
+    while (lookup[num_thunks]) {
+      ++num_thunks;
+    }
+
+    uint32_t iat_offset;
+    uint32_t descriptor_offset;
+    if (!RawOffset(ctx, raw_size, descriptor->FirstThunk,
+                   num_thunks * sizeof(uint32_t), &iat_offset) ||
+        !RawOffset(ctx, raw_size, descriptor_rva, sizeof(*descriptor),
+                   &descriptor_offset)) {
+      ret = BIND_INVALID_IMAGE;
+      break;
+    }
+    memcpy(raw + iat_offset, image + descriptor->FirstThunk,
+           num_thunks * sizeof(uint32_t));
+
+    IMAGE_IMPORT_DESCRIPTOR *raw_descriptor =
+        (IMAGE_IMPORT_DESCRIPTOR *)(raw + descriptor_offset);
+    raw_descriptor->TimeDateStamp = BOUND_IMPORT_TIMESTAMP;
+
+    uint32_t i = 0;
+    while (i < *num_bound && bound[i] != module) {
+      ++i;
+    }
+    if (i == *num_bound) {
+      bound[(*num_bound)++] = module;
+    }
+  }
+
+  if (ret == BIND_OK && *num_bound) {
+    ret = WriteBoundImportDirectory(raw, ctx, bound, *num_bound);
+  }
+  free(bound);
+  return ret;
+}
+
+BindStatus BNBindImage(uint8_t *raw, uint32_t raw_size,
+                       const RegistrySnapshot *snapshot,
+                       const BoundModule *modules, uint32_t num_modules,
+                       DLLContext *ctx, uint32_t *num_bound) {
+  *num_bound = 0;
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->input.raw_data = raw;
+  ctx->input.raw_data_size = raw_size;
+  if (!PLResolveImports(ctx, snapshot)) {
+    DLLFreeContext(ctx, false);
+    return BIND_LOAD_FAILED;
+  }
+
+  BindStatus ret =
+      BindImports(raw, raw_size, ctx, modules, num_modules, num_bound);
+  DLLFreeContext(ctx, false);
+  return ret;
+}
@@ -0,0 +1,61 @@
+#ifndef DYNDXT_LOADER_TOOLS_BIND_BIND_H
+#define DYNDXT_LOADER_TOOLS_BIND_BIND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dll_loader.h"
+#include "registry_snapshot.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! A module whose imports should be bound, identified by the TimeDateStamp of
+//! the build that is loaded on the target (e.g., as reported by XBDM's
+//! `modules` command).
+typedef struct BoundModule {
+  const char *name;
+  uint32_t timestamp;
+} BoundModule;
+
+typedef enum BindStatus {
+  BIND_OK = 0,
+
+  //! The image could not be loaded or one of its imports could not be
+  //! resolved against the snapshot. Details are reported via the DLLContext.
+  BIND_LOAD_FAILED = 1,
+
+  //! An import descriptor of a module to be bound has no import lookup table,
+  //! so its imports could not be resolved on the target if the binding is
+  //! stale.
+  BIND_NO_LOOKUP_TABLE = 2,
+
+  //! The import tables reference data outside of the raw image.
+  BIND_INVALID_IMAGE = 3,
+
+  //! The padding after the section table is too small to hold the bound import
+  //! directory.
+  BIND_NO_HEADER_SPACE = 4,
+} BindStatus;
+
+//! Binds the imports of the raw DLL at `raw` from each of the given modules in
+//! place. The import address table entries for those modules are set to the
+//! addresses in `snapshot`, their import descriptors are marked as bound, and
+//! an IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT recording each module's timestamp is
+//! written into the header padding. Every import must be resolvable via the
+//! snapshot.
+//!
+//! `ctx` is used to load the image and report errors; its resources are
+//! released before returning. `num_bound` is set to the number of modules that
+//! were bound.
+BindStatus BNBindImage(uint8_t *raw, uint32_t raw_size,
+                       const RegistrySnapshot *snapshot,
+                       const BoundModule *modules, uint32_t num_modules,
+                       DLLContext *ctx, uint32_t *num_bound);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // DYNDXT_LOADER_TOOLS_BIND_BIND_H
@@ -0,0 +1,131 @@
+// Binds the imports of a plugin DLL against a registry snapshot so that the
+// loader may skip resolving them when the target runs the same module builds.
+//
+// Usage:
+//   dyndxt_bind <plugin.dll> <registry_snapshot.txt> <output.dll>
+//               <module>=<timestamp>...
+//
+// The registry snapshot is the output of `ddxt!hello` and each timestamp is the
+// `timestamp` reported for the module by XBDM's `modules` command. Imports from
+// modules that are not listed are left unbound. If the timestamp of a bound
+// module does not match the target at load time, its imports are resolved as
+// usual.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bind.h"
+#include "registry_snapshot.h"
+
+static void *ReadFile(const char *path, uint32_t *size) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    return NULL;
+  }
+
+  fseek(fp, 0, SEEK_END);
+  long file_size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  void *ret = malloc(file_size);
+  if (ret && fread(ret, 1, file_size, fp) != (size_t)file_size) {
+    free(ret);
+    ret = NULL;
+  }
+  fclose(fp);
+
+  *size = (uint32_t)file_size;
+  return ret;
+}
+
+// Parses a `<module>=<timestamp>` argument. `arg` is modified in place.
+static bool ParseModule(char *arg, BoundModule *module) {
+  char *separator = strrchr(arg, '=');
+  if (!separator || separator == arg) {
+    return false;
+  }
+  *separator = 0;
+
+  char *end;
+  module->name = arg;
+  module->timestamp = (uint32_t)strtoul(separator + 1, &end, 0);
+  return end != separator + 1 && !*end && module->timestamp;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 5) {
+    fprintf(stderr,
+            "Usage: %s <plugin.dll> <registry_snapshot.txt> <output.dll> "
+            "<module>=<timestamp>...\n",
+            argv[0]);
+    return 1;
+  }
+
+  uint32_t num_modules = argc - 4;
+  BoundModule *modules = calloc(num_modules, sizeof(*modules));
+  if (!modules) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+  for (uint32_t i = 0; i < num_modules; ++i) {
+    char *arg = argv[i + 4];
+    if (!ParseModule(arg, modules + i)) {
+      fprintf(stderr, "Invalid module '%s'\n", arg);
+      free(modules);
+      return 1;
+    }
+  }
+
+  RegistrySnapshot snapshot;
+  uint32_t error_line;
+  if (!RSLoadFile(argv[2], &snapshot, &error_line)) {
+    if (error_line) {
+      fprintf(stderr, "Malformed registry snapshot %s:%u\n", argv[2],
+              error_line);
+    } else {
+      fprintf(stderr, "Failed to read registry snapshot %s\n", argv[2]);
+    }
+    free(modules);
+    return 1;
+  }
+
+  uint32_t raw_size;
+  uint8_t *raw = ReadFile(argv[1], &raw_size);
+  if (!raw) {
+    fprintf(stderr, "Failed to read %s\n", argv[1]);
+    RSFree(&snapshot);
+    free(modules);
+    return 1;
+  }
+
+  int ret = 0;
+  DLLContext ctx;
+  uint32_t num_bound;
+  BindStatus status = BNBindImage(raw, raw_size, &snapshot, modules,
+                                  num_modules, &ctx, &num_bound);
+  if (status == BIND_LOAD_FAILED) {
+    fprintf(stderr, "Bind failed %d::%d %s\n", ctx.output.context,
+            ctx.output.status, ctx.output.error_message);
+    ret = 1;
+  } else if (status != BIND_OK) {
+    fprintf(stderr, "Bind failed %d\n", status);
+    ret = 1;
+  } else {
+    FILE *fp = fopen(argv[3], "wb");
+    if (!fp || fwrite(raw, 1, raw_size, fp) != raw_size) {
+      fprintf(stderr, "Failed to write %s\n", argv[3]);
+      ret = 1;
+    } else {
+      printf("bound=%u\n", num_bound);
+    }
+    if (fp) {
+      fclose(fp);
+    }
+  }
+
+  free(raw);
+  RSFree(&snapshot);
+  free(modules);
+  return ret;
+}
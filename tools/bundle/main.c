@@ -0,0 +1,90 @@
+// Packs several plugin DLLs into a single bundle for transfer via
+// `ddxt!loadbundle`.
+//
+// Usage:
+//   dyndxt_bundle <output.bundle> <plugin.dll>...
+//
+// The DLLs may be given in any order; the loader orders them by their imports.
+// On success the parameters for `ddxt!loadbundle` are printed to stdout.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "image_bundle.h"
+
+static void *ReadFile(const char *path, uint32_t *size) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    return NULL;
+  }
+
+  fseek(fp, 0, SEEK_END);
+  long file_size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  void *ret = malloc(file_size ? file_size : 1);
+  if (ret && fread(ret, 1, file_size, fp) != (size_t)file_size) {
+    free(ret);
+    ret = NULL;
+  }
+  fclose(fp);
+
+  *size = (uint32_t)file_size;
+  return ret;
+}
+
+static bool WriteUInt32(FILE *fp, uint32_t value) {
+  const uint8_t bytes[] = {value & 0xFF, (value >> 8) & 0xFF,
+                           (value >> 16) & 0xFF, (value >> 24) & 0xFF};
+  return fwrite(bytes, 1, sizeof(bytes), fp) == sizeof(bytes);
+}
+
+int main(int argc, char **argv) {
+  uint32_t count = argc - 2;
+  if (argc < 3 || count > IMAGE_BUNDLE_MAX_IMAGES) {
+    fprintf(stderr, "Usage: %s <output.bundle> <plugin.dll>...\n", argv[0]);
+    fprintf(stderr, "At most %d DLLs may be bundled.\n",
+            IMAGE_BUNDLE_MAX_IMAGES);
+    return 1;
+  }
+
+  void *images[IMAGE_BUNDLE_MAX_IMAGES] = {NULL};
+  uint32_t sizes[IMAGE_BUNDLE_MAX_IMAGES];
+  int ret = 0;
+  for (uint32_t i = 0; i < count && !ret; ++i) {
+    images[i] = ReadFile(argv[i + 2], sizes + i);
+    if (!images[i]) {
+      fprintf(stderr, "Failed to read %s\n", argv[i + 2]);
+      ret = 1;
+    }
+  }
+
+  FILE *fp = ret ? NULL : fopen(argv[1], "wb");
+  if (!ret) {
+    bool ok = fp && WriteUInt32(fp, IMAGE_BUNDLE_MAGIC) &&
+              WriteUInt32(fp, count);
+    uint32_t total_size = (2 + count) * sizeof(uint32_t);
+    for (uint32_t i = 0; i < count && ok; ++i) {
+      ok = WriteUInt32(fp, sizes[i]);
+      total_size += sizes[i];
+    }
+    for (uint32_t i = 0; i < count && ok; ++i) {
+      ok = fwrite(images[i], 1, sizes[i], fp) == sizes[i];
+    }
+
+    if (!ok) {
+      fprintf(stderr, "Failed to write %s\n", argv[1]);
+      ret = 1;
+    } else {
+      printf("size=0x%X\n", total_size);
+    }
+  }
+  if (fp) {
+    fclose(fp);
+  }
+
+  for (uint32_t i = 0; i < count; ++i) {
+    free(images[i]);
+  }
+  return ret;
+}
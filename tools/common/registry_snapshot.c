@@ -0,0 +1,205 @@
+#include "registry_snapshot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LINE_TOKENS 8
+
+static bool ParseLine(char *line, RegistrySnapshot *snapshot);
+static bool AppendEntry(RegistrySnapshot *snapshot, const char *module_name,
+                        uint32_t ordinal, const char *method_name,
+                        const char *alias, uint32_t address);
+
+bool RSParse(const char *text, RegistrySnapshot *snapshot,
+             uint32_t *error_line) {
+  memset(snapshot, 0, sizeof(*snapshot));
+  *error_line = 0;
+
+  char *buffer = strdup(text);
+  if (!buffer) {
+    return false;
+  }
+
+  uint32_t line_number = 0;
+  char *line = buffer;
+  while (*line) {
+    ++line_number;
+    char *line_end = strchr(line, '\n');
+    char *next_line = line_end ? line_end + 1 : line + strlen(line);
+    if (line_end) {
+      *line_end = 0;
+    }
+
+    if (!ParseLine(line, snapshot)) {
+      *error_line = line_number;
+      free(buffer);
+      RSFree(snapshot);
+      return false;
+    }
+
+    line = next_line;
+  }
+
+  free(buffer);
+  return true;
+}
+
+bool RSLoadFile(const char *path, RegistrySnapshot *snapshot,
+                uint32_t *error_line) {
+  *error_line = 0;
+
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    return false;
+  }
+
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  char *text = malloc(size + 1);
+  if (!text) {
+    fclose(fp);
+    return false;
+  }
+
+  bool ret = fread(text, 1, size, fp) == (size_t)size;
+  fclose(fp);
+  text[size] = 0;
+
+  if (ret) {
+    ret = RSParse(text, snapshot, error_line);
+  }
+  free(text);
+  return ret;
+}
+
+void RSFree(RegistrySnapshot *snapshot) {
+  for (uint32_t i = 0; i < snapshot->num_entries; ++i) {
+    SnapshotEntry *entry = snapshot->entries + i;
+    free(entry->module_name);
+    free(entry->method_name);
+    free(entry->alias);
+  }
+  free(snapshot->entries);
+  memset(snapshot, 0, sizeof(*snapshot));
+}
+
+bool RSGetMethodByOrdinal(const RegistrySnapshot *snapshot,
+                          const char *module_name, uint32_t ordinal,
+                          uint32_t *result) {
+  *result = 0;
+  for (uint32_t i = 0; i < snapshot->num_entries; ++i) {
+    const SnapshotEntry *entry = snapshot->entries + i;
+    if (entry->ordinal == ordinal && !strcmp(entry->module_name, module_name)) {
+      *result = entry->address;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool RSGetMethodByName(const RegistrySnapshot *snapshot,
+                       const char *module_name, const char *name,
+                       uint32_t *result) {
+  *result = 0;
+  for (uint32_t i = 0; i < snapshot->num_entries; ++i) {
+    const SnapshotEntry *entry = snapshot->entries + i;
+    if (strcmp(entry->module_name, module_name)) {
+      continue;
+    }
+    if ((entry->method_name && !strcmp(entry->method_name, name)) ||
+        (entry->alias && !strcmp(entry->alias, name))) {
+      *result = entry->address;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool ParseUInt32(const char *str, uint32_t *result) {
+  char *end;
+  unsigned long value = strtoul(str, &end, 0);
+  if (end == str || *end) {
+    return false;
+  }
+  *result = (uint32_t)value;
+  return true;
+}
+
+// Parses a single line, appending any export it describes to the snapshot.
+// Returns false if the line is malformed.
+static bool ParseLine(char *line, RegistrySnapshot *snapshot) {
+  char *tokens[MAX_LINE_TOKENS];
+  uint32_t num_tokens = 0;
+  char *save_ptr;
+  for (char *token = strtok_r(line, " \t\r", &save_ptr); token;
+       token = strtok_r(NULL, " \t\r", &save_ptr)) {
+    if (num_tokens == 0 && token[0] == '#') {
+      return true;
+    }
+    if (num_tokens == MAX_LINE_TOKENS) {
+      return false;
+    }
+    tokens[num_tokens++] = token;
+  }
+
+  if (num_tokens < 2 || strcmp(tokens[1], "@")) {
+    return true;
+  }
+
+  // <module> @ <ordinal> [<name> [<alias>]] = <address>
+  if (num_tokens < 5 || num_tokens > 7 ||
+      strcmp(tokens[num_tokens - 2], "=")) {
+    return false;
+  }
+
+  uint32_t ordinal;
+  uint32_t address;
+  if (!ParseUInt32(tokens[2], &ordinal) ||
+      !ParseUInt32(tokens[num_tokens - 1], &address)) {
+    return false;
+  }
+
+  const char *method_name = num_tokens > 5 ? tokens[3] : NULL;
+  const char *alias = num_tokens > 6 ? tokens[4] : NULL;
+  return AppendEntry(snapshot, tokens[0], ordinal, method_name, alias,
+                     address);
+}
+
+static char *OptionalStrdup(const char *str) {
+  return str ? strdup(str) : NULL;
+}
+
+static bool AppendEntry(RegistrySnapshot *snapshot, const char *module_name,
+                        uint32_t ordinal, const char *method_name,
+                        const char *alias, uint32_t address) {
+  if (snapshot->num_entries == snapshot->capacity) {
+    uint32_t capacity = snapshot->capacity ? snapshot->capacity * 2 : 64;
+    SnapshotEntry *entries =
+        realloc(snapshot->entries, capacity * sizeof(*entries));
+    if (!entries) {
+      return false;
+    }
+    snapshot->entries = entries;
+    snapshot->capacity = capacity;
+  }
+
+  SnapshotEntry *entry = snapshot->entries + snapshot->num_entries;
+  entry->module_name = strdup(module_name);
+  entry->ordinal = ordinal;
+  entry->method_name = OptionalStrdup(method_name);
+  entry->alias = OptionalStrdup(alias);
+  entry->address = address;
+  if (!entry->module_name || (method_name && !entry->method_name) ||
+      (alias && !entry->alias)) {
+    free(entry->module_name);
+    free(entry->method_name);
+    free(entry->alias);
+    return false;
+  }
+
+  ++snapshot->num_entries;
+  return true;
+}
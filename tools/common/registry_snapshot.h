@@ -0,0 +1,57 @@
+#ifndef DYNDXT_LOADER_TOOLS_COMMON_REGISTRY_SNAPSHOT_H
+#define DYNDXT_LOADER_TOOLS_COMMON_REGISTRY_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A single export captured from the target's module registry.
+typedef struct SnapshotEntry {
+  char *module_name;
+  uint32_t ordinal;
+  char *method_name;  // Optional.
+  char *alias;        // Optional.
+  uint32_t address;
+} SnapshotEntry;
+
+// Host-side copy of the target's module registry, used to resolve imports
+// without access to the target.
+typedef struct RegistrySnapshot {
+  SnapshotEntry *entries;
+  uint32_t num_entries;
+  uint32_t capacity;
+} RegistrySnapshot;
+
+//! Parses a registry snapshot in the format produced by `ddxt!hello`, one
+//! export per line:
+//!   <module> @ <ordinal> [<name> [<alias>]] = <address>
+//!
+//! Blank lines, lines starting with '#', and lines without an '@' token (e.g.,
+//! the "Registered exports" header) are ignored.
+//!
+//! Returns false and sets `error_line` to the 1-based line number of the first
+//! malformed entry on failure.
+bool RSParse(const char *text, RegistrySnapshot *snapshot,
+             uint32_t *error_line);
+
+//! Reads and parses the snapshot file at the given path.
+bool RSLoadFile(const char *path, RegistrySnapshot *snapshot,
+                uint32_t *error_line);
+
+void RSFree(RegistrySnapshot *snapshot);
+
+bool RSGetMethodByOrdinal(const RegistrySnapshot *snapshot,
+                          const char *module_name, uint32_t ordinal,
+                          uint32_t *result);
+bool RSGetMethodByName(const RegistrySnapshot *snapshot,
+                       const char *module_name, const char *name,
+                       uint32_t *result);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // DYNDXT_LOADER_TOOLS_COMMON_REGISTRY_SNAPSHOT_H
@@ -0,0 +1,188 @@
+#include "lz4_compress.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Matches are always at least this many bytes long.
+#define MIN_MATCH 4
+
+// The final LAST_LITERALS bytes of a block must be literals and the last match
+// must begin at least MATCH_FINISH_LIMIT bytes before the end of the block.
+#define LAST_LITERALS 5
+#define MATCH_FINISH_LIMIT 12
+
+// Matches may reference at most this many bytes of previous input.
+#define MAX_DISTANCE 0xFFFF
+
+#define HASH_BITS 16
+#define HASH_SIZE (1 << HASH_BITS)
+
+// The chain table is indexed by position within the match window.
+#define CHAIN_SIZE 0x10000
+#define CHAIN_MASK (CHAIN_SIZE - 1)
+
+// Maximum number of candidates examined per position. Compression happens once
+// on the host, so ratio is favored over speed.
+#define MAX_SEARCH_DEPTH 256
+
+// Length nibble value indicating that additional length bytes follow.
+#define LENGTH_EXTENDED 0x0F
+
+#define NO_POSITION 0xFFFFFFFF
+
+typedef struct MatchFinder {
+  const uint8_t *input;
+  uint32_t *head;
+  uint32_t *chain;
+  // Next position to be inserted into the hash chains.
+  uint32_t next_insert;
+} MatchFinder;
+
+uint32_t LZ4CompressBound(uint32_t input_size) {
+  return input_size + input_size / 255 + 16;
+}
+
+static uint32_t Read32(const uint8_t *data) {
+  uint32_t ret;
+  memcpy(&ret, data, sizeof(ret));
+  return ret;
+}
+
+static uint32_t Hash(const uint8_t *data) {
+  return (Read32(data) * 2654435761U) >> (32 - HASH_BITS);
+}
+
+static void InsertUpTo(MatchFinder *finder, uint32_t position) {
+  while (finder->next_insert < position) {
+    uint32_t hash = Hash(finder->input + finder->next_insert);
+    finder->chain[finder->next_insert & CHAIN_MASK] = finder->head[hash];
+    finder->head[hash] = finder->next_insert;
+    ++finder->next_insert;
+  }
+}
+
+// Finds the longest match for the data at `position` that ends before
+// `match_limit`. Returns the match length or 0 if there is no usable match.
+static uint32_t FindMatch(MatchFinder *finder, uint32_t position,
+                          uint32_t match_limit, uint32_t *match_position) {
+  InsertUpTo(finder, position);
+
+  const uint8_t *input = finder->input;
+  uint32_t best_length = 0;
+  uint32_t candidate = finder->head[Hash(input + position)];
+  for (uint32_t depth = 0; depth < MAX_SEARCH_DEPTH; ++depth) {
+    if (candidate == NO_POSITION || position - candidate > MAX_DISTANCE) {
+      break;
+    }
+
+    if (input[candidate + best_length] == input[position + best_length] &&
+        Read32(input + candidate) == Read32(input + position)) {
+      uint32_t length = MIN_MATCH;
+      while (position + length < match_limit &&
+             input[candidate + length] == input[position + length]) {
+        ++length;
+      }
+      if (length > best_length) {
+        best_length = length;
+        *match_position = candidate;
+        if (position + length == match_limit) {
+          break;
+        }
+      }
+    }
+
+    candidate = finder->chain[candidate & CHAIN_MASK];
+  }
+
+  return best_length;
+}
+
+static uint8_t *WriteLength(uint8_t *output, uint32_t length) {
+  while (length >= 0xFF) {
+    *output++ = 0xFF;
+    length -= 0xFF;
+  }
+  *output++ = (uint8_t)length;
+  return output;
+}
+
+static uint8_t *WriteSequence(uint8_t *output, const uint8_t *literals,
+                              uint32_t literal_length, uint32_t match_offset,
+                              uint32_t match_length) {
+  uint8_t *token = output++;
+  *token = (literal_length < LENGTH_EXTENDED ? literal_length : LENGTH_EXTENDED)
+           << 4;
+  if (literal_length >= LENGTH_EXTENDED) {
+    output = WriteLength(output, literal_length - LENGTH_EXTENDED);
+  }
+  memcpy(output, literals, literal_length);
+  output += literal_length;
+
+  if (!match_length) {
+    return output;
+  }
+
+  *output++ = (uint8_t)match_offset;
+  *output++ = (uint8_t)(match_offset >> 8);
+
+  match_length -= MIN_MATCH;
+  if (match_length < LENGTH_EXTENDED) {
+    *token |= match_length;
+    return output;
+  }
+  *token |= LENGTH_EXTENDED;
+  return WriteLength(output, match_length - LENGTH_EXTENDED);
+}
+
+uint32_t LZ4Compress(const void *input, uint32_t input_size, void *output) {
+  const uint8_t *in = (const uint8_t *)input;
+  uint8_t *out = (uint8_t *)output;
+  uint32_t literal_start = 0;
+
+  if (input_size > MATCH_FINISH_LIMIT) {
+    MatchFinder finder;
+    finder.input = in;
+    finder.head = malloc(HASH_SIZE * sizeof(*finder.head));
+    finder.chain = malloc(CHAIN_SIZE * sizeof(*finder.chain));
+    finder.next_insert = 0;
+    if (!finder.head || !finder.chain) {
+      free(finder.head);
+      free(finder.chain);
+      return 0;
+    }
+    memset(finder.head, 0xFF, HASH_SIZE * sizeof(*finder.head));
+
+    uint32_t match_start_limit = input_size - MATCH_FINISH_LIMIT;
+    uint32_t match_limit = input_size - LAST_LITERALS;
+    uint32_t position = 0;
+    while (position < match_start_limit) {
+      uint32_t match_position;
+      uint32_t length =
+          FindMatch(&finder, position, match_limit, &match_position);
+      if (!length) {
+        ++position;
+        continue;
+      }
+
+      // Extend the match backwards into the pending literals.
+      while (position > literal_start && match_position &&
+             in[position - 1] == in[match_position - 1]) {
+        --position;
+        --match_position;
+        ++length;
+      }
+
+      out = WriteSequence(out, in + literal_start, position - literal_start,
+                          position - match_position, length);
+      position += length;
+      literal_start = position;
+    }
+
+    free(finder.head);
+    free(finder.chain);
+  }
+
+  out = WriteSequence(out, in + literal_start, input_size - literal_start, 0,
+                      0);
+  return out - (uint8_t *)output;
+}
@@ -0,0 +1,25 @@
+#ifndef DYNDXT_LOADER_TOOLS_COMPRESS_LZ4_COMPRESS_H
+#define DYNDXT_LOADER_TOOLS_COMPRESS_LZ4_COMPRESS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Returns the maximum size of the output of LZ4Compress for an input of
+//! `input_size` bytes.
+uint32_t LZ4CompressBound(uint32_t input_size);
+
+//! Compresses `input` into a single LZ4 block that may be decoded by the
+//! loader's LZ4Stream* methods (or any LZ4 block decompressor).
+//!
+//! `output` must be at least LZ4CompressBound(input_size) bytes. Returns the
+//! size of the compressed data.
+uint32_t LZ4Compress(const void *input, uint32_t input_size, void *output);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // DYNDXT_LOADER_TOOLS_COMPRESS_LZ4_COMPRESS_H
@@ -0,0 +1,84 @@
+// Compresses a plugin DLL for transfer via `ddxt!load codec=lz4`.
+//
+// Usage:
+//   dyndxt_compress <plugin.dll> <output.lz4>
+//
+// On success the parameters for `ddxt!load` are printed to stdout. The `hash`
+// parameter allows the target to load the image from its cache, if present,
+// without the compressed data being sent.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lz4_compress.h"
+#include "sha256.h"
+
+static void *ReadFile(const char *path, uint32_t *size) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    return NULL;
+  }
+
+  fseek(fp, 0, SEEK_END);
+  long file_size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  void *ret = malloc(file_size ? file_size : 1);
+  if (ret && fread(ret, 1, file_size, fp) != (size_t)file_size) {
+    free(ret);
+    ret = NULL;
+  }
+  fclose(fp);
+
+  *size = (uint32_t)file_size;
+  return ret;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <plugin.dll> <output.lz4>\n", argv[0]);
+    return 1;
+  }
+
+  uint32_t size;
+  void *input = ReadFile(argv[1], &size);
+  if (!input) {
+    fprintf(stderr, "Failed to read %s\n", argv[1]);
+    return 1;
+  }
+
+  void *output = malloc(LZ4CompressBound(size));
+  uint32_t compressed_size = output ? LZ4Compress(input, size, output) : 0;
+  if (!compressed_size) {
+    fprintf(stderr, "Compression failed\n");
+    free(output);
+    free(input);
+    return 1;
+  }
+
+  int ret = 0;
+  FILE *fp = fopen(argv[2], "wb");
+  if (!fp || fwrite(output, 1, compressed_size, fp) != compressed_size) {
+    fprintf(stderr, "Failed to write %s\n", argv[2]);
+    ret = 1;
+  } else {
+    SHA256Context sha256;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    SHA256Init(&sha256);
+    SHA256Update(&sha256, input, size);
+    SHA256Final(&sha256, digest);
+
+    printf("size=0x%X csize=0x%X codec=lz4 hash=", size, compressed_size);
+    for (uint32_t i = 0; i < sizeof(digest); ++i) {
+      printf("%02x", digest[i]);
+    }
+    printf("\n");
+  }
+  if (fp) {
+    fclose(fp);
+  }
+
+  free(output);
+  free(input);
+  return ret;
+}
@@ -0,0 +1,205 @@
+#include "image_diff.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image_patch.h"
+
+// Number of bytes hashed to find candidate matches in the base image.
+#define HASH_WINDOW 8
+
+// Copies shorter than this are emitted as inserts, as the copy operation would
+// not be meaningfully smaller.
+#define MIN_COPY 12
+
+#define HASH_BITS 16
+#define HASH_SIZE (1 << HASH_BITS)
+
+// Maximum number of candidates examined per position.
+#define MAX_SEARCH_DEPTH 64
+
+#define NO_POSITION 0xFFFFFFFF
+
+typedef struct PatchBuffer {
+  uint8_t *data;
+  uint32_t size;
+  uint32_t capacity;
+} PatchBuffer;
+
+typedef struct BaseIndex {
+  const uint8_t *base;
+  uint32_t base_size;
+  uint32_t *head;
+  // Previous position with the same hash, indexed by base position.
+  uint32_t *chain;
+} BaseIndex;
+
+static uint32_t Hash(const uint8_t *data) {
+  uint64_t value;
+  memcpy(&value, data, sizeof(value));
+  return (uint32_t)((value * 0x9E3779B97F4A7C15ULL) >> (64 - HASH_BITS));
+}
+
+static bool Reserve(PatchBuffer *buffer, uint32_t size) {
+  if (buffer->capacity - buffer->size >= size) {
+    return true;
+  }
+
+  uint32_t capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+  while (capacity - buffer->size < size) {
+    capacity *= 2;
+  }
+  uint8_t *data = realloc(buffer->data, capacity);
+  if (!data) {
+    return false;
+  }
+  buffer->data = data;
+  buffer->capacity = capacity;
+  return true;
+}
+
+static void WriteArgument(PatchBuffer *buffer, uint32_t value) {
+  while (value >= 0x80) {
+    buffer->data[buffer->size++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  buffer->data[buffer->size++] = (uint8_t)value;
+}
+
+// Opcode plus up to two 5 byte arguments.
+#define MAX_OP_HEADER_SIZE 11
+
+static bool WriteInsert(PatchBuffer *buffer, const uint8_t *data,
+                        uint32_t length) {
+  if (!length) {
+    return true;
+  }
+  if (!Reserve(buffer, MAX_OP_HEADER_SIZE + length)) {
+    return false;
+  }
+  buffer->data[buffer->size++] = IMAGE_PATCH_OP_INSERT;
+  WriteArgument(buffer, length);
+  memcpy(buffer->data + buffer->size, data, length);
+  buffer->size += length;
+  return true;
+}
+
+static bool WriteCopy(PatchBuffer *buffer, uint32_t offset, uint32_t length) {
+  if (!Reserve(buffer, MAX_OP_HEADER_SIZE)) {
+    return false;
+  }
+  buffer->data[buffer->size++] = IMAGE_PATCH_OP_COPY;
+  WriteArgument(buffer, offset);
+  WriteArgument(buffer, length);
+  return true;
+}
+
+static bool BuildIndex(BaseIndex *index, const uint8_t *base,
+                       uint32_t base_size) {
+  index->base = base;
+  index->base_size = base_size;
+  index->head = malloc(HASH_SIZE * sizeof(*index->head));
+  index->chain = malloc((base_size ? base_size : 1) * sizeof(*index->chain));
+  if (!index->head || !index->chain) {
+    free(index->head);
+    free(index->chain);
+    return false;
+  }
+  memset(index->head, 0xFF, HASH_SIZE * sizeof(*index->head));
+
+  for (uint32_t i = 0; i + HASH_WINDOW <= base_size; ++i) {
+    uint32_t hash = Hash(base + i);
+    index->chain[i] = index->head[hash];
+    index->head[hash] = i;
+  }
+  return true;
+}
+
+// Finds the longest run of `target` starting at `position` that also appears in
+// the base image.
+static uint32_t FindMatch(const BaseIndex *index, const uint8_t *target,
+                          uint32_t target_size, uint32_t position,
+                          uint32_t *match_offset) {
+  const uint8_t *base = index->base;
+  uint32_t best_length = 0;
+  uint32_t candidate = index->head[Hash(target + position)];
+  for (uint32_t depth = 0; depth < MAX_SEARCH_DEPTH; ++depth) {
+    if (candidate == NO_POSITION) {
+      break;
+    }
+
+    uint32_t limit = index->base_size - candidate;
+    if (limit > target_size - position) {
+      limit = target_size - position;
+    }
+    uint32_t length = 0;
+    while (length < limit &&
+           base[candidate + length] == target[position + length]) {
+      ++length;
+    }
+    if (length > best_length) {
+      best_length = length;
+      *match_offset = candidate;
+      if (length == limit) {
+        break;
+      }
+    }
+
+    candidate = index->chain[candidate];
+  }
+  return best_length;
+}
+
+uint8_t *IDCreatePatch(const void *base, uint32_t base_size,
+                       const void *target, uint32_t target_size,
+                       uint32_t *patch_size) {
+  const uint8_t *base_bytes = (const uint8_t *)base;
+  const uint8_t *target_bytes = (const uint8_t *)target;
+
+  BaseIndex index;
+  if (!BuildIndex(&index, base_bytes, base_size)) {
+    return NULL;
+  }
+
+  PatchBuffer buffer = {NULL, 0, 0};
+  bool ok = Reserve(&buffer, MAX_OP_HEADER_SIZE);
+  uint32_t insert_start = 0;
+  uint32_t position = 0;
+  while (ok && position + HASH_WINDOW <= target_size) {
+    uint32_t offset;
+    uint32_t length =
+        FindMatch(&index, target_bytes, target_size, position, &offset);
+    if (length < MIN_COPY) {
+      ++position;
+      continue;
+    }
+
+    // Extend the match backwards into the pending insert.
+    while (position > insert_start && offset &&
+           base_bytes[offset - 1] == target_bytes[position - 1]) {
+      --position;
+      --offset;
+      ++length;
+    }
+
+    ok = WriteInsert(&buffer, target_bytes + insert_start,
+                     position - insert_start) &&
+         WriteCopy(&buffer, offset, length);
+    position += length;
+    insert_start = position;
+  }
+
+  ok = ok && WriteInsert(&buffer, target_bytes + insert_start,
+                         target_size - insert_start);
+
+  free(index.head);
+  free(index.chain);
+
+  if (!ok) {
+    free(buffer.data);
+    return NULL;
+  }
+  *patch_size = buffer.size;
+  return buffer.data;
+}
@@ -0,0 +1,23 @@
+#ifndef DYNDXT_LOADER_TOOLS_DELTA_IMAGE_DIFF_H
+#define DYNDXT_LOADER_TOOLS_DELTA_IMAGE_DIFF_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Generates a patch in the format described by image_patch.h that rebuilds
+//! `target` from `base`.
+//!
+//! Returns a malloc-allocated buffer that must be released by the caller, or
+//! NULL on failure. `patch_size` is set to the size of the patch.
+uint8_t *IDCreatePatch(const void *base, uint32_t base_size,
+                       const void *target, uint32_t target_size,
+                       uint32_t *patch_size);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // DYNDXT_LOADER_TOOLS_DELTA_IMAGE_DIFF_H
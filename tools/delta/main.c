@@ -0,0 +1,101 @@
+// Generates a patch that rebuilds a plugin DLL from a previously loaded version
+// for transfer via `ddxt!loaddelta`.
+//
+// Usage:
+//   dyndxt_diff <base.dll> <plugin.dll> <output.patch>
+//
+// `base.dll` must be the exact image that was previously sent to the target via
+// `ddxt!load hash=...`. On success the parameters for `ddxt!loaddelta` are
+// printed to stdout.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "image_diff.h"
+#include "sha256.h"
+
+static void *ReadFile(const char *path, uint32_t *size) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    return NULL;
+  }
+
+  fseek(fp, 0, SEEK_END);
+  long file_size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  void *ret = malloc(file_size ? file_size : 1);
+  if (ret && fread(ret, 1, file_size, fp) != (size_t)file_size) {
+    free(ret);
+    ret = NULL;
+  }
+  fclose(fp);
+
+  *size = (uint32_t)file_size;
+  return ret;
+}
+
+static void PrintDigest(const char *key, const void *data, uint32_t size) {
+  SHA256Context sha256;
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  SHA256Init(&sha256);
+  SHA256Update(&sha256, data, size);
+  SHA256Final(&sha256, digest);
+
+  printf("%s=", key);
+  for (uint32_t i = 0; i < sizeof(digest); ++i) {
+    printf("%02x", digest[i]);
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc != 4) {
+    fprintf(stderr, "Usage: %s <base.dll> <plugin.dll> <output.patch>\n",
+            argv[0]);
+    return 1;
+  }
+
+  uint32_t base_size;
+  void *base = ReadFile(argv[1], &base_size);
+  if (!base) {
+    fprintf(stderr, "Failed to read %s\n", argv[1]);
+    return 1;
+  }
+
+  uint32_t size;
+  void *input = ReadFile(argv[2], &size);
+  if (!input) {
+    fprintf(stderr, "Failed to read %s\n", argv[2]);
+    free(base);
+    return 1;
+  }
+
+  uint32_t patch_size;
+  uint8_t *patch = IDCreatePatch(base, base_size, input, size, &patch_size);
+  if (!patch) {
+    fprintf(stderr, "Patch generation failed\n");
+    free(input);
+    free(base);
+    return 1;
+  }
+
+  int ret = 0;
+  FILE *fp = fopen(argv[3], "wb");
+  if (!fp || fwrite(patch, 1, patch_size, fp) != patch_size) {
+    fprintf(stderr, "Failed to write %s\n", argv[3]);
+    ret = 1;
+  } else {
+    PrintDigest("base_hash", base, base_size);
+    printf(" size=0x%X psize=0x%X ", size, patch_size);
+    PrintDigest("hash", input, size);
+    printf("\n");
+  }
+  if (fp) {
+    fclose(fp);
+  }
+
+  free(patch);
+  free(input);
+  free(base);
+  return ret;
+}
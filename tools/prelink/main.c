@@ -0,0 +1,100 @@
+// Produces a fully import-bound image relocated for a fixed base address, so
+// that the target only needs to copy it into place and call the entrypoint.
+//
+// Usage:
+//   dyndxt_prelink <plugin.dll> <registry_snapshot.txt> <base> <output.bin>
+//
+// The registry snapshot is the output of `ddxt!hello` and `base` is an address
+// returned by `ddxt!reserve`. On success the parameters for `ddxt!install` are
+// printed to stdout.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prelink.h"
+#include "registry_snapshot.h"
+
+static void *ReadFile(const char *path, uint32_t *size) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    return NULL;
+  }
+
+  fseek(fp, 0, SEEK_END);
+  long file_size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  void *ret = malloc(file_size);
+  if (ret && fread(ret, 1, file_size, fp) != (size_t)file_size) {
+    free(ret);
+    ret = NULL;
+  }
+  fclose(fp);
+
+  *size = (uint32_t)file_size;
+  return ret;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 5) {
+    fprintf(stderr,
+            "Usage: %s <plugin.dll> <registry_snapshot.txt> <base> "
+            "<output.bin>\n",
+            argv[0]);
+    return 1;
+  }
+
+  char *end;
+  hwaddress_t base = (hwaddress_t)strtoul(argv[3], &end, 0);
+  if (end == argv[3] || *end || !base) {
+    fprintf(stderr, "Invalid base address '%s'\n", argv[3]);
+    return 1;
+  }
+
+  RegistrySnapshot snapshot;
+  uint32_t error_line;
+  if (!RSLoadFile(argv[2], &snapshot, &error_line)) {
+    if (error_line) {
+      fprintf(stderr, "Malformed registry snapshot %s:%u\n", argv[2],
+              error_line);
+    } else {
+      fprintf(stderr, "Failed to read registry snapshot %s\n", argv[2]);
+    }
+    return 1;
+  }
+
+  DLLContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.input.raw_data = ReadFile(argv[1], &ctx.input.raw_data_size);
+  if (!ctx.input.raw_data) {
+    fprintf(stderr, "Failed to read %s\n", argv[1]);
+    RSFree(&snapshot);
+    return 1;
+  }
+
+  int ret = 0;
+  if (!PLPrelinkImage(&ctx, &snapshot, base)) {
+    fprintf(stderr, "Prelink failed %d::%d %s\n", ctx.output.context,
+            ctx.output.status, ctx.output.error_message);
+    ret = 1;
+  } else {
+    uint32_t image_size = ctx.output.header.OptionalHeader.SizeOfImage;
+    FILE *fp = fopen(argv[4], "wb");
+    if (!fp || fwrite(ctx.output.image, 1, image_size, fp) != image_size) {
+      fprintf(stderr, "Failed to write %s\n", argv[4]);
+      ret = 1;
+    } else {
+      printf("base=0x%X length=0x%X entrypoint=0x%X\n", base, image_size,
+             ctx.output.entrypoint);
+    }
+    if (fp) {
+      fclose(fp);
+    }
+  }
+
+  DLLFreeContext(&ctx, false);
+  free((void *)ctx.input.raw_data);
+  RSFree(&snapshot);
+  return ret;
+}
@@ -0,0 +1,45 @@
+#include "prelink.h"
+
+#include <stdlib.h>
+
+// The loader callbacks do not accept a context parameter, so the snapshot being
+// linked against is tracked globally for the duration of PLResolveImports.
+static const RegistrySnapshot *active_snapshot = NULL;
+
+static void *Alloc(size_t size) { return calloc(1, size); }
+
+static bool ResolveImportByOrdinal(const char *image, uint32_t ordinal,
+                                   uint32_t *result) {
+  return RSGetMethodByOrdinal(active_snapshot, image, ordinal, result);
+}
+
+static bool ResolveImportByName(const char *image, const char *name,
+                                uint32_t *result) {
+  return RSGetMethodByName(active_snapshot, image, name, result);
+}
+
+bool PLResolveImports(DLLContext *ctx, const RegistrySnapshot *snapshot) {
+  ctx->input.alloc = Alloc;
+  ctx->input.free = free;
+  ctx->input.resolve_import_by_ordinal = ResolveImportByOrdinal;
+  ctx->input.resolve_import_by_name = ResolveImportByName;
+
+  active_snapshot = snapshot;
+  bool ret = DLLParse(ctx);
+  active_snapshot = NULL;
+  return ret;
+}
+
+bool PLPrelinkImage(DLLContext *ctx, const RegistrySnapshot *snapshot,
+                    hwaddress_t base) {
+  if (!PLResolveImports(ctx, snapshot)) {
+    return false;
+  }
+
+  if (!DLLRelocate(ctx, base)) {
+    DLLFreeContext(ctx, false);
+    return false;
+  }
+
+  return true;
+}
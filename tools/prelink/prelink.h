@@ -0,0 +1,34 @@
+#ifndef DYNDXT_LOADER_TOOLS_PRELINK_PRELINK_H
+#define DYNDXT_LOADER_TOOLS_PRELINK_PRELINK_H
+
+#include <stdbool.h>
+
+#include "dll_loader.h"
+#include "registry_snapshot.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Loads the raw DLL described by `ctx->input.raw_data` and
+//! `ctx->input.raw_data_size`, resolves all imports against the given snapshot
+//! and relocates the result to `base`.
+//!
+//! On success `ctx->output.image` contains an image that may be copied verbatim
+//! to `base` on the target (e.g., via `ddxt!install`) and
+//! `ctx->output.entrypoint` is the absolute address of its entrypoint. The
+//! caller must release the context via DLLFreeContext.
+bool PLPrelinkImage(DLLContext *ctx, const RegistrySnapshot *snapshot,
+                    hwaddress_t base);
+
+//! Loads the raw DLL described by `ctx->input.raw_data` and
+//! `ctx->input.raw_data_size` and resolves all imports against the given
+//! snapshot without relocating the result. The caller must release the context
+//! via DLLFreeContext.
+bool PLResolveImports(DLLContext *ctx, const RegistrySnapshot *snapshot);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // DYNDXT_LOADER_TOOLS_PRELINK_PRELINK_H